@@ -0,0 +1,316 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * DSIGBatchVerifier := Verify many independent signed documents on a pool of threads
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/dsig/DSIGBatchVerifier.hpp>
+#include <xsec/dsig/DSIGSignature.hpp>
+#include <xsec/enc/XSECCryptoKey.hpp>
+#include <xsec/enc/XSECCryptoException.hpp>
+#include <xsec/enc/XSECKeyInfoResolver.hpp>
+#include <xsec/framework/XSECError.hpp>
+#include <xsec/framework/XSECProvider.hpp>
+#include <xsec/utils/XSECDOMUtils.hpp>
+#include <xsec/utils/XSECParserPool.hpp>
+
+// Xerces
+
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/util/XMLException.hpp>
+
+#include <string.h>
+#include <algorithm>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Job
+// --------------------------------------------------------------------------------
+
+DSIGBatchVerifier::Job::Job(const DSIGBatchVerifier * verifier,
+							DOMDocument * doc,
+							const XMLByte * bytes,
+							unsigned int bytesLen,
+							const XSECKeyInfoResolver * resolver,
+							const XSECCryptoKey * key,
+							void * userData) :
+mp_digestCache(verifier->mp_digestCache),
+mp_verificationCache(verifier->mp_verificationCache),
+mp_doc(doc),
+m_ownsDoc(false),
+mp_bytes(NULL),
+m_bytesLen(0),
+mp_resolver(NULL),
+mp_key(NULL),
+mp_userData(userData),
+m_result(BATCH_PENDING) {
+
+	m_errStr.sbTranscodeIn("");
+
+	// Everything is copied now, so the worker never touches anything
+	// the caller might change or release
+
+	if (bytes != NULL) {
+		XSECnew(mp_bytes, XMLByte[bytesLen > 0 ? bytesLen : 1]);
+		memcpy(mp_bytes, bytes, bytesLen);
+		m_bytesLen = bytesLen;
+	}
+
+	if (resolver != NULL)
+		mp_resolver = resolver->clone();
+
+	if (key != NULL)
+		mp_key = key->clone();
+
+}
+
+DSIGBatchVerifier::Job::~Job() {
+
+	if (m_ownsDoc && mp_doc != NULL)
+		mp_doc->release();
+
+	delete[] mp_bytes;
+	delete mp_resolver;
+	delete mp_key;
+
+}
+
+const XMLCh * DSIGBatchVerifier::Job::getErrorMessage(void) const {
+
+	return m_errStr.rawXMLChBuffer();
+
+}
+
+void DSIGBatchVerifier::Job::parse(void) {
+
+	// Uses the worker thread's pooled parser
+
+	XSECParserPoolJanitor j_parser;
+	XercesDOMParser * parser = j_parser.get();
+
+	MemBufInputSource src(mp_bytes, m_bytesLen, "XSECBatchVerifierJob");
+	parser->parse(src);
+
+	if (parser->getErrorCount() > 0) {
+
+		throw XSECException(XSECException::SigVfyError,
+			"DSIGBatchVerifier - Errors occurred parsing the document");
+
+	}
+
+	mp_doc = parser->adoptDocument();
+	m_ownsDoc = true;
+	j_parser.done();
+
+	// No longer needed
+	delete[] mp_bytes;
+	mp_bytes = NULL;
+	m_bytesLen = 0;
+
+}
+
+void DSIGBatchVerifier::Job::verify(void) {
+
+	if (mp_doc == NULL)
+		parse();
+
+	DOMNode * sigNode = findDSIGNode(mp_doc, "Signature");
+
+	if (sigNode == NULL) {
+
+		throw XSECException(XSECException::SigVfyError,
+			"DSIGBatchVerifier - No Signature element found in the document");
+
+	}
+
+	XSECProvider prov;
+	DSIGSignature * sig = prov.newSignatureFromDOM(mp_doc, sigNode);
+
+	if (mp_key != NULL) {
+		// Ownership passes to the signature
+		sig->setSigningKey(mp_key);
+		mp_key = NULL;
+	}
+	else if (mp_resolver != NULL)
+		sig->setKeyInfoResolver(mp_resolver);
+
+	sig->setDigestCache(mp_digestCache);
+	sig->setVerificationCache(mp_verificationCache);
+
+	sig->load();
+
+	if (sig->verify())
+		m_result = BATCH_VALID;
+	else {
+		m_errStr.sbXMLChIn(sig->getErrMsgs());
+		m_result = BATCH_INVALID;
+	}
+
+}
+
+void DSIGBatchVerifier::Job::run(void) {
+
+	try {
+		verify();
+	}
+	catch (XSECException &e) {
+		m_errStr.sbXMLChIn(e.getMsg());
+		m_result = BATCH_ERROR;
+	}
+	catch (XSECCryptoException &e) {
+		m_errStr.sbTranscodeIn(e.getMsg());
+		m_result = BATCH_ERROR;
+	}
+	catch (const XMLException &e) {
+		m_errStr.sbXMLChIn(e.getMessage());
+		m_result = BATCH_ERROR;
+	}
+	catch (...) {
+		m_errStr.sbTranscodeIn("DSIGBatchVerifier - Unknown error verifying the document");
+		m_result = BATCH_ERROR;
+	}
+
+}
+
+// --------------------------------------------------------------------------------
+//           Construct/Destroy
+// --------------------------------------------------------------------------------
+
+DSIGBatchVerifier::DSIGBatchVerifier(unsigned int numThreads) :
+mp_pool(NULL),
+mp_digestCache(NULL),
+mp_verificationCache(NULL) {
+
+	if (numThreads == 0)
+		numThreads = XSECThreadPool::getDefaultThreadCount();
+
+	XSECnew(mp_pool, XSECThreadPool(numThreads));
+
+}
+
+DSIGBatchVerifier::~DSIGBatchVerifier() {
+
+	JobVectorType::iterator i;
+	for (i = m_jobs.begin(); i != m_jobs.end(); ++i) {
+		mp_pool->wait(*i);
+		delete *i;
+	}
+
+	delete mp_pool;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Jobs
+// --------------------------------------------------------------------------------
+
+DSIGBatchVerifier::Job * DSIGBatchVerifier::addJob(Job * job) {
+
+	m_jobs.push_back(job);
+	mp_pool->submit(job);
+
+	return job;
+
+}
+
+DSIGBatchVerifier::Job * DSIGBatchVerifier::submit(DOMDocument * doc,
+												   const XSECKeyInfoResolver * resolver,
+												   const XSECCryptoKey * key,
+												   void * userData) {
+
+	if (doc == NULL) {
+
+		throw XSECException(XSECException::SigVfyError,
+			"DSIGBatchVerifier::submit - NULL document passed in");
+
+	}
+
+	Job * job;
+	XSECnew(job, Job(this, doc, NULL, 0, resolver, key, userData));
+
+	return addJob(job);
+
+}
+
+DSIGBatchVerifier::Job * DSIGBatchVerifier::submit(const XMLByte * bytes,
+												   unsigned int bytesLen,
+												   const XSECKeyInfoResolver * resolver,
+												   const XSECCryptoKey * key,
+												   void * userData) {
+
+	if (bytes == NULL) {
+
+		throw XSECException(XSECException::SigVfyError,
+			"DSIGBatchVerifier::submit - NULL document passed in");
+
+	}
+
+	Job * job;
+	XSECnew(job, Job(this, NULL, bytes, bytesLen, resolver, key, userData));
+
+	return addJob(job);
+
+}
+
+DSIGBatchVerifier::BatchResult DSIGBatchVerifier::wait(Job * job) {
+
+	mp_pool->wait(job);
+	return job->getResult();
+
+}
+
+void DSIGBatchVerifier::waitAll(void) {
+
+	JobVectorType::iterator i;
+	for (i = m_jobs.begin(); i != m_jobs.end(); ++i)
+		mp_pool->wait(*i);
+
+}
+
+void DSIGBatchVerifier::releaseJob(Job * job) {
+
+	JobVectorType::iterator i = std::find(m_jobs.begin(), m_jobs.end(), job);
+
+	if (i == m_jobs.end()) {
+
+		throw XSECException(XSECException::InternalError,
+			"DSIGBatchVerifier::releaseJob - Job not owned by this verifier");
+
+	}
+
+	mp_pool->wait(job);
+	m_jobs.erase(i);
+	delete job;
+
+}
+
+unsigned int DSIGBatchVerifier::getThreadCount(void) const {
+
+	return mp_pool->getThreadCount();
+
+}
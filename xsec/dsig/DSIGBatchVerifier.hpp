@@ -0,0 +1,294 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * DSIGBatchVerifier := Verify many independent signed documents on a pool of threads
+ *
+ * $Id$
+ *
+ */
+
+#ifndef DSIGBATCHVERIFIER_INCLUDE
+#define DSIGBATCHVERIFIER_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
+#include <xsec/utils/XSECThreadPool.hpp>
+
+#include <xercesc/dom/DOM.hpp>
+
+#include <vector>
+
+class XSECCryptoKey;
+class XSECKeyInfoResolver;
+class XSECDigestCache;
+class XSECVerificationCache;
+
+/**
+ * @ingroup pubsig
+ */
+/*\@{*/
+
+/**
+ * @brief Verify a stream of independent signatures concurrently
+ *
+ * Each job is a document holding a signature, together with the key (or
+ * the KeyInfo resolver) to check it with.  Jobs are verified on a pool of
+ * worker threads owned by the verifier, so the caller can keep submitting
+ * while earlier jobs run, and collect results as they complete.
+ *
+ * Documents may be handed over either already parsed or as bytes.  Bytes
+ * are parsed on the worker, using that thread's pooled parser, so parser
+ * set up is paid once per thread rather than once per document.
+ *
+ * Any XSECDigestCache or XSECVerificationCache set on the verifier is
+ * shared by every job, so keys and resources that recur across the
+ * stream are only processed once.
+ *
+ * @note The verifier itself is driven from one thread - submit(),
+ * wait() and releaseJob() are not to be called concurrently.
+ */
+
+class DSIG_EXPORT DSIGBatchVerifier {
+
+public:
+
+	/**
+	 * \brief Outcome of a job
+	 */
+
+	enum BatchResult {
+		BATCH_PENDING,				// Not yet complete
+		BATCH_VALID,				// Signature and all References verified
+		BATCH_INVALID,				// Verification failed
+		BATCH_ERROR					// Could not be processed (see error message)
+	};
+
+	/**
+	 * \brief A document being verified
+	 *
+	 * Jobs are owned by the verifier.  Results may only be read once
+	 * DSIGBatchVerifier::wait() has returned for the job.
+	 */
+
+	class DSIG_EXPORT Job : public XSECThreadPool::Task {
+
+	public:
+
+		/** \brief The result of the verification */
+		BatchResult getResult(void) const {return m_result;}
+
+		/**
+		 * \brief Why the job was not valid
+		 *
+		 * @returns The signature's error messages (BATCH_INVALID) or the
+		 * exception text (BATCH_ERROR).  Empty for a valid signature.
+		 */
+
+		const XMLCh * getErrorMessage(void) const;
+
+		/**
+		 * \brief The document verified
+		 *
+		 * For jobs submitted as bytes this is the parsed document, which
+		 * is owned by the job (NULL if it could not be parsed).
+		 */
+
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * getDocument(void) const {return mp_doc;}
+
+		/** \brief The value passed to submit() to identify the job */
+		void * getUserData(void) const {return mp_userData;}
+
+		// Used by the worker threads
+		void run(void);
+
+	private:
+
+		friend class DSIGBatchVerifier;
+
+		Job(const DSIGBatchVerifier * verifier,
+			XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc,
+			const XMLByte * bytes,
+			unsigned int bytesLen,
+			const XSECKeyInfoResolver * resolver,
+			const XSECCryptoKey * key,
+			void * userData);
+		~Job();
+
+		void parse(void);
+		void verify(void);
+
+		// Unimplemented
+		Job(const Job &);
+		Job & operator = (const Job &);
+
+		XSECDigestCache			* mp_digestCache;
+		XSECVerificationCache	* mp_verificationCache;
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument
+								* mp_doc;
+		bool					m_ownsDoc;
+		XMLByte					* mp_bytes;
+		unsigned int			m_bytesLen;
+		XSECKeyInfoResolver		* mp_resolver;
+		XSECCryptoKey			* mp_key;
+		void					* mp_userData;
+		BatchResult				m_result;
+		safeBuffer				m_errStr;
+
+	};
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	/**
+	 * \brief Start a verifier
+	 *
+	 * @param numThreads Number of worker threads.  0 uses one per
+	 * online CPU.
+	 */
+
+	DSIGBatchVerifier(unsigned int numThreads = 0);
+
+	/**
+	 * \brief Finish all outstanding jobs and release them
+	 */
+
+	~DSIGBatchVerifier();
+
+	//@}
+
+	/** @name Jobs */
+	//@{
+
+	/**
+	 * \brief Queue a parsed document for verification
+	 *
+	 * The first Signature element in the document is verified.
+	 *
+	 * @param doc The document.  Not owned, and must not be changed or
+	 * released until wait() has returned for the job.
+	 * @param resolver Resolver used to find the key from the KeyInfo.  It
+	 * is cloned, so may be released once submit() returns.
+	 * @param key Key to verify with, in place of the resolver.  Cloned -
+	 * if the key is shareable (see XSECCryptoKey::isShareable()) every job
+	 * then works from the one set of key material.
+	 * @param userData Passed back by Job::getUserData()
+	 * @returns The job, owned by the verifier
+	 */
+
+	Job * submit(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc,
+		const XSECKeyInfoResolver * resolver,
+		const XSECCryptoKey * key = NULL,
+		void * userData = NULL);
+
+	/**
+	 * \brief Queue a serialised document for verification
+	 *
+	 * The bytes are copied, and parsed on the worker thread.
+	 *
+	 * @see submit(DOMDocument *, const XSECKeyInfoResolver *, const XSECCryptoKey *, void *)
+	 */
+
+	Job * submit(const XMLByte * bytes,
+		unsigned int bytesLen,
+		const XSECKeyInfoResolver * resolver,
+		const XSECCryptoKey * key = NULL,
+		void * userData = NULL);
+
+	/**
+	 * \brief Wait for a job to finish
+	 *
+	 * @returns The job's result
+	 */
+
+	BatchResult wait(Job * job);
+
+	/**
+	 * \brief Wait for all outstanding jobs
+	 */
+
+	void waitAll(void);
+
+	/**
+	 * \brief Release a job (waiting for it first if necessary)
+	 */
+
+	void releaseJob(Job * job);
+
+	/**
+	 * \brief Number of jobs submitted and not yet released
+	 */
+
+	unsigned int getJobCount(void) const {return (unsigned int) m_jobs.size();}
+
+	/**
+	 * \brief Number of worker threads
+	 */
+
+	unsigned int getThreadCount(void) const;
+
+	//@}
+
+	/** @name Shared state */
+	//@{
+
+	/**
+	 * \brief Share a digest cache between all jobs
+	 *
+	 * @note Not owned.  Only affects jobs submitted afterwards.
+	 * @see DSIGSignature::setDigestCache
+	 */
+
+	void setDigestCache(XSECDigestCache * cache) {mp_digestCache = cache;}
+
+	/**
+	 * \brief Share a verification cache between all jobs
+	 *
+	 * @note Not owned.  Only affects jobs submitted afterwards.
+	 * @see DSIGSignature::setVerificationCache
+	 */
+
+	void setVerificationCache(XSECVerificationCache * cache) {mp_verificationCache = cache;}
+
+	//@}
+
+private:
+
+	friend class Job;
+
+	typedef std::vector<Job *>		JobVectorType;
+
+	Job * addJob(Job * job);
+
+	// Unimplemented
+	DSIGBatchVerifier(const DSIGBatchVerifier &);
+	DSIGBatchVerifier & operator = (const DSIGBatchVerifier &);
+
+	XSECThreadPool				* mp_pool;
+	JobVectorType				m_jobs;
+	XSECDigestCache				* mp_digestCache;
+	XSECVerificationCache		* mp_verificationCache;
+
+};
+
+/*\@}*/
+
+#endif /* DSIGBATCHVERIFIER_INCLUDE */
@@ -50,14 +50,21 @@
 #include <xsec/dsig/DSIGTransformXPathFilter.hpp>
 #include <xsec/dsig/DSIGTransformXSL.hpp>
 #include <xsec/dsig/DSIGTransformC14n.hpp>
+#include <xsec/dsig/DSIGAlgorithmHandlerDefault.hpp>
 
 #include <xsec/framework/XSECError.hpp>
 #include <xsec/framework/XSECEnv.hpp>
 #include <xsec/framework/XSECAlgorithmHandler.hpp>
 #include <xsec/framework/XSECAlgorithmMapper.hpp>
+#include <xsec/framework/XSECDigestCache.hpp>
+#include <xsec/framework/XSECDocumentContext.hpp>
+#include <xsec/framework/XSECURIResolver.hpp>
+#include <xsec/canon/XSECC14n20010315.hpp>
 #include <xsec/utils/XSECPlatformUtils.hpp>
 #include <xsec/utils/XSECDOMUtils.hpp>
 #include <xsec/utils/XSECBinTXFMInputStream.hpp>
+#include <xsec/utils/XSECThreadPool.hpp>
+#include <xsec/utils/XSECIdIndex.hpp>
 
 // Xerces
 
@@ -68,6 +75,12 @@
 XERCES_CPP_NAMESPACE_USE
 
 #include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
 
 // --------------------------------------------------------------------------------
 //           Some useful strings
@@ -127,6 +140,10 @@ DSIGReference::DSIGReference(const XSECEnv * env, DOMNode *dom) {
 	m_isManifest = false;
 	mp_algorithmURI = NULL;
 	m_loaded = false;
+	mp_planHandler = NULL;
+	m_planGeneration = 0;
+	m_planHashMethod = HASH_NONE;
+	mp_lastInputRoot = NULL;
 
 }
 
@@ -147,6 +164,10 @@ DSIGReference::DSIGReference(const XSECEnv * env) {
 	m_isManifest = false;
 	mp_algorithmURI = NULL;
 	m_loaded = false;
+	mp_planHandler = NULL;
+	m_planGeneration = 0;
+	m_planHashMethod = HASH_NONE;
+	mp_lastInputRoot = NULL;
 
 };
 
@@ -207,6 +228,8 @@ void DSIGReference::addTransform(DSIGTransform * txfm, DOMElement * txfmElt) {
 	mp_env->doPrettyPrint(mp_transformsNode);
 
 	mp_transformList->addTransform(txfm);
+
+	mp_lastInputRoot = NULL;
 }
 
 
@@ -388,6 +411,8 @@ DOMElement *DSIGReference::createBlankReference(const XMLCh * URI,
 	mp_env->doPrettyPrint(ret);
 	mp_hashValueNode->appendChild(doc->createTextNode(MAKE_UNICODE_STRING("Not yet calculated")));
 
+	mp_planHandler = NULL;
+
 	m_loaded = true;
 	return ret;
 
@@ -401,6 +426,7 @@ DOMElement *DSIGReference::createBlankReference(const XMLCh * URI,
 void DSIGReference::setPreHashTXFM(TXFMBase * t) {
 
 	mp_preHash = t;
+	mp_lastInputRoot = NULL;
 
 }
 
@@ -567,6 +593,58 @@ TXFMBase * DSIGReference::getURIBaseTXFM(DOMDocument * doc,
 
 }
 
+// --------------------------------------------------------------------------------
+//           Digest plan
+// --------------------------------------------------------------------------------
+
+XSECAlgorithmHandler * DSIGReference::getPlanHandler(void) {
+
+	// The handler for the DigestMethod is only mapped again when the
+	// algorithm, or the mapper's handlers or policy, have changed.  For
+	// the library's own handler, the digest it would append is kept too.
+
+	const XSECAlgorithmMapper * mapper = XSECPlatformUtils::g_algorithmMapper;
+	unsigned int generation = mapper->getGeneration();
+
+	if (mp_planHandler != NULL && m_planGeneration == generation)
+		return mp_planHandler;
+
+	// Throws if the algorithm is not allowed
+	XSECAlgorithmHandler * handler = mapper->mapURIToHandler(mp_algorithmURI);
+
+	m_planHashMethod = HASH_NONE;
+
+	if (handler != NULL && dynamic_cast<DSIGAlgorithmHandlerDefault *>(handler) != NULL) {
+
+		hashMethod hm;
+		if (XSECmapURIToHashMethod(mp_algorithmURI, hm)) {
+
+			switch (hm) {
+
+			case HASH_SHA1 :
+			case HASH_MD5 :
+			case HASH_SHA224 :
+			case HASH_SHA256 :
+			case HASH_SHA384 :
+			case HASH_SHA512 :
+				m_planHashMethod = hm;
+				break;
+			default :
+				break;
+
+			}
+
+		}
+
+	}
+
+	mp_planHandler = handler;
+	m_planGeneration = generation;
+
+	return handler;
+
+}
+
 // --------------------------------------------------------------------------------
 //           load
 // --------------------------------------------------------------------------------
@@ -786,6 +864,8 @@ void DSIGReference::load(void) {
 
 	} /* m_isManifest */
 
+	mp_planHandler = NULL;
+
 	m_loaded = true;
 
 }
@@ -892,360 +972,1568 @@ XSECBinTXFMInputStream * DSIGReference::makeBinInputStream(void) const {
 }
 
 // --------------------------------------------------------------------------------
-//           Hash a reference list
+//           Verify reference list
 // --------------------------------------------------------------------------------
 
+// --------------------------------------------------------------------------------
+//           Concurrent digesting of external references
+// --------------------------------------------------------------------------------
+
+// Digests one Reference on a worker thread.  The cache key and the
+// DigestValue are dealt with by the caller.  External References are
+// digested using a copy of the environment (and so their own clone of the
+// URI resolver).  Same-document References only ever read the DOM, and so
+// can share the signature's environment.
+
+class DSIGReferenceHashTask : public XSECThreadPool::Task {
+
+public:
+
+	enum HashResult {
+		HASH_PENDING,
+		HASH_OK,				// Digest available
+		HASH_NETWORK_ERROR,		// Resource could not be fetched
+		HASH_RETRY				// Anything else - re-run on the caller
+	};
+
+	DSIGReferenceHashTask(DSIGReference * ref, bool sameDocument) :
+		mp_ref(ref),
+		mp_env(ref->mp_env),
+		mp_ownedEnv(NULL),
+		m_sameDocument(sameDocument),
+		m_result(HASH_PENDING),
+		m_hashLen(0),
+		m_useCache(false),
+		mp_context(NULL),
+		m_submitted(false) {
+
+		if (!sameDocument) {
+			XSECnew(mp_ownedEnv, XSECEnv(*(ref->mp_env)));
+			mp_env = mp_ownedEnv;
+		}
 
-void DSIGReference::hashReferenceList(DSIGReferenceList *lst, bool interlocking) {
+	}
 
-// Run through a list of hashes and checkHash for each one
+	~DSIGReferenceHashTask() {
 
-	DSIGReference * r;
-	int i = (int) lst->getSize();
-	safeBuffer errStr;
-	errStr.sbXMLChIn(DSIGConstants::s_unicodeStrEmpty);
-
-	// Run a VERY naieve process at the moment that assumes the list will "settle"
-	// after N iterations through the list.  This will settle any inter-locking references
-	// Where a hash in a later calculated reference could impact an already calculated hash
-	// in a previous references
-	//
-	// If interlocking is set to false, assume there are no interacting <Reference> nodes
+		delete mp_ownedEnv;
 
-	do {
+	}
 
-		for (int j = 0; j < i; ++j) {
+	void run(void) {
 
-			r = lst->item(j);
+		XSEC_USING_XERCES(NetAccessorException);
 
-			// If this is a manifest we need to set all the references in the manifest as well
+		try {
+			m_hashLen = mp_ref->calculateDigest(m_hash, CRYPTO_MAX_HASH_SIZE, mp_env);
+			m_result = HASH_OK;
+		}
+		catch (NetAccessorException &e) {
+			m_result = HASH_NETWORK_ERROR;
+			m_errMsg.sbXMLChIn(e.getMessage());
+		}
+		catch (XSECException &e) {
+			if (e.getType() == XSECException::HTTPURIInputStreamError) {
+				m_result = HASH_NETWORK_ERROR;
+				m_errMsg.sbXMLChIn(e.getMsg());
+			}
+			else
+				m_result = HASH_RETRY;
+		}
+		catch (...) {
+			m_result = HASH_RETRY;
+		}
 
-			if (r->isManifest())
-				hashReferenceList(r->getManifestReferenceList());
+	}
 
-			// Re-ordered as per suggestion by Peter Gubis to make it more likely
-			// that hashes are correct on first pass when manifests are involved
+	// Look for the digest in the environment's cache (or, if useContext
+	// is set, the document context).  Returns true if it was found (and
+	// so there's no need to run the task).
 
-			r->setHash();
+	bool lookupCache(bool useContext) {
 
+		m_useCache = mp_ref->makeDigestCacheKey(m_cacheKey);
+		if (m_useCache)
+			m_hashLen = mp_ref->mp_env->getDigestCache()->lookup(
+				m_cacheKey.rawCharBuffer(), m_hash, CRYPTO_MAX_HASH_SIZE);
+		else if (useContext && mp_ref->makeDocumentDigestKey(m_cacheKey)) {
+			mp_context = mp_ref->mp_env->getDocumentContext();
+			m_hashLen = mp_context->lookupDigest(
+				m_cacheKey.rawCharBuffer(), m_hash, CRYPTO_MAX_HASH_SIZE);
 		}
 
-	} while (interlocking && !DSIGReference::verifyReferenceList(lst, errStr) && i-- >= 0);
-}
+		if (m_hashLen == 0)
+			return false;
 
-// --------------------------------------------------------------------------------
-//           Verify reference list
-// --------------------------------------------------------------------------------
+		m_result = HASH_OK;
+		m_useCache = false;
+		mp_context = NULL;
+		return true;
 
-bool DSIGReference::verifyReferenceList(DSIGReferenceList * lst, safeBuffer &errStr) {
+	}
 
-	// Run through a list of hashes and checkHash for each one
+	void storeCache(void) {
 
-	XSEC_USING_XERCES(NetAccessorException);
+		if (m_hashLen == 0)
+			return;
 
-	DSIGReference * r;
-	bool res = true;
+		if (m_useCache)
+			mp_ref->mp_env->getDigestCache()->store(
+				m_cacheKey.rawCharBuffer(), m_hash, m_hashLen);
+		else if (mp_context != NULL)
+			mp_context->storeDigest(m_cacheKey.rawCharBuffer(), m_hash, m_hashLen);
 
-	int size = (lst ? (int) lst->getSize() : 0);
+	}
 
-	for (int i = 0; i < size; ++i) {
+	DSIGReference		* mp_ref;
+	const XSECEnv		* mp_env;
+	XSECEnv				* mp_ownedEnv;
+	bool				m_sameDocument;
+	HashResult			m_result;
+	XMLByte				m_hash[CRYPTO_MAX_HASH_SIZE];
+	unsigned int		m_hashLen;
+	bool				m_useCache;
+	XSECDocumentContext	* mp_context;
+	safeBuffer			m_cacheKey;
+	bool				m_submitted;
+	safeBuffer			m_errMsg;		// Why a HASH_NETWORK_ERROR happened
+
+private:
+
+	// Unimplemented
+	DSIGReferenceHashTask(const DSIGReferenceHashTask &);
+	DSIGReferenceHashTask & operator = (const DSIGReferenceHashTask &);
 
-		r = lst->item(i);
+};
 
-		try {
-			if (!r->checkHash()) {
+namespace {
 
-				// Failed
-				errStr.sbXMLChCat("Reference URI=\"");
-				errStr.sbXMLChCat(r->getURI());
-				errStr.sbXMLChCat("\" failed to verify\n");
+	typedef std::vector<DSIGReferenceHashTask *> HashTaskVectorType;
 
-				res = false;
+	// Makes sure nothing is left running against a reference list
+	// (for example when a Reference throws part way through)
+
+	class HashTaskVectorJanitor {
+
+	public:
+
+		HashTaskVectorJanitor(XSECThreadPool * pool, HashTaskVectorType & tasks) :
+			mp_pool(pool), m_tasks(tasks) {}
+
+		~HashTaskVectorJanitor() {
 
+			HashTaskVectorType::iterator i;
+			for (i = m_tasks.begin(); i != m_tasks.end(); ++i) {
+				if (*i != NULL) {
+					if ((*i)->m_submitted)
+						mp_pool->wait(*i);
+					delete *i;
+				}
 			}
+
 		}
-		catch (NetAccessorException e) {
 
-			res = false;
+	private:
 
-			errStr.sbXMLChCat("Error accessing network URI=\"");
-			errStr.sbXMLChCat(r->getURI());
-			errStr.sbXMLChCat("\".  Reference failed to verify\n");
+		XSECThreadPool			* mp_pool;
+		HashTaskVectorType		& m_tasks;
 
-		}
-		catch (XSECException e) {
+	};
 
-			if (e.getType() != XSECException::HTTPURIInputStreamError)
-				throw;
+	// Wait for any workers still reading the document
 
-			res = false;
+	unsigned int waitForSameDocumentTasks(XSECThreadPool * pool, HashTaskVectorType & tasks) {
 
-			errStr.sbXMLChCat("Error accessing network URI=\"");
-			errStr.sbXMLChCat(r->getURI());
-			errStr.sbXMLChCat("\".  Reference failed to verify\n");
+		unsigned int done = 0;
 
+		HashTaskVectorType::iterator i;
+		for (i = tasks.begin(); i != tasks.end(); ++i) {
+			if (*i != NULL && (*i)->m_submitted && (*i)->m_sameDocument) {
+				pool->wait(*i);
+				(*i)->m_submitted = false;
+				++done;
+			}
 		}
 
-		// if a manifest, check the manifest list
-		if (r->isManifest())
-			res = res & verifyReferenceList(r->getManifestReferenceList(), errStr);
+		return done;
 
 	}
 
-	return res;
-}
-
-// --------------------------------------------------------------------------------
-//           processTransforms
-// --------------------------------------------------------------------------------
+	// Work out how (and how far ahead) References may be digested on the
+	// library thread pool.  Returns NULL if they may not.
 
-TXFMChain * DSIGReference::createTXFMChainFromList(TXFMBase * input,
-							DSIGTransformList * lst) {
+	XSECThreadPool * getHashTaskPool(const XSECEnv * env, unsigned int & limit, bool & parallel) {
 
-	TXFMChain * ret;
-	XSECnew(ret, TXFMChain(input));
+		limit = 0;
+		parallel = false;
 
-	if (lst == NULL)
-		return ret;
+		if (XSECPlatformUtils::HasReferenceLoggingSink())
+			return NULL;
 
-	Janitor<TXFMChain> j_ret(ret);
+		limit = env->getExternalReferencePrefetch();
+		parallel = env->getParallelReferenceVerification();
 
-	DSIGTransformList::TransformListVectorType::size_type size, i;
+		if (limit == 0 && !parallel)
+			return NULL;
 
-	size = lst->getSize();
+		XSECThreadPool * pool = XSECPlatformUtils::GetThreadPool();
 
-	if (size > 0) {
+		// Keep every worker (and the caller) busy
+		if (parallel && limit < 2 * (pool->getThreadCount() + 1))
+			limit = 2 * (pool->getThreadCount() + 1);
 
-		// Iterate through the list
+		// Same document workers must only ever read the DOM and what is
+		// shared between them.  The Id index is the only thing they would
+		// otherwise build on first use, so it is built here.
+		DOMDocument * doc = env->getParentDocument();
+		if (parallel && doc != NULL && env->getIdByAttributeName())
+			XSECIdIndex::getIndex(doc, env)->prepare(doc, env);
 
-		for (i = 0; i < size; ++i) {
+		return pool;
 
-			lst->item(i)->appendTransformer(ret);
+	}
 
-		}
+}
 
-	}
+bool DSIGReference::canPrefetch(void) {
 
-	j_ret.release();
-	return ret;
+	// Only external resources whose transforms work purely on the fetched
+	// bytes (and never look at the signature's document) can be moved off
+	// the calling thread
 
-}
+	if (mp_URI == NULL || mp_URI[0] == 0 || mp_URI[0] == chPound ||
+		isManifest() || mp_preHash != NULL)
+		return false;
 
-// --------------------------------------------------------------------------------
-//           loadTransforms
-// --------------------------------------------------------------------------------
+	if (mp_transformList == NULL)
+		return true;
 
-DSIGTransformList * DSIGReference::loadTransforms(
-							DOMNode *transformsNode,
-							XSECSafeBufferFormatter * formatter,
-							const XSECEnv * env) {
+	DSIGTransformList::TransformListVectorType::size_type size, i;
+	size = mp_transformList->getSize();
 
-	// This is defined as a static function, not because it makes use of any static variables
-	// in the DSIGReference class, but to neatly link it to the other users
+	for (i = 0; i < size; ++i) {
 
-	if (transformsNode == 0 || (!strEquals(getDSIGLocalName(transformsNode), "Transforms") &&
-		!strEquals(getXENCLocalName(transformsNode), "Transforms"))) {
+		DSIGTransform * t = mp_transformList->item(i);
 
-			throw XSECException(XSECException::ExpectedDSIGChildNotFound,
-					"Expected <Transforms> in function DSIGReference::processTransforms");
+		switch (t->getTransformType()) {
 
-	}
+		case TRANSFORM_BASE64 :
+		case TRANSFORM_C14N :
+		case TRANSFORM_C14N11 :
+			break;
 
-	// Create the list
-	DSIGTransformList * lst;
-	XSECnew(lst, DSIGTransformList());
-	Janitor<DSIGTransformList> j_lst(lst);
+		case TRANSFORM_EXC_C14N :
+			// The prefix list is transcoded via the shared formatter
+			if (((DSIGTransformC14n *) t)->getPrefixList() != NULL)
+				return false;
+			break;
 
-	// Find First transform
+		default :
+			return false;
 
-	DOMNode * transforms = transformsNode->getFirstChild();
-	while (transforms != NULL && transforms->getNodeType() != DOMNode::ELEMENT_NODE)
-		transforms = transforms->getNextSibling();
+		}
 
-	while (transforms != NULL) {
+	}
 
-		// Process each transform in turn
-		if (!strEquals(getDSIGLocalName(transforms), "Transform")) {
+	return true;
 
-			// Not what we expected to see!
-			safeBuffer tmp, error;
+}
 
-			error << (*formatter << getDSIGLocalName(transforms));
-			tmp.sbStrcpyIn("Unknown attribute in <Transforms> - Expected <Transform> found ");
-			tmp.sbStrcatIn(error);
-			tmp.sbStrcatIn(">.");
+bool DSIGReference::canVerifyConcurrently(void) {
 
-			throw XSECException(XSECException::ExpectedDSIGChildNotFound, error.rawCharBuffer());
+	// Same document References whose transforms only ever read the DOM.
+	// Anything that might expand namespaces into the document (XPath,
+	// XSLT, Base64 over nodes) or share state (an inclusive prefix list
+	// is transcoded via the environment's formatter) stays on the caller.
 
-		}
+	if (mp_URI == NULL || (mp_URI[0] != 0 && mp_URI[0] != chPound) || mp_preHash != NULL)
+		return false;
 
-		DOMNamedNodeMap * transformAtts = transforms->getAttributes();
+	if (mp_transformList == NULL)
+		return true;
 
-		unsigned int i;
+	DSIGTransformList::TransformListVectorType::size_type size, i;
+	size = mp_transformList->getSize();
 
-		for (i = 0; i < transformAtts->getLength() &&
-				!strEquals(transformAtts->item(i)->getNodeName(), DSIGConstants::s_unicodeStrAlgorithm); ++i);
+	for (i = 0; i < size; ++i) {
 
-		if (i == transformAtts->getLength()) {
+		DSIGTransform * t = mp_transformList->item(i);
 
-			throw XSECException(XSECException::ExpectedDSIGChildNotFound,
-				"Algorithm attribute not found in <Transform> element");
+		switch (t->getTransformType()) {
 
-		}
+		case TRANSFORM_C14N :
+		case TRANSFORM_C14N11 :
+			break;
 
-		safeBuffer algorithm;
-		algorithm << (*formatter << transformAtts->item(i)->getNodeValue());
+		case TRANSFORM_EXC_C14N :
+			if (((DSIGTransformC14n *) t)->getPrefixList() != NULL)
+				return false;
+			break;
 
-		// Determine what the transform is
+#if !defined(XSEC_USE_XPATH_ENVELOPE)
+		case TRANSFORM_ENVELOPED_SIGNATURE :
+			break;
+#endif
 
-		if (algorithm.sbStrcmp(URI_ID_BASE64) == 0) {
+		default :
+			return false;
 
-			DSIGTransformBase64 * b;
-			XSECnew(b, DSIGTransformBase64(env, transforms));
-			lst->addTransform(b);
-			b->load();
 		}
 
-		else if (algorithm.sbStrcmp(URI_ID_XPATH) == 0) {
+	}
 
-			DSIGTransformXPath * x;
-			XSECnew(x, DSIGTransformXPath(env, transforms));
-			lst->addTransform(x);
-			x->load();
-		}
+	return true;
 
-		else if (algorithm.sbStrcmp(URI_ID_XPF) == 0) {
+}
 
-			DSIGTransformXPathFilter * xpf;
+bool DSIGReference::mayModifyDocument(void) {
 
-			XSECnew(xpf, DSIGTransformXPathFilter(env, transforms));
-			lst->addTransform(xpf);
-			xpf->load();
+	// Processing of anything that cannot run concurrently with readers
+	// of the DOM (including any manifest it refers to)
 
-		}
+	if (!canVerifyConcurrently() && !canPrefetch())
+		return true;
 
-		else if (algorithm.sbStrcmp(URI_ID_ENVELOPE) == 0) {
+	if (isManifest()) {
 
-			DSIGTransformEnvelope * e;
-			XSECnew(e, DSIGTransformEnvelope(env, transforms));
-			lst->addTransform(e);
-			e->load();
-		}
+		DSIGReferenceList * lst = getManifestReferenceList();
+		int size = (lst ? (int) lst->getSize() : 0);
 
-		else if (algorithm.sbStrcmp(URI_ID_XSLT) == 0) {
+		for (int i = 0; i < size; ++i)
+			if (lst->item(i)->mayModifyDocument())
+				return true;
 
-			DSIGTransformXSL * x;
-			XSECnew(x, DSIGTransformXSL(env, transforms));
-			lst->addTransform(x);
-			x->load();
+	}
 
-		}
+	return false;
 
+}
 
-		else if (algorithm.sbStrcmp(URI_ID_C14N_COM) == 0 ||
-			     algorithm.sbStrcmp(URI_ID_C14N_NOC) == 0 ||
-			     algorithm.sbStrcmp(URI_ID_C14N11_COM) == 0 ||
-                 algorithm.sbStrcmp(URI_ID_C14N11_NOC) == 0 ||
-				 algorithm.sbStrcmp(URI_ID_EXC_C14N_COM) == 0 ||
-				 algorithm.sbStrcmp(URI_ID_EXC_C14N_NOC) == 0) {
+// --------------------------------------------------------------------------------
+//           Digest small References together
+// --------------------------------------------------------------------------------
 
-			DSIGTransformC14n * c;
-			XSECnew(c, DSIGTransformC14n(env, transforms));
-			lst->addTransform(c);
-			c->load();
+// Largest canonical form that is held in memory to be digested with others
+#define XSEC_BATCH_DIGEST_LIMIT		4096
 
-		}
+namespace {
 
-		else {
+	// Undoes what a chain did to the document, however it is left
 
-			// Not what we expected to see!
-			safeBuffer tmp;
+	class ExpandedNameSpacesJanitor {
 
-			tmp.sbStrcpyIn("Unknown transform : ");
-			tmp.sbStrcatIn(algorithm);
-			tmp.sbStrcatIn(" found.");
+	public:
 
-			throw XSECException(XSECException::UnknownTransform, tmp.rawCharBuffer());
-		}
+		ExpandedNameSpacesJanitor(TXFMBase * t) : mp_txfm(t) {}
+		~ExpandedNameSpacesJanitor() {mp_txfm->deleteExpandedNameSpaces();}
 
-		// Now find next element
+	private:
 
-		transforms = transforms->getNextSibling();
-		while (transforms != NULL && transforms->getNodeType() != DOMNode::ELEMENT_NODE)
-			transforms = transforms->getNextSibling();
+		TXFMBase					* mp_txfm;
 
-	} /* while (transforms != NULL) */
+	};
 
-	j_lst.release();
-	return lst;
 }
 
-// --------------------------------------------------------------------------------
-//           Set hash
-// --------------------------------------------------------------------------------
+bool DSIGReference::canBatchDigest(XSECCryptoHash::HashType & type) {
 
-void DSIGReference::setHash(void) {
+	// Only References that can be read in any order, and whose digest is
+	// calculated by the library itself
 
-	// First determine the hash value
-	XMLByte calculatedHashVal[CRYPTO_MAX_HASH_SIZE];	// The hash that we determined
-	unsigned int calculatedHashLen;
-	XMLByte base64Hash [CRYPTO_MAX_HASH_SIZE * 2];
-	unsigned int base64HashLen;
+	if (!m_loaded || XSECPlatformUtils::HasReferenceLoggingSink() || !canVerifyConcurrently())
+		return false;
 
-	calculatedHashLen = calculateHash(calculatedHashVal, CRYPTO_MAX_HASH_SIZE);
+	if (getPlanHandler() == NULL)
+		return false;
 
-	// Calculate the base64 value
+	switch (m_planHashMethod) {
+
+	case HASH_SHA1 :
+		type = XSECCryptoHash::HASH_SHA1;
+		break;
+	case HASH_MD5 :
+		type = XSECCryptoHash::HASH_MD5;
+		break;
+	case HASH_SHA224 :
+		type = XSECCryptoHash::HASH_SHA224;
+		break;
+	case HASH_SHA256 :
+		type = XSECCryptoHash::HASH_SHA256;
+		break;
+	case HASH_SHA384 :
+		type = XSECCryptoHash::HASH_SHA384;
+		break;
+	case HASH_SHA512 :
+		type = XSECCryptoHash::HASH_SHA512;
+		break;
+	default :
+		return false;
 
-	XSECCryptoBase64 *	b64 = XSECPlatformUtils::g_cryptoProvider->base64();
+	}
 
-	if (!b64) {
+	return true;
 
-		throw XSECException(XSECException::CryptoProviderError,
-				"Error requesting Base64 object from Crypto Provider");
+}
+
+TXFMChain * DSIGReference::createInputChain(void) {
+
+	// The transforms up to (but not including) the digest, ending in bytes
+
+	TXFMBase * currentTxfm = getURIBaseTXFM(mp_referenceNode->getOwnerDocument(),
+		mp_URI, mp_env);
+
+	TXFMChain * chain = createTXFMChainFromList(currentTxfm, mp_transformList);
+	Janitor<TXFMChain> j_chain(chain);
+
+	if (chain->getLastTxfm()->getOutputType() == TXFMBase::DOM_NODES) {
+
+		TXFMC14n * c14n;
+		XSECnew(c14n, TXFMC14n(mp_referenceNode->getOwnerDocument()));
+		chain->appendTxfm(c14n);
+
+	}
+
+	j_chain.release();
+	return chain;
+
+}
+
+bool DSIGReference::readBatchInput(std::vector<XMLByte> & buf, unsigned int limit,
+									XSECCryptoHash::HashType type,
+									XMLByte * toFill, unsigned int & hashLen) {
+
+	// Canonicalise into buf.  If the result is bigger than limit, the
+	// input is not read again - what has been read and the rest are
+	// digested here, the digest is placed in toFill and false is returned
+	// (buf is then of no use).
+
+	TXFMChain * chain = createInputChain();
+	Janitor<TXFMChain> j_chain(chain);
+
+	TXFMBase * last = chain->getLastTxfm();
+	ExpandedNameSpacesJanitor j_ns(last);
+
+	// One byte over the limit is enough to know it does not fit
+	buf.resize(limit + 1);
+
+	unsigned int len = 0, n;
+	while (len <= limit && (n = last->readBytes(&buf[len], limit + 1 - len)) > 0)
+		len += n;
+
+	if (len <= limit) {
+		buf.resize(len);
+		return true;
+	}
+
+	XSECCryptoHash * h = XSECPlatformUtils::g_cryptoProvider->hashByType(type);
+	Janitor<XSECCryptoHash> j_h(h);
+
+	h->hash(&buf[0], len);
+	while ((n = last->readBytes(&buf[0], limit + 1)) > 0)
+		h->hash(&buf[0], n);
+
+	hashLen = h->finish(toFill, CRYPTO_MAX_HASH_SIZE);
+	return false;
+
+}
+
+void DSIGReference::digestSharedInput(const XSECCryptoHash::HashType * types, int count,
+									  XMLByte * toFill, unsigned int * hashLens) {
+
+	// For References that differ only in their DigestMethod.  The input is
+	// canonicalised once and each chunk fed to a digest of every type asked
+	// for.  The digest for types[i] is placed at
+	// toFill + (i * CRYPTO_MAX_HASH_SIZE).
+
+	XSECCryptoHash * digests[XSECCryptoHash::HASH_SHA512 + 1];
+	memset(digests, 0, sizeof(digests));
+
+	TXFMChain * chain = createInputChain();
+	Janitor<TXFMChain> j_chain(chain);
+
+	TXFMBase * last = chain->getLastTxfm();
+	ExpandedNameSpacesJanitor j_ns(last);
+
+	try {
+
+		int i;
+		for (i = 0; i < count; ++i)
+			if (digests[types[i]] == NULL)
+				digests[types[i]] = XSECPlatformUtils::g_cryptoProvider->hashByType(types[i]);
+
+		XMLByte buf[2048];
+		unsigned int n;
+
+		while ((n = last->readBytes(buf, 2048)) > 0)
+			for (i = 0; i <= XSECCryptoHash::HASH_SHA512; ++i)
+				if (digests[i] != NULL)
+					digests[i]->hash(buf, n);
+
+		// Same type, same digest
+		for (i = 0; i < count; ++i) {
+
+			int j;
+			for (j = 0; j < i && types[j] != types[i]; ++j);
+
+			if (j < i) {
+				memcpy(&toFill[i * CRYPTO_MAX_HASH_SIZE], &toFill[j * CRYPTO_MAX_HASH_SIZE], hashLens[j]);
+				hashLens[i] = hashLens[j];
+			}
+			else
+				hashLens[i] = digests[types[i]]->finish(&toFill[i * CRYPTO_MAX_HASH_SIZE],
+					CRYPTO_MAX_HASH_SIZE);
+
+		}
+
+	}
+	catch (...) {
+
+		for (int i = 0; i <= XSECCryptoHash::HASH_SHA512; ++i)
+			delete digests[i];
+		throw;
+
+	}
+
+	for (int i = 0; i <= XSECCryptoHash::HASH_SHA512; ++i)
+		delete digests[i];
+
+}
+
+void DSIGReference::digestReferenceBatch(DSIGReferenceList * lst,
+										 std::vector<XMLByte> & hashes,
+										 std::vector<unsigned int> & hashLens) {
+
+	// Digests what it can of the same document References in the list
+	// before they are checked.  Anything left with a length of 0 (including
+	// any failure along the way) is done in turn by verifyReferenceList().
+	//
+	// References that read the same input with the same transforms (say a
+	// SHA-1 and a SHA-256 Reference to the same element) have it
+	// canonicalised once, with every digest they need calculated together.
+	//
+	// For many small References, setting up a digest costs as much as the
+	// digest itself.  Those that canonicalise to no more than
+	// XSEC_BATCH_DIGEST_LIMIT bytes are read into memory and handed to the
+	// provider together, a batch per digest algorithm.  Larger ones are
+	// digested as they are read.
+
+	int size = (lst ? (int) lst->getSize() : 0);
+
+	hashes.assign(size * CRYPTO_MAX_HASH_SIZE, 0);
+	hashLens.assign(size, 0);
+
+	std::vector<XSECCryptoHash::HashType> types(size, XSECCryptoHash::HASH_NONE);
+	std::vector<safeBuffer> keys(size);
+	std::vector<bool> shared(size, false);
+
+	typedef std::map<std::string, std::vector<int> > InputMapType;
+	InputMapType sameInput;
+	safeBuffer inputKey;
+
+	int i;
+	for (i = 0; i < size; ++i) {
+
+		DSIGReference * r = lst->item(i);
+		XSECCryptoHash::HashType type;
+
+		if (!r->canBatchDigest(type))
+			continue;
+
+		// The digest may already be known to the document context
+
+		if (r->makeDocumentDigestKey(keys[i])) {
+
+			shared[i] = true;
+			hashLens[i] = r->mp_env->getDocumentContext()->lookupDigest(
+				keys[i].rawCharBuffer(), &hashes[i * CRYPTO_MAX_HASH_SIZE], CRYPTO_MAX_HASH_SIZE);
+
+			if (hashLens[i] > 0)
+				continue;
+
+		}
+
+		types[i] = type;
+
+		r->makeInputKey(inputKey, false);
+		sameInput[inputKey.rawCharBuffer()].push_back(i);
+
+	}
+
+	// Shared inputs
+
+	std::vector<XSECCryptoHash::HashType> groupTypes;
+	InputMapType::iterator it;
+
+	for (it = sameInput.begin(); it != sameInput.end(); ++it) {
+
+		std::vector<int> & members = it->second;
+		int count = (int) members.size();
+
+		if (count < 2)
+			continue;
+
+		groupTypes.clear();
+		int j;
+		for (j = 0; j < count; ++j) {
+			groupTypes.push_back(types[members[j]]);
+			types[members[j]] = XSECCryptoHash::HASH_NONE;
+		}
+
+		std::vector<XMLByte> groupHashes(count * CRYPTO_MAX_HASH_SIZE);
+		std::vector<unsigned int> groupLens(count, 0);
+
+		try {
+
+			lst->item(members[0])->digestSharedInput(&groupTypes[0], count,
+				&groupHashes[0], &groupLens[0]);
+
+		}
+		catch (...) {
+
+			// Will be thrown again when the References are done in turn
+			continue;
+
+		}
+
+		for (j = 0; j < count; ++j) {
+
+			i = members[j];
+			memcpy(&hashes[i * CRYPTO_MAX_HASH_SIZE], &groupHashes[j * CRYPTO_MAX_HASH_SIZE], groupLens[j]);
+			hashLens[i] = groupLens[j];
+
+			if (shared[i] && hashLens[i] > 0)
+				lst->item(i)->mp_env->getDocumentContext()->storeDigest(
+					keys[i].rawCharBuffer(), &hashes[i * CRYPTO_MAX_HASH_SIZE], hashLens[i]);
+
+		}
+
+	}
+
+	// Small inputs
+
+	std::vector<std::vector<XMLByte> > inputs(size);
+
+	for (i = 0; i < size; ++i) {
+
+		if (types[i] == XSECCryptoHash::HASH_NONE)
+			continue;
+
+		try {
+
+			if (!lst->item(i)->readBatchInput(inputs[i], XSEC_BATCH_DIGEST_LIMIT, types[i],
+					&hashes[i * CRYPTO_MAX_HASH_SIZE], hashLens[i])) {
+
+				inputs[i].clear();
+				types[i] = XSECCryptoHash::HASH_NONE;
+
+				if (shared[i] && hashLens[i] > 0)
+					lst->item(i)->mp_env->getDocumentContext()->storeDigest(
+						keys[i].rawCharBuffer(), &hashes[i * CRYPTO_MAX_HASH_SIZE], hashLens[i]);
+
+			}
+
+		}
+		catch (...) {
+
+			inputs[i].clear();
+			types[i] = XSECCryptoHash::HASH_NONE;
+			hashLens[i] = 0;
+
+		}
+
+	}
+
+	// A batch per algorithm
+
+	std::vector<const unsigned char *> batchInputs;
+	std::vector<unsigned int> batchLens;
+	std::vector<int> batchIndex;
+	std::vector<unsigned char> batchOut;
+
+	for (int t = XSECCryptoHash::HASH_SHA1; t <= XSECCryptoHash::HASH_SHA512; ++t) {
+
+		batchInputs.clear();
+		batchLens.clear();
+		batchIndex.clear();
+
+		for (i = 0; i < size; ++i) {
+
+			if (types[i] != t)
+				continue;
+
+			batchInputs.push_back(inputs[i].empty() ? (const unsigned char *) "" : &inputs[i][0]);
+			batchLens.push_back((unsigned int) inputs[i].size());
+			batchIndex.push_back(i);
+
+		}
+
+		if (batchIndex.empty())
+			continue;
+
+		unsigned int count = (unsigned int) batchIndex.size();
+		batchOut.resize(count * CRYPTO_MAX_HASH_SIZE);
+
+		unsigned int len;
+
+		try {
+
+			len = XSECPlatformUtils::g_cryptoProvider->hashBatch((XSECCryptoHash::HashType) t,
+				count, &batchInputs[0], &batchLens[0], &batchOut[0], CRYPTO_MAX_HASH_SIZE);
+
+		}
+		catch (...) {
+
+			len = 0;
+
+		}
+
+		for (unsigned int j = 0; len > 0 && j < count; ++j) {
+
+			i = batchIndex[j];
+			memcpy(&hashes[i * CRYPTO_MAX_HASH_SIZE], &batchOut[j * CRYPTO_MAX_HASH_SIZE], len);
+			hashLens[i] = len;
+
+			if (shared[i])
+				lst->item(i)->mp_env->getDocumentContext()->storeDigest(
+					keys[i].rawCharBuffer(), &hashes[i * CRYPTO_MAX_HASH_SIZE], len);
+
+		}
+
+	}
+
+}
+
+bool DSIGReference::verifyReferenceList(DSIGReferenceList * lst, safeBuffer &errStr) {
+
+	// Run through a list of hashes and checkHash for each one
+
+	XSEC_USING_XERCES(NetAccessorException);
+
+	DSIGReference * r;
+	bool res = true;
+
+	int size = (lst ? (int) lst->getSize() : 0);
+
+	// References may be digested ahead of time on the library thread pool -
+	// external ones if prefetching is on, and (in parallel mode) same
+	// document ones that only read the DOM.  At most limit are outstanding
+	// at once, and results are still dealt with in order, so the outcome
+	// (and error string) is the same as doing them in turn.
+
+	unsigned int limit = 0;
+	bool parallel = false;
+	XSECThreadPool * pool = NULL;
+
+	if (size > 0)
+		pool = getHashTaskPool(lst->item(0)->mp_env, limit, parallel);
+
+	bool prefetch = (limit > 0);
+
+	HashTaskVectorType tasks(size, (DSIGReferenceHashTask *) NULL);
+	HashTaskVectorJanitor j_tasks(pool, tasks);
+
+	// Otherwise, same document References that share an input, or are
+	// small, are digested together before any of them are checked.  They
+	// only read the DOM, so this is no different to checking them in turn.
+
+	std::vector<XMLByte> batchHashes;
+	std::vector<unsigned int> batchHashLens;
+
+	if (!parallel && size > 1)
+		digestReferenceBatch(lst, batchHashes, batchHashLens);
+
+	unsigned int outstanding = 0;
+	int next = 0;
+
+	for (int i = 0; i < size; ++i) {
+
+		while (limit > 0 && outstanding < limit && next < size) {
+
+			DSIGReference * n = lst->item(next);
+
+			bool sameDocument = (parallel && n->m_loaded && n->canVerifyConcurrently());
+
+			if (sameDocument || (prefetch && n->m_loaded && n->canPrefetch())) {
+
+				DSIGReferenceHashTask * t;
+				XSECnew(t, DSIGReferenceHashTask(n, sameDocument));
+				tasks[next] = t;
+
+				// No need to go anywhere if the digest is already known
+				if (!t->lookupCache(true)) {
+					t->m_submitted = true;
+					pool->submit(t);
+					++outstanding;
+				}
+
+			}
+
+			++next;
+
+		}
+
+		r = lst->item(i);
+		DSIGReferenceHashTask * t = tasks[i];
+
+		if (t != NULL && t->m_submitted) {
+			pool->wait(t);
+			--outstanding;
+			t->m_submitted = false;
+		}
+
+		// Nothing may be reading the DOM while it is (potentially) changed
+		if (parallel && (t == NULL ? r->mayModifyDocument() :
+				(r->isManifest() && r->mayModifyDocument())))
+			outstanding -= waitForSameDocumentTasks(pool, tasks);
+
+		try {
+
+			bool ok;
+
+			if (!batchHashLens.empty() && batchHashLens[i] > 0)
+				ok = r->compareHash(&batchHashes[i * CRYPTO_MAX_HASH_SIZE], batchHashLens[i]);
+			else if (t == NULL || t->m_result == DSIGReferenceHashTask::HASH_RETRY)
+				ok = r->checkHashInContext();
+			else if (t->m_result == DSIGReferenceHashTask::HASH_NETWORK_ERROR)
+				throw XSECException(XSECException::HTTPURIInputStreamError,
+					t->m_errMsg.rawXMLChBuffer());
+			else {
+				t->storeCache();
+				ok = r->compareHash(t->m_hash, t->m_hashLen);
+			}
+
+			if (!ok) {
+
+				// Failed
+				errStr.sbXMLChCat("Reference URI=\"");
+				errStr.sbXMLChCat(r->getURI());
+				errStr.sbXMLChCat("\" failed to verify\n");
+
+				res = false;
+
+			}
+		}
+		catch (NetAccessorException e) {
+
+			res = false;
+
+			errStr.sbXMLChCat("Error accessing network URI=\"");
+			errStr.sbXMLChCat(r->getURI());
+			errStr.sbXMLChCat("\".  Reference failed to verify\n");
+
+		}
+		catch (XSECException e) {
+
+			if (e.getType() != XSECException::HTTPURIInputStreamError)
+				throw;
+
+			res = false;
+
+			errStr.sbXMLChCat("Error accessing network URI=\"");
+			errStr.sbXMLChCat(r->getURI());
+			errStr.sbXMLChCat("\".  Reference failed to verify\n");
+
+		}
+
+		// if a manifest, check the manifest list
+		if (r->isManifest())
+			res = res & verifyReferenceList(r->getManifestReferenceList(), errStr);
+
+	}
+
+	return res;
+}
+
+// --------------------------------------------------------------------------------
+//           Hash a reference list
+// --------------------------------------------------------------------------------
+
+namespace {
+
+	typedef std::vector<DSIGReference *> ReferenceVectorType;
+	typedef std::vector<int> IndexVectorType;
+
+	// Every Reference in the list, with those in a Manifest ahead of the
+	// Reference to the Manifest itself
+
+	void flattenReferenceList(DSIGReferenceList * lst, ReferenceVectorType & refs) {
+
+		int size = (lst ? (int) lst->getSize() : 0);
+
+		for (int i = 0; i < size; ++i) {
+
+			DSIGReference * r = lst->item(i);
+			if (r->isManifest())
+				flattenReferenceList(r->getManifestReferenceList(), refs);
+			refs.push_back(r);
+
+		}
+
+	}
+
+	bool isAncestorOrSelf(const DOMNode * ancestor, const DOMNode * n) {
+
+		if (n != NULL && n->getNodeType() == DOMNode::ATTRIBUTE_NODE)
+			n = ((const DOMAttr *) n)->getOwnerElement();
+
+		for (; n != NULL; n = n->getParentNode())
+			if (n == ancestor)
+				return true;
+
+		return false;
+
+	}
+
+	bool checkReferences(ReferenceVectorType & refs) {
+
+		ReferenceVectorType::iterator i;
+		for (i = refs.begin(); i != refs.end(); ++i)
+			if (!(*i)->checkHash())
+				return false;
+
+		return true;
+
+	}
+
+}
+
+DOMNode * DSIGReference::getInputRoot(DOMNode *& excludedSignature) {
+
+	// The node whose subtree this Reference is taken over (if it is in
+	// the same document) and, for an enveloped signature, the Signature
+	// element the transform cuts out of it
+
+	excludedSignature = NULL;
+
+	if (mp_URI == NULL || (mp_URI[0] != 0 && mp_URI[0] != chPound))
+		return NULL;
+
+	DOMDocument * doc = mp_referenceNode->getOwnerDocument();
+	DOMNode * root;
+
+	try {
+
+		TXFMBase * t = getURIBaseTXFM(doc, mp_URI, mp_env);
+		Janitor<TXFMBase> j_t(t);
+
+		root = (t->getNodeType() == TXFMBase::DOM_NODE_DOCUMENT ? doc : t->getFragmentNode());
+
+	}
+	catch (XSECException &) {
+
+		// Will be reported when the Reference is hashed
+		return NULL;
+
+	}
+
+	excludedSignature = getEnvelopingSignature();
+
+	return root;
+
+}
+
+DOMNode * DSIGReference::getEnvelopingSignature(void) {
+
+	// The Signature an enveloped signature transform removes (if there
+	// is one in the list)
+
+	if (mp_transformList == NULL)
+		return NULL;
+
+	DSIGTransformList::TransformListVectorType::size_type size, i;
+	size = mp_transformList->getSize();
+
+	for (i = 0; i < size; ++i) {
+
+		if (mp_transformList->item(i)->getTransformType() == TRANSFORM_ENVELOPED_SIGNATURE) {
+
+			DOMNode * sig = mp_referenceNode->getParentNode();
+			while (sig != NULL && !strEquals(getDSIGLocalName(sig), "Signature"))
+				sig = sig->getParentNode();
+			return sig;
+
+		}
+
+	}
+
+	return NULL;
+
+}
+
+void DSIGReference::writeHash(const XMLByte * hashVal, unsigned int hashLen) {
+
+	XMLByte base64Hash [CRYPTO_MAX_HASH_SIZE * 2];
+	unsigned int base64HashLen;
+
+	// Calculate the base64 value
+
+	XSECCryptoBase64 *	b64 = XSECPlatformUtils::g_cryptoProvider->base64();
+
+	if (!b64) {
+
+		throw XSECException(XSECException::CryptoProviderError,
+				"Error requesting Base64 object from Crypto Provider");
+
+	}
+
+	Janitor<XSECCryptoBase64> j_b64(b64);
+
+	b64->encodeInit();
+	base64HashLen = b64->encode(hashVal,
+								hashLen,
+								base64Hash,
+								CRYPTO_MAX_HASH_SIZE * 2);
+	base64HashLen += b64->encodeFinish(&base64Hash[base64HashLen],
+										(CRYPTO_MAX_HASH_SIZE * 2) - base64HashLen);
+
+	// Ensure the string is terminated
+	if (base64Hash[base64HashLen-1] == '\n')
+		base64Hash[base64HashLen-1] = '\0';
+	else
+		base64Hash[base64HashLen] = '\0';
+
+	// Now find the correct text node to re-set
+
+	DOMNode *tmpElt = mp_hashValueNode;
+
+	if (mp_hashValueNode == 0) {
+
+		throw XSECException(XSECException::NotLoaded,
+			"setHash() called in DSIGReference before load()");
+
+	}
+
+	tmpElt = mp_hashValueNode->getFirstChild();
+
+	while (tmpElt != NULL && tmpElt->getNodeType() != DOMNode::TEXT_NODE)
+		tmpElt = tmpElt->getNextSibling();
+
+	if (tmpElt == NULL) {
+		// Need to create the underlying TEXT_NODE
+		DOMDocument *doc = mp_referenceNode->getOwnerDocument();
+		tmpElt = doc->createTextNode(MAKE_UNICODE_STRING((char *) base64Hash));
+		mp_hashValueNode->appendChild(tmpElt);
+	}
+	else {
+		tmpElt->setNodeValue(MAKE_UNICODE_STRING((char *) base64Hash));
+	}
+
+}
+
+void DSIGReference::hashReferenceLevel(DSIGReference * const * refs, int count) {
+
+	// Hash a set of References, none of which covers the DigestValue of
+	// any other.  They are digested first (on the thread pool if allowed)
+	// and the DigestValues only written once nothing is reading the DOM.
+
+	unsigned int limit = 0;
+	bool parallel = false;
+	XSECThreadPool * pool = NULL;
+
+	if (count > 1)
+		pool = getHashTaskPool(refs[0]->mp_env, limit, parallel);
+
+	bool prefetch = (limit > 0);
+
+	HashTaskVectorType tasks(count, (DSIGReferenceHashTask *) NULL);
+	HashTaskVectorJanitor j_tasks(pool, tasks);
+
+	std::vector<XMLByte> hashes(count * CRYPTO_MAX_HASH_SIZE);
+	std::vector<unsigned int> hashLens(count, 0);
+
+	unsigned int outstanding = 0;
+	int next = 0;
+
+	for (int i = 0; i < count; ++i) {
+
+		while (limit > 0 && outstanding < limit && next < count) {
+
+			DSIGReference * n = refs[next];
+
+			bool sameDocument = (parallel && n->m_loaded && n->canVerifyConcurrently());
+
+			if (sameDocument || (prefetch && n->m_loaded && n->canPrefetch())) {
+
+				DSIGReferenceHashTask * t;
+				XSECnew(t, DSIGReferenceHashTask(n, sameDocument));
+				tasks[next] = t;
+
+				if (!t->lookupCache(false)) {
+					t->m_submitted = true;
+					pool->submit(t);
+					++outstanding;
+				}
+
+			}
+
+			++next;
+
+		}
+
+		DSIGReference * r = refs[i];
+		DSIGReferenceHashTask * t = tasks[i];
+
+		if (t != NULL && t->m_submitted) {
+			pool->wait(t);
+			--outstanding;
+			t->m_submitted = false;
+		}
+
+		if (t != NULL && t->m_result == DSIGReferenceHashTask::HASH_OK) {
+
+			t->storeCache();
+			memcpy(&hashes[i * CRYPTO_MAX_HASH_SIZE], t->m_hash, t->m_hashLen);
+			hashLens[i] = t->m_hashLen;
+
+		}
+		else {
+
+			// Done here, so any error is thrown exactly as setHash() would
+			if (parallel && t == NULL && r->mayModifyDocument())
+				outstanding -= waitForSameDocumentTasks(pool, tasks);
+
+			hashLens[i] = r->calculateHash(&hashes[i * CRYPTO_MAX_HASH_SIZE], CRYPTO_MAX_HASH_SIZE);
+
+		}
+
+	}
+
+	for (int i = 0; i < count; ++i)
+		refs[i]->writeHash(&hashes[i * CRYPTO_MAX_HASH_SIZE], hashLens[i]);
+
+}
+
+bool DSIGReference::needsRehash(const DOMNode * root, const DOMNode * excludedSignature,
+								 const ChangedNodeVectorType & changed) {
+
+	// Conservative - a Reference is re-hashed unless it is certain none of
+	// the changes can reach its input
+
+	if (root == NULL || root != mp_lastInputRoot || mp_preHash != NULL)
+		return true;
+
+	// These can select from anywhere in the document
+	if (mp_transformList != NULL) {
+
+		DSIGTransformList::TransformListVectorType::size_type size, i;
+		size = mp_transformList->getSize();
+
+		for (i = 0; i < size; ++i) {
+
+			transformType t = mp_transformList->item(i)->getTransformType();
+			if (t == TRANSFORM_XPATH || t == TRANSFORM_XSLT || t == TRANSFORM_XPATH_FILTER)
+				return true;
+
+		}
+
+	}
+
+	// Anything else that decides what is read and how it is digested -
+	// the URI, Id attribute names, transforms and their parameters
+	// (InclusiveNamespaces, XPath-Filter expressions) and DigestMethod.
+	// This also guards against a new root allocated at the old address.
+
+	safeBuffer key;
+	makeInputKey(key, true);
+	if (key.sbStrcmp(m_lastInputKey) != 0)
+		return true;
+
+	ChangedNodeVectorType::const_iterator c;
+	for (c = changed.begin(); c != changed.end(); ++c) {
+
+		if (excludedSignature != NULL && isAncestorOrSelf(excludedSignature, *c))
+			continue;
+
+		// Anything within the input, or above it (which takes in the
+		// namespaces and xml: attributes c14n inherits)
+		if (isAncestorOrSelf(root, *c) || isAncestorOrSelf(*c, root))
+			return true;
+
+	}
+
+	return false;
+
+}
+
+void DSIGReference::hashReferenceList(DSIGReferenceList *lst, bool interlocking,
+									  const ChangedNodeVectorType * changed) {
+
+	// Every Reference (including those in Manifests) is treated as a node
+	// in a graph.  A Reference depends on another if the other's DigestValue
+	// lies within the subtree it is taken over, so must be hashed after it.
+	// References are then hashed a level at a time in topological order -
+	// the members of a level are independent of each other, so can be
+	// digested together.
+	//
+	// Transforms are not run, so this is conservative (an XPath may well
+	// remove a DigestValue that is counted here).  The exception is the
+	// enveloped signature transform, whose Signature is ignored.
+	//
+	// Anything left in a cycle (or depending on one) is done as before - a
+	// VERY naieve process that assumes the list will "settle" after N passes.
+	// If interlocking is set to false, there is only one pass.
+	//
+	// When signing incrementally, only References that may be affected by
+	// the changed nodes are hashed - together with anything covering their
+	// DigestValues, found by walking the same graph.
+
+	ReferenceVectorType refs;
+	flattenReferenceList(lst, refs);
+
+	int size = (int) refs.size();
+	if (size == 0)
+		return;
+
+	// Find the root of each same document Reference
+
+	typedef std::map<const DOMNode *, IndexVectorType> RootMapType;
+
+	RootMapType roots;
+	std::vector<DOMNode *> inputRoots(size, (DOMNode *) NULL);
+	std::vector<DOMNode *> excluded(size, (DOMNode *) NULL);
+
+	int i;
+	for (i = 0; i < size; ++i) {
+
+		inputRoots[i] = refs[i]->getInputRoot(excluded[i]);
+		if (inputRoots[i] != NULL)
+			roots[inputRoots[i]].push_back(i);
+
+	}
+
+	// Which need hashing
+
+	std::vector<bool> dirty(size, true);
+
+	if (changed != NULL)
+		for (i = 0; i < size; ++i)
+			dirty[i] = refs[i]->needsRehash(inputRoots[i], excluded[i], *changed);
+
+	// Then which of those roots each DigestValue is below
+
+	IndexVectorType deps(size, 0);
+	std::vector<IndexVectorType> dependents(size);
+
+	if (!roots.empty()) {
+
+		std::vector<const DOMNode *> ancestors;
+
+		for (int j = 0; j < size; ++j) {
+
+			ancestors.clear();
+
+			for (const DOMNode * n = refs[j]->mp_hashValueNode; n != NULL; n = n->getParentNode()) {
+
+				ancestors.push_back(n);
+
+				RootMapType::iterator it = roots.find(n);
+				if (it == roots.end())
+					continue;
+
+				IndexVectorType::iterator k;
+				for (k = it->second.begin(); k != it->second.end(); ++k) {
+
+					if (*k == j || (excluded[*k] != NULL &&
+						std::find(ancestors.begin(), ancestors.end(), excluded[*k]) != ancestors.end()))
+						continue;
+
+					dependents[j].push_back(*k);
+					++deps[*k];
+
+				}
+
+			}
+
+		}
+
+	}
+
+	// Hash in topological order
+
+	IndexVectorType level, nextLevel;
+	ReferenceVectorType levelRefs;
+	int done = 0;
+
+	for (i = 0; i < size; ++i)
+		if (deps[i] == 0)
+			level.push_back(i);
+
+	while (!level.empty()) {
+
+		levelRefs.clear();
+		IndexVectorType::iterator k, d;
+		for (k = level.begin(); k != level.end(); ++k)
+			if (dirty[*k])
+				levelRefs.push_back(refs[*k]);
+
+		if (!levelRefs.empty())
+			hashReferenceLevel(&levelRefs[0], (int) levelRefs.size());
+		done += (int) level.size();
+
+		nextLevel.clear();
+		for (k = level.begin(); k != level.end(); ++k) {
+
+			if (dirty[*k])
+				refs[*k]->recordInput(inputRoots[*k]);
+
+			for (d = dependents[*k].begin(); d != dependents[*k].end(); ++d) {
+				// A new DigestValue changes the input of those covering it
+				if (dirty[*k])
+					dirty[*d] = true;
+				if (--deps[*d] == 0)
+					nextLevel.push_back(*d);
+			}
+
+		}
+
+		// Keep to document order
+		std::sort(nextLevel.begin(), nextLevel.end());
+		level.swap(nextLevel);
+
+	}
+
+	if (done == size)
+		return;
+
+	// Whatever is left is interlocked
+
+	levelRefs.clear();
+	bool anyDirty = false;
+	for (i = 0; i < size; ++i) {
+		if (deps[i] > 0) {
+			levelRefs.push_back(refs[i]);
+			anyDirty = anyDirty || dirty[i];
+		}
+	}
+
+	if (!anyDirty)
+		return;
+
+	int passes = (int) levelRefs.size();
+
+	do {
+
+		ReferenceVectorType::iterator k;
+		for (k = levelRefs.begin(); k != levelRefs.end(); ++k)
+			(*k)->setHash();
+
+	} while (interlocking && !checkReferences(levelRefs) && passes-- >= 0);
+
+	for (i = 0; i < size; ++i)
+		if (deps[i] > 0)
+			refs[i]->recordInput(inputRoots[i]);
+
+}
+
+void DSIGReference::recordInput(const DOMNode * root) {
+
+	// What needsRehash() compares against on the next sign
+
+	mp_lastInputRoot = root;
+	if (root != NULL)
+		makeInputKey(m_lastInputKey, true);
+
+}
+
+// --------------------------------------------------------------------------------
+//           processTransforms
+// --------------------------------------------------------------------------------
+
+TXFMChain * DSIGReference::createTXFMChainFromList(TXFMBase * input,
+							DSIGTransformList * lst) {
+
+	TXFMChain * ret;
+	XSECnew(ret, TXFMChain(input));
+
+	if (lst == NULL)
+		return ret;
+
+	Janitor<TXFMChain> j_ret(ret);
+
+	DSIGTransformList::TransformListVectorType::size_type size, i;
+
+	size = lst->getSize();
+
+	if (size > 0) {
+
+		// Iterate through the list
+
+		for (i = 0; i < size; ++i) {
+
+			lst->item(i)->appendTransformer(ret);
+
+		}
+
+	}
+
+	j_ret.release();
+	return ret;
+
+}
+
+// --------------------------------------------------------------------------------
+//           loadTransforms
+// --------------------------------------------------------------------------------
+
+DSIGTransformList * DSIGReference::loadTransforms(
+							DOMNode *transformsNode,
+							XSECSafeBufferFormatter * formatter,
+							const XSECEnv * env) {
+
+	// This is defined as a static function, not because it makes use of any static variables
+	// in the DSIGReference class, but to neatly link it to the other users
+
+	if (transformsNode == 0 || (!strEquals(getDSIGLocalName(transformsNode), "Transforms") &&
+		!strEquals(getXENCLocalName(transformsNode), "Transforms"))) {
+
+			throw XSECException(XSECException::ExpectedDSIGChildNotFound,
+					"Expected <Transforms> in function DSIGReference::processTransforms");
 
 	}
 
-	Janitor<XSECCryptoBase64> j_b64(b64);
+	// Create the list
+	DSIGTransformList * lst;
+	XSECnew(lst, DSIGTransformList());
+	Janitor<DSIGTransformList> j_lst(lst);
+
+	// Find First transform
+
+	DOMNode * transforms = transformsNode->getFirstChild();
+	while (transforms != NULL && transforms->getNodeType() != DOMNode::ELEMENT_NODE)
+		transforms = transforms->getNextSibling();
+
+	while (transforms != NULL) {
+
+		// Process each transform in turn
+		if (!strEquals(getDSIGLocalName(transforms), "Transform")) {
+
+			// Not what we expected to see!
+			safeBuffer tmp, error;
+
+			error << (*formatter << getDSIGLocalName(transforms));
+			tmp.sbStrcpyIn("Unknown attribute in <Transforms> - Expected <Transform> found ");
+			tmp.sbStrcatIn(error);
+			tmp.sbStrcatIn(">.");
 
-	b64->encodeInit();
-	base64HashLen = b64->encode(calculatedHashVal,
-								calculatedHashLen,
-								base64Hash,
-								CRYPTO_MAX_HASH_SIZE * 2);
-	base64HashLen += b64->encodeFinish(&base64Hash[base64HashLen],
-										(CRYPTO_MAX_HASH_SIZE * 2) - base64HashLen);
+			throw XSECException(XSECException::ExpectedDSIGChildNotFound, error.rawCharBuffer());
 
-	// Ensure the string is terminated
-	if (base64Hash[base64HashLen-1] == '\n')
-		base64Hash[base64HashLen-1] = '\0';
-	else
-		base64Hash[base64HashLen] = '\0';
+		}
 
-	// Now find the correct text node to re-set
+		DOMNamedNodeMap * transformAtts = transforms->getAttributes();
 
-	DOMNode *tmpElt = mp_hashValueNode;
+		unsigned int i;
 
-	if (mp_hashValueNode == 0) {
+		for (i = 0; i < transformAtts->getLength() &&
+				!strEquals(transformAtts->item(i)->getNodeName(), DSIGConstants::s_unicodeStrAlgorithm); ++i);
 
-		throw XSECException(XSECException::NotLoaded,
-			"setHash() called in DSIGReference before load()");
+		if (i == transformAtts->getLength()) {
 
-	}
+			throw XSECException(XSECException::ExpectedDSIGChildNotFound,
+				"Algorithm attribute not found in <Transform> element");
 
-	tmpElt = mp_hashValueNode->getFirstChild();
+		}
 
-	while (tmpElt != NULL && tmpElt->getNodeType() != DOMNode::TEXT_NODE)
-		tmpElt = tmpElt->getNextSibling();
+		safeBuffer algorithm;
+		algorithm << (*formatter << transformAtts->item(i)->getNodeValue());
 
-	if (tmpElt == NULL) {
-		// Need to create the underlying TEXT_NODE
-		DOMDocument *doc = mp_referenceNode->getOwnerDocument();
-		tmpElt = doc->createTextNode(MAKE_UNICODE_STRING((char *) base64Hash));
-		mp_hashValueNode->appendChild(tmpElt);
-	}
-	else {
-		tmpElt->setNodeValue(MAKE_UNICODE_STRING((char *) base64Hash));
-	}
+		// Determine what the transform is
+
+		if (algorithm.sbStrcmp(URI_ID_BASE64) == 0) {
+
+			DSIGTransformBase64 * b;
+			XSECnew(b, DSIGTransformBase64(env, transforms));
+			lst->addTransform(b);
+			b->load();
+		}
+
+		else if (algorithm.sbStrcmp(URI_ID_XPATH) == 0) {
+
+			DSIGTransformXPath * x;
+			XSECnew(x, DSIGTransformXPath(env, transforms));
+			lst->addTransform(x);
+			x->load();
+		}
+
+		else if (algorithm.sbStrcmp(URI_ID_XPF) == 0) {
+
+			DSIGTransformXPathFilter * xpf;
+
+			XSECnew(xpf, DSIGTransformXPathFilter(env, transforms));
+			lst->addTransform(xpf);
+			xpf->load();
+
+		}
+
+		else if (algorithm.sbStrcmp(URI_ID_ENVELOPE) == 0) {
+
+			DSIGTransformEnvelope * e;
+			XSECnew(e, DSIGTransformEnvelope(env, transforms));
+			lst->addTransform(e);
+			e->load();
+		}
+
+		else if (algorithm.sbStrcmp(URI_ID_XSLT) == 0) {
+
+			DSIGTransformXSL * x;
+			XSECnew(x, DSIGTransformXSL(env, transforms));
+			lst->addTransform(x);
+			x->load();
+
+		}
+
+
+		else if (algorithm.sbStrcmp(URI_ID_C14N_COM) == 0 ||
+			     algorithm.sbStrcmp(URI_ID_C14N_NOC) == 0 ||
+			     algorithm.sbStrcmp(URI_ID_C14N11_COM) == 0 ||
+                 algorithm.sbStrcmp(URI_ID_C14N11_NOC) == 0 ||
+				 algorithm.sbStrcmp(URI_ID_EXC_C14N_COM) == 0 ||
+				 algorithm.sbStrcmp(URI_ID_EXC_C14N_NOC) == 0) {
+
+			DSIGTransformC14n * c;
+			XSECnew(c, DSIGTransformC14n(env, transforms));
+			lst->addTransform(c);
+			c->load();
+
+		}
+
+		else {
+
+			// Not what we expected to see!
+			safeBuffer tmp;
+
+			tmp.sbStrcpyIn("Unknown transform : ");
+			tmp.sbStrcatIn(algorithm);
+			tmp.sbStrcatIn(" found.");
+
+			throw XSECException(XSECException::UnknownTransform, tmp.rawCharBuffer());
+		}
+
+		// Now find next element
+
+		transforms = transforms->getNextSibling();
+		while (transforms != NULL && transforms->getNodeType() != DOMNode::ELEMENT_NODE)
+			transforms = transforms->getNextSibling();
+
+	} /* while (transforms != NULL) */
+
+	j_lst.release();
+	return lst;
+}
+
+// --------------------------------------------------------------------------------
+//           Set hash
+// --------------------------------------------------------------------------------
+
+void DSIGReference::setHash(void) {
+
+	// First determine the hash value
+	XMLByte calculatedHashVal[CRYPTO_MAX_HASH_SIZE];	// The hash that we determined
+	unsigned int calculatedHashLen;
+
+	calculatedHashLen = calculateHash(calculatedHashVal, CRYPTO_MAX_HASH_SIZE);
+
+	// Then set the Base64 encoded string
+	writeHash(calculatedHashVal, calculatedHashLen);
 
 }
 
@@ -1256,14 +2544,134 @@ void DSIGReference::setHash(void) {
 //           Create hash
 // --------------------------------------------------------------------------------
 
-unsigned int DSIGReference::calculateHash(XMLByte *toFill, unsigned int maxToFill) {
+// --------------------------------------------------------------------------------
+//           Digest cache keys
+// --------------------------------------------------------------------------------
 
-	// Determine the hash value of the element
+bool DSIGReference::makeDigestCacheKey(safeBuffer & key) {
 
-	// First set up for input
+	// Only external references with nothing else watching the data
+	// (pre-hash transforms or a logging sink) can come from the cache
 
-	TXFMBase * currentTxfm;
-	TXFMChain * chain;
+	if (mp_env->getDigestCache() == NULL || mp_URI == NULL || mp_URI[0] == 0 ||
+		mp_URI[0] == chPound || mp_preHash != NULL || XSECPlatformUtils::HasReferenceLoggingSink())
+		return false;
+
+	XSECURIResolver * resolver = mp_env->getURIResolver();
+	safeBuffer validator;
+
+	if (resolver == NULL || !resolver->getValidator(mp_URI, validator))
+		return false;
+
+	key.sbStrcpyIn(validator);
+	key.sbStrcatIn("\n");
+
+	addTransformsToKey(key);
+
+	return true;
+
+}
+
+bool DSIGReference::makeDocumentDigestKey(safeBuffer & key) {
+
+	// Same document References whose digest depends only on the document
+	// content can be shared with other signatures via the document context
+
+	XSECDocumentContext * ctx = mp_env->getDocumentContext();
+
+	if (ctx == NULL || !m_loaded || ctx->getDocument() != mp_referenceNode->getOwnerDocument() ||
+		XSECPlatformUtils::HasReferenceLoggingSink() || !canVerifyConcurrently())
+		return false;
+
+	makeInputKey(key, true);
+
+	return true;
+
+}
+
+// Strings go into the input key one UTF-16 unit at a time, so that no
+// two strings (even ones the local code page cannot represent) share a
+// key, and the separators cannot appear in them
+
+static void appendKeyString(safeBuffer & key, const XMLCh * str) {
+
+	if (str == NULL)
+		return;
+
+	char buf[8];
+	for (; *str != 0; ++str) {
+
+		if (*str > 0x20 && *str < 0x7F && *str != '%') {
+			buf[0] = (char) *str;
+			buf[1] = '\0';
+		}
+		else
+			sprintf(buf, "%%%04X", (unsigned int) *str);
+
+		key.sbStrcatIn(buf);
+
+	}
+
+}
+
+void DSIGReference::makeInputKey(safeBuffer & key, bool withAlgorithm) {
+
+	// Identifies what is read (and, optionally, how it is digested) for a
+	// same document Reference
+
+	key.sbStrcpyIn("#");
+	appendKeyString(key, mp_URI);
+	key.sbStrcatIn("\n");
+
+	// Which element an Id resolves to depends on the Id attribute names
+	key.sbStrcatIn(XSECIdIndex::makeConfigKey(mp_env).c_str());
+	key.sbStrcatIn("\n");
+
+	// What the enveloped signature transform removes depends on where
+	// the Reference is
+
+	DOMNode * sig = getEnvelopingSignature();
+	if (sig != NULL) {
+		char buf[32];
+		sprintf(buf, "%p\n", (void *) sig);
+		key.sbStrcatIn(buf);
+	}
+
+	addTransformsToKey(key, withAlgorithm);
+
+}
+
+void DSIGReference::addTransformsToKey(safeBuffer & key, bool withAlgorithm) {
+
+	if (withAlgorithm) {
+
+		appendKeyString(key, mp_algorithmURI);
+		key.sbStrcatIn("\n");
+
+	}
+
+	// The transforms are fingerprinted by their canonical form, which
+	// picks up parameters and in-scope namespaces
+
+	if (mp_transformsNode != NULL) {
+
+		XSECC14n20010315 canon(mp_referenceNode->getOwnerDocument(), mp_transformsNode);
+		canon.setCommentsProcessing(false);
+
+		unsigned char buf[1024];
+		xsecsize_t sz;
+		while ((sz = canon.outputBuffer(buf, 1023)) > 0) {
+			buf[sz] = '\0';
+			key.sbStrcatIn((char *) buf);
+		}
+
+	}
+
+}
+
+unsigned int DSIGReference::calculateHash(XMLByte *toFill, unsigned int maxToFill) {
+
+	// Determine the hash value of the element
 
 	unsigned int size;
 
@@ -1274,9 +2682,40 @@ unsigned int DSIGReference::calculateHash(XMLByte *toFill, unsigned int maxToFil
 
 	}
 
+	// External resources may already have been digested
+
+	safeBuffer cacheKey;
+	bool useCache = makeDigestCacheKey(cacheKey);
+	if (useCache) {
+
+		size = mp_env->getDigestCache()->lookup(cacheKey.rawCharBuffer(), toFill, maxToFill);
+		if (size > 0)
+			return size;
+
+	}
+
+	size = calculateDigest(toFill, maxToFill, mp_env);
+
+	if (useCache)
+		mp_env->getDigestCache()->store(cacheKey.rawCharBuffer(), toFill, size);
+
+	return size;
+
+}
+
+unsigned int DSIGReference::calculateDigest(XMLByte *toFill, unsigned int maxToFill,
+											const XSECEnv * env) {
+
+	// Build and run the transform chain.  The URI is resolved via env,
+	// which need not be the Reference's own environment.
+
+	TXFMBase * currentTxfm;
+	TXFMChain * chain;
+
+	unsigned int size;
+
 	// Find base transform
-	currentTxfm = getURIBaseTXFM(mp_referenceNode->getOwnerDocument(), mp_URI,
-		mp_env);
+	currentTxfm = getURIBaseTXFM(mp_referenceNode->getOwnerDocument(), mp_URI, env);
 
 	// Now build the transforms list
 	// Note this passes ownership of currentTxfm to the function, so it is the
@@ -1314,8 +2753,7 @@ unsigned int DSIGReference::calculateHash(XMLByte *toFill, unsigned int maxToFil
 
 	// Get the mapping for the hash transform
 
-	XSECAlgorithmHandler * handler =
-		XSECPlatformUtils::g_algorithmMapper->mapURIToHandler(mp_algorithmURI);
+	XSECAlgorithmHandler * handler = getPlanHandler();
 
 	if (handler == NULL) {
 
@@ -1325,7 +2763,18 @@ unsigned int DSIGReference::calculateHash(XMLByte *toFill, unsigned int maxToFil
 
 	}
 
-	if (!handler->appendHashTxfm(chain, mp_algorithmURI)) {
+	if (m_planHashMethod != HASH_NONE) {
+
+		// What the default handler would append
+		TXFMBase * txfm;
+		if (m_planHashMethod == HASH_MD5)
+			XSECnew(txfm, TXFMMD5(d));
+		else
+			XSECnew(txfm, TXFMSHA1(d, m_planHashMethod));
+		chain->appendTxfm(txfm);
+
+	}
+	else if (!handler->appendHashTxfm(chain, mp_algorithmURI)) {
 
 		throw XSECException(XSECException::SigVfyError,
 			"Unexpected error in handler whilst appending Hash transform");
@@ -1427,11 +2876,55 @@ bool DSIGReference::checkHash() {
 	// First set up for input
 
 	XMLByte calculatedHashVal[CRYPTO_MAX_HASH_SIZE];		// The hash that we determined
+
+	unsigned int calculatedHashSize;
+
+	calculatedHashSize = calculateHash(calculatedHashVal, CRYPTO_MAX_HASH_SIZE);
+
+	return compareHash(calculatedHashVal, calculatedHashSize);
+
+}
+
+bool DSIGReference::checkHashInContext(void) {
+
+	// As checkHash(), but the digest may come from (and is given to) the
+	// document context
+
+	XMLByte calculatedHashVal[CRYPTO_MAX_HASH_SIZE];		// The hash that we determined
+
+	unsigned int calculatedHashSize = 0;
+
+	safeBuffer key;
+	XSECDocumentContext * ctx = NULL;
+
+	if (makeDocumentDigestKey(key)) {
+
+		ctx = mp_env->getDocumentContext();
+		calculatedHashSize = ctx->lookupDigest(key.rawCharBuffer(), calculatedHashVal, CRYPTO_MAX_HASH_SIZE);
+
+	}
+
+	if (calculatedHashSize == 0) {
+
+		calculatedHashSize = calculateHash(calculatedHashVal, CRYPTO_MAX_HASH_SIZE);
+
+		if (ctx != NULL && calculatedHashSize > 0)
+			ctx->storeDigest(key.rawCharBuffer(), calculatedHashVal, calculatedHashSize);
+
+	}
+
+	return compareHash(calculatedHashVal, calculatedHashSize);
+
+}
+
+bool DSIGReference::compareHash(const XMLByte * calculatedHashVal,
+								unsigned int calculatedHashSize) {
+
 	XMLByte readHashVal[CRYPTO_MAX_HASH_SIZE];			// The hash in the element
 
-	unsigned int calculatedHashSize, i;
+	unsigned int i;
 
-	if ((calculatedHashSize = calculateHash(calculatedHashVal, CRYPTO_MAX_HASH_SIZE)) == 0)
+	if (calculatedHashSize == 0)
 		return false;
 
 	if (readHash(readHashVal, CRYPTO_MAX_HASH_SIZE) != calculatedHashSize)
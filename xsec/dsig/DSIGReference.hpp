@@ -39,6 +39,9 @@
 #include <xsec/dsig/DSIGTransform.hpp>
 #include <xsec/dsig/DSIGReferenceList.hpp>
 #include <xsec/dsig/DSIGConstants.hpp>
+#include <xsec/enc/XSECCryptoHash.hpp>
+
+#include <vector>
 
 class DSIGTransformList;
 class DSIGTransformBase64;
@@ -55,6 +58,8 @@ class TXFMChain;
 class XSECBinTXFMInputStream;
 class XSECURIResolver;
 class XSECEnv;
+class XSECAlgorithmHandler;
+class DSIGReferenceHashTask;
 
 /**
  * @ingroup pubsig
@@ -72,6 +77,13 @@ class DSIG_EXPORT DSIGReference {
 
 public:
 
+	// Nodes changed since References were last hashed
+#if defined(XSEC_NO_NAMESPACES)
+	typedef vector<const XERCES_CPP_NAMESPACE_QUALIFIER DOMNode *>		ChangedNodeVectorType;
+#else
+	typedef std::vector<const XERCES_CPP_NAMESPACE_QUALIFIER DOMNode *>	ChangedNodeVectorType;
+#endif
+
     /** @name Constructors and Destructors */
     //@{
 	
@@ -529,15 +541,26 @@ public:
 	 * element.  Finally set the Base64 encoded string according to the newly
 	 * calcuated hash.
 	 *
+	 * References are hashed in dependency order - a Reference whose input
+	 * contains the DigestValue of another is hashed after it - so chains of
+	 * inter-related references are settled in a single pass.  References
+	 * that do not depend on each other are digested on the library thread
+	 * pool if the environment allows it (see
+	 * XSECEnv::setParallelReferenceVerification()).
+	 *
 	 * @note This is an internal library function and should not be called directly.
 	 *
 	 * @param list The list of references
 	 * @param interlocking If set to false, the library will assume there
-	 * are no inter-related references.  The algorithm for determining this
-	 * internally is very primitive and CPU intensive, so this is a method to 
-	 * bypass the checks.
+	 * are no circular dependencies between references.  If true, any
+	 * references found to depend on each other in a cycle are re-hashed
+	 * until they settle, which is CPU intensive.
+	 * @param changed If not NULL, only References that may have been
+	 * affected by changes to these nodes since they were last hashed are
+	 * re-hashed (see DSIGSignature::setIncrementalSigning()).
 	 */
-	static void hashReferenceList(DSIGReferenceList * list, bool interlocking = true);
+	static void hashReferenceList(DSIGReferenceList * list, bool interlocking = true,
+		const ChangedNodeVectorType * changed = NULL);
 
 	//@}
 
@@ -549,6 +572,37 @@ private:
 		DSIGTransform * txfm, 
 		XERCES_CPP_NAMESPACE_QUALIFIER DOMElement * txfmElt
 	);
+	bool makeDigestCacheKey(safeBuffer & key);
+	bool makeDocumentDigestKey(safeBuffer & key);
+	void makeInputKey(safeBuffer & key, bool withAlgorithm);
+	void addTransformsToKey(safeBuffer & key, bool withAlgorithm = true);
+	unsigned int calculateDigest(XMLByte * toFill, unsigned int maxToFill, const XSECEnv * env);
+	bool compareHash(const XMLByte * calculatedHashVal, unsigned int calculatedHashSize);
+	bool checkHashInContext(void);
+	bool canPrefetch(void);
+	bool canVerifyConcurrently(void);
+	bool mayModifyDocument(void);
+	bool canBatchDigest(XSECCryptoHash::HashType & type);
+	TXFMChain * createInputChain(void);
+	bool readBatchInput(std::vector<XMLByte> & buf, unsigned int limit,
+		XSECCryptoHash::HashType type, XMLByte * toFill, unsigned int & hashLen);
+	void digestSharedInput(const XSECCryptoHash::HashType * types, int count,
+		XMLByte * toFill, unsigned int * hashLens);
+	static void digestReferenceBatch(DSIGReferenceList * lst,
+		std::vector<XMLByte> & hashes, std::vector<unsigned int> & hashLens);
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * getInputRoot(
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMNode *& excludedSignature
+	);
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * getEnvelopingSignature(void);
+	void writeHash(const XMLByte * hashVal, unsigned int hashLen);
+	static void hashReferenceLevel(DSIGReference * const * refs, int count);
+	bool needsRehash(
+		const XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * root,
+		const XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * excludedSignature,
+		const ChangedNodeVectorType & changed
+	);
+	void recordInput(const XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * root);
+	XSECAlgorithmHandler * getPlanHandler(void);
 
 
 	XSECSafeBufferFormatter		* mp_formatter;
@@ -570,11 +624,24 @@ private:
 	
 	bool                        m_loaded;
 
+	// Resolved DigestMethod - reset when mp_algorithmURI is set, and only
+	// used while the algorithm mapper is at m_planGeneration
+	XSECAlgorithmHandler		* mp_planHandler;
+	unsigned int				m_planGeneration;
+	hashMethod					m_planHashMethod;		// HASH_NONE unless the default handler
+
+	// Root of the input when last hashed, and the makeInputKey() it was
+	// hashed with (for incremental signing)
+	const XERCES_CPP_NAMESPACE_QUALIFIER DOMNode
+								* mp_lastInputRoot;
+	safeBuffer					m_lastInputKey;
+
 	DSIGReference();
 
 	/*\@}*/
 
 	friend class DSIGSignedInfo;
+	friend class DSIGReferenceHashTask;
 };
 
 
@@ -49,6 +49,8 @@
 #include <xsec/framework/XSECAlgorithmHandler.hpp>
 #include <xsec/framework/XSECAlgorithmMapper.hpp>
 #include <xsec/framework/XSECEnv.hpp>
+#include <xsec/framework/XSECDocumentContext.hpp>
+#include <xsec/framework/XSECVerificationCache.hpp>
 #include <xsec/framework/XSECURIResolver.hpp>
 #include <xsec/transformers/TXFMDocObject.hpp>
 #include <xsec/transformers/TXFMOutputFile.hpp>
@@ -65,6 +67,8 @@
 #include <xercesc/dom/DOMNamedNodeMap.hpp>
 #include <xercesc/util/Janitor.hpp>
 
+#include <string.h>
+
 XERCES_CPP_NAMESPACE_USE
 
 // --------------------------------------------------------------------------------
@@ -226,6 +230,66 @@ XSECURIResolver * DSIGSignature::getURIResolver(void) const {
 
 }
 
+void DSIGSignature::setDigestCache(XSECDigestCache * cache) {
+
+	mp_env->setDigestCache(cache);
+
+}
+
+XSECDigestCache * DSIGSignature::getDigestCache(void) const {
+
+	return mp_env->getDigestCache();
+
+}
+
+void DSIGSignature::setDocumentContext(XSECDocumentContext * ctx) {
+
+	mp_env->setDocumentContext(ctx);
+
+}
+
+XSECDocumentContext * DSIGSignature::getDocumentContext(void) const {
+
+	return mp_env->getDocumentContext();
+
+}
+
+void DSIGSignature::setVerificationCache(XSECVerificationCache * cache) {
+
+	mp_env->setVerificationCache(cache);
+
+}
+
+XSECVerificationCache * DSIGSignature::getVerificationCache(void) const {
+
+	return mp_env->getVerificationCache();
+
+}
+
+void DSIGSignature::setExternalReferencePrefetch(unsigned int maxConcurrent) {
+
+	mp_env->setExternalReferencePrefetch(maxConcurrent);
+
+}
+
+unsigned int DSIGSignature::getExternalReferencePrefetch(void) const {
+
+	return mp_env->getExternalReferencePrefetch();
+
+}
+
+void DSIGSignature::setParallelReferenceVerification(bool flag) {
+
+	mp_env->setParallelReferenceVerification(flag);
+
+}
+
+bool DSIGSignature::getParallelReferenceVerification(void) const {
+
+	return mp_env->getParallelReferenceVerification();
+
+}
+
 void DSIGSignature::setKeyInfoResolver(XSECKeyInfoResolver * resolver) {
 
 	if (mp_KeyInfoResolver != 0)
@@ -306,6 +370,7 @@ m_errStr("") {
 	mp_KeyInfoNode = NULL;
 	m_loaded = false;
 	m_interlockingReferences = false;
+	m_incrementalSigning = false;
 
 	// Set up our formatter
 	XSECnew(mp_formatter, XSECSafeBufferFormatter("UTF-8",XMLFormatter::NoEscapes, 
@@ -329,6 +394,7 @@ m_errStr("") {
 	mp_KeyInfoNode = NULL;
 	m_loaded = false;
 	m_interlockingReferences = false;
+	m_incrementalSigning = false;
 
 	// Set up our formatter
 	XSECnew(mp_formatter, XSECSafeBufferFormatter("UTF-8",XMLFormatter::NoEscapes, 
@@ -890,6 +956,11 @@ unsigned int DSIGSignature::calculateSignedInfoHash(unsigned char * hashBuf,
 unsigned int DSIGSignature::calculateSignedInfoAndReferenceHash(unsigned char * hashBuf, 
 													unsigned int hashBufLen) {
 
+	// The document is about to change under any shared context
+	mp_env->invalidateIdIndex();
+	if (mp_env->getDocumentContext() != NULL)
+		mp_env->getDocumentContext()->reset();
+
 	// Set up the reference list hashes - including any manifests
 	mp_signedInfo->hash(m_interlockingReferences);
 	// calculaet signed InfoHash
@@ -900,6 +971,66 @@ unsigned int DSIGSignature::calculateSignedInfoAndReferenceHash(unsigned char *
 //           Verify a signature
 // --------------------------------------------------------------------------------
 
+namespace {
+
+	void hashCacheKeyField(XSECCryptoHash * h, const unsigned char * data, unsigned int len) {
+
+		// Length prefixed, so no two sets of fields hash the same input
+
+		unsigned char lenBuf[4];
+		lenBuf[0] = (unsigned char) (len >> 24);
+		lenBuf[1] = (unsigned char) (len >> 16);
+		lenBuf[2] = (unsigned char) (len >> 8);
+		lenBuf[3] = (unsigned char) len;
+
+		h->hash(lenBuf, 4);
+		if (len > 0)
+			h->hash((unsigned char *) data, len);
+
+	}
+
+}
+
+bool DSIGSignature::makeVerificationCacheKey(const unsigned char * signedInfoHash,
+											 unsigned int signedInfoHashLen,
+											 std::string & key) {
+
+	// The key is a SHA-256 over the signature algorithm, the hash of the
+	// canonical SignedInfo under that algorithm, the SignatureValue and
+	// the public key.  Keys that cannot be identified (HMAC) are not cached.
+
+	if (mp_env->getVerificationCache() == NULL || mp_signingKey == NULL ||
+		signedInfoHashLen == 0)
+		return false;
+
+	safeBuffer keyId;
+	unsigned int keyIdLen = mp_signingKey->getPublicKeyIdentity(keyId);
+	if (keyIdLen == 0)
+		return false;
+
+	XSECCryptoHash * h = XSECPlatformUtils::g_cryptoProvider->hashSHA(256);
+	if (h == NULL)
+		return false;
+
+	Janitor<XSECCryptoHash> j_h(h);
+
+	const XMLCh * uri = mp_signedInfo->getAlgorithmURI();
+	unsigned int uriLen = (uri != NULL ? XMLString::stringLen(uri) : 0);
+	const char * sigValue = m_signatureValueSB.rawCharBuffer();
+
+	hashCacheKeyField(h, (const unsigned char *) uri, uriLen * (unsigned int) sizeof(XMLCh));
+	hashCacheKeyField(h, signedInfoHash, signedInfoHashLen);
+	hashCacheKeyField(h, (const unsigned char *) sigValue, (unsigned int) strlen(sigValue));
+	hashCacheKeyField(h, keyId.rawBuffer(), keyIdLen);
+
+	unsigned char digest[CRYPTO_MAX_HASH_SIZE];
+	unsigned int digestLen = h->finish(digest, CRYPTO_MAX_HASH_SIZE);
+
+	key.assign((const char *) digest, digestLen);
+	return true;
+
+}
+
 bool DSIGSignature::verifySignatureOnlyInternal(void) {
 
 	unsigned char hash[4096];
@@ -951,6 +1082,13 @@ bool DSIGSignature::verifySignatureOnlyInternal(void) {
 
 	hashLen = calculateSignedInfoHash(hash, 4096);
 
+	// Seen (and verified) before?
+	std::string cacheKey;
+	bool cacheable = makeVerificationCacheKey(hash, hashLen, cacheKey);
+
+	if (cacheable && mp_env->getVerificationCache()->lookup(cacheKey))
+		return true;
+
 	// Now set up to verify
 	// First find the appropriate handler for the URI
 	XSECAlgorithmHandler * handler = 
@@ -972,6 +1110,8 @@ bool DSIGSignature::verifySignatureOnlyInternal(void) {
 
 	if (!sigVfyRet)
 		m_errStr.sbXMLChCat("Validation of <SignedInfo> failed");
+	else if (cacheable)
+		mp_env->getVerificationCache()->store(cacheKey);
 
 	return sigVfyRet;
 
@@ -1001,6 +1141,7 @@ bool DSIGSignature::verify(void) {
 
 	// Reset
 	m_errStr.sbXMLChIn(DSIGConstants::s_unicodeStrEmpty);
+	mp_env->invalidateIdIndex();
 
 	// First thing to do is check the references
 
@@ -1042,8 +1183,15 @@ void DSIGSignature::sign(void) {
 	// Reset error string in case we have any reference problems.
 	m_errStr.sbXMLChIn(DSIGConstants::s_unicodeStrEmpty);
 
+	// The document is about to change under any shared context
+	mp_env->invalidateIdIndex();
+	if (mp_env->getDocumentContext() != NULL)
+		mp_env->getDocumentContext()->reset();
+
 	// Set up the reference list hashes - including any manifests
-	mp_signedInfo->hash(m_interlockingReferences);
+	mp_signedInfo->hash(m_interlockingReferences,
+		m_incrementalSigning ? &m_changedNodes : NULL);
+	m_changedNodes.clear();
 
 	// Get the SignedInfo input bytes
 	TXFMChain * chain = getSignedInfoInput();
@@ -42,9 +42,14 @@
 
 #include <xercesc/dom/DOM.hpp>
 
+#include <string>
+
 class XSECEnv;
 class XSECBinTXFMInputStream;
 class XSECURIResolver;
+class XSECDigestCache;
+class XSECDocumentContext;
+class XSECVerificationCache;
 class XSECKeyInfoResolver;
 class DSIGKeyInfoValue;
 class DSIGKeyInfoX509;
@@ -651,6 +656,48 @@ public:
 
 	bool getInterlockingReferences(void) const {return m_interlockingReferences;}
 
+	/**
+	 * \brief Only re-hash References affected by changes when re-signing
+	 *
+	 * When set, sign() re-digests only the References whose input may
+	 * have been changed since they were last hashed by this object, as
+	 * reported through #noteChanged (plus any covering the DigestValue of
+	 * a Reference that was re-hashed).  The SignatureValue is always
+	 * recalculated.
+	 *
+	 * The Xerces DOM has no mutation events, so the application reports
+	 * its changes.  The first sign() hashes every Reference.  References
+	 * to other documents, or with XPath or XSLT transforms, are always
+	 * re-hashed.
+	 *
+	 * @param flag true to sign incrementally
+	 */
+
+	void setIncrementalSigning(bool flag) {m_incrementalSigning = flag;}
+
+	/**
+	 * \brief Return the incremental signing flag
+	 */
+
+	bool getIncrementalSigning(void) const {return m_incrementalSigning;}
+
+	/**
+	 * \brief Report a change to the document before the next sign()
+	 *
+	 * Pass the node (element, attribute or text) that was changed.  For
+	 * nodes inserted or removed, pass the parent they were inserted into
+	 * or removed from.  Changes to the namespace declarations or xml:
+	 * attributes of an ancestor of a Reference's input must also be
+	 * reported (on that ancestor).
+	 *
+	 * @note Reported nodes must remain in the document until the next
+	 * call to sign(), which clears the list.
+	 * @param node The node changed
+	 * @see #setIncrementalSigning
+	 */
+
+	void noteChanged(const XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * node) {m_changedNodes.push_back(node);}
+
 	//@}
 
 	/** @name Resolver manipulation */
@@ -674,6 +721,125 @@ public:
 
 	XSECURIResolver * getURIResolver(void) const;
 
+	/**
+	 * \brief Use a cache for digests of external References
+	 *
+	 * When set, digests calculated over References to external resources
+	 * are remembered, so verifying further signatures over the same
+	 * (unchanged) resources does not re-read and re-hash them.
+	 *
+	 * @note The cache is not owned by the signature, and may be shared
+	 * by many signatures and threads.  Pass NULL to stop using it.
+	 * @see XSECDigestCache
+	 */
+
+	void setDigestCache(XSECDigestCache * cache);
+
+	/**
+	 * \brief Return the digest cache in use (or NULL)
+	 */
+
+	XSECDigestCache * getDigestCache(void) const;
+
+	/**
+	 * \brief Share verification state with other signatures in the document
+	 *
+	 * Signatures attached to the same context share the document's Id
+	 * index and the digests of same-document References, so verifying
+	 * several signatures over the same content only canonicalises and
+	 * hashes it once.  sign() resets the context, as it changes the
+	 * document.
+	 *
+	 * @note The context is not owned by the signature.  It must have been
+	 * created for the document this signature is in.  Pass NULL to stop
+	 * using it.
+	 * @see XSECDocumentContext
+	 */
+
+	void setDocumentContext(XSECDocumentContext * ctx);
+
+	/**
+	 * \brief Return the document context in use (or NULL)
+	 */
+
+	XSECDocumentContext * getDocumentContext(void) const;
+
+	/**
+	 * \brief Remember successful checks of the SignatureValue
+	 *
+	 * When set, a SignatureValue that has already been verified over the
+	 * same canonical SignedInfo with the same public key is accepted
+	 * without repeating the public key operation.  The References are
+	 * still digested and checked against the SignedInfo by verify().
+	 *
+	 * @note The cache is not owned by the signature, and may be shared
+	 * by many signatures and threads.  Pass NULL to stop using it.
+	 * @see XSECVerificationCache
+	 */
+
+	void setVerificationCache(XSECVerificationCache * cache);
+
+	/**
+	 * \brief Return the verification cache in use (or NULL)
+	 */
+
+	XSECVerificationCache * getVerificationCache(void) const;
+
+	/**
+	 * \brief Fetch and digest external References concurrently
+	 *
+	 * Detached signatures and manifests referring to many files or HTTP
+	 * resources spend most of their verification time waiting on I/O.
+	 * Setting a non-zero limit allows up to maxConcurrent such References
+	 * to be opened and digested at once on the library's thread pool.
+	 * Same-document References are still processed on the calling thread
+	 * and results (including error messages) are reported in Reference
+	 * order, exactly as when the limit is 0 (the default).
+	 *
+	 * @note Each concurrent fetch uses its own clone of the registered
+	 * URI resolver.  The number of threads doing the work is set by
+	 * XSECPlatformUtils::SetThreadPoolSize().
+	 * @param maxConcurrent Maximum number of outstanding fetches
+	 */
+
+	void setExternalReferencePrefetch(unsigned int maxConcurrent);
+
+	/**
+	 * \brief Return the limit on concurrently fetched external References
+	 */
+
+	unsigned int getExternalReferencePrefetch(void) const;
+
+	/**
+	 * \brief Verify References in parallel
+	 *
+	 * When set, verify() digests the Signature's References concurrently
+	 * on the library's thread pool.  This covers same-document References
+	 * whose transforms only read the DOM (canonicalisation and enveloped
+	 * signature) as well as external References (as for
+	 * setExternalReferencePrefetch()).  Other References, and any
+	 * Manifests, are processed on the calling thread, and the document is
+	 * never read by a worker while one of them is being processed.
+	 *
+	 * The result, and any error strings, are identical to verifying the
+	 * References one at a time.
+	 *
+	 * The flag also applies to sign(), where References that do not
+	 * cover each other's DigestValue are digested concurrently.
+	 *
+	 * @note The document must not be modified by other threads while
+	 * verification is in progress.
+	 * @param flag true to verify References in parallel (default false)
+	 */
+
+	void setParallelReferenceVerification(bool flag);
+
+	/**
+	 * \brief Are References verified in parallel?
+	 */
+
+	bool getParallelReferenceVerification(void) const;
+
 	/**
 	 * \brief Register a KeyInfoResolver 
 	 *
@@ -991,6 +1157,8 @@ private:
 	void createKeyInfoElement(void);
 	bool verifySignatureOnlyInternal(void);
 	TXFMChain * getSignedInfoInput(void);
+	bool makeVerificationCacheKey(const unsigned char * signedInfoHash,
+		unsigned int signedInfoHashLen, std::string & key);
 
 	// Initialisation
 	static void Initialise(void);
@@ -1026,6 +1194,11 @@ private:
 	// Interlocking references
 	bool						m_interlockingReferences;
 
+	// Incremental signing
+	bool						m_incrementalSigning;
+	DSIGReference::ChangedNodeVectorType
+								m_changedNodes;
+
 	// Not implemented constructors
 
 	DSIGSignature();
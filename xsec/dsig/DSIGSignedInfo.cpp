@@ -131,9 +131,10 @@ bool DSIGSignedInfo::verify(safeBuffer &errStr) {
 //           Calculate and set hash values for each reference element
 // --------------------------------------------------------------------------------
 
-void DSIGSignedInfo::hash(bool interlockingReferences) {
+void DSIGSignedInfo::hash(bool interlockingReferences,
+						  const DSIGReference::ChangedNodeVectorType * changed) {
 
-	DSIGReference::hashReferenceList(mp_referenceList, interlockingReferences);
+	DSIGReference::hashReferenceList(mp_referenceList, interlockingReferences, changed);
 
 }
 
@@ -35,6 +35,7 @@
 #include <xsec/framework/XSECDefs.hpp>
 #include <xsec/utils/XSECSafeBufferFormatter.hpp>
 #include <xsec/dsig/DSIGConstants.hpp>
+#include <xsec/dsig/DSIGReference.hpp>
 #include <xsec/dsig/DSIGReferenceList.hpp>
 
 // Xerces Includes
@@ -149,9 +150,12 @@ public:
 	 *
 	 * @param interlockingReferences Set to true if any references depend on other
 	 * references
+	 * @param changed If not NULL, only re-hash references that may be affected
+	 * by changes to these nodes
 	 */
 
-	void hash(bool interlockingReferences);
+	void hash(bool interlockingReferences,
+		const DSIGReference::ChangedNodeVectorType * changed = NULL);
 
 	/**
 	 * \brief Create an empty SignedInfo
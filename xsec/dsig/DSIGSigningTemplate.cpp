@@ -0,0 +1,230 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * DSIGSigningTemplate := A validated Signature that can be stamped onto
+ *                        many documents
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/dsig/DSIGSigningTemplate.hpp>
+#include <xsec/dsig/DSIGConstants.hpp>
+#include <xsec/dsig/DSIGReference.hpp>
+#include <xsec/dsig/DSIGReferenceList.hpp>
+#include <xsec/dsig/DSIGSignature.hpp>
+#include <xsec/enc/XSECCryptoKey.hpp>
+#include <xsec/framework/XSECAlgorithmMapper.hpp>
+#include <xsec/framework/XSECError.hpp>
+#include <xsec/framework/XSECProvider.hpp>
+#include <xsec/utils/XSECDOMUtils.hpp>
+#include <xsec/utils/XSECPlatformUtils.hpp>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Construction
+// --------------------------------------------------------------------------------
+
+namespace {
+
+	void checkReferenceAlgorithms(DSIGReferenceList * lst) {
+
+		DSIGReferenceList::size_type size = (lst ? lst->getSize() : 0);
+
+		for (DSIGReferenceList::size_type i = 0; i < size; ++i) {
+
+			DSIGReference * r = lst->item(i);
+
+			if (XSECPlatformUtils::g_algorithmMapper->mapURIToHandler(r->getAlgorithmURI()) == NULL) {
+
+				throw XSECException(XSECException::SigVfyError,
+					"DSIGSigningTemplate - Reference digest method has no handler");
+
+			}
+
+			if (r->isManifest())
+				checkReferenceAlgorithms(r->getManifestReferenceList());
+
+		}
+
+	}
+
+}
+
+DSIGSigningTemplate::DSIGSigningTemplate(const DOMElement * signature) :
+mp_templateDoc(NULL),
+mp_templateElt(NULL),
+m_referenceCount(0) {
+
+	if (signature == NULL || !strEquals(getDSIGLocalName(signature), "Signature")) {
+
+		throw XSECException(XSECException::ExpectedDSIGChildNotFound,
+			"DSIGSigningTemplate - Expected a Signature element");
+
+	}
+
+	// Copy into a document of our own
+
+	XMLCh tempStr[100];
+	XMLString::transcode("Core", tempStr, 99);
+	DOMImplementation *impl = DOMImplementationRegistry::getDOMImplementation(tempStr);
+
+	mp_templateDoc = impl->createDocument();
+
+	try {
+
+		mp_templateElt = (DOMElement *) mp_templateDoc->importNode(
+			(DOMNode *) signature, true);
+		mp_templateDoc->appendChild(mp_templateElt);
+
+		// Bring along any namespaces declared above the Signature, so the
+		// copy canonicalises the same wherever it is stamped.  The nearest
+		// declaration of each prefix wins.
+
+		for (const DOMNode * a = signature->getParentNode(); a != NULL; a = a->getParentNode()) {
+
+			if (a->getNodeType() != DOMNode::ELEMENT_NODE)
+				continue;
+
+			DOMNamedNodeMap * atts = a->getAttributes();
+			xsecsize_t count = (atts ? atts->getLength() : 0);
+
+			for (xsecsize_t i = 0; i < count; ++i) {
+
+				DOMNode * att = atts->item(i);
+
+				if (!strEquals(att->getNamespaceURI(), DSIGConstants::s_unicodeStrURIXMLNS) ||
+					mp_templateElt->hasAttributeNS(DSIGConstants::s_unicodeStrURIXMLNS, att->getLocalName()))
+					continue;
+
+				mp_templateElt->setAttributeNS(DSIGConstants::s_unicodeStrURIXMLNS,
+					att->getNodeName(), att->getNodeValue());
+
+			}
+
+		}
+
+		// Check it all loads and every algorithm is known, so stamp()
+		// cannot fail for reasons of the template
+
+		XSECProvider prov;
+		DSIGSignature * sig = prov.newSignatureFromDOM(mp_templateDoc, mp_templateElt);
+		sig->load();
+
+		if (sig->getCanonicalizationMethod() == CANON_NONE) {
+
+			throw XSECException(XSECException::SigVfyError,
+				"DSIGSigningTemplate - Unknown canonicalisation method");
+
+		}
+
+		if (XSECPlatformUtils::g_algorithmMapper->mapURIToHandler(sig->getAlgorithmURI()) == NULL) {
+
+			throw XSECException(XSECException::SigVfyError,
+				"DSIGSigningTemplate - Signature method has no handler");
+
+		}
+
+		checkReferenceAlgorithms(sig->getReferenceList());
+		m_referenceCount = (unsigned int) sig->getReferenceList()->getSize();
+
+	}
+	catch (...) {
+		mp_templateDoc->release();
+		throw;
+	}
+
+}
+
+DSIGSigningTemplate::~DSIGSigningTemplate() {
+
+	mp_templateDoc->release();
+
+}
+
+// --------------------------------------------------------------------------------
+//           Stamp
+// --------------------------------------------------------------------------------
+
+DOMElement * DSIGSigningTemplate::stamp(DOMDocument * doc,
+										DOMNode * parent,
+										const XSECCryptoKey * key,
+										const XMLCh * const * referenceURIs,
+										DOMNode * before) const {
+
+	if (doc == NULL || parent == NULL || key == NULL) {
+
+		throw XSECException(XSECException::SignatureCreationError,
+			"DSIGSigningTemplate::stamp - document, parent and key must be provided");
+
+	}
+
+	DOMElement * sigElt;
+
+	{
+		XMLMutexLock lock(&m_mutex);
+		sigElt = (DOMElement *) doc->importNode(mp_templateElt, true);
+	}
+
+	parent->insertBefore(sigElt, before);
+
+	try {
+
+		if (referenceURIs != NULL) {
+
+			DOMElement * ref = findFirstElementChild(findFirstElementChild(sigElt));
+			unsigned int i = 0;
+
+			for (; ref != NULL && i < m_referenceCount; ref = findNextElementChild(ref)) {
+
+				if (!strEquals(getDSIGLocalName(ref), "Reference"))
+					continue;
+
+				if (referenceURIs[i] != NULL)
+					ref->setAttributeNS(NULL, DSIGConstants::s_unicodeStrURI, referenceURIs[i]);
+
+				++i;
+
+			}
+
+		}
+
+		XSECProvider prov;
+		DSIGSignature * sig = prov.newSignatureFromDOM(doc, sigElt);
+
+		sig->setSigningKey(key->clone());
+		sig->load();
+		sig->sign();
+
+	}
+	catch (...) {
+		parent->removeChild(sigElt);
+		sigElt->release();
+		throw;
+	}
+
+	return sigElt;
+
+}
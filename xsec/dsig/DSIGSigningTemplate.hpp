@@ -0,0 +1,148 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * DSIGSigningTemplate := A validated Signature that can be stamped onto
+ *                        many documents
+ *
+ * $Id$
+ *
+ */
+
+#ifndef DSIGSIGNINGTEMPLATE_INCLUDE
+#define DSIGSIGNINGTEMPLATE_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+
+#include <xercesc/dom/DOM.hpp>
+#include <xercesc/util/Mutexes.hpp>
+
+class XSECCryptoKey;
+
+/**
+ * @ingroup pubsig
+ */
+/*\@{*/
+
+/**
+ * @brief Sign many identically shaped documents from one template
+ *
+ * Building a Signature through DSIGSignature::createBlankSignature(),
+ * createReference() and the transform calls creates every element and
+ * checks every algorithm for every document signed.  A signing template
+ * is a checked copy of a Signature element that is cloned instead.
+ *
+ * The template is built from an existing Signature element (such as one
+ * created with the calls above in a scratch document, or the input to
+ * templatesign).  Its canonicalisation, signature and digest methods are
+ * checked against the algorithm mapper, and it is copied together with
+ * every namespace declaration in scope for it.
+ *
+ * stamp() imports a copy of the template into a document, then loads
+ * and signs it as DSIGSignature::sign() would.  The URIs of the
+ * References in the SignedInfo may be replaced for each stamp.  What is
+ * saved is building the Signature element; each stamp still loads the
+ * SignedInfo, its References and their transforms.
+ *
+ * A template is not changed after construction, so one may be shared by
+ * any number of threads.
+ */
+
+class DSIG_EXPORT DSIGSigningTemplate {
+
+public:
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	/**
+	 * \brief Create a template
+	 *
+	 * @param signature The Signature element to use.  It is copied, so
+	 * need not outlive the template.
+	 * @throws XSECException if the Signature cannot be loaded or uses an
+	 * algorithm that has no handler
+	 */
+
+	DSIGSigningTemplate(const XERCES_CPP_NAMESPACE_QUALIFIER DOMElement * signature);
+
+	~DSIGSigningTemplate();
+
+	//@}
+
+	/** @name Signing */
+	//@{
+
+	/**
+	 * \brief Sign a document
+	 *
+	 * A copy of the template is inserted into the document and loaded as
+	 * a DSIGSignature.  Its References are then digested and the
+	 * SignedInfo signed.
+	 *
+	 * @param doc The document to sign
+	 * @param parent The node to insert the Signature into
+	 * @param key The signing key.  It is cloned for each stamp.
+	 * @param referenceURIs If not NULL, one entry per Reference in the
+	 * SignedInfo (in order).  Non-NULL entries replace that Reference's URI.
+	 * @param before If not NULL, the Signature is inserted before this
+	 * child of parent rather than appended.
+	 * @returns The signed Signature element
+	 */
+
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMElement * stamp(
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc,
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * parent,
+		const XSECCryptoKey * key,
+		const XMLCh * const * referenceURIs = NULL,
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * before = NULL) const;
+
+	/**
+	 * \brief Number of References in the SignedInfo
+	 *
+	 * This is the number of entries expected in stamp()'s referenceURIs.
+	 */
+
+	unsigned int getReferenceCount(void) const {return m_referenceCount;}
+
+	//@}
+
+private:
+
+	// Unimplemented
+	DSIGSigningTemplate(const DSIGSigningTemplate &);
+	DSIGSigningTemplate & operator = (const DSIGSigningTemplate &);
+
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument
+								* mp_templateDoc;
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMElement
+								* mp_templateElt;
+	unsigned int				m_referenceCount;
+
+	// Guards reads of the template document
+	mutable XERCES_CPP_NAMESPACE_QUALIFIER XMLMutex
+								m_mutex;
+
+};
+
+/*\@}*/
+
+#endif /* DSIGSIGNINGTEMPLATE_INCLUDE */
@@ -0,0 +1,351 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * OpenSSLCryptoContextPool := Per-thread pool of re-usable OpenSSL digest
+ *                             and HMAC contexts
+ *
+ * $Id$
+ *
+ */
+
+#include <xsec/framework/XSECDefs.hpp>
+#if defined (XSEC_HAVE_OPENSSL)
+
+#include <xsec/enc/OpenSSL/OpenSSLCryptoContextPool.hpp>
+#include <xsec/framework/XSECError.hpp>
+
+#include <xercesc/util/Mutexes.hpp>
+
+#include <openssl/crypto.h>
+
+#include <vector>
+#include <algorithm>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Per-thread lists
+// --------------------------------------------------------------------------------
+
+namespace {
+
+	struct ThreadContexts {
+
+		std::vector<EVP_MD_CTX *>	m_digests;
+		std::vector<HMAC_CTX *>		m_hmacs;
+
+	};
+
+	typedef std::vector<ThreadContexts *>	ThreadContextsVectorType;
+
+	// As for XSECParserPool, every per-thread list is also held here so
+	// Terminate() can clean up after threads that are still running.
+	//
+	// Threads may exit (and so run their cleanup) after Terminate(), and
+	// after Xerces itself has gone, so on POSIX the registry is guarded by
+	// a native mutex that is never destroyed.  s_active is only true
+	// between Initialise() and Terminate(); once it is false the pool is
+	// bypassed and thread cleanups find nothing to do.
+
+	int							s_initCount = 0;
+	bool						s_active = false;
+	ThreadContextsVectorType	* s_registry = NULL;
+
+#if defined(_WIN32)
+	XMLMutex					* s_registryMutex = NULL;
+	DWORD						s_tlsIndex = TLS_OUT_OF_INDEXES;
+#else
+	pthread_mutex_t				s_registryMutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_key_t				s_tlsKey;
+#endif
+
+	class RegistryLock {
+
+	public:
+
+#if defined(_WIN32)
+		RegistryLock() {s_registryMutex->lock();}
+		~RegistryLock() {s_registryMutex->unlock();}
+#else
+		RegistryLock() {pthread_mutex_lock(&s_registryMutex);}
+		~RegistryLock() {pthread_mutex_unlock(&s_registryMutex);}
+#endif
+
+	};
+
+	void cleanseDigest(EVP_MD_CTX * ctx) {
+
+		// Leave the digest state allocated (so it can be re-used) but empty
+
+		if (ctx->digest != NULL && ctx->md_data != NULL)
+			OPENSSL_cleanse(ctx->md_data, ctx->digest->ctx_size);
+
+	}
+
+	void freeHMAC(HMAC_CTX * ctx) {
+
+		HMAC_CTX_cleanup(ctx);
+		delete ctx;
+
+	}
+
+	void deleteThreadContexts(ThreadContexts * tc) {
+
+		std::for_each(tc->m_digests.begin(), tc->m_digests.end(), EVP_MD_CTX_destroy);
+		std::for_each(tc->m_hmacs.begin(), tc->m_hmacs.end(), freeHMAC);
+
+		delete tc;
+
+	}
+
+	ThreadContexts * getThreadContexts(bool create) {
+
+		ThreadContexts * tc;
+
+#if defined(_WIN32)
+		tc = (ThreadContexts *) TlsGetValue(s_tlsIndex);
+#else
+		tc = (ThreadContexts *) pthread_getspecific(s_tlsKey);
+#endif
+
+		if (tc != NULL || !create)
+			return tc;
+
+		XSECnew(tc, ThreadContexts);
+		tc->m_digests.reserve(XSEC_CONTEXT_POOL_MAX_PER_THREAD);
+		tc->m_hmacs.reserve(XSEC_CONTEXT_POOL_MAX_PER_THREAD);
+
+		{
+			RegistryLock lock;
+			s_registry->push_back(tc);
+		}
+
+#if defined(_WIN32)
+		TlsSetValue(s_tlsIndex, tc);
+#else
+		pthread_setspecific(s_tlsKey, tc);
+#endif
+
+		return tc;
+
+	}
+
+}
+
+#if !defined(_WIN32)
+
+// Called by pthreads as each thread that used the pool exits
+
+extern "C" void OpenSSLCryptoContextPoolThreadCleanup(void * arg) {
+
+	ThreadContexts * tc = (ThreadContexts *) arg;
+
+	{
+		RegistryLock lock;
+
+		if (!s_active)
+			return;		// Already cleaned up by Terminate
+
+		ThreadContextsVectorType::iterator i =
+			std::find(s_registry->begin(), s_registry->end(), tc);
+		if (i == s_registry->end())
+			return;
+		s_registry->erase(i);
+	}
+
+	deleteThreadContexts(tc);
+
+}
+
+#endif
+
+// --------------------------------------------------------------------------------
+//           Initialise and Terminate
+// --------------------------------------------------------------------------------
+
+void OpenSSLCryptoContextPool::Initialise(void) {
+
+	if (s_initCount++ > 0)
+		return;
+
+#if defined(_WIN32)
+	s_tlsIndex = TlsAlloc();
+	if (s_tlsIndex == TLS_OUT_OF_INDEXES)
+#else
+	if (pthread_key_create(&s_tlsKey, OpenSSLCryptoContextPoolThreadCleanup) != 0)
+#endif
+		throw XSECException(XSECException::InternalError,
+			"OpenSSLCryptoContextPool::Initialise - Unable to allocate thread local storage");
+
+#if defined(_WIN32)
+	XSECnew(s_registryMutex, XMLMutex);
+#endif
+
+	RegistryLock lock;
+	XSECnew(s_registry, ThreadContextsVectorType);
+	s_active = true;
+
+}
+
+void OpenSSLCryptoContextPool::Terminate(void) {
+
+	if (s_initCount == 0 || --s_initCount > 0 || !s_active)
+		return;
+
+	// Drain every thread's list and disable the pool, so nothing is
+	// freed twice or left for a thread cleanup to find later
+
+	{
+		RegistryLock lock;
+
+		s_active = false;
+
+		std::for_each(s_registry->begin(), s_registry->end(), deleteThreadContexts);
+		delete s_registry;
+		s_registry = NULL;
+	}
+
+#if defined(_WIN32)
+	TlsFree(s_tlsIndex);
+	s_tlsIndex = TLS_OUT_OF_INDEXES;
+	delete s_registryMutex;
+	s_registryMutex = NULL;
+#else
+	// No more cleanups are started for this key
+	pthread_key_delete(s_tlsKey);
+#endif
+
+}
+
+// --------------------------------------------------------------------------------
+//           Digest contexts
+// --------------------------------------------------------------------------------
+
+EVP_MD_CTX * OpenSSLCryptoContextPool::acquireDigest(const EVP_MD * md) {
+
+	EVP_MD_CTX * ret = NULL;
+
+	ThreadContexts * tc = (s_active ? getThreadContexts(true) : NULL);
+
+	if (tc != NULL && !tc->m_digests.empty()) {
+
+		// Prefer one last used for the same digest, as it needs no allocation
+		std::vector<EVP_MD_CTX *>::iterator i = tc->m_digests.end();
+		while (i != tc->m_digests.begin()) {
+			--i;
+			if ((*i)->digest == md)
+				break;
+		}
+
+		if ((*i)->digest != md)
+			i = tc->m_digests.end() - 1;
+
+		ret = *i;
+		tc->m_digests.erase(i);
+
+	}
+
+	if (ret == NULL) {
+
+		ret = EVP_MD_CTX_create();
+		if (ret == NULL)
+			throw XSECException(XSECException::MemoryAllocationFail,
+				"OpenSSLCryptoContextPool - Unable to allocate digest context");
+
+	}
+
+	EVP_DigestInit_ex(ret, md, NULL);
+	return ret;
+
+}
+
+void OpenSSLCryptoContextPool::releaseDigest(EVP_MD_CTX * ctx) {
+
+	if (ctx == NULL)
+		return;
+
+	ThreadContexts * tc = (s_active ? getThreadContexts(false) : NULL);
+
+	if (tc == NULL || tc->m_digests.size() >= XSEC_CONTEXT_POOL_MAX_PER_THREAD) {
+		EVP_MD_CTX_destroy(ctx);
+		return;
+	}
+
+	cleanseDigest(ctx);
+	tc->m_digests.push_back(ctx);
+
+}
+
+// --------------------------------------------------------------------------------
+//           HMAC contexts
+// --------------------------------------------------------------------------------
+
+HMAC_CTX * OpenSSLCryptoContextPool::acquireHMAC(void) {
+
+	ThreadContexts * tc = (s_active ? getThreadContexts(true) : NULL);
+
+	if (tc != NULL && !tc->m_hmacs.empty()) {
+
+		HMAC_CTX * ret = tc->m_hmacs.back();
+		tc->m_hmacs.pop_back();
+		return ret;
+
+	}
+
+	HMAC_CTX * ret;
+	XSECnew(ret, HMAC_CTX);
+	HMAC_CTX_init(ret);
+
+	return ret;
+
+}
+
+void OpenSSLCryptoContextPool::releaseHMAC(HMAC_CTX * ctx) {
+
+	if (ctx == NULL)
+		return;
+
+	ThreadContexts * tc = (s_active ? getThreadContexts(false) : NULL);
+
+	if (tc == NULL || tc->m_hmacs.size() >= XSEC_CONTEXT_POOL_MAX_PER_THREAD) {
+		freeHMAC(ctx);
+		return;
+	}
+
+	// The keyed state especially must not be left behind
+	cleanseDigest(&ctx->i_ctx);
+	cleanseDigest(&ctx->o_ctx);
+	cleanseDigest(&ctx->md_ctx);
+	OPENSSL_cleanse(ctx->key, sizeof(ctx->key));
+	ctx->key_length = 0;
+
+	tc->m_hmacs.push_back(ctx);
+
+}
+
+#endif /* XSEC_HAVE_OPENSSL */
@@ -0,0 +1,122 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * OpenSSLCryptoContextPool := Per-thread pool of re-usable OpenSSL digest
+ *                             and HMAC contexts
+ *
+ * $Id$
+ *
+ */
+
+#ifndef OPENSSLCRYPTOCONTEXTPOOL_INCLUDE
+#define OPENSSLCRYPTOCONTEXTPOOL_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+
+#if defined (XSEC_HAVE_OPENSSL)
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+/**
+ * \brief Pool of OpenSSL contexts used by the hash classes
+ * @ingroup internal
+ *
+ * Every OpenSSLCryptoHash and OpenSSLCryptoHashHMAC needs a context,
+ * and setting one up means allocating both the context and the digest
+ * state behind it.  Hash objects are created and deleted constantly
+ * (one or more per Reference), so the contexts are instead taken from,
+ * and handed back to, a free list held per thread.  A context handed
+ * back still has its digest state allocated, so re-initialising it for
+ * the same algorithm does no allocation at all.  No locking is needed
+ * on the hot path.
+ *
+ * Each thread keeps at most XSEC_CONTEXT_POOL_MAX_PER_THREAD idle
+ * contexts of each kind - any beyond that are freed when returned.
+ * Returned contexts are cleansed, so no digest or key state is left
+ * lying in the pool.
+ *
+ * The pool is set up and torn down by OpenSSLCryptoProvider.  Until it
+ * is (or once it has gone) contexts are simply created and freed.
+ */
+
+#define XSEC_CONTEXT_POOL_MAX_PER_THREAD	8
+
+class OpenSSLCryptoContextPool {
+
+public:
+
+	/**
+	 * \brief Obtain a digest context
+	 *
+	 * @param md The digest the context is to be initialised for
+	 * @returns A context, initialised for md.  Must be handed back via
+	 * releaseDigest() on the same thread.
+	 */
+
+	static EVP_MD_CTX * acquireDigest(const EVP_MD * md);
+
+	/**
+	 * \brief Return a digest context to the calling thread's pool
+	 */
+
+	static void releaseDigest(EVP_MD_CTX * ctx);
+
+	/**
+	 * \brief Obtain an HMAC context
+	 *
+	 * @returns An HMAC context, ready for HMAC_Init_ex().  Must be
+	 * handed back via releaseHMAC() on the same thread.
+	 */
+
+	static HMAC_CTX * acquireHMAC(void);
+
+	/**
+	 * \brief Return an HMAC context to the calling thread's pool
+	 */
+
+	static void releaseHMAC(HMAC_CTX * ctx);
+
+	/**
+	 * \brief Set up the pool.  Called as each OpenSSLCryptoProvider is built
+	 */
+
+	static void Initialise(void);
+
+	/**
+	 * \brief Free all pooled contexts for all threads.
+	 *
+	 * Called as each OpenSSLCryptoProvider is deleted.  Only the last
+	 * call does anything.  The pool is disabled, so threads that exit
+	 * afterwards have nothing left to free.
+	 */
+
+	static void Terminate(void);
+
+private:
+
+	OpenSSLCryptoContextPool();
+
+};
+
+#endif /* XSEC_HAVE_OPENSSL */
+#endif /* OPENSSLCRYPTOCONTEXTPOOL_INCLUDE */
@@ -32,6 +32,8 @@
 #if defined (XSEC_HAVE_OPENSSL)
 
 #include <xsec/enc/OpenSSL/OpenSSLCryptoHash.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoProvider.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoContextPool.hpp>
 #include <xsec/enc/XSECCryptoException.hpp>
 
 #include <memory.h>
@@ -40,71 +42,45 @@
 
 OpenSSLCryptoHash::OpenSSLCryptoHash(HashType alg) {
 
-	switch (alg) {
+	mp_md = OpenSSLCryptoProvider::getDigest(alg);
 
-	case (XSECCryptoHash::HASH_SHA1) :
-	
-		mp_md = EVP_get_digestbyname("SHA1");
-		break;
+	if(!mp_md) {
 
-	case (XSECCryptoHash::HASH_MD5) :
-	
-		mp_md = EVP_get_digestbyname("MD5");
-		break;
+		// The provider found no digest when it was built - say which
 
-	case (XSECCryptoHash::HASH_SHA224) :
-	
-		mp_md = EVP_get_digestbyname("SHA224");
-		if (mp_md == NULL) {
-			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA224 not supported by this version of OpenSSL"); 
-		}
+		switch (alg) {
 
-		break;
+		case (XSECCryptoHash::HASH_SHA224) :
 
-	case (XSECCryptoHash::HASH_SHA256) :
-	
-		mp_md = EVP_get_digestbyname("SHA256");
-		if (mp_md == NULL) {
 			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA256 not supported by this version of OpenSSL"); 
-		}
+				"OpenSSL:Hash - SHA224 not supported by this version of OpenSSL"); 
 
-		break;
+		case (XSECCryptoHash::HASH_SHA256) :
 
-	case (XSECCryptoHash::HASH_SHA384) :
-	
-		mp_md = EVP_get_digestbyname("SHA384");
-		if (mp_md == NULL) {
 			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA384 not supported by this version of OpenSSL"); 
-		}
+				"OpenSSL:Hash - SHA256 not supported by this version of OpenSSL"); 
 
-		break;
+		case (XSECCryptoHash::HASH_SHA384) :
 
-	case (XSECCryptoHash::HASH_SHA512) :
-	
-		mp_md = EVP_get_digestbyname("SHA512");
-		if (mp_md == NULL) {
 			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA512 not supported by this version of OpenSSL"); 
-		}
+				"OpenSSL:Hash - SHA384 not supported by this version of OpenSSL"); 
 
-		break;
+		case (XSECCryptoHash::HASH_SHA512) :
 
-	default :
+			throw XSECCryptoException(XSECCryptoException::MDError,
+				"OpenSSL:Hash - SHA512 not supported by this version of OpenSSL"); 
 
-		mp_md = NULL;
+		default :
 
-	}
+			throw XSECCryptoException(XSECCryptoException::MDError,
+				"OpenSSL:Hash - Error loading Message Digest"); 
 
-	if(!mp_md) {
+		}
 
-		throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - Error loading Message Digest"); 
 	}
 
-	EVP_DigestInit(&m_mdctx, mp_md);
+	// Comes from the thread's pool, already initialised for mp_md
+	mp_mdctx = OpenSSLCryptoContextPool::acquireDigest(mp_md);
 	m_hashType = alg;
 
 }
@@ -112,7 +88,7 @@ OpenSSLCryptoHash::OpenSSLCryptoHash(HashType alg) {
 
 OpenSSLCryptoHash::~OpenSSLCryptoHash() {
 
-	EVP_MD_CTX_cleanup(&m_mdctx);
+	OpenSSLCryptoContextPool::releaseDigest(mp_mdctx);
 
 }
 
@@ -121,16 +97,15 @@ OpenSSLCryptoHash::~OpenSSLCryptoHash() {
 // Hashing Activities
 void OpenSSLCryptoHash::reset(void) {
 
-	EVP_MD_CTX_cleanup(&m_mdctx);
-
-	EVP_DigestInit(&m_mdctx, mp_md);
+	// Re-uses the digest state already allocated in the context
+	EVP_DigestInit_ex(mp_mdctx, mp_md, NULL);
 
 }
 
 void OpenSSLCryptoHash::hash(unsigned char * data, 
 								 unsigned int length) {
 
-	EVP_DigestUpdate(&m_mdctx, data, length);
+	EVP_DigestUpdate(mp_mdctx, data, length);
 
 }
 unsigned int OpenSSLCryptoHash::finish(unsigned char * hash,
@@ -140,7 +115,7 @@ unsigned int OpenSSLCryptoHash::finish(unsigned char * hash,
 
 	// Finish up and copy out hash, returning the length
 
-	EVP_DigestFinal(&m_mdctx, m_mdValue, &m_mdLen);
+	EVP_DigestFinal_ex(mp_mdctx, m_mdValue, &m_mdLen);
 
 	// Copy to output buffer
 	
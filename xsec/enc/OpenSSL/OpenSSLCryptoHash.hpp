@@ -138,7 +138,7 @@ public :
 	 * \brief Get OpenSSL hash context structure
 	 */
 
-	EVP_MD_CTX * getOpenSSLEVP_MD_CTX(void) {return &m_mdctx;}
+	EVP_MD_CTX * getOpenSSLEVP_MD_CTX(void) {return mp_mdctx;}
 
 	//@}
 
@@ -148,7 +148,7 @@ private:
 	// Not implemented constructors
 	OpenSSLCryptoHash();
 
-	EVP_MD_CTX			m_mdctx;						// Context for digest
+	EVP_MD_CTX			* mp_mdctx;						// Context for digest (pooled)
 	const EVP_MD		* mp_md;						// Digest instance
 	unsigned char		m_mdValue[EVP_MAX_MD_SIZE];		// Final output
 	unsigned int		m_mdLen;						// Length of digest
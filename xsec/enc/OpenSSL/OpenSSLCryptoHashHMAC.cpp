@@ -33,8 +33,12 @@
 
 
 #include <xsec/enc/OpenSSL/OpenSSLCryptoHashHMAC.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoProvider.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoContextPool.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoKeyHMAC.hpp>
 #include <xsec/enc/XSECCryptoException.hpp>
 #include <xsec/enc/XSECCryptoKeyHMAC.hpp>
+#include <xsec/utils/XSECDOMUtils.hpp>
 
 #include <memory.h>
 
@@ -44,70 +48,44 @@ OpenSSLCryptoHashHMAC::OpenSSLCryptoHashHMAC(HashType alg) {
 
 	// Initialise the digest
 
-	switch (alg) {
+	mp_md = OpenSSLCryptoProvider::getDigest(alg);
 
-	case (XSECCryptoHash::HASH_SHA1) :
-	
-		mp_md = EVP_get_digestbyname("SHA1");
-		break;
+	if(!mp_md) {
 
-	case (XSECCryptoHash::HASH_MD5) :
-	
-		mp_md = EVP_get_digestbyname("MD5");
-		break;
+		// The provider found no digest when it was built - say which
 
-	case (XSECCryptoHash::HASH_SHA224) :
-	
-		mp_md = EVP_get_digestbyname("SHA224");
-		if (mp_md == NULL) {
-			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA224 not supported by this version of OpenSSL"); 
-		}
+		switch (alg) {
 
-		break;
+		case (XSECCryptoHash::HASH_SHA224) :
 
-	case (XSECCryptoHash::HASH_SHA256) :
-	
-		mp_md = EVP_get_digestbyname("SHA256");
-		if (mp_md == NULL) {
 			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA256 not supported by this version of OpenSSL"); 
-		}
+				"OpenSSL:Hash - SHA224 not supported by this version of OpenSSL"); 
 
-		break;
+		case (XSECCryptoHash::HASH_SHA256) :
 
-	case (XSECCryptoHash::HASH_SHA384) :
-	
-		mp_md = EVP_get_digestbyname("SHA384");
-		if (mp_md == NULL) {
 			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA384 not supported by this version of OpenSSL"); 
-		}
+				"OpenSSL:Hash - SHA256 not supported by this version of OpenSSL"); 
 
-		break;
+		case (XSECCryptoHash::HASH_SHA384) :
 
-	case (XSECCryptoHash::HASH_SHA512) :
-	
-		mp_md = EVP_get_digestbyname("SHA512");
-		if (mp_md == NULL) {
 			throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:Hash - SHA512 not supported by this version of OpenSSL"); 
-		}
+				"OpenSSL:Hash - SHA384 not supported by this version of OpenSSL"); 
 
-		break;
+		case (XSECCryptoHash::HASH_SHA512) :
 
-	default :
+			throw XSECCryptoException(XSECCryptoException::MDError,
+				"OpenSSL:Hash - SHA512 not supported by this version of OpenSSL"); 
 
-		mp_md = NULL;
+		default :
 
-	}
+			throw XSECCryptoException(XSECCryptoException::MDError,
+				"OpenSSL:HashHMAC - Error loading Message Digest"); 
 
-	if(!mp_md) {
+		}
 
-		throw XSECCryptoException(XSECCryptoException::MDError,
-			"OpenSSL:HashHMAC - Error loading Message Digest"); 
 	}
 
+	mp_hctx = OpenSSLCryptoContextPool::acquireHMAC();
 	m_initialised = false;
 	m_hashType = alg;
 
@@ -124,13 +102,26 @@ void OpenSSLCryptoHashHMAC::setKey(XSECCryptoKey *key) {
 
 	}
 
-	m_keyLen = ((XSECCryptoKeyHMAC *) key)->getKey(m_keyBuf);
+	// An OpenSSL key holds contexts it has already keyed, so this is
+	// just a copy
+
+	if (strEquals(key->getProviderName(), DSIGConstants::s_unicodeStrPROVOpenSSL) &&
+		((OpenSSLCryptoKeyHMAC *) key)->initHMAC(mp_hctx, m_hashType)) {
+
+		m_initialised = true;
+		return;
+
+	}
 
+	m_keyLen = ((XSECCryptoKeyHMAC *) key)->getKey(m_keyBuf);
 
-	HMAC_Init(&m_hctx, 
+	// The pooled context keeps its digest state allocated, so this
+	// only re-computes the keyed pads
+	HMAC_Init_ex(mp_hctx, 
 		m_keyBuf.rawBuffer(),
 		m_keyLen,
-		mp_md);
+		mp_md,
+		NULL);
 
 	m_initialised = true;
 
@@ -138,8 +129,7 @@ void OpenSSLCryptoHashHMAC::setKey(XSECCryptoKey *key) {
 
 OpenSSLCryptoHashHMAC::~OpenSSLCryptoHashHMAC() {
 
-	if (m_initialised)
-		HMAC_CTX_cleanup(&m_hctx);
+	OpenSSLCryptoContextPool::releaseHMAC(mp_hctx);
 
 }
 
@@ -149,16 +139,10 @@ OpenSSLCryptoHashHMAC::~OpenSSLCryptoHashHMAC() {
 
 void OpenSSLCryptoHashHMAC::reset(void) {
 
-	if (m_initialised) {
-
-		HMAC_CTX_cleanup(&m_hctx);
+	// No key, so the context starts again from the already keyed pads
 
-		HMAC_Init(&m_hctx, 
-			m_keyBuf.rawBuffer(),
-			m_keyLen,
-			mp_md);
-
-	}
+	if (m_initialised)
+		HMAC_Init_ex(mp_hctx, NULL, 0, NULL, NULL);
 
 }
 
@@ -170,7 +154,7 @@ void OpenSSLCryptoHashHMAC::hash(unsigned char * data,
 			"OpenSSL:HashHMAC - hash called prior to setKey");
 
 
-	HMAC_Update(&m_hctx, data, (int) length);
+	HMAC_Update(mp_hctx, data, (int) length);
 
 }
 
@@ -181,7 +165,7 @@ unsigned int OpenSSLCryptoHashHMAC::finish(unsigned char * hash,
 
 	// Finish up and copy out hash, returning the length
 
-	HMAC_Final(&m_hctx, m_mdValue, &m_mdLen);
+	HMAC_Final(mp_hctx, m_mdValue, &m_mdLen);
 
 	// Copy to output buffer
 	
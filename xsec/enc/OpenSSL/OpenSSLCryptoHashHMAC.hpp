@@ -162,7 +162,7 @@ public :
 	 * \brief Get OpenSSL Hash Context
 	 */
 
-	HMAC_CTX * getOpenSSLHMAC_CTX(void) {return &m_hctx;}
+	HMAC_CTX * getOpenSSLHMAC_CTX(void) {return mp_hctx;}
 
 	//@}
 
@@ -175,7 +175,7 @@ private:
 	unsigned char		m_mdValue[EVP_MAX_MD_SIZE];		// Final output
 	unsigned int		m_mdLen;						// Length of digest
 	HashType			m_hashType;						// What type of hash is this?
-	HMAC_CTX			m_hctx;							// Context for HMAC
+	HMAC_CTX			* mp_hctx;						// Context for HMAC (pooled)
 	safeBuffer			m_keyBuf;						// The loaded key
 	unsigned int		m_keyLen;						// The loaded key length
 	bool				m_initialised;
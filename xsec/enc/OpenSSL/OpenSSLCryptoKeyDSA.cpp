@@ -35,12 +35,14 @@
 #include <xsec/enc/XSECCryptoException.hpp>
 #include <xsec/enc/XSECCryptoUtils.hpp>
 #include <xsec/framework/XSECError.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
 
 #include <xercesc/util/Janitor.hpp>
 
 XSEC_USING_XERCES(ArrayJanitor);
 
 #include <openssl/dsa.h>
+#include <openssl/x509.h>
 
 OpenSSLCryptoKeyDSA::OpenSSLCryptoKeyDSA() : mp_dsaKey(NULL) {
 };
@@ -79,8 +81,7 @@ XSECCryptoKey::KeyType OpenSSLCryptoKeyDSA::getKeyType() const {
 
 void OpenSSLCryptoKeyDSA::loadPBase64BigNums(const char * b64, unsigned int len) {
 
-	if (mp_dsaKey == NULL)
-		mp_dsaKey = DSA_new();
+	unshareKey();
 
 	mp_dsaKey->p = OpenSSLCryptoBase64::b642BN((char *) b64, len);
 
@@ -88,8 +89,7 @@ void OpenSSLCryptoKeyDSA::loadPBase64BigNums(const char * b64, unsigned int len)
 
 void OpenSSLCryptoKeyDSA::loadQBase64BigNums(const char * b64, unsigned int len) {
 
-	if (mp_dsaKey == NULL)
-		mp_dsaKey = DSA_new();
+	unshareKey();
 
 	mp_dsaKey->q = OpenSSLCryptoBase64::b642BN((char *) b64, len);
 
@@ -97,8 +97,7 @@ void OpenSSLCryptoKeyDSA::loadQBase64BigNums(const char * b64, unsigned int len)
 
 void OpenSSLCryptoKeyDSA::loadGBase64BigNums(const char * b64, unsigned int len) {
 
-	if (mp_dsaKey == NULL)
-		mp_dsaKey = DSA_new();
+	unshareKey();
 
 	mp_dsaKey->g = OpenSSLCryptoBase64::b642BN((char *) b64, len);
 
@@ -106,8 +105,7 @@ void OpenSSLCryptoKeyDSA::loadGBase64BigNums(const char * b64, unsigned int len)
 
 void OpenSSLCryptoKeyDSA::loadYBase64BigNums(const char * b64, unsigned int len) {
 
-	if (mp_dsaKey == NULL)
-		mp_dsaKey = DSA_new();
+	unshareKey();
 
 	mp_dsaKey->pub_key = OpenSSLCryptoBase64::b642BN((char *) b64, len);
 
@@ -121,6 +119,36 @@ void OpenSSLCryptoKeyDSA::loadJBase64BigNums(const char * b64, unsigned int len)
 	// Do nothing
 }
 
+void OpenSSLCryptoKeyDSA::unshareKey(void) {
+
+	if (mp_dsaKey == NULL) {
+		mp_dsaKey = DSA_new();
+		return;
+	}
+
+	// Clones share the DSA structure, and may be in use on other threads.
+	// The count is read under the lock DSA_up_ref() and DSA_free() take; a
+	// count of 1 is ours alone, and only a holder can raise it.
+	if (CRYPTO_add(&mp_dsaKey->references, 0, CRYPTO_LOCK_DSA) <= 1)
+		return;
+
+	DSA * k = DSA_new();
+
+	if (mp_dsaKey->p)
+		k->p = BN_dup(mp_dsaKey->p);
+	if (mp_dsaKey->q)
+		k->q = BN_dup(mp_dsaKey->q);
+	if (mp_dsaKey->g)
+		k->g = BN_dup(mp_dsaKey->g);
+	if (mp_dsaKey->pub_key)
+		k->pub_key = BN_dup(mp_dsaKey->pub_key);
+	if (mp_dsaKey->priv_key)
+		k->priv_key = BN_dup(mp_dsaKey->priv_key);
+
+	DSA_free(mp_dsaKey);
+	mp_dsaKey = k;
+
+}
 
 // "Hidden" OpenSSL functions
 
@@ -329,6 +357,34 @@ unsigned int OpenSSLCryptoKeyDSA::signBase64Signature(unsigned char * hashBuf,
 
 
 
+// --------------------------------------------------------------------------------
+//           Key identity
+// --------------------------------------------------------------------------------
+
+unsigned int OpenSSLCryptoKeyDSA::getPublicKeyIdentity(safeBuffer & id) const {
+
+	// The SubjectPublicKeyInfo (including the domain parameters)
+
+	if (mp_dsaKey == NULL || mp_dsaKey->pub_key == NULL)
+		return 0;
+
+	int len = i2d_DSA_PUBKEY(mp_dsaKey, NULL);
+	if (len <= 0)
+		return 0;
+
+	unsigned char * buf;
+	XSECnew(buf, unsigned char[len]);
+	ArrayJanitor<unsigned char> j_buf(buf);
+
+	unsigned char * p = buf;
+	i2d_DSA_PUBKEY(mp_dsaKey, &p);
+
+	id.sbMemcpyIn(buf, len);
+
+	return (unsigned int) len;
+
+}
+
 XSECCryptoKey * OpenSSLCryptoKeyDSA::clone() const {
 
 	OpenSSLCryptoKeyDSA * ret;
@@ -336,19 +392,12 @@ XSECCryptoKey * OpenSSLCryptoKeyDSA::clone() const {
 	XSECnew(ret, OpenSSLCryptoKeyDSA);
 
 	ret->m_keyType = m_keyType;
-	ret->mp_dsaKey = DSA_new();
 
-	// Duplicate parameters
-	if (mp_dsaKey->p)
-		ret->mp_dsaKey->p = BN_dup(mp_dsaKey->p);
-	if (mp_dsaKey->q)
-		ret->mp_dsaKey->q = BN_dup(mp_dsaKey->q);
-	if (mp_dsaKey->g)
-		ret->mp_dsaKey->g = BN_dup(mp_dsaKey->g);
-	if (mp_dsaKey->pub_key)
-		ret->mp_dsaKey->pub_key = BN_dup(mp_dsaKey->pub_key);
-	if (mp_dsaKey->priv_key)
-		ret->mp_dsaKey->priv_key = BN_dup(mp_dsaKey->priv_key);
+	// Share the key itself - it is not altered by signing or verifying
+	if (mp_dsaKey != NULL) {
+		DSA_up_ref(mp_dsaKey);
+		ret->mp_dsaKey = mp_dsaKey;
+	}
 
 	return ret;
 
@@ -87,10 +87,25 @@ public :
 
 	/**
 	 * \brief Replicate key
+	 *
+	 * The copy shares the underlying OpenSSL DSA structure (which is
+	 * reference counted) with this key.
 	 */
 
 	virtual XSECCryptoKey * clone() const;
 
+	/**
+	 * \brief Identify the key by its DER encoded public key
+	 */
+
+	virtual unsigned int getPublicKeyIdentity(safeBuffer & id) const;
+
+	/**
+	 * \brief OpenSSL keys may be used from many threads at once
+	 */
+
+	virtual bool isShareable() const {return true;}
+
 	//@}
 
 	/** @name Required DSA methods */
@@ -220,6 +235,9 @@ public :
 
 private:
 
+	// Before the key is altered, take a private copy of any shared material
+	void unshareKey(void);
+
 	XSECCryptoKey::KeyType			m_keyType;
 	DSA								* mp_dsaKey;
 	
@@ -37,6 +37,7 @@
 #include <xsec/enc/XSECCryptoUtils.hpp>
 #include <xsec/enc/XSCrypt/XSCryptCryptoBase64.hpp>
 #include <xsec/framework/XSECError.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
 #include <xsec/utils/XSECPlatformUtils.hpp>
 
 #include <xercesc/util/Janitor.hpp>
@@ -46,6 +47,7 @@ XSEC_USING_XERCES(ArrayJanitor);
 
 
 #include <openssl/ecdsa.h>
+#include <openssl/x509.h>
 
 OpenSSLCryptoKeyEC::OpenSSLCryptoKeyEC() : mp_ecKey(NULL) {
 };
@@ -300,6 +302,34 @@ unsigned int OpenSSLCryptoKeyEC::signBase64SignatureDSA(unsigned char * hashBuf,
 
 
 
+// --------------------------------------------------------------------------------
+//           Key identity
+// --------------------------------------------------------------------------------
+
+unsigned int OpenSSLCryptoKeyEC::getPublicKeyIdentity(safeBuffer & id) const {
+
+	// The SubjectPublicKeyInfo (including the curve)
+
+	if (mp_ecKey == NULL || EC_KEY_get0_public_key(mp_ecKey) == NULL)
+		return 0;
+
+	int len = i2d_EC_PUBKEY(mp_ecKey, NULL);
+	if (len <= 0)
+		return 0;
+
+	unsigned char * buf;
+	XSECnew(buf, unsigned char[len]);
+	ArrayJanitor<unsigned char> j_buf(buf);
+
+	unsigned char * p = buf;
+	i2d_EC_PUBKEY(mp_ecKey, &p);
+
+	id.sbMemcpyIn(buf, len);
+
+	return (unsigned int) len;
+
+}
+
 XSECCryptoKey * OpenSSLCryptoKeyEC::clone() const {
 
 	OpenSSLCryptoKeyEC * ret;
@@ -307,8 +337,12 @@ XSECCryptoKey * OpenSSLCryptoKeyEC::clone() const {
 	XSECnew(ret, OpenSSLCryptoKeyEC);
 
 	ret->m_keyType = m_keyType;
-    if (mp_ecKey)
-        ret->mp_ecKey = EC_KEY_dup(mp_ecKey);
+
+    // Share the key itself - it is not altered by signing or verifying
+    if (mp_ecKey) {
+        EC_KEY_up_ref(mp_ecKey);
+        ret->mp_ecKey = mp_ecKey;
+    }
 
 	return ret;
 
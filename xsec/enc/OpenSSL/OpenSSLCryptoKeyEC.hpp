@@ -88,10 +88,25 @@ public :
 
 	/**
 	 * \brief Replicate key
+	 *
+	 * The copy shares the underlying OpenSSL EC_KEY structure (which is
+	 * reference counted) with this key.
 	 */
 
 	virtual XSECCryptoKey * clone() const;
 
+	/**
+	 * \brief Identify the key by its DER encoded public key
+	 */
+
+	virtual unsigned int getPublicKeyIdentity(safeBuffer & id) const;
+
+	/**
+	 * \brief OpenSSL keys may be used from many threads at once
+	 */
+
+	virtual bool isShareable() const {return true;}
+
 	//@}
 
 	/** @name Required EC methods */
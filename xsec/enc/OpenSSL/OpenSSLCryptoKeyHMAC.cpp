@@ -32,21 +32,93 @@
 #if defined (XSEC_HAVE_OPENSSL)
 
 #include <xsec/enc/OpenSSL/OpenSSLCryptoKeyHMAC.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoProvider.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoSharedKeyState.hpp>
 #include <xsec/framework/XSECError.hpp>
+#include <xsec/enc/XSECCryptoException.hpp>
 
-OpenSSLCryptoKeyHMAC::OpenSSLCryptoKeyHMAC() :m_keyBuf("") {
+#include <memory.h>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Keyed contexts
+// --------------------------------------------------------------------------------
+
+struct OpenSSLCryptoKeyHMAC::KeyedState : public OpenSSLCryptoSharedKeyState {
+
+	KeyedState() {
+		for (int i = 0; i <= XSECCryptoHash::HASH_SHA512; ++i)
+			mp_ctx[i] = NULL;
+	}
+
+	~KeyedState() {
+		// Cleanup overwrites the keyed pads
+		for (int i = 0; i <= XSECCryptoHash::HASH_SHA512; ++i) {
+			if (mp_ctx[i] != NULL) {
+				HMAC_CTX_cleanup(mp_ctx[i]);
+				delete mp_ctx[i];
+			}
+		}
+	}
+
+	HMAC_CTX		* mp_ctx[XSECCryptoHash::HASH_SHA512 + 1];
+
+};
+
+namespace {
+
+	// HMAC_CTX_copy is not in all the OpenSSL versions supported.  As
+	// the contexts come from the pool, the copies do not allocate.
+
+	void copyHMAC(HMAC_CTX * out, HMAC_CTX * in) {
+
+		if (EVP_MD_CTX_copy_ex(&out->i_ctx, &in->i_ctx) != 1 ||
+			EVP_MD_CTX_copy_ex(&out->o_ctx, &in->o_ctx) != 1 ||
+			EVP_MD_CTX_copy_ex(&out->md_ctx, &in->md_ctx) != 1) {
+
+			throw XSECCryptoException(XSECCryptoException::MDError,
+				"OpenSSL:KeyHMAC - Error copying keyed HMAC context");
+
+		}
+
+		memcpy(out->key, in->key, sizeof(out->key));
+		out->key_length = in->key_length;
+		out->md = in->md;
+
+	}
+
+}
+
+// --------------------------------------------------------------------------------
+//           Construct/Destroy
+// --------------------------------------------------------------------------------
+
+OpenSSLCryptoKeyHMAC::OpenSSLCryptoKeyHMAC() :m_keyBuf(""), mp_state(NULL) {
 
 	m_keyBuf.isSensitive();
 	m_keyLen = 0;
 
+	XSECnew(mp_state, KeyedState);
+
 };
 
+OpenSSLCryptoKeyHMAC::~OpenSSLCryptoKeyHMAC() {
+
+	OpenSSLCryptoSharedKeyState::release(mp_state);
+
+}
+
 void OpenSSLCryptoKeyHMAC::setKey(unsigned char * inBuf, unsigned int inLength) {
 
 	m_keyBuf.sbMemcpyIn(inBuf, inLength);
 	m_keyBuf.isSensitive();
 	m_keyLen = inLength;
 
+	// Anything keyed so far (and shared with clones) is for the old key
+	OpenSSLCryptoSharedKeyState::release(mp_state);
+	XSECnew(mp_state, KeyedState);
+
 }
 
 unsigned int OpenSSLCryptoKeyHMAC::getKey(safeBuffer &outBuf) const {
@@ -56,6 +128,39 @@ unsigned int OpenSSLCryptoKeyHMAC::getKey(safeBuffer &outBuf) const {
 
 }
 
+bool OpenSSLCryptoKeyHMAC::initHMAC(HMAC_CTX * ctx, XSECCryptoHash::HashType type) const {
+
+	const EVP_MD * md = OpenSSLCryptoProvider::getDigest(type);
+
+	if (md == NULL || mp_state == NULL)
+		return false;
+
+	HMAC_CTX * keyed;
+
+	{
+		XMLMutexLock lock(&mp_state->m_mutex);
+
+		keyed = mp_state->mp_ctx[type];
+
+		if (keyed == NULL) {
+
+			XSECnew(keyed, HMAC_CTX);
+			HMAC_CTX_init(keyed);
+			HMAC_Init_ex(keyed, m_keyBuf.rawBuffer(), (int) m_keyLen, md, NULL);
+			mp_state->mp_ctx[type] = keyed;
+
+		}
+	}
+
+	// HMAC_Init_ex has already absorbed the padded key into the inner and
+	// outer digests, and the hash then only updates the copy, so the
+	// shared context is read-only from here on.
+	copyHMAC(ctx, keyed);
+
+	return true;
+
+}
+
 XSECCryptoKey * OpenSSLCryptoKeyHMAC::clone() const {
 
 	OpenSSLCryptoKeyHMAC * ret;
@@ -65,6 +170,10 @@ XSECCryptoKey * OpenSSLCryptoKeyHMAC::clone() const {
 	ret->m_keyBuf = m_keyBuf;
 	ret->m_keyLen = m_keyLen;
 
+	// Share the keyed contexts
+	OpenSSLCryptoSharedKeyState::release(ret->mp_state);
+	ret->mp_state = OpenSSLCryptoSharedKeyState::share(mp_state);
+
 	return ret;
 
 }
@@ -32,9 +32,12 @@
 #define OPENSSLCRYPTOKEYHMAC_INCLUDE
 
 #include <xsec/enc/XSECCryptoKeyHMAC.hpp>
+#include <xsec/enc/XSECCryptoHash.hpp>
 
 #if defined (XSEC_HAVE_OPENSSL)
 
+#include <openssl/hmac.h>
+
 /**
  * \ingroup opensslcrypto
  */
@@ -53,7 +56,7 @@ public :
 	//@{
 
 	OpenSSLCryptoKeyHMAC();
-	virtual ~OpenSSLCryptoKeyHMAC() {};
+	virtual ~OpenSSLCryptoKeyHMAC();
 
 	//@}
 
@@ -80,7 +83,13 @@ public :
 	 */
 
 	virtual const XMLCh * getProviderName() const {return DSIGConstants::s_unicodeStrPROVOpenSSL;}
-	
+
+	/**
+	 * \brief Only read once the key is set (each HMAC has its own context)
+	 */
+
+	virtual bool isShareable() const {return true;}
+
 	//@}
 
 	/** @name Optional Interface methods
@@ -122,10 +131,41 @@ public :
 
 	//@}
 
+	/** @name OpenSSL specific methods */
+	//@{
+
+	/**
+	 * \brief Start an HMAC with this key
+	 *
+	 * For each digest it is used with, the key keeps an HMAC context that
+	 * has already absorbed the key (the inner and outer pads).  Starting
+	 * a new HMAC is then a copy of that context rather than deriving the
+	 * pads again.  The keyed contexts are built on first use and shared
+	 * with all clones of the key.
+	 *
+	 * @param ctx The context to start
+	 * @param type The digest the HMAC is to use
+	 * @returns false if no keyed context is available, in which case
+	 * ctx is untouched and must be keyed by the caller
+	 * @throws XSECCryptoException if the keyed context cannot be copied
+	 */
+
+	bool initHMAC(HMAC_CTX * ctx, XSECCryptoHash::HashType type) const;
+
+	//@}
+
 private:
 
+	// Keyed contexts, shared between clones
+	struct KeyedState;
+
+	// Not implemented
+	OpenSSLCryptoKeyHMAC(const OpenSSLCryptoKeyHMAC &);
+	OpenSSLCryptoKeyHMAC & operator = (const OpenSSLCryptoKeyHMAC &);
+
 	safeBuffer			m_keyBuf;
 	unsigned int		m_keyLen;
+	KeyedState			* mp_state;
 };
 
 #endif /* XSEC_HAVE_OPENSSL */
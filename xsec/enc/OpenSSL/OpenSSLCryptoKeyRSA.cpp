@@ -36,6 +36,7 @@
 #include <xsec/enc/XSECCryptoException.hpp>
 #include <xsec/enc/XSECCryptoUtils.hpp>
 #include <xsec/framework/XSECError.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
 
 #include <openssl/err.h>
 #include <openssl/rand.h>
@@ -341,8 +342,7 @@ XSECCryptoKey::KeyType OpenSSLCryptoKeyRSA::getKeyType() const {
 
 void OpenSSLCryptoKeyRSA::loadPublicModulusBase64BigNums(const char * b64, unsigned int len) {
 
-	if (mp_rsaKey == NULL)
-		mp_rsaKey = RSA_new();
+	unshareKey();
 
 	mp_rsaKey->n = OpenSSLCryptoBase64::b642BN((char *) b64, len);
 
@@ -350,13 +350,56 @@ void OpenSSLCryptoKeyRSA::loadPublicModulusBase64BigNums(const char * b64, unsig
 
 void OpenSSLCryptoKeyRSA::loadPublicExponentBase64BigNums(const char * b64, unsigned int len) {
 
-	if (mp_rsaKey == NULL)
-		mp_rsaKey = RSA_new();
+	unshareKey();
 
 	mp_rsaKey->e = OpenSSLCryptoBase64::b642BN((char *) b64, len);
 
 }
 
+void OpenSSLCryptoKeyRSA::unshareKey(void) {
+
+	if (mp_rsaKey == NULL) {
+		mp_rsaKey = RSA_new();
+		return;
+	}
+
+	// Clones share the RSA structure, and may be in use on other threads.
+	// The count is read under the lock RSA_up_ref() and RSA_free() take; a
+	// count of 1 is ours alone, and only a holder can raise it.
+	if (CRYPTO_add(&mp_rsaKey->references, 0, CRYPTO_LOCK_RSA) <= 1)
+		return;
+
+	RSA * k = RSA_new();
+
+	if (mp_rsaKey->n)
+		k->n = BN_dup(mp_rsaKey->n);
+
+	if (mp_rsaKey->e)
+		k->e = BN_dup(mp_rsaKey->e);
+
+	if (mp_rsaKey->d)
+		k->d = BN_dup(mp_rsaKey->d);
+
+	if (mp_rsaKey->p)
+		k->p = BN_dup(mp_rsaKey->p);
+
+	if (mp_rsaKey->q)
+		k->q = BN_dup(mp_rsaKey->q);
+
+	if (mp_rsaKey->dmp1)
+		k->dmp1 = BN_dup(mp_rsaKey->dmp1);
+
+	if (mp_rsaKey->dmq1)
+		k->dmq1 = BN_dup(mp_rsaKey->dmq1);
+
+	if (mp_rsaKey->iqmp)
+		k->iqmp = BN_dup(mp_rsaKey->iqmp);
+
+	RSA_free(mp_rsaKey);
+	mp_rsaKey = k;
+
+}
+
 // "Hidden" OpenSSL functions
 
 OpenSSLCryptoKeyRSA::OpenSSLCryptoKeyRSA(EVP_PKEY *k) {
@@ -955,6 +998,34 @@ unsigned int OpenSSLCryptoKeyRSA::getLength(void) const {
 
 }
 
+// --------------------------------------------------------------------------------
+//           Key identity
+// --------------------------------------------------------------------------------
+
+unsigned int OpenSSLCryptoKeyRSA::getPublicKeyIdentity(safeBuffer & id) const {
+
+	// The PKCS#1 RSAPublicKey
+
+	if (mp_rsaKey == NULL || mp_rsaKey->n == NULL || mp_rsaKey->e == NULL)
+		return 0;
+
+	int len = i2d_RSAPublicKey(mp_rsaKey, NULL);
+	if (len <= 0)
+		return 0;
+
+	unsigned char * buf;
+	XSECnew(buf, unsigned char[len]);
+	ArrayJanitor<unsigned char> j_buf(buf);
+
+	unsigned char * p = buf;
+	i2d_RSAPublicKey(mp_rsaKey, &p);
+
+	id.sbMemcpyIn(buf, len);
+
+	return (unsigned int) len;
+
+}
+
 // --------------------------------------------------------------------------------
 //           Clone this key
 // --------------------------------------------------------------------------------
@@ -965,8 +1036,6 @@ XSECCryptoKey * OpenSSLCryptoKeyRSA::clone() const {
 
 	XSECnew(ret, OpenSSLCryptoKeyRSA);
 
-	ret->mp_rsaKey = RSA_new();
-
 	if (mp_oaepParams != NULL) {
 		XSECnew(ret->mp_oaepParams, unsigned char[m_oaepParamsLen]);
 		memcpy(ret->mp_oaepParams, mp_oaepParams, m_oaepParamsLen);
@@ -977,31 +1046,16 @@ XSECCryptoKey * OpenSSLCryptoKeyRSA::clone() const {
 		ret->m_oaepParamsLen = 0;
 	}
 
-	// Duplicate parameters
+	ret->m_mgf = m_mgf;
 
-	if (mp_rsaKey->n)
-		ret->mp_rsaKey->n = BN_dup(mp_rsaKey->n);
+	// Share the key itself.  Nothing here alters it once loaded (OpenSSL
+	// locks the Montgomery and blinding values it caches in it), so the
+	// copies can be used on different threads at the same time.
 
-	if (mp_rsaKey->e)
-		ret->mp_rsaKey->e = BN_dup(mp_rsaKey->e);
-
-	if (mp_rsaKey->d)
-		ret->mp_rsaKey->d = BN_dup(mp_rsaKey->d);
-
-	if (mp_rsaKey->p)
-		ret->mp_rsaKey->p = BN_dup(mp_rsaKey->p);
-
-	if (mp_rsaKey->q)
-		ret->mp_rsaKey->q = BN_dup(mp_rsaKey->q);
-
-	if (mp_rsaKey->dmp1)
-		ret->mp_rsaKey->dmp1 = BN_dup(mp_rsaKey->dmp1);
-
-	if (mp_rsaKey->dmq1)
-		ret->mp_rsaKey->dmq1 = BN_dup(mp_rsaKey->dmq1);
-
-	if (mp_rsaKey->iqmp)
-		ret->mp_rsaKey->iqmp = BN_dup(mp_rsaKey->iqmp);
+	if (mp_rsaKey != NULL) {
+		RSA_up_ref(mp_rsaKey);
+		ret->mp_rsaKey = mp_rsaKey;
+	}
 
 	return ret;
 
@@ -78,10 +78,25 @@ public :
 
 	/**
 	 * \brief Replicate key
+	 *
+	 * The copy shares the underlying OpenSSL RSA structure (which is
+	 * reference counted) with this key.
 	 */
 
 	virtual XSECCryptoKey * clone() const;
 
+	/**
+	 * \brief Identify the key by its DER encoded public key
+	 */
+
+	virtual unsigned int getPublicKeyIdentity(safeBuffer & id) const;
+
+	/**
+	 * \brief OpenSSL keys may be used from many threads at once
+	 */
+
+	virtual bool isShareable() const {return true;}
+
 	//@}
 
 	/** @name Mandatory RSA interface methods 
@@ -302,6 +317,9 @@ public :
 
 private:
 
+	// Before the key is altered, take a private copy of any shared material
+	void unshareKey(void);
+
 	RSA								* mp_rsaKey;
 	unsigned char					* mp_oaepParams;
 	unsigned int					m_oaepParamsLen;
@@ -36,6 +36,7 @@
 #include <xsec/enc/OpenSSL/OpenSSLCryptoProvider.hpp>
 #include <xsec/enc/OpenSSL/OpenSSLCryptoHash.hpp>
 #include <xsec/enc/OpenSSL/OpenSSLCryptoHashHMAC.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoContextPool.hpp>
 #include <xsec/enc/OpenSSL/OpenSSLCryptoBase64.hpp>
 #include <xsec/enc/OpenSSL/OpenSSLCryptoX509.hpp>
 #include <xsec/enc/OpenSSL/OpenSSLCryptoKeyDSA.hpp>
@@ -47,6 +48,7 @@
 #include <xsec/enc/XSCrypt/XSCryptCryptoBase64.hpp>
 
 #include <xsec/enc/XSECCryptoException.hpp>
+#include <xsec/utils/XSECDOMUtils.hpp>
 
 #include <xercesc/util/Janitor.hpp>
 
@@ -57,6 +59,13 @@ XSEC_USING_XERCES(Janitor);
 #include <openssl/err.h>
 #include <openssl/obj_mac.h>
 
+namespace {
+
+	// Indexed by XSECCryptoHash::HashType
+	const EVP_MD * s_digests[XSECCryptoHash::HASH_SHA512 + 1];
+
+}
+
 OpenSSLCryptoProvider::OpenSSLCryptoProvider() {
 
 	OpenSSL_add_all_algorithms();		// Initialise Openssl
@@ -139,11 +148,25 @@ OpenSSLCryptoProvider::OpenSSLCryptoProvider() {
     m_namedCurveMap["urn:oid:2.23.43.1.4.11"] = NID_wap_wsg_idm_ecid_wtls11;
     m_namedCurveMap["urn:oid:2.23.43.1.4.12"] = NID_wap_wsg_idm_ecid_wtls12;
 #endif
+
+	// Look up the digests once, rather than for every hash object
+	s_digests[XSECCryptoHash::HASH_NONE] = NULL;
+	s_digests[XSECCryptoHash::HASH_SHA1] = EVP_get_digestbyname("SHA1");
+	s_digests[XSECCryptoHash::HASH_MD5] = EVP_get_digestbyname("MD5");
+	s_digests[XSECCryptoHash::HASH_SHA224] = EVP_get_digestbyname("SHA224");
+	s_digests[XSECCryptoHash::HASH_SHA256] = EVP_get_digestbyname("SHA256");
+	s_digests[XSECCryptoHash::HASH_SHA384] = EVP_get_digestbyname("SHA384");
+	s_digests[XSECCryptoHash::HASH_SHA512] = EVP_get_digestbyname("SHA512");
+
+	OpenSSLCryptoContextPool::Initialise();
+
 }
 
 
 OpenSSLCryptoProvider::~OpenSSLCryptoProvider() {
 
+	OpenSSLCryptoContextPool::Terminate();
+
 	EVP_cleanup();
 	ERR_free_strings();
 	/* As suggested by Jesse Pelton */
@@ -155,6 +178,15 @@ OpenSSLCryptoProvider::~OpenSSLCryptoProvider() {
 	ERR_remove_state(0);
 }
 
+const EVP_MD * OpenSSLCryptoProvider::getDigest(XSECCryptoHash::HashType type) {
+
+	if (type < XSECCryptoHash::HASH_NONE || type > XSECCryptoHash::HASH_SHA512)
+		return NULL;
+
+	return s_digests[type];
+
+}
+
 #ifdef XSEC_OPENSSL_HAVE_EC
 int OpenSSLCryptoProvider::curveNameToNID(const char* curveName) const {
 
@@ -272,6 +304,49 @@ XSECCryptoKeyHMAC * OpenSSLCryptoProvider::keyHMAC(void) const {
 
 }
 
+unsigned int OpenSSLCryptoProvider::hashBatch(XSECCryptoHash::HashType type,
+											  unsigned int count,
+											  const unsigned char * const * inputs,
+											  const unsigned int * inputLens,
+											  unsigned char * outputs,
+											  unsigned int outputStride) const {
+
+	const EVP_MD * md = getDigest(type);
+
+	if (md == NULL) {
+
+		throw XSECCryptoException(XSECCryptoException::MDError,
+			"OpenSSL:hashBatch - Digest not supported by this version of OpenSSL");
+
+	}
+
+	if ((unsigned int) EVP_MD_size(md) > outputStride) {
+
+		throw XSECCryptoException(XSECCryptoException::MDError,
+			"OpenSSL:hashBatch - Output stride too small for digest");
+
+	}
+
+	EVP_MD_CTX * ctx = OpenSSLCryptoContextPool::acquireDigest(md);
+
+	unsigned int len = 0;
+
+	for (unsigned int i = 0; i < count; ++i) {
+
+		if (i > 0)
+			EVP_DigestInit_ex(ctx, md, NULL);
+
+		EVP_DigestUpdate(ctx, inputs[i], inputLens[i]);
+		EVP_DigestFinal_ex(ctx, outputs + (i * outputStride), &len);
+
+	}
+
+	OpenSSLCryptoContextPool::releaseDigest(ctx);
+
+	return len;
+
+}
+
 XSECCryptoKeyDSA * OpenSSLCryptoProvider::keyDSA() const {
 	
 	OpenSSLCryptoKeyDSA * ret;
@@ -466,6 +541,32 @@ XSECCryptoSymmetricKey	* OpenSSLCryptoProvider::keySymmetric(XSECCryptoSymmetric
 
 }
 
+unsigned int OpenSSLCryptoProvider::wrapKeyAES(XSECCryptoSymmetricKey * kek,
+											   const unsigned char * inBuf,
+											   unsigned int inLength,
+											   unsigned char * outBuf,
+											   unsigned int maxOutLength) const {
+
+	if (strEquals(kek->getProviderName(), DSIGConstants::s_unicodeStrPROVOpenSSL))
+		return ((OpenSSLCryptoSymmetricKey *) kek)->wrapKeyAES(inBuf, inLength, outBuf, maxOutLength);
+
+	return XSECCryptoProvider::wrapKeyAES(kek, inBuf, inLength, outBuf, maxOutLength);
+
+}
+
+unsigned int OpenSSLCryptoProvider::unwrapKeyAES(XSECCryptoSymmetricKey * kek,
+												 const unsigned char * inBuf,
+												 unsigned int inLength,
+												 unsigned char * outBuf,
+												 unsigned int maxOutLength) const {
+
+	if (strEquals(kek->getProviderName(), DSIGConstants::s_unicodeStrPROVOpenSSL))
+		return ((OpenSSLCryptoSymmetricKey *) kek)->unwrapKeyAES(inBuf, inLength, outBuf, maxOutLength);
+
+	return XSECCryptoProvider::unwrapKeyAES(kek, inBuf, inLength, outBuf, maxOutLength);
+
+}
+
 unsigned int OpenSSLCryptoProvider::getRandom(unsigned char * buffer, unsigned int numOctets) const {
 
 	if (RAND_status() != 1) {
@@ -33,12 +33,15 @@
 
 #include <xsec/framework/XSECDefs.hpp>
 #include <xsec/enc/XSECCryptoProvider.hpp>
+#include <xsec/enc/XSECCryptoHash.hpp>
 
 #include <map>
 #include <string>
 
 #if defined (XSEC_HAVE_OPENSSL)
 
+#include <openssl/evp.h>
+
 /**
  * @defgroup opensslcrypto OpenSSL Interface
  * @ingroup crypto
@@ -166,6 +169,22 @@ public :
 
 	virtual XSECCryptoKeyHMAC		* keyHMAC(void) const;
 
+	/**
+	 * \brief Digest a number of small, independent inputs
+	 *
+	 * All of the inputs are run through one pooled EVP_MD_CTX, which is
+	 * re-initialised (without being freed) between them.
+	 *
+	 * @see XSECCryptoProvider::hashBatch
+	 */
+
+	virtual unsigned int hashBatch(XSECCryptoHash::HashType type,
+		unsigned int count,
+		const unsigned char * const * inputs,
+		const unsigned int * inputLens,
+		unsigned char * outputs,
+		unsigned int outputStride) const;
+
 	//@}
 
 	/** @name Encoding functions */
@@ -277,6 +296,34 @@ public :
 
 	virtual XSECCryptoSymmetricKey	* keySymmetric(XSECCryptoSymmetricKey::SymmetricKeyType alg) const;
 
+	/**
+	 * \brief Wrap a key with AES (RFC 3394)
+	 *
+	 * An OpenSSL key wraps on a single context, set up once from its
+	 * cached key schedule.  Keys from other providers take the default
+	 * path.
+	 *
+	 * @see XSECCryptoProvider::wrapKeyAES
+	 */
+
+	virtual unsigned int wrapKeyAES(XSECCryptoSymmetricKey * kek,
+		const unsigned char * inBuf,
+		unsigned int inLength,
+		unsigned char * outBuf,
+		unsigned int maxOutLength) const;
+
+	/**
+	 * \brief Unwrap a key with AES (RFC 3394)
+	 *
+	 * @see XSECCryptoProvider::unwrapKeyAES
+	 */
+
+	virtual unsigned int unwrapKeyAES(XSECCryptoSymmetricKey * kek,
+		const unsigned char * inBuf,
+		unsigned int inLength,
+		unsigned char * outBuf,
+		unsigned int maxOutLength) const;
+
 	/**
 	 * \brief Obtain some random octets
 	 *
@@ -303,6 +350,18 @@ public :
     int curveNameToNID(const char* curveName) const;
 #endif
 
+	/**
+	 * \brief Map a hash type to an OpenSSL digest
+	 *
+	 * The digests are looked up once, when the provider is built, rather
+	 * than by name each time a hash object is created.
+	 *
+	 * @param type The hash algorithm
+	 * @returns The digest, or NULL if this version of OpenSSL lacks it
+	 */
+
+	static const EVP_MD * getDigest(XSECCryptoHash::HashType type);
+
 	//@}
 
 	/** @name Information Functions */
@@ -0,0 +1,105 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * OpenSSLCryptoSharedKeyState := Reference counted state shared between
+ *                                an OpenSSL key and its clones
+ *
+ * $Id$
+ *
+ */
+
+#ifndef OPENSSLCRYPTOSHAREDKEYSTATE_INCLUDE
+#define OPENSSLCRYPTOSHAREDKEYSTATE_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+
+#if defined (XSEC_HAVE_OPENSSL)
+
+#include <xercesc/util/Mutexes.hpp>
+#include <xercesc/util/PlatformUtils.hpp>
+
+/**
+ * \brief Base for state that an OpenSSL key shares with its clones
+ * @ingroup internal
+ *
+ * Keys cache contexts that have already been keyed (so the expensive
+ * key set up is done once) and hand them to every clone.  Each key
+ * holds one reference to the state; the last key to let go deletes it.
+ * The mutex guards whatever the derived state lazily creates - the
+ * derived class decides what may then be read without it.
+ *
+ * The state is created with a single reference, belonging to the key
+ * that made it.
+ */
+
+class OpenSSLCryptoSharedKeyState {
+
+public:
+
+	OpenSSLCryptoSharedKeyState() : m_refs(1) {}
+
+	/**
+	 * \brief Take a reference to the state
+	 *
+	 * @param state The state to share (may be NULL)
+	 * @returns state
+	 */
+
+	template <class STATE>
+	static STATE * share(STATE * state) {
+
+		if (state != NULL)
+			XERCES_CPP_NAMESPACE_QUALIFIER XMLPlatformUtils::atomicIncrement(state->m_refs);
+		return state;
+
+	}
+
+	/**
+	 * \brief Drop a reference to the state, deleting it if it was the last
+	 *
+	 * @param state The state to release.  Set to NULL on return.
+	 */
+
+	template <class STATE>
+	static void release(STATE *& state) {
+
+		if (state != NULL &&
+			XERCES_CPP_NAMESPACE_QUALIFIER XMLPlatformUtils::atomicDecrement(state->m_refs) == 0)
+			delete state;
+		state = NULL;
+
+	}
+
+	XERCES_CPP_NAMESPACE_QUALIFIER XMLMutex		m_mutex;
+
+private:
+
+	int											m_refs;
+
+	// Not implemented
+	OpenSSLCryptoSharedKeyState(const OpenSSLCryptoSharedKeyState &);
+	OpenSSLCryptoSharedKeyState & operator = (const OpenSSLCryptoSharedKeyState &);
+
+};
+
+#endif /* XSEC_HAVE_OPENSSL */
+#endif /* OPENSSLCRYPTOSHAREDKEYSTATE_INCLUDE */
@@ -32,6 +32,7 @@
 #include <xsec/framework/XSECDefs.hpp>
 #include <iostream>
 #include <xsec/enc/OpenSSL/OpenSSLCryptoSymmetricKey.hpp>
+#include <xsec/enc/OpenSSL/OpenSSLCryptoSharedKeyState.hpp>
 #include <xsec/framework/XSECError.hpp>
 #include <xsec/enc/XSECCryptoException.hpp>
 
@@ -44,6 +45,32 @@ XERCES_CPP_NAMESPACE_USE;
 
 #include <openssl/rand.h>
 
+// --------------------------------------------------------------------------------
+//           Key schedules
+// --------------------------------------------------------------------------------
+
+struct OpenSSLCryptoSymmetricKey::KeySchedules : public OpenSSLCryptoSharedKeyState {
+
+	KeySchedules() {
+		memset(mp_ctx, 0, sizeof(mp_ctx));
+	}
+
+	~KeySchedules() {
+		// Cleanup overwrites the expanded keys
+		for (int i = 0; i <= MODE_GCM; ++i) {
+			for (int j = 0; j < 2; ++j) {
+				if (mp_ctx[i][j] != NULL) {
+					EVP_CIPHER_CTX_cleanup(mp_ctx[i][j]);
+					delete mp_ctx[i][j];
+				}
+			}
+		}
+	}
+
+	EVP_CIPHER_CTX		* mp_ctx[MODE_GCM + 1][2];		// By mode, then decrypt/encrypt
+
+};
+
 // --------------------------------------------------------------------------------
 //           Constructors and Destructors
 // --------------------------------------------------------------------------------
@@ -53,12 +80,16 @@ m_keyType(type),
 m_keyMode(MODE_NONE),
 m_keyBuf(""),
 m_tagBuf(""),
+m_tagLen(0),
 m_keyLen(0),
-m_initialised(false) {
+m_initialised(false),
+mp_schedules(NULL) {
 
 	EVP_CIPHER_CTX_init(&m_ctx);
 	m_keyBuf.isSensitive();
 
+	XSECnew(mp_schedules, KeySchedules);
+
 }
 
 OpenSSLCryptoSymmetricKey::~OpenSSLCryptoSymmetricKey() {
@@ -66,6 +97,69 @@ OpenSSLCryptoSymmetricKey::~OpenSSLCryptoSymmetricKey() {
 	// Clean up the context
 
 	EVP_CIPHER_CTX_cleanup(&m_ctx);
+	OpenSSLCryptoSharedKeyState::release(mp_schedules);
+}
+
+void OpenSSLCryptoSymmetricKey::cipherInit(const EVP_CIPHER * cipher,
+										   const unsigned char * iv,
+										   bool encrypt) {
+
+	// Set m_ctx up for an operation.  The key schedule for each mode and
+	// direction is expanded once, into a context that is shared with all
+	// clones of the key, so an operation only copies it and sets the IV.
+
+	int enc = (encrypt ? 1 : 0);
+
+#if defined (XSEC_OPENSSL_HAVE_CIPHER_CTX_COPY)
+
+	EVP_CIPHER_CTX * keyed;
+
+	{
+		XMLMutexLock lock(&mp_schedules->m_mutex);
+
+		keyed = mp_schedules->mp_ctx[m_keyMode][enc];
+
+		if (keyed == NULL) {
+
+			XSECnew(keyed, EVP_CIPHER_CTX);
+			EVP_CIPHER_CTX_init(keyed);
+			EVP_CipherInit_ex(keyed, cipher, NULL, NULL, NULL, enc);
+#if defined (XSEC_OPENSSL_HAVE_GCM)
+			if (m_keyMode == MODE_GCM)
+				EVP_CIPHER_CTX_ctrl(keyed, EVP_CTRL_GCM_SET_IVLEN, 12, NULL);
+#endif
+			EVP_CipherInit_ex(keyed, NULL, NULL, m_keyBuf.rawBuffer(), NULL, enc);
+			mp_schedules->mp_ctx[m_keyMode][enc] = keyed;
+
+		}
+	}
+
+	// The schedule is only written by the EVP_CipherInit_ex calls above,
+	// before it is published under the lock.  The IV and any GCM tag are
+	// set on the copy in m_ctx, so the copy only ever reads it.
+	if (EVP_CIPHER_CTX_copy(&m_ctx, keyed) == 0) {
+		throw XSECCryptoException(XSECCryptoException::SymmetricError,
+			"OpenSSL:SymmetricKey - Error copying key schedule"); 
+	}
+
+#else
+
+	EVP_CipherInit_ex(&m_ctx, cipher, NULL, NULL, NULL, enc);
+#if defined (XSEC_OPENSSL_HAVE_GCM)
+	if (m_keyMode == MODE_GCM)
+		EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_IVLEN, 12, NULL);
+#endif
+	EVP_CipherInit_ex(&m_ctx, NULL, NULL, m_keyBuf.rawBuffer(), NULL, enc);
+
+#endif
+
+#if defined (XSEC_OPENSSL_HAVE_GCM)
+	if (m_keyMode == MODE_GCM && !encrypt && m_tagLen > 0)
+		EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_TAG, 16, (void*)m_tagBuf.rawBuffer());
+#endif
+
+	EVP_CipherInit_ex(&m_ctx, NULL, NULL, NULL, iv, enc);
+
 }
 
 // --------------------------------------------------------------------------------
@@ -93,6 +187,10 @@ XSECCryptoKey * OpenSSLCryptoSymmetricKey::clone() const {
 	ret->m_keyLen = m_keyLen;
 	ret->m_keyBuf = m_keyBuf;
 
+	// Share the key schedules
+	OpenSSLCryptoSharedKeyState::release(ret->mp_schedules);
+	ret->mp_schedules = OpenSSLCryptoSharedKeyState::share(mp_schedules);
+
 	return ret;
 
 }
@@ -106,6 +204,10 @@ void OpenSSLCryptoSymmetricKey::setKey(const unsigned char * key, unsigned int k
 	m_keyBuf.sbMemcpyIn(key, keyLen);
 	m_keyLen = keyLen;
 
+	// Any schedules so far (and shared with clones) are for the old key
+	OpenSSLCryptoSharedKeyState::release(mp_schedules);
+	XSECnew(mp_schedules, KeySchedules);
+
 }
 
 // --------------------------------------------------------------------------------
@@ -145,22 +247,11 @@ int OpenSSLCryptoSymmetricKey::decryptCtxInit(const unsigned char* iv, const uns
 				return 0;	// Cannot initialise without an IV
 			}
 
-			/* Do not use "_ex" calls yet - as want backwards compatibility
-			   with 0.9.6 */
-
-#if defined(XSEC_OPENSSL_CONST_BUFFERS)
-			EVP_DecryptInit(&m_ctx, EVP_des_ede3_cbc(),m_keyBuf.rawBuffer(), iv);
-#else
-			EVP_DecryptInit(&m_ctx, EVP_des_ede3_cbc(),(unsigned char *) m_keyBuf.rawBuffer(), (unsigned char *) iv);
-#endif
+			cipherInit(EVP_des_ede3_cbc(), iv, false);
 			m_ivSize = 8;
 		}
 		else if (m_keyMode == MODE_ECB) {
-#if defined(XSEC_OPENSSL_CONST_BUFFERS)
-			EVP_DecryptInit(&m_ctx, EVP_des_ecb(), m_keyBuf.rawBuffer(), NULL);
-#else
-			EVP_DecryptInit(&m_ctx, EVP_des_ecb(), (unsigned char *) m_keyBuf.rawBuffer(), NULL);
-#endif
+			cipherInit(EVP_des_ecb(), NULL, false);
 			m_ivSize = 0;
 		}
         else {
@@ -184,7 +275,7 @@ int OpenSSLCryptoSymmetricKey::decryptCtxInit(const unsigned char* iv, const uns
 				return 0;	// Cannot initialise without an IV
 			}
 
-			EVP_DecryptInit_ex(&m_ctx, EVP_aes_128_cbc(), NULL, m_keyBuf.rawBuffer(), iv);
+			cipherInit(EVP_aes_128_cbc(), iv, false);
 
 		}
 #if defined (XSEC_OPENSSL_HAVE_GCM)
@@ -197,25 +288,21 @@ int OpenSSLCryptoSymmetricKey::decryptCtxInit(const unsigned char* iv, const uns
 
             if (iv == NULL) {
                 // Just save off tag for later.
-                m_tagBuf.sbMemcpyIn(tag, taglen);
+                if (tag != NULL) {
+                    m_tagBuf.sbMemcpyIn(tag, taglen);
+                    m_tagLen = taglen;
+                }
                 return 0;
             }
 
-            if (m_tagBuf.sbRawBufferSize() == 0) {
-		        throw XSECCryptoException(XSECCryptoException::SymmetricError,
-			        "OpenSSL:SymmetricKey - Authentication tag not set"); 
-            }
-
-            // We have everything, so we can fully init.
-            EVP_CipherInit(&m_ctx, EVP_aes_128_gcm(), NULL, NULL, 0);
-            EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_IVLEN, 12, NULL);
-            EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_TAG, 16, (void*)m_tagBuf.rawBuffer());
-            EVP_CipherInit(&m_ctx, NULL, m_keyBuf.rawBuffer(), iv, 0);
+            // We have everything (bar a tag still to come via setTag()),
+            // so we can fully init.  Without a tag, decryptFinish() fails.
+            cipherInit(EVP_aes_128_gcm(), iv, false);
 		}
 #endif
 		else if (m_keyMode == MODE_ECB) {
 
-			EVP_DecryptInit_ex(&m_ctx, EVP_aes_128_ecb(), NULL, m_keyBuf.rawBuffer(), NULL);
+			cipherInit(EVP_aes_128_ecb(), NULL, false);
 
 		}
         else {
@@ -236,7 +323,7 @@ int OpenSSLCryptoSymmetricKey::decryptCtxInit(const unsigned char* iv, const uns
 				return 0;	// Cannot initialise without an IV
 			}
 
-			EVP_DecryptInit_ex(&m_ctx, EVP_aes_192_cbc(), NULL, m_keyBuf.rawBuffer(), iv);
+			cipherInit(EVP_aes_192_cbc(), iv, false);
 
 		}
 #if defined (XSEC_OPENSSL_HAVE_GCM)
@@ -249,26 +336,22 @@ int OpenSSLCryptoSymmetricKey::decryptCtxInit(const unsigned char* iv, const uns
 
             if (iv == NULL) {
                 // Just save off tag for later.
-                m_tagBuf.sbMemcpyIn(tag, taglen);
+                if (tag != NULL) {
+                    m_tagBuf.sbMemcpyIn(tag, taglen);
+                    m_tagLen = taglen;
+                }
                 return 0;
             }
 
-            if (m_tagBuf.sbRawBufferSize() == 0) {
-		        throw XSECCryptoException(XSECCryptoException::SymmetricError,
-			        "OpenSSL:SymmetricKey - Authentication tag not set"); 
-            }
-
-            // We have everything, so we can fully init.
-            EVP_CipherInit(&m_ctx, EVP_aes_192_gcm(), NULL, NULL, 0);
-            EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_IVLEN, 12, NULL);
-            EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_TAG, 16, (void*)m_tagBuf.rawBuffer());
-            EVP_CipherInit(&m_ctx, NULL, m_keyBuf.rawBuffer(), iv, 0);
+            // We have everything (bar a tag still to come via setTag()),
+            // so we can fully init.  Without a tag, decryptFinish() fails.
+            cipherInit(EVP_aes_192_gcm(), iv, false);
 
 		}
 #endif
 		else if (m_keyMode == MODE_ECB) {
 
-			EVP_DecryptInit_ex(&m_ctx, EVP_aes_192_ecb(), NULL, m_keyBuf.rawBuffer(), NULL);
+			cipherInit(EVP_aes_192_ecb(), NULL, false);
 
 		}
         else {
@@ -289,7 +372,7 @@ int OpenSSLCryptoSymmetricKey::decryptCtxInit(const unsigned char* iv, const uns
 				return 0;	// Cannot initialise without an IV
 			}
 
-			EVP_DecryptInit_ex(&m_ctx, EVP_aes_256_cbc(), NULL, m_keyBuf.rawBuffer(), iv);
+			cipherInit(EVP_aes_256_cbc(), iv, false);
 
 		}
 #if defined (XSEC_OPENSSL_HAVE_GCM)
@@ -302,26 +385,22 @@ int OpenSSLCryptoSymmetricKey::decryptCtxInit(const unsigned char* iv, const uns
 
             if (iv == NULL) {
                 // Just save off tag for later.
-                m_tagBuf.sbMemcpyIn(tag, taglen);
+                if (tag != NULL) {
+                    m_tagBuf.sbMemcpyIn(tag, taglen);
+                    m_tagLen = taglen;
+                }
                 return 0;
             }
 
-            if (m_tagBuf.sbRawBufferSize() == 0) {
-		        throw XSECCryptoException(XSECCryptoException::SymmetricError,
-			        "OpenSSL:SymmetricKey - Authentication tag not set"); 
-            }
-
-            // We have everything, so we can fully init.
-            EVP_CipherInit(&m_ctx, EVP_aes_256_gcm(), NULL, NULL, 0);
-            EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_IVLEN, 12, NULL);
-            EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_TAG, 16, (void*)m_tagBuf.rawBuffer());
-            EVP_CipherInit(&m_ctx, NULL, m_keyBuf.rawBuffer(), iv, 0);
+            // We have everything (bar a tag still to come via setTag()),
+            // so we can fully init.  Without a tag, decryptFinish() fails.
+            cipherInit(EVP_aes_256_gcm(), iv, false);
 
 		}
 #endif
 		else if (m_keyMode == MODE_ECB) {
 
-			EVP_DecryptInit_ex(&m_ctx, EVP_aes_256_ecb(), NULL, m_keyBuf.rawBuffer(), NULL);
+			cipherInit(EVP_aes_256_ecb(), NULL, false);
 
 		}
         else {
@@ -388,6 +467,7 @@ bool OpenSSLCryptoSymmetricKey::decryptInit(bool doPad,
 	m_doPad = doPad;
 	m_keyMode = mode;
 	m_initialised = false;
+	m_tagLen = 0;
 	decryptCtxInit(iv, tag, taglen);
 	return true;
 
@@ -581,6 +661,43 @@ unsigned int OpenSSLCryptoSymmetricKey::decryptFinish(unsigned char * plainBuf,
 
 }
 
+bool OpenSSLCryptoSymmetricKey::canDeferTag(void) const {
+
+#if defined (XSEC_OPENSSL_HAVE_GCM)
+	return true;
+#else
+	return false;
+#endif
+
+}
+
+bool OpenSSLCryptoSymmetricKey::setTag(const unsigned char * tag, unsigned int taglen) {
+
+#if defined (XSEC_OPENSSL_HAVE_GCM)
+
+	if (m_keyMode != MODE_GCM || tag == NULL || taglen != 16) {
+		throw XSECCryptoException(XSECCryptoException::SymmetricError,
+			"OpenSSL:SymmetricKey - Invalid authentication tag"); 
+	}
+
+	m_tagBuf.sbMemcpyIn(tag, taglen);
+	m_tagLen = taglen;
+
+	// Once the IV has been seen the context is set up, so it goes straight in
+	if (m_initialised)
+		EVP_CIPHER_CTX_ctrl(&m_ctx, EVP_CTRL_GCM_SET_TAG, taglen, (void*)m_tagBuf.rawBuffer());
+
+	return true;
+
+#else
+
+	throw XSECCryptoException(XSECCryptoException::UnsupportedAlgorithm,
+		"OpenSSL:SymmetricKey - AES-GCM not supported in this version of OpenSSL"); 
+
+#endif
+
+}
+
 // --------------------------------------------------------------------------------
 //           Encrypt
 // --------------------------------------------------------------------------------
@@ -640,18 +757,10 @@ bool OpenSSLCryptoSymmetricKey::encryptInit(bool doPad,
 				usedIV = iv;
             }
 
-#if defined (XSEC_OPENSSL_CONST_BUFFERS)
-			EVP_EncryptInit(&m_ctx, EVP_des_ede3_cbc(), m_keyBuf.rawBuffer(), usedIV);
-#else
-			EVP_EncryptInit(&m_ctx, EVP_des_ede3_cbc(), (unsigned char *) m_keyBuf.rawBuffer(), (unsigned char *) usedIV);
-#endif
+			cipherInit(EVP_des_ede3_cbc(), usedIV, true);
 		}
 		else if (m_keyMode == MODE_ECB) {
-#if defined (XSEC_OPENSSL_CONST_BUFFERS)
-			EVP_EncryptInit(&m_ctx, EVP_des_ede3_ecb(), m_keyBuf.rawBuffer(), NULL);
-#else
-			EVP_EncryptInit(&m_ctx, EVP_des_ede3(), (unsigned char *) m_keyBuf.rawBuffer(), NULL);
-#endif
+			cipherInit(EVP_des_ede3_ecb(), NULL, true);
 		}
         else {
 		    throw XSECCryptoException(XSECCryptoException::SymmetricError,
@@ -684,11 +793,11 @@ bool OpenSSLCryptoSymmetricKey::encryptInit(bool doPad,
 			else
 				usedIV = iv;
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_128_cbc(), NULL, m_keyBuf.rawBuffer(), usedIV);
+			cipherInit(EVP_aes_128_cbc(), usedIV, true);
 		}
 		else if (m_keyMode == MODE_ECB) {
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_128_ecb(), NULL, m_keyBuf.rawBuffer(), NULL);
+			cipherInit(EVP_aes_128_ecb(), NULL, true);
 
 		}
 #ifdef XSEC_OPENSSL_HAVE_GCM
@@ -708,7 +817,7 @@ bool OpenSSLCryptoSymmetricKey::encryptInit(bool doPad,
 			else
 				usedIV = iv;
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_128_gcm(), NULL, m_keyBuf.rawBuffer(), usedIV);
+			cipherInit(EVP_aes_128_gcm(), usedIV, true);
 		}
 #endif
         else {
@@ -739,7 +848,7 @@ bool OpenSSLCryptoSymmetricKey::encryptInit(bool doPad,
 			else
 				usedIV = iv;
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_192_cbc(), NULL, m_keyBuf.rawBuffer(), usedIV);
+			cipherInit(EVP_aes_192_cbc(), usedIV, true);
 
 		}
 #ifdef XSEC_OPENSSL_HAVE_GCM
@@ -759,12 +868,12 @@ bool OpenSSLCryptoSymmetricKey::encryptInit(bool doPad,
 			else
 				usedIV = iv;
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_192_gcm(), NULL, m_keyBuf.rawBuffer(), usedIV);
+			cipherInit(EVP_aes_192_gcm(), usedIV, true);
 		}
 #endif
 		else if (m_keyMode == MODE_ECB) {
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_192_ecb(), NULL, m_keyBuf.rawBuffer(), NULL);
+			cipherInit(EVP_aes_192_ecb(), NULL, true);
 		}
         else {
 		    throw XSECCryptoException(XSECCryptoException::SymmetricError,
@@ -793,7 +902,7 @@ bool OpenSSLCryptoSymmetricKey::encryptInit(bool doPad,
 			else
 				usedIV = iv;
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_256_cbc(), NULL, m_keyBuf.rawBuffer(), usedIV);
+			cipherInit(EVP_aes_256_cbc(), usedIV, true);
 
 		}
 #ifdef XSEC_OPENSSL_HAVE_GCM
@@ -813,12 +922,12 @@ bool OpenSSLCryptoSymmetricKey::encryptInit(bool doPad,
 			else
 				usedIV = iv;
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_256_gcm(), NULL, m_keyBuf.rawBuffer(), usedIV);
+			cipherInit(EVP_aes_256_gcm(), usedIV, true);
 		}
 #endif
 		else if (m_keyMode == MODE_ECB) {
 
-			EVP_EncryptInit_ex(&m_ctx, EVP_aes_256_ecb(), NULL, m_keyBuf.rawBuffer(), NULL);
+			cipherInit(EVP_aes_256_ecb(), NULL, true);
 
 		}
         else {
@@ -979,4 +1088,137 @@ unsigned int OpenSSLCryptoSymmetricKey::encryptFinish(unsigned char * cipherBuf,
 
 }
 
+// --------------------------------------------------------------------------------
+//           AES key wrap
+// --------------------------------------------------------------------------------
+
+static const unsigned char s_AESWrapIV[] = {
+	0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6
+};
+
+unsigned int OpenSSLCryptoSymmetricKey::wrapKeyAES(const unsigned char * inBuf,
+												   unsigned int inLength,
+												   unsigned char * outBuf,
+												   unsigned int maxOutLength) {
+
+	if (m_keyType == KEY_3DES_192 || m_keyType == KEY_NONE) {
+		throw XSECCryptoException(XSECCryptoException::SymmetricError,
+			"OpenSSL:SymmetricKey - AES key wrap requires an AES key"); 
+	}
+
+	if (inLength < 16 || inLength % 8 != 0 || maxOutLength < inLength + 8) {
+		throw XSECCryptoException(XSECCryptoException::SymmetricError,
+			"OpenSSL:SymmetricKey - Bad lengths for AES key wrap"); 
+	}
+
+	// ECB holds no state between blocks, so one context (copied from the
+	// cached key schedule) does every block
+
+	m_initialised = false;
+	encryptInit(false, MODE_ECB);
+
+	unsigned char aesBuf[16];
+	unsigned char aesOutBuf[16];
+	int outl;
+
+	memmove(&outBuf[8], inBuf, inLength);
+	memcpy(outBuf, s_AESWrapIV, 8);
+
+	unsigned int n = inLength / 8;
+
+	for (unsigned int j = 0; j <= 5; ++j) {
+		for (unsigned int i = 1; i <= n; ++i) {
+
+			// A | Ri
+			memcpy(aesBuf, outBuf, 8);
+			memcpy(&aesBuf[8], &outBuf[8 * i], 8);
+
+			if (EVP_EncryptUpdate(&m_ctx, aesOutBuf, &outl, aesBuf, 16) == 0 || outl != 16) {
+				m_initialised = false;
+				throw XSECCryptoException(XSECCryptoException::SymmetricError,
+					"OpenSSL:SymmetricKey - Error performing encrypt in AES wrap"); 
+			}
+
+			// A = MSB(B) ^ t, Ri = LSB(B)
+			unsigned int t = (n * j) + i;
+			memcpy(outBuf, aesOutBuf, 8);
+			outBuf[4] ^= (unsigned char) (t >> 24);
+			outBuf[5] ^= (unsigned char) (t >> 16);
+			outBuf[6] ^= (unsigned char) (t >> 8);
+			outBuf[7] ^= (unsigned char) t;
+			memcpy(&outBuf[8 * i], &aesOutBuf[8], 8);
+
+		}
+	}
+
+	m_initialised = false;
+
+	return inLength + 8;
+
+}
+
+unsigned int OpenSSLCryptoSymmetricKey::unwrapKeyAES(const unsigned char * inBuf,
+													 unsigned int inLength,
+													 unsigned char * outBuf,
+													 unsigned int maxOutLength) {
+
+	if (m_keyType == KEY_3DES_192 || m_keyType == KEY_NONE) {
+		throw XSECCryptoException(XSECCryptoException::SymmetricError,
+			"OpenSSL:SymmetricKey - AES key unwrap requires an AES key"); 
+	}
+
+	if (inLength < 24 || inLength % 8 != 0 || maxOutLength < inLength - 8) {
+		throw XSECCryptoException(XSECCryptoException::SymmetricError,
+			"OpenSSL:SymmetricKey - Bad lengths for AES key unwrap"); 
+	}
+
+	decryptInit(false, MODE_ECB);
+
+	unsigned char a[8];
+	unsigned char aesBuf[16];
+	unsigned char aesOutBuf[16];
+	int outl;
+
+	unsigned int n = (inLength / 8) - 1;
+
+	memcpy(a, inBuf, 8);
+	memmove(outBuf, &inBuf[8], n * 8);
+
+	for (int j = 5; j >= 0; --j) {
+		for (unsigned int i = n; i > 0; --i) {
+
+			// (A ^ t) | Ri
+			unsigned int t = (n * j) + i;
+			memcpy(aesBuf, a, 8);
+			aesBuf[4] ^= (unsigned char) (t >> 24);
+			aesBuf[5] ^= (unsigned char) (t >> 16);
+			aesBuf[6] ^= (unsigned char) (t >> 8);
+			aesBuf[7] ^= (unsigned char) t;
+			memcpy(&aesBuf[8], &outBuf[8 * (i - 1)], 8);
+
+			// Padding is off, so OpenSSL holds nothing back
+			if (EVP_DecryptUpdate(&m_ctx, aesOutBuf, &outl, aesBuf, 16) == 0 || outl != 16) {
+				m_initialised = false;
+				throw XSECCryptoException(XSECCryptoException::SymmetricError,
+					"OpenSSL:SymmetricKey - Error performing decrypt in AES unwrap"); 
+			}
+
+			// A = MSB(B), Ri = LSB(B)
+			memcpy(a, aesOutBuf, 8);
+			memcpy(&outBuf[8 * (i - 1)], &aesOutBuf[8], 8);
+
+		}
+	}
+
+	m_initialised = false;
+
+	if (memcmp(a, s_AESWrapIV, 8) != 0) {
+		memset(outBuf, 0, n * 8);
+		return 0;
+	}
+
+	return n * 8;
+
+}
+
 #endif /* XSEC_HAVE_OPENSSL */
@@ -97,6 +97,10 @@ public :
 	 * All keys need to be able to copy themselves and return
 	 * a pointer to the copy.  This allows the library to 
 	 * duplicate keys.
+	 *
+	 * The key schedule for each mode is expanded on first use and
+	 * shared with all clones, so an operation on a clone only has
+	 * to set its IV.
 	 */
 
 	virtual XSECCryptoKey * clone() const;
@@ -204,6 +208,24 @@ public :
 	virtual unsigned int decryptFinish(unsigned char * plainBuf,
 									   unsigned int maxOutLength);
 
+	/**
+	 * \brief Can the authentication tag be given once decryption is under way
+	 *
+	 * True if this version of OpenSSL supports GCM
+	 */
+
+	virtual bool canDeferTag(void) const;
+
+	/**
+	 * \brief Supply the GCM tag for the current decryption
+	 *
+	 * @param tag The authentication tag
+	 * @param taglen Length of the tag (must be 16)
+	 * @returns true
+	 */
+
+	virtual bool setTag(const unsigned char * tag, unsigned int taglen);
+
 	/**
 	 * \brief Initialise an encryption process
 	 *
@@ -291,6 +313,32 @@ public :
 
 	const EVP_CIPHER_CTX * getOpenSSLEVP_CIPHER_CTX(void) const {return &m_ctx;}
 
+	/**
+	 * \brief Wrap a key with this AES key (RFC 3394)
+	 *
+	 * Every block of the wrap is run through one context, copied from
+	 * the cached ECB key schedule, rather than setting up the cipher
+	 * again for each block.
+	 *
+	 * @see XSECCryptoProvider::wrapKeyAES
+	 */
+
+	unsigned int wrapKeyAES(const unsigned char * inBuf,
+							unsigned int inLength,
+							unsigned char * outBuf,
+							unsigned int maxOutLength);
+
+	/**
+	 * \brief Unwrap a key with this AES key (RFC 3394)
+	 *
+	 * @see XSECCryptoProvider::unwrapKeyAES
+	 */
+
+	unsigned int unwrapKeyAES(const unsigned char * inBuf,
+							  unsigned int inLength,
+							  unsigned char * outBuf,
+							  unsigned int maxOutLength);
+
 	//@}
 
 private:
@@ -301,8 +349,12 @@ private:
 	OpenSSLCryptoSymmetricKey(const OpenSSLCryptoSymmetricKey &);
 	OpenSSLCryptoSymmetricKey & operator= (const OpenSSLCryptoSymmetricKey &);
 
+	// Expanded keys, shared between clones
+	struct KeySchedules;
+
 	// Private functions
 	int decryptCtxInit(const unsigned char* iv, const unsigned char* tag, unsigned int taglen);
+	void cipherInit(const EVP_CIPHER * cipher, const unsigned char * iv, bool encrypt);
 
 	// Private variables
 	SymmetricKeyType				m_keyType;
@@ -310,6 +362,7 @@ private:
 	EVP_CIPHER_CTX					m_ctx;			// OpenSSL Cipher Context structure
 	safeBuffer						m_keyBuf;		// Holder of the key
     safeBuffer                      m_tagBuf;       // Holder of authentication tag
+	unsigned int					m_tagLen;		// Bytes in m_tagBuf (0 if none yet)
 	unsigned int					m_keyLen;
 	bool							m_initialised;	// Is the context ready to work?
 	unsigned char					m_lastBlock[MAX_BLOCK_SIZE];
@@ -318,6 +371,7 @@ private:
 	int								m_bytesInLastBlock;
 	bool							m_ivSent;		// Has the IV been put in the stream
 	bool							m_doPad;		// Do we pad last block?
+	KeySchedules					* mp_schedules;
 };
 
 #endif /* XSEC_HAVE_OPENSSL */
@@ -38,6 +38,8 @@
 #include <xsec/framework/XSECDefs.hpp>
 #include <xsec/dsig/DSIGConstants.hpp>
 
+class safeBuffer;
+
 /**
  * \ingroup crypto
  */
@@ -126,6 +128,43 @@ public :
 
 	virtual XSECCryptoKey * clone() const = 0;
 
+	/**
+	 * \brief Identify the public part of the key
+	 *
+	 * Provides a byte string (such as the DER encoded public key) that
+	 * is the same for any two key objects holding the same public key and
+	 * differs otherwise.  It is used to key caches of verification
+	 * results, so must never be derived from secret key material.
+	 *
+	 * The default implementation cannot identify the key.
+	 *
+	 * @param id Buffer to place the identity in
+	 * @returns The length of the identity, or 0 if none is available
+	 */
+
+	virtual unsigned int getPublicKeyIdentity(safeBuffer & id) const {return 0;}
+
+	/**
+	 * \brief Can the key be shared between threads
+	 *
+	 * A shareable key keeps no per-operation state in the object, so
+	 * signing, verifying, encrypting and decrypting may be called on one
+	 * instance from many threads at once.  Its clone() is cheap - the
+	 * clone shares the underlying key material (and any precomputation
+	 * the crypto library has attached to it) rather than copying it.
+	 *
+	 * Anything that changes the key (loading material, setting OAEP
+	 * parameters and the like) must not be called while other threads
+	 * are using the same instance.  Changing the material of a clone
+	 * does not affect the keys it was cloned from or with.
+	 *
+	 * The default implementation is not shareable.
+	 *
+	 * @returns true if the key may be used concurrently
+	 */
+
+	virtual bool isShareable() const {return false;}
+
   //@}
 
 };
@@ -33,6 +33,15 @@
 
 #include <xercesc/util/Janitor.hpp>
 
+#include <string.h>
+
+XSEC_USING_XERCES(Janitor);
+
+// RFC 3394 default initial value
+static const unsigned char s_AESWrapIV[] = {
+    0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6
+};
+
 XSECCryptoKeyEC* XSECCryptoProvider::keyEC() const {
     throw XSECCryptoException(XSECCryptoException::UnsupportedError,
 		"XSECCryptoProvider - EC keys not supported");
@@ -42,3 +51,172 @@ XSECCryptoKey* XSECCryptoProvider::keyDER(const char* buf, unsigned long buflen,
     throw XSECCryptoException(XSECCryptoException::UnsupportedError,
 		"XSECCryptoProvider - DER-encoded keys not supported");
 }
+
+XSECCryptoHash* XSECCryptoProvider::hashByType(XSECCryptoHash::HashType type) const {
+
+    XSECCryptoHash * h;
+
+    switch (type) {
+
+    case XSECCryptoHash::HASH_SHA1 :
+        h = hashSHA(160);
+        break;
+    case XSECCryptoHash::HASH_SHA224 :
+        h = hashSHA(224);
+        break;
+    case XSECCryptoHash::HASH_SHA256 :
+        h = hashSHA(256);
+        break;
+    case XSECCryptoHash::HASH_SHA384 :
+        h = hashSHA(384);
+        break;
+    case XSECCryptoHash::HASH_SHA512 :
+        h = hashSHA(512);
+        break;
+    case XSECCryptoHash::HASH_MD5 :
+        h = hashMD5();
+        break;
+    default :
+        throw XSECCryptoException(XSECCryptoException::UnsupportedError,
+            "XSECCryptoProvider - Unknown hash type");
+
+    }
+
+    if (h == NULL) {
+        throw XSECCryptoException(XSECCryptoException::UnsupportedError,
+            "XSECCryptoProvider - Hash type not supported");
+    }
+
+    return h;
+}
+
+unsigned int XSECCryptoProvider::hashBatch(XSECCryptoHash::HashType type,
+                                           unsigned int count,
+                                           const unsigned char * const * inputs,
+                                           const unsigned int * inputLens,
+                                           unsigned char * outputs,
+                                           unsigned int outputStride) const {
+
+    XSECCryptoHash * h = hashByType(type);
+    Janitor<XSECCryptoHash> j_h(h);
+
+    unsigned int len = 0;
+
+    for (unsigned int i = 0; i < count; ++i) {
+
+        if (i > 0)
+            h->reset();
+
+        h->hash((unsigned char *) inputs[i], inputLens[i]);
+        len = h->finish(outputs + (i * outputStride), outputStride);
+
+    }
+
+    return len;
+}
+
+unsigned int XSECCryptoProvider::wrapKeyAES(XSECCryptoSymmetricKey * kek,
+                                            const unsigned char * inBuf,
+                                            unsigned int inLength,
+                                            unsigned char * outBuf,
+                                            unsigned int maxOutLength) const {
+
+    if (inLength < 16 || inLength % 8 != 0 || maxOutLength < inLength + 8) {
+        throw XSECCryptoException(XSECCryptoException::SymmetricError,
+            "XSECCryptoProvider - Bad lengths for AES key wrap");
+    }
+
+    unsigned char aesBuf[16];
+    unsigned char aesOutBuf[32];  // Give this an extra block for WinCAPI
+
+    memmove(&outBuf[8], inBuf, inLength);
+    memcpy(outBuf, s_AESWrapIV, 8);
+
+    unsigned int n = inLength / 8;
+
+    for (unsigned int j = 0; j <= 5; ++j) {
+        for (unsigned int i = 1; i <= n; ++i) {
+
+            // A | Ri
+            memcpy(aesBuf, outBuf, 8);
+            memcpy(&aesBuf[8], &outBuf[8 * i], 8);
+
+            kek->encryptInit(false, XSECCryptoSymmetricKey::MODE_ECB);
+            unsigned int sz = kek->encrypt(aesBuf, aesOutBuf, 16, 32);
+            sz += kek->encryptFinish(&aesOutBuf[sz], 32 - sz);
+
+            if (sz != 16) {
+                throw XSECCryptoException(XSECCryptoException::SymmetricError,
+                    "XSECCryptoProvider - Error performing encrypt in AES wrap");
+            }
+
+            // A = MSB(B) ^ t, Ri = LSB(B)
+            unsigned int t = (n * j) + i;
+            memcpy(outBuf, aesOutBuf, 8);
+            outBuf[4] ^= (unsigned char) (t >> 24);
+            outBuf[5] ^= (unsigned char) (t >> 16);
+            outBuf[6] ^= (unsigned char) (t >> 8);
+            outBuf[7] ^= (unsigned char) t;
+            memcpy(&outBuf[8 * i], &aesOutBuf[8], 8);
+
+        }
+    }
+
+    return inLength + 8;
+}
+
+unsigned int XSECCryptoProvider::unwrapKeyAES(XSECCryptoSymmetricKey * kek,
+                                              const unsigned char * inBuf,
+                                              unsigned int inLength,
+                                              unsigned char * outBuf,
+                                              unsigned int maxOutLength) const {
+
+    if (inLength < 24 || inLength % 8 != 0 || maxOutLength < inLength - 8) {
+        throw XSECCryptoException(XSECCryptoException::SymmetricError,
+            "XSECCryptoProvider - Bad lengths for AES key unwrap");
+    }
+
+    unsigned char a[8];
+    unsigned char aesBuf[16];
+    unsigned char aesOutBuf[32];
+
+    unsigned int n = (inLength / 8) - 1;
+
+    memcpy(a, inBuf, 8);
+    memmove(outBuf, &inBuf[8], n * 8);
+
+    for (int j = 5; j >= 0; --j) {
+        for (unsigned int i = n; i > 0; --i) {
+
+            // (A ^ t) | Ri
+            unsigned int t = (n * j) + i;
+            memcpy(aesBuf, a, 8);
+            aesBuf[4] ^= (unsigned char) (t >> 24);
+            aesBuf[5] ^= (unsigned char) (t >> 16);
+            aesBuf[6] ^= (unsigned char) (t >> 8);
+            aesBuf[7] ^= (unsigned char) t;
+            memcpy(&aesBuf[8], &outBuf[8 * (i - 1)], 8);
+
+            kek->decryptInit(false, XSECCryptoSymmetricKey::MODE_ECB);
+            unsigned int sz = kek->decrypt(aesBuf, aesOutBuf, 16, 32);
+            sz += kek->decryptFinish(&aesOutBuf[sz], 32 - sz);
+
+            if (sz != 16) {
+                throw XSECCryptoException(XSECCryptoException::SymmetricError,
+                    "XSECCryptoProvider - Error performing decrypt in AES unwrap");
+            }
+
+            // A = MSB(B), Ri = LSB(B)
+            memcpy(a, aesOutBuf, 8);
+            memcpy(&outBuf[8 * (i - 1)], &aesOutBuf[8], 8);
+
+        }
+    }
+
+    if (memcmp(a, s_AESWrapIV, 8) != 0) {
+        memset(outBuf, 0, n * 8);
+        return 0;
+    }
+
+    return n * 8;
+}
@@ -249,6 +249,18 @@ public :
 
 	virtual XSECCryptoKeyHMAC		* keyHMAC() const = 0;
 
+	/**
+	 * \brief Return a hash implementation for a given hash type
+	 *
+	 * Maps the type to a call to hashSHA() or hashMD5().
+	 *
+	 * @param type The digest required
+	 * @returns A pointer to a Hash object for the digest.  An exception
+	 * is thrown if the type is unknown.
+	 */
+
+	XSECCryptoHash * hashByType(XSECCryptoHash::HashType type) const;
+
 	//@}
 
 	/** @name Encoding functions */
@@ -359,6 +371,49 @@ public :
 
 	virtual XSECCryptoSymmetricKey	* keySymmetric(XSECCryptoSymmetricKey::SymmetricKeyType alg) const = 0;
 
+	/**
+	 * \brief Wrap a key with AES (RFC 3394)
+	 *
+	 * The key wrap runs AES over 6 * n blocks of the input (for n 64 bit
+	 * blocks of key).  The default implementation does so through the
+	 * XSECCryptoSymmetricKey interface, setting up ECB mode for each
+	 * block.  A provider can override this to wrap on a single context.
+	 *
+	 * @param kek The AES key encryption key
+	 * @param inBuf The key to wrap.  At least 16 bytes and a multiple of 8
+	 * @param inLength Bytes of key to wrap
+	 * @param outBuf Buffer for the wrapped key
+	 * @param maxOutLength Size of outBuf.  Must be at least inLength + 8
+	 * @returns The length of the wrapped key.  An exception is thrown
+	 * on error.
+	 */
+
+	virtual unsigned int wrapKeyAES(XSECCryptoSymmetricKey * kek,
+		const unsigned char * inBuf,
+		unsigned int inLength,
+		unsigned char * outBuf,
+		unsigned int maxOutLength) const;
+
+	/**
+	 * \brief Unwrap a key with AES (RFC 3394)
+	 *
+	 * The reverse of wrapKeyAES().
+	 *
+	 * @param kek The AES key encryption key
+	 * @param inBuf The wrapped key.  At least 24 bytes and a multiple of 8
+	 * @param inLength Bytes of wrapped key
+	 * @param outBuf Buffer for the key
+	 * @param maxOutLength Size of outBuf.  Must be at least inLength - 8
+	 * @returns The length of the key, or 0 if the integrity check fails.
+	 * An exception is thrown on any other error.
+	 */
+
+	virtual unsigned int unwrapKeyAES(XSECCryptoSymmetricKey * kek,
+		const unsigned char * inBuf,
+		unsigned int inLength,
+		unsigned char * outBuf,
+		unsigned int maxOutLength) const;
+
 	/**
 	 * \brief Obtain some random octets
 	 *
@@ -386,6 +441,43 @@ public :
 
 	//@}
 
+	/** @name Batch Functions */
+	//@{
+
+	/**
+	 * \brief Digest a number of small, independent inputs
+	 *
+	 * Hashes count separate inputs in one call.  For inputs of a few
+	 * hundred bytes, creating and setting up a hash object costs about
+	 * as much as the digest itself, so a provider can override this to
+	 * run the whole batch through one context.
+	 *
+	 * The default implementation re-uses a single object obtained from
+	 * hashByType().
+	 *
+	 * @note Declared last, so the vtable slots of the other functions are
+	 * as they were.  The vtable still grows, so providers compiled
+	 * against earlier headers must be rebuilt.
+	 *
+	 * @param type The digest to calculate
+	 * @param count Number of inputs
+	 * @param inputs The inputs to digest
+	 * @param inputLens Length of each input
+	 * @param outputs Buffer for the digests.  The digest of inputs[i] is
+	 * written at outputs + (i * outputStride)
+	 * @param outputStride Space available for each digest
+	 * @returns The length of each digest
+	 */
+
+	virtual unsigned int hashBatch(XSECCryptoHash::HashType type,
+		unsigned int count,
+		const unsigned char * const * inputs,
+		const unsigned int * inputLens,
+		unsigned char * outputs,
+		unsigned int outputStride) const;
+
+	//@}
+
 	/*\@}*/
 };
 
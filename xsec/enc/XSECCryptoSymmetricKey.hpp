@@ -230,6 +230,32 @@ public :
 	virtual unsigned int decryptFinish(unsigned char * plainBuf,
 									   unsigned int maxOutLength) = 0;
 
+	/**
+	 * \brief Can the authentication tag be given once decryption is under way
+	 *
+	 * The tag of an authenticated (AEAD) mode follows the cipher text, so
+	 * a caller reading the cipher text as a stream only has it at the end.
+	 * Keys that return true here may have decryptInit() called without a
+	 * tag and be given it via setTag() at any point before decryptFinish().
+	 *
+	 * The default implementation requires the tag up front.
+	 *
+	 * @returns true if setTag() is supported
+	 */
+
+	virtual bool canDeferTag(void) const {return false;}
+
+	/**
+	 * \brief Supply the authentication tag for the current decryption
+	 *
+	 * @param tag The authentication tag
+	 * @param taglen Length of the tag
+	 * @returns false if the key does not support a deferred tag
+	 * @see canDeferTag
+	 */
+
+	virtual bool setTag(const unsigned char * tag, unsigned int taglen) {return false;}
+
 	/**
 	 * \brief Initialise an encryption process
 	 *
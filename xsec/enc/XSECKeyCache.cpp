@@ -0,0 +1,142 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECKeyCache := Bounded cache of keys resolved from KeyInfo material
+ *
+ * $Id$
+ *
+ */
+
+#include <xsec/enc/XSECKeyCache.hpp>
+#include <xsec/enc/XSECCryptoKey.hpp>
+#include <xsec/enc/XSECCryptoProvider.hpp>
+#include <xsec/framework/XSECError.hpp>
+#include <xsec/utils/XSECPlatformUtils.hpp>
+
+#include <xercesc/util/Janitor.hpp>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Construct/Destroy
+// --------------------------------------------------------------------------------
+
+XSECKeyCache::XSECKeyCache(unsigned int maxEntries, unsigned int maxAge) :
+m_cache(maxEntries, maxAge) {
+
+}
+
+XSECKeyCache::~XSECKeyCache() {
+
+}
+
+// --------------------------------------------------------------------------------
+//           Internals
+// --------------------------------------------------------------------------------
+
+std::string XSECKeyCache::makeId(const char * material, unsigned int materialLen) {
+
+	XSECCryptoHash * h = XSECPlatformUtils::g_cryptoProvider->hashSHA(256);
+	Janitor<XSECCryptoHash> j_h(h);
+
+	h->hash((unsigned char *) material, materialLen);
+
+	unsigned char digest[CRYPTO_MAX_HASH_SIZE];
+	unsigned int digestLen = h->finish(digest, CRYPTO_MAX_HASH_SIZE);
+
+	return std::string((const char *) digest, digestLen);
+
+}
+
+// --------------------------------------------------------------------------------
+//           Cache operations
+// --------------------------------------------------------------------------------
+
+XSECCryptoKey * XSECKeyCache::lookup(const char * material, unsigned int materialLen) {
+
+	std::string id = makeId(material, materialLen);
+
+	XMLMutexLock lock(&m_mutex);
+
+	XSECCryptoKey ** k = m_cache.find(id);
+	if (k == NULL)
+		return NULL;
+
+	// Clone under the lock - the held key may be evicted once it is released
+	return (*k)->clone();
+
+}
+
+void XSECKeyCache::store(const char * material, unsigned int materialLen, const XSECCryptoKey * key) {
+
+	if (key == NULL)
+		return;
+
+	std::string id = makeId(material, materialLen);
+	XSECCryptoKey * copy = key->clone();
+
+	XMLMutexLock lock(&m_mutex);
+
+	XSECCryptoKey ** k = m_cache.store(id);
+	delete *k;
+	*k = copy;
+
+}
+
+void XSECKeyCache::clear(void) {
+
+	XMLMutexLock lock(&m_mutex);
+	m_cache.clear();
+
+}
+
+// --------------------------------------------------------------------------------
+//           Statistics
+// --------------------------------------------------------------------------------
+
+unsigned long XSECKeyCache::getHits(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getHits();
+
+}
+
+unsigned long XSECKeyCache::getMisses(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getMisses();
+
+}
+
+unsigned long XSECKeyCache::getEvictions(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getEvictions();
+
+}
+
+unsigned int XSECKeyCache::getSize(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getSize();
+
+}
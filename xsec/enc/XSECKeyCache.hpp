@@ -0,0 +1,154 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECKeyCache := Bounded cache of keys resolved from KeyInfo material
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECKEYCACHE_INCLUDE
+#define XSECKEYCACHE_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+#include <xsec/utils/XSECLRUCache.hpp>
+
+#include <xercesc/util/Mutexes.hpp>
+
+#include <string>
+
+class XSECCryptoKey;
+
+/**
+ * @ingroup interfaces
+ */
+/*\@{*/
+
+/**
+ * @brief Cache of keys built from KeyInfo elements
+ *
+ * Building a key from a KeyInfo means decoding and parsing a certificate,
+ * or loading each of a KeyValue's big numbers - identical work every
+ * time the same signer is seen.  When installed in an
+ * XSECKeyInfoResolverDefault (XSECKeyInfoResolverDefault::setKeyCache())
+ * the keys built are remembered, keyed by a SHA-256 digest of the raw
+ * KeyInfo material (the certificate, or the KeyValue's components).
+ *
+ * The cache holds its own copy of each key and hands out clones, so
+ * callers own (and may delete) what they are given.
+ *
+ * The cache holds at most the number of entries given at construction,
+ * discarding the least recently used, and entries expire after the
+ * given number of seconds.  A single cache may be shared by any number
+ * of resolvers and threads.
+ *
+ * @note Nothing is validated - a key is returned for whatever material
+ * it was built from, exactly as the resolver would have built it.
+ */
+
+class DSIG_EXPORT XSECKeyCache {
+
+public:
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	/**
+	 * \brief Create an empty cache
+	 *
+	 * @param maxEntries Maximum number of keys held
+	 * @param maxAge Number of seconds a key is held for (0 for no limit)
+	 */
+
+	XSECKeyCache(unsigned int maxEntries = 64, unsigned int maxAge = 3600);
+	~XSECKeyCache();
+
+	//@}
+
+	/** @name Cache operations */
+	//@{
+
+	/**
+	 * \brief Find the key built from some KeyInfo material
+	 *
+	 * @param material The raw KeyInfo material
+	 * @param materialLen Its length
+	 * @returns A clone of the key (owned by the caller), or NULL
+	 */
+
+	XSECCryptoKey * lookup(const char * material, unsigned int materialLen);
+
+	/**
+	 * \brief Remember the key built from some KeyInfo material
+	 *
+	 * @param material The raw KeyInfo material
+	 * @param materialLen Its length
+	 * @param key The key.  It is cloned, so remains owned by the caller.
+	 */
+
+	void store(const char * material, unsigned int materialLen, const XSECCryptoKey * key);
+
+	/**
+	 * \brief Remove all keys (the statistics are kept)
+	 */
+
+	void clear(void);
+
+	//@}
+
+	/** @name Statistics */
+	//@{
+
+	/** \brief Number of lookups that found a key */
+	unsigned long getHits(void) const;
+
+	/** \brief Number of lookups that did not */
+	unsigned long getMisses(void) const;
+
+	/** \brief Number of keys discarded to make room for others */
+	unsigned long getEvictions(void) const;
+
+	/** \brief Number of keys currently held */
+	unsigned int getSize(void) const;
+
+	//@}
+
+private:
+
+	typedef XSECLRUCache<XSECCryptoKey *, XSECLRUDeleteRelease<XSECCryptoKey *> >
+												KeyLRUType;
+
+	// Unimplemented
+	XSECKeyCache(const XSECKeyCache &);
+	XSECKeyCache & operator = (const XSECKeyCache &);
+
+	static std::string makeId(const char * material, unsigned int materialLen);
+
+	KeyLRUType									m_cache;
+	mutable XERCES_CPP_NAMESPACE_QUALIFIER XMLMutex
+												m_mutex;
+
+};
+
+/*\@}*/
+
+#endif /* XSECKEYCACHE_INCLUDE */
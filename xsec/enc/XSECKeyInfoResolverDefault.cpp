@@ -31,6 +31,7 @@
 #include <xsec/dsig/DSIGKeyInfoX509.hpp>
 #include <xsec/dsig/DSIGKeyInfoValue.hpp>
 #include <xsec/dsig/DSIGKeyInfoDEREncoded.hpp>
+#include <xsec/enc/XSECKeyCache.hpp>
 #include <xsec/framework/XSECError.hpp>
 
 #include "../utils/XSECAutoPtr.hpp"
@@ -42,7 +43,8 @@ XERCES_CPP_NAMESPACE_USE
 // --------------------------------------------------------------------------------
 //           Construct/Destruct
 // --------------------------------------------------------------------------------
-XSECKeyInfoResolverDefault::XSECKeyInfoResolverDefault() {
+XSECKeyInfoResolverDefault::XSECKeyInfoResolverDefault() :
+mp_keyCache(NULL) {
 
 	// Create a UTF-8 formatter
 	XSECnew(mp_formatter, XSECSafeBufferFormatter("UTF-8",XMLFormatter::NoEscapes, 
@@ -68,118 +70,214 @@ XSECCryptoKey * XSECKeyInfoResolverDefault::resolveKey(DSIGKeyInfoList * lst) {
 	// Try to find a key from the KeyInfo list as best we can
 	// NOTE: No validation is performed (i.e. no cert/CRL checks etc.)
 
-	XSECCryptoKey * ret = NULL;
+	XSECCryptoKey * ret;
+	std::string material;
 
 	DSIGKeyInfoList::size_type sz = lst->getSize();
 
 	for (DSIGKeyInfoList::size_type i = 0; i < sz; ++i) {
 
-		switch (lst->item(i)->getKeyInfoType()) {
+		bool useCache = (mp_keyCache != NULL && getKeyMaterial(lst->item(i), material));
 
-		case (DSIGKeyInfo::KEYINFO_X509) :
-		{
-			ret = NULL;
-			const XMLCh * x509Str;
-			XSECCryptoX509 * x509 = XSECPlatformUtils::g_cryptoProvider->X509();
-			Janitor<XSECCryptoX509> j_x509(x509);
+		if (useCache) {
+			ret = mp_keyCache->lookup(material.data(), (unsigned int) material.size());
+			if (ret != NULL)
+				return ret;
+		}
 
-			x509Str = ((DSIGKeyInfoX509 *) lst->item(i))->getCertificateItem(0);
-			
-			if (x509Str != 0) {
+		ret = makeKey(lst->item(i));
 
-				// The crypto interface classes work UTF-8
-				safeBuffer transX509;
+		if (ret != NULL) {
+			if (useCache)
+				mp_keyCache->store(material.data(), (unsigned int) material.size(), ret);
+			return ret;
+		}
 
-				transX509 << (*mp_formatter << x509Str);
-				x509->loadX509Base64Bin(transX509.rawCharBuffer(), (unsigned int) strlen(transX509.rawCharBuffer()));
-				ret = x509->clonePublicKey();
-			}
+	}
 
-			if (ret != NULL)
-				return ret;
+	return NULL;
+
+}
+
+XSECCryptoKey * XSECKeyInfoResolverDefault::makeKey(DSIGKeyInfo * ki) {
+
+	// Build the key held in one KeyInfo element, or return NULL if there
+	// isn't one
+
+	XSECCryptoKey * ret = NULL;
+
+	switch (ki->getKeyInfoType()) {
+
+	case (DSIGKeyInfo::KEYINFO_X509) :
+	{
+		ret = NULL;
+		const XMLCh * x509Str;
+		XSECCryptoX509 * x509 = XSECPlatformUtils::g_cryptoProvider->X509();
+		Janitor<XSECCryptoX509> j_x509(x509);
+
+		x509Str = ((DSIGKeyInfoX509 *) ki)->getCertificateItem(0);
 		
+		if (x509Str != 0) {
+
+			// The crypto interface classes work UTF-8
+			safeBuffer transX509;
+
+			transX509 << (*mp_formatter << x509Str);
+			x509->loadX509Base64Bin(transX509.rawCharBuffer(), (unsigned int) strlen(transX509.rawCharBuffer()));
+			ret = x509->clonePublicKey();
 		}
-			break;
 
-		case (DSIGKeyInfo::KEYINFO_VALUE_DSA) :
-		{
+		if (ret != NULL)
+			return ret;
+	
+	}
+		break;
 
-			XSECCryptoKeyDSA * dsa = XSECPlatformUtils::g_cryptoProvider->keyDSA();
-			Janitor<XSECCryptoKeyDSA> j_dsa(dsa);
+	case (DSIGKeyInfo::KEYINFO_VALUE_DSA) :
+	{
 
-			safeBuffer value;
+		XSECCryptoKeyDSA * dsa = XSECPlatformUtils::g_cryptoProvider->keyDSA();
+		Janitor<XSECCryptoKeyDSA> j_dsa(dsa);
 
-			value << (*mp_formatter << ((DSIGKeyInfoValue *) lst->item(i))->getDSAP());
-			dsa->loadPBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
-			value << (*mp_formatter << ((DSIGKeyInfoValue *) lst->item(i))->getDSAQ());
-			dsa->loadQBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
-			value << (*mp_formatter << ((DSIGKeyInfoValue *) lst->item(i))->getDSAG());
-			dsa->loadGBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
-			value << (*mp_formatter << ((DSIGKeyInfoValue *) lst->item(i))->getDSAY());
-			dsa->loadYBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
+		safeBuffer value;
 
-			j_dsa.release();
-			return dsa;
-		}
-			break;
+		value << (*mp_formatter << ((DSIGKeyInfoValue *) ki)->getDSAP());
+		dsa->loadPBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
+		value << (*mp_formatter << ((DSIGKeyInfoValue *) ki)->getDSAQ());
+		dsa->loadQBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
+		value << (*mp_formatter << ((DSIGKeyInfoValue *) ki)->getDSAG());
+		dsa->loadGBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
+		value << (*mp_formatter << ((DSIGKeyInfoValue *) ki)->getDSAY());
+		dsa->loadYBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
 
-		case (DSIGKeyInfo::KEYINFO_VALUE_RSA) :
-		{
+		j_dsa.release();
+		return dsa;
+	}
+		break;
 
-			XSECCryptoKeyRSA * rsa = XSECPlatformUtils::g_cryptoProvider->keyRSA();
-			Janitor<XSECCryptoKeyRSA> j_rsa(rsa);
+	case (DSIGKeyInfo::KEYINFO_VALUE_RSA) :
+	{
 
-			safeBuffer value;
+		XSECCryptoKeyRSA * rsa = XSECPlatformUtils::g_cryptoProvider->keyRSA();
+		Janitor<XSECCryptoKeyRSA> j_rsa(rsa);
 
-			value << (*mp_formatter << ((DSIGKeyInfoValue *) lst->item(i))->getRSAModulus());
-			rsa->loadPublicModulusBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
-			value << (*mp_formatter << ((DSIGKeyInfoValue *) lst->item(i))->getRSAExponent());
-			rsa->loadPublicExponentBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
+		safeBuffer value;
 
-			j_rsa.release();
-			return rsa;
+		value << (*mp_formatter << ((DSIGKeyInfoValue *) ki)->getRSAModulus());
+		rsa->loadPublicModulusBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
+		value << (*mp_formatter << ((DSIGKeyInfoValue *) ki)->getRSAExponent());
+		rsa->loadPublicExponentBase64BigNums(value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
 
-		}
-            break;
-
-        case (DSIGKeyInfo::KEYINFO_VALUE_EC) :
-        {
-
-            XSECCryptoKeyEC* ec = XSECPlatformUtils::g_cryptoProvider->keyEC();
-            Janitor<XSECCryptoKeyEC> j_ec(ec);
-
-            safeBuffer value;
-			value << (*mp_formatter << ((DSIGKeyInfoValue *) lst->item(i))->getECPublicKey());
-            XSECAutoPtrChar curve(((DSIGKeyInfoValue *) lst->item(i))->getECNamedCurve());
-            if (curve.get()) {
-                ec->loadPublicKeyBase64(curve.get(), value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
-                j_ec.release();
-                return ec;
-            }
-        }
-            break;
+		j_rsa.release();
+		return rsa;
+
+	}
+        break;
+
+    case (DSIGKeyInfo::KEYINFO_VALUE_EC) :
+    {
 
-        case (DSIGKeyInfo::KEYINFO_DERENCODED) :
-        {
-            safeBuffer value;
-			value << (*mp_formatter << ((DSIGKeyInfoDEREncoded *) lst->item(i))->getData());
-            return XSECPlatformUtils::g_cryptoProvider->keyDER(value.rawCharBuffer(), (unsigned int)strlen(value.rawCharBuffer()), true);
+        XSECCryptoKeyEC* ec = XSECPlatformUtils::g_cryptoProvider->keyEC();
+        Janitor<XSECCryptoKeyEC> j_ec(ec);
+
+        safeBuffer value;
+		value << (*mp_formatter << ((DSIGKeyInfoValue *) ki)->getECPublicKey());
+        XSECAutoPtrChar curve(((DSIGKeyInfoValue *) ki)->getECNamedCurve());
+        if (curve.get()) {
+            ec->loadPublicKeyBase64(curve.get(), value.rawCharBuffer(), (unsigned int) strlen(value.rawCharBuffer()));
+            j_ec.release();
+            return ec;
         }
-            break;
+    }
+        break;
 
-		default :
-			break;
+    case (DSIGKeyInfo::KEYINFO_DERENCODED) :
+    {
+        safeBuffer value;
+		value << (*mp_formatter << ((DSIGKeyInfoDEREncoded *) ki)->getData());
+        return XSECPlatformUtils::g_cryptoProvider->keyDER(value.rawCharBuffer(), (unsigned int)strlen(value.rawCharBuffer()), true);
+    }
+        break;
+
+	default :
+		break;
 
-		}
 	}
 
 	return NULL;
 
 }
 
+// --------------------------------------------------------------------------------
+//           Key material
+// --------------------------------------------------------------------------------
+
+namespace {
+
+	bool addMaterial(std::string & material, const XMLCh * field) {
+
+		if (field == NULL)
+			return false;
+
+		// Length prefixed, so no two sets of fields are the same bytes
+		unsigned int len = (unsigned int) (XMLString::stringLen(field) * sizeof(XMLCh));
+		material.append((const char *) &len, sizeof(len));
+		material.append((const char *) field, len);
+
+		return true;
+
+	}
+
+}
+
+bool XSECKeyInfoResolverDefault::getKeyMaterial(DSIGKeyInfo * ki, std::string & material) {
+
+	// The raw (untranscoded) text the key is built from
+
+	material.erase();
+	material += (char) ki->getKeyInfoType();
+
+	switch (ki->getKeyInfoType()) {
+
+	case (DSIGKeyInfo::KEYINFO_X509) :
+
+		return addMaterial(material, ((DSIGKeyInfoX509 *) ki)->getCertificateItem(0));
+
+	case (DSIGKeyInfo::KEYINFO_VALUE_DSA) :
+
+		return addMaterial(material, ((DSIGKeyInfoValue *) ki)->getDSAP()) &&
+			addMaterial(material, ((DSIGKeyInfoValue *) ki)->getDSAQ()) &&
+			addMaterial(material, ((DSIGKeyInfoValue *) ki)->getDSAG()) &&
+			addMaterial(material, ((DSIGKeyInfoValue *) ki)->getDSAY());
+
+	case (DSIGKeyInfo::KEYINFO_VALUE_RSA) :
+
+		return addMaterial(material, ((DSIGKeyInfoValue *) ki)->getRSAModulus()) &&
+			addMaterial(material, ((DSIGKeyInfoValue *) ki)->getRSAExponent());
+
+	case (DSIGKeyInfo::KEYINFO_VALUE_EC) :
+
+		return addMaterial(material, ((DSIGKeyInfoValue *) ki)->getECNamedCurve()) &&
+			addMaterial(material, ((DSIGKeyInfoValue *) ki)->getECPublicKey());
+
+	case (DSIGKeyInfo::KEYINFO_DERENCODED) :
+
+		return addMaterial(material, ((DSIGKeyInfoDEREncoded *) ki)->getData());
+
+	default :
+
+		return false;
+
+	}
+
+}
+
 
 XSECKeyInfoResolver * XSECKeyInfoResolverDefault::clone(void) const {
 
-	return new XSECKeyInfoResolverDefault();
+	XSECKeyInfoResolverDefault * ret = new XSECKeyInfoResolverDefault();
+	ret->mp_keyCache = mp_keyCache;
+
+	return ret;
 
 }
@@ -36,6 +36,11 @@
 
 #include <xsec/enc/XSECKeyInfoResolver.hpp>
 
+#include <string>
+
+class DSIGKeyInfo;
+class XSECKeyCache;
+
 /**
  * @ingroup interfaces
  */
@@ -99,9 +104,39 @@ public :
 
 	//@}
 
+	/** @name Key cache */
+	//@{
+
+	/**
+	 * \brief Remember the keys built from KeyInfo material
+	 *
+	 * With a cache installed, a KeyInfo holding the same certificate or
+	 * KeyValue as one seen before is answered with a clone of the key
+	 * already built, rather than parsing it again.
+	 *
+	 * @note The cache is not owned by the resolver, and is shared with
+	 * its clones (so with every signature it is installed in).  Pass NULL
+	 * to stop using it.
+	 * @see XSECKeyCache
+	 */
+
+	void setKeyCache(XSECKeyCache * cache) {mp_keyCache = cache;}
+
+	/**
+	 * \brief Return the key cache in use (or NULL)
+	 */
+
+	XSECKeyCache * getKeyCache(void) const {return mp_keyCache;}
+
+	//@}
+
 private:
 
+	XSECCryptoKey * makeKey(DSIGKeyInfo * ki);
+	static bool getKeyMaterial(DSIGKeyInfo * ki, std::string & material);
+
 	XSECSafeBufferFormatter		* mp_formatter;
+	XSECKeyCache				* mp_keyCache;
 
 	/*\@}*/
 };
@@ -67,7 +67,14 @@ const XMLCh XSECAlgorithmMapper::s_defaultEncryptionMapping [] = {
 
 
 
-XSECAlgorithmMapper::XSECAlgorithmMapper(void) {
+// Generations are never re-used, even by a mapper created after another
+// is deleted (on re-initialisation), so a handler kept from one mapper
+// is never mistaken for one of the next
+
+static unsigned int s_lastGeneration = 0;
+
+XSECAlgorithmMapper::XSECAlgorithmMapper(void) :
+	m_generation(++s_lastGeneration) {
 
 }
 
@@ -179,15 +186,18 @@ void XSECAlgorithmMapper::registerHandler(const XMLCh * URI, const XSECAlgorithm
 
 	}
 	entry->mp_handler = handler.clone();
+	m_generation = ++s_lastGeneration;
 
 }
 
 void XSECAlgorithmMapper::whitelistAlgorithm(const XMLCh* URI)
 {
     m_whitelist.push_back(XMLString::replicate(URI));
+    m_generation = ++s_lastGeneration;
 }
 
 void XSECAlgorithmMapper::blacklistAlgorithm(const XMLCh* URI)
 {
     m_blacklist.push_back(XMLString::replicate(URI));
+    m_generation = ++s_lastGeneration;
 }
@@ -75,6 +75,16 @@ public:
 
 	XSECAlgorithmHandler * mapURIToHandler(const XMLCh * URI) const;
 
+	/**
+	 * \brief Return the generation of the mapping
+	 *
+	 * Changes whenever a handler is registered or the whitelist or
+	 * blacklist changes.  A result of mapURIToHandler() may be kept
+	 * for as long as the generation stays the same.
+	 */
+
+	unsigned int getGeneration(void) const {return m_generation;}
+
 	//@}
 
 	/** @name Registration Methods */
@@ -121,6 +131,7 @@ private:
 
 	MapperEntryVectorType		            m_mapping;
     WhitelistVectorType                     m_whitelist,m_blacklist;
+	unsigned int							m_generation;
 };
 
 /*\@}*/
@@ -0,0 +1,115 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECDigestCache := Bounded cache of Reference digest values
+ *
+ * $Id$
+ *
+ */
+
+#include <xsec/framework/XSECDigestCache.hpp>
+
+#include <string.h>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Construct/Destroy
+// --------------------------------------------------------------------------------
+
+XSECDigestCache::XSECDigestCache(unsigned int maxEntries) :
+m_cache(maxEntries) {
+
+}
+
+XSECDigestCache::~XSECDigestCache() {
+
+}
+
+// --------------------------------------------------------------------------------
+//           Cache operations
+// --------------------------------------------------------------------------------
+
+unsigned int XSECDigestCache::lookup(const std::string & key, XMLByte * toFill, unsigned int maxToFill) {
+
+	XMLMutexLock lock(&m_mutex);
+
+	DigestValue * v = m_cache.find(key);
+	if (v == NULL || v->m_len > maxToFill)
+		return 0;
+
+	memcpy(toFill, v->m_digest, v->m_len);
+	return v->m_len;
+
+}
+
+void XSECDigestCache::store(const std::string & key, const XMLByte * digest, unsigned int len) {
+
+	if (len == 0 || len > CRYPTO_MAX_HASH_SIZE)
+		return;
+
+	XMLMutexLock lock(&m_mutex);
+
+	DigestValue * v = m_cache.store(key);
+	memcpy(v->m_digest, digest, len);
+	v->m_len = len;
+
+}
+
+void XSECDigestCache::clear(void) {
+
+	XMLMutexLock lock(&m_mutex);
+	m_cache.clear();
+
+}
+
+// --------------------------------------------------------------------------------
+//           Statistics
+// --------------------------------------------------------------------------------
+
+unsigned long XSECDigestCache::getHits(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getHits();
+
+}
+
+unsigned long XSECDigestCache::getMisses(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getMisses();
+
+}
+
+unsigned long XSECDigestCache::getEvictions(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getEvictions();
+
+}
+
+unsigned int XSECDigestCache::getSize(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getSize();
+
+}
@@ -0,0 +1,152 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECDigestCache := Bounded cache of Reference digest values
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECDIGESTCACHE_INCLUDE
+#define XSECDIGESTCACHE_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+#include <xsec/enc/XSECCryptoProvider.hpp>
+#include <xsec/utils/XSECLRUCache.hpp>
+
+#include <xercesc/util/Mutexes.hpp>
+
+#include <string>
+
+/**
+ * @ingroup pubsig
+ */
+/*\@{*/
+
+/**
+ * @brief Cache of digests calculated over external references
+ *
+ * Signatures frequently reference the same external resources (schemas,
+ * shared attachments, published files).  When a cache is installed in a
+ * signature (DSIGSignature::setDigestCache()) the digest calculated for
+ * an external Reference is remembered, keyed by:
+ *
+ *  - a validator for the resolved resource, obtained from
+ *    XSECURIResolver::getValidator() (for local files this captures the
+ *    resolved path, file identity, size and modification time);
+ *  - a fingerprint of the Reference's Transforms; and
+ *  - the digest algorithm URI.
+ *
+ * References whose resolver cannot provide a validator are never cached.
+ *
+ * The cache holds at most the number of entries given at construction,
+ * discarding the least recently used.  A single cache may be shared by
+ * any number of signatures and threads.
+ */
+
+class DSIG_EXPORT XSECDigestCache {
+
+public:
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	/**
+	 * \brief Create an empty cache
+	 *
+	 * @param maxEntries Maximum number of digests held
+	 */
+
+	XSECDigestCache(unsigned int maxEntries = 256);
+	~XSECDigestCache();
+
+	//@}
+
+	/** @name Cache operations */
+	//@{
+
+	/**
+	 * \brief Find a digest
+	 *
+	 * @param key Key built by the caller from the fields described above
+	 * @param toFill Buffer to copy the digest into
+	 * @param maxToFill Size of toFill
+	 * @returns Length of the digest copied, or 0 if not found
+	 */
+
+	unsigned int lookup(const std::string & key, XMLByte * toFill, unsigned int maxToFill);
+
+	/**
+	 * \brief Store a digest
+	 *
+	 * @param key Key built by the caller from the fields described above
+	 * @param digest The digest value
+	 * @param len Length of the digest
+	 */
+
+	void store(const std::string & key, const XMLByte * digest, unsigned int len);
+
+	/**
+	 * \brief Remove all entries (the statistics are kept)
+	 */
+
+	void clear(void);
+
+	//@}
+
+	/** @name Statistics */
+	//@{
+
+	/** \brief Number of lookups that found a digest */
+	unsigned long getHits(void) const;
+
+	/** \brief Number of lookups that did not */
+	unsigned long getMisses(void) const;
+
+	/** \brief Number of digests discarded to make room for others */
+	unsigned long getEvictions(void) const;
+
+	/** \brief Number of digests currently held */
+	unsigned int getSize(void) const;
+
+	//@}
+
+private:
+
+	struct DigestValue {
+		unsigned char							m_digest[CRYPTO_MAX_HASH_SIZE];
+		unsigned int							m_len;
+	};
+
+	// Unimplemented
+	XSECDigestCache(const XSECDigestCache &);
+	XSECDigestCache & operator = (const XSECDigestCache &);
+
+	XSECLRUCache<DigestValue>					m_cache;
+	mutable XERCES_CPP_NAMESPACE_QUALIFIER XMLMutex
+												m_mutex;
+
+};
+
+/*\@}*/
+
+#endif /* XSECDIGESTCACHE_INCLUDE */
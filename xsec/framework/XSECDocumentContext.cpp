@@ -0,0 +1,80 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECDocumentContext := State shared by the signatures in one document
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/framework/XSECDocumentContext.hpp>
+#include <xsec/framework/XSECError.hpp>
+#include <xsec/utils/XSECIdIndex.hpp>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Constructors and Destructors
+// --------------------------------------------------------------------------------
+
+XSECDocumentContext::XSECDocumentContext(DOMDocument * doc, unsigned int maxDigests) :
+	mp_doc(doc),
+	m_digests(maxDigests) {
+
+	XSECnew(mp_idIndex, XSECIdIndex);
+
+}
+
+XSECDocumentContext::~XSECDocumentContext() {
+
+	delete mp_idIndex;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Context operations
+// --------------------------------------------------------------------------------
+
+void XSECDocumentContext::reset(void) {
+
+	m_digests.clear();
+	mp_idIndex->invalidate();
+
+}
+
+unsigned int XSECDocumentContext::lookupDigest(const std::string & key,
+											   XMLByte * toFill,
+											   unsigned int maxToFill) {
+
+	return m_digests.lookup(key, toFill, maxToFill);
+
+}
+
+void XSECDocumentContext::storeDigest(const std::string & key,
+									  const XMLByte * digest,
+									  unsigned int len) {
+
+	m_digests.store(key, digest, len);
+
+}
@@ -0,0 +1,164 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECDocumentContext := State shared by the signatures in one document
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECDOCUMENTCONTEXT_INCLUDE
+#define XSECDOCUMENTCONTEXT_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+#include <xsec/framework/XSECDigestCache.hpp>
+
+#include <xercesc/dom/DOM.hpp>
+
+#include <string>
+
+class XSECIdIndex;
+
+/**
+ * @ingroup pubsig
+ */
+/*\@{*/
+
+/**
+ * \brief Verification state shared by all the signatures in a document
+ *
+ * Documents such as WS-Security messages or countersigned documents
+ * carry several signatures, frequently over the same content.  Each
+ * DSIGSignature attached to the same context (via
+ * DSIGSignature::setDocumentContext()) shares:
+ *
+ *  - an index of the document's Id attributes, so "#id" References are
+ *    resolved without searching the document again; and
+ *  - the digests of same-document References.  A Reference with the same
+ *    URI, Transforms and digest algorithm as one already verified in
+ *    another signature (and, for the enveloped signature transform, the
+ *    same enveloping Signature) is not canonicalised and hashed again.
+ *
+ * Only References whose transforms are limited to canonicalisation and
+ * the enveloped signature transform are shared, as the result of these
+ * depends only on the document content.
+ *
+ * @note The context assumes the document is not changed while it is in
+ * use.  Signing through an attached DSIGSignature resets it; any other
+ * change to the document must be followed by a call to reset().
+ * A context may be used by several signatures (and threads) at once.
+ */
+
+class DSIG_EXPORT XSECDocumentContext {
+
+public:
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	/**
+	 * \brief Create a context for a document
+	 *
+	 * @param doc The document the signatures are in
+	 * @param maxDigests Maximum number of Reference digests held
+	 */
+
+	XSECDocumentContext(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc,
+		unsigned int maxDigests = 4096);
+
+	~XSECDocumentContext();
+
+	//@}
+
+	/** @name Context operations */
+	//@{
+
+	/**
+	 * \brief Return the document this context belongs to
+	 */
+
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * getDocument(void) const {return mp_doc;}
+
+	/**
+	 * \brief Forget everything derived from the document
+	 *
+	 * Must be called after the document has been changed.
+	 */
+
+	void reset(void);
+
+	/**
+	 * \brief Find the digest of a same-document Reference
+	 *
+	 * @param key Key built by DSIGReference
+	 * @param toFill Buffer to copy the digest into
+	 * @param maxToFill Size of toFill
+	 * @returns Length of the digest copied, or 0 if not found
+	 */
+
+	unsigned int lookupDigest(const std::string & key, XMLByte * toFill, unsigned int maxToFill);
+
+	/**
+	 * \brief Remember the digest of a same-document Reference
+	 *
+	 * @param key Key built by DSIGReference
+	 * @param digest The digest value
+	 * @param len Length of the digest
+	 */
+
+	void storeDigest(const std::string & key, const XMLByte * digest, unsigned int len);
+
+	/**
+	 * \brief Return the Id index shared by the attached signatures
+	 */
+
+	XSECIdIndex * getIdIndex(void) const {return mp_idIndex;}
+
+	//@}
+
+	/** @name Statistics */
+	//@{
+
+	/** \brief Number of Reference digests found in the context */
+	unsigned long getDigestHits(void) const {return m_digests.getHits();}
+
+	/** \brief Number of Reference digests that had to be calculated */
+	unsigned long getDigestMisses(void) const {return m_digests.getMisses();}
+
+	//@}
+
+private:
+
+	// Unimplemented
+	XSECDocumentContext(const XSECDocumentContext &);
+	XSECDocumentContext & operator = (const XSECDocumentContext &);
+
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument
+								* mp_doc;
+	XSECDigestCache				m_digests;
+	XSECIdIndex					* mp_idIndex;
+
+};
+
+/*\@}*/
+
+#endif /* XSECDOCUMENTCONTEXT_INCLUDE */
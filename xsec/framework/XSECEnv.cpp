@@ -33,6 +33,7 @@
 #include <xsec/framework/XSECURIResolver.hpp>
 #include <xsec/dsig/DSIGConstants.hpp>
 #include <xsec/utils/XSECDOMUtils.hpp>
+#include <xsec/utils/XSECIdIndex.hpp>
 
 #include <xercesc/util/XMLUniDefs.hpp>
 
@@ -150,12 +151,18 @@ XSECEnv::XSECEnv(DOMDocument *doc) {
 	m_prettyPrintFlag = true;
 
 	mp_URIResolver = NULL;
+	mp_digestCache = NULL;
+	mp_documentContext = NULL;
+	mp_verificationCache = NULL;
+	m_prefetchLimit = 0;
+	m_parallelVerifyFlag = false;
 
 	// Set up our formatter
 	XSECnew(mp_formatter, XSECSafeBufferFormatter("UTF-8",XMLFormatter::NoEscapes, 
 												XMLFormatter::UnRep_CharRef));
 
 	// Set up IDs
+	XSECnew(mp_idIndex, XSECIdIndex);
 	m_idByAttributeNameFlag = true;		// At the moment this is on by default
 	// Register "Id" and "id" as valid Attribute names
 	registerIdAttributeName(s_Id);
@@ -182,11 +189,18 @@ XSECEnv::XSECEnv(const XSECEnv & theOther) {
 	else
 		mp_URIResolver = NULL;
 
+	mp_digestCache = theOther.mp_digestCache;
+	mp_documentContext = theOther.mp_documentContext;
+	mp_verificationCache = theOther.mp_verificationCache;
+	m_prefetchLimit = theOther.m_prefetchLimit;
+	m_parallelVerifyFlag = theOther.m_parallelVerifyFlag;
+
 	// Set up our formatter
 	XSECnew(mp_formatter, XSECSafeBufferFormatter("UTF-8",XMLFormatter::NoEscapes, 
 												XMLFormatter::UnRep_CharRef));
 
 	// Set up IDs
+	XSECnew(mp_idIndex, XSECIdIndex);
 	m_idByAttributeNameFlag = theOther.m_idByAttributeNameFlag;
 
 	for (int i = 0; i < theOther.getIdAttributeNameListSize() ; ++i) {
@@ -248,6 +262,14 @@ XSECEnv::~XSECEnv() {
 
 	m_idAttributeNameList.empty();
 
+	delete mp_idIndex;
+
+}
+
+void XSECEnv::setParentDocument(DOMDocument * doc) {
+
+	mp_doc = doc;
+	mp_idIndex->invalidate();
 
 }
 
@@ -354,6 +376,12 @@ bool XSECEnv::getIdByAttributeName(void) const {
 
 }
 
+void XSECEnv::invalidateIdIndex(void) {
+
+	mp_idIndex->invalidate();
+
+}
+
 bool XSECEnv::isRegisteredIdAttributeName(const XMLCh * name) const {
 
 	int sz = (int) m_idAttributeNameList.size();
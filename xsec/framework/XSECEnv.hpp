@@ -41,6 +41,10 @@
 #include <xercesc/dom/DOM.hpp>
 
 class XSECURIResolver;
+class XSECDigestCache;
+class XSECDocumentContext;
+class XSECVerificationCache;
+class XSECIdIndex;
 
 /**
  * @ingroup internal
@@ -314,8 +318,7 @@ public:
 	 * @param doc The Document node.
 	 */
 
-	void setParentDocument(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc)
-		{mp_doc = doc;}
+	void setParentDocument(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc);
 
 	//@}
 
@@ -340,6 +343,90 @@ public:
 
 	XSECURIResolver * getURIResolver(void) const;
 
+	/**
+	 * \brief Register a cache for external Reference digests
+	 *
+	 * @note The cache is not owned by (and may be shared between)
+	 * environments.  NULL turns caching off.
+	 */
+
+	void setDigestCache(XSECDigestCache * cache) {mp_digestCache = cache;}
+
+	/**
+	 * \brief Return the digest cache, or NULL if none is in use
+	 */
+
+	XSECDigestCache * getDigestCache(void) const {return mp_digestCache;}
+
+	/**
+	 * \brief Share state with other signatures in the same document
+	 *
+	 * @note The context is not owned by (and may be shared between)
+	 * environments.  NULL stops sharing.
+	 */
+
+	void setDocumentContext(XSECDocumentContext * ctx) {mp_documentContext = ctx;}
+
+	/**
+	 * \brief Return the document context, or NULL if none is in use
+	 */
+
+	XSECDocumentContext * getDocumentContext(void) const {return mp_documentContext;}
+
+	/**
+	 * \brief Register a cache of successful signature verifications
+	 *
+	 * @note The cache is not owned by (and may be shared between)
+	 * environments.  NULL turns caching off.
+	 */
+
+	void setVerificationCache(XSECVerificationCache * cache) {mp_verificationCache = cache;}
+
+	/**
+	 * \brief Return the verification cache, or NULL if none is in use
+	 */
+
+	XSECVerificationCache * getVerificationCache(void) const {return mp_verificationCache;}
+
+	/**
+	 * \brief Set how many external References may be fetched at once
+	 *
+	 * When non-zero, References to external resources are opened and
+	 * digested on the library thread pool during verification, with at
+	 * most maxConcurrent outstanding at any time.  0 (the default)
+	 * processes every Reference in turn on the calling thread.
+	 *
+	 * @note The URI resolver is cloned for each concurrent fetch, so it
+	 * must implement clone() fully.
+	 */
+
+	void setExternalReferencePrefetch(unsigned int maxConcurrent) {m_prefetchLimit = maxConcurrent;}
+
+	/**
+	 * \brief Return the limit on concurrently fetched external References
+	 */
+
+	unsigned int getExternalReferencePrefetch(void) const {return m_prefetchLimit;}
+
+	/**
+	 * \brief Verify References concurrently
+	 *
+	 * When set, References that only read the document (or fetch external
+	 * data) are digested on the library thread pool during verification.
+	 * Results are identical to verifying them one at a time.
+	 *
+	 * The same applies when signing, to References that do not depend
+	 * on each other.
+	 */
+
+	void setParallelReferenceVerification(bool flag) {m_parallelVerifyFlag = flag;}
+
+	/**
+	 * \brief Are References verified concurrently?
+	 */
+
+	bool getParallelReferenceVerification(void) const {return m_parallelVerifyFlag;}
+
 
 	//@}
 
@@ -508,6 +595,22 @@ public:
 
 	bool getIdAttributeNameListItemIsNS(int index) const;
 
+	/*
+	 * \brief Return the index of Id attributes in the parent document
+	 *
+	 * @note This is an internal function and should not be called directly
+	 */
+
+	XSECIdIndex * getIdIndex(void) const {return mp_idIndex;}
+
+	/*
+	 * \brief Discard the Id index, as the document may have changed
+	 *
+	 * @note This is an internal function and should not be called directly
+	 */
+
+	void invalidateIdIndex(void);
+
 	//@}
 	
 	/** @name Formatters */
@@ -554,12 +657,22 @@ private:
 	// Resolvers
 	XSECURIResolver				* mp_URIResolver;
 
+	// Caches (not owned)
+	XSECDigestCache				* mp_digestCache;
+	XSECDocumentContext			* mp_documentContext;
+	XSECVerificationCache		* mp_verificationCache;
+
+	// Concurrency
+	unsigned int				m_prefetchLimit;
+	bool						m_parallelVerifyFlag;
+
 	// Flags
 	bool						m_prettyPrintFlag;
 	bool						m_idByAttributeNameFlag;
 
 	// Id handling
 	IdNameVectorType			m_idAttributeNameList;	
+	XSECIdIndex					* mp_idIndex;
 
 	XSECEnv();
 
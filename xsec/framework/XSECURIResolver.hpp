@@ -33,6 +33,8 @@
 
 XSEC_DECLARE_XERCES_CLASS(BinInputStream);
 
+class safeBuffer;
+
 /**
  * @ingroup pubsig
  */
@@ -102,6 +104,23 @@ public:
 
 	virtual XSECURIResolver * clone(void) = 0;
 
+	/**
+	 * \brief Provide a validator for the content a URI resolves to.
+	 *
+	 * Used to key cached digests (see XSECDigestCache).  The validator
+	 * must identify the resolved resource and change whenever its
+	 * content may have changed.
+	 *
+	 * The default implementation provides no validator, so nothing
+	 * this resolver dereferences is cached.
+	 *
+	 * @param uri The URI as passed to resolveURI()
+	 * @param validator Buffer to receive the validator string
+	 * @returns true if a validator was set
+	 */
+
+	virtual bool getValidator(const XMLCh * uri, safeBuffer & validator) {return false;}
+
 	//@}
 
 };
@@ -0,0 +1,101 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECVerificationCache := Bounded cache of successful SignedInfo verifications
+ *
+ * $Id$
+ *
+ */
+
+#include <xsec/framework/XSECVerificationCache.hpp>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Construct/Destroy
+// --------------------------------------------------------------------------------
+
+XSECVerificationCache::XSECVerificationCache(unsigned int maxEntries, unsigned int maxAge) :
+m_cache(maxEntries, maxAge) {
+
+}
+
+XSECVerificationCache::~XSECVerificationCache() {
+
+}
+
+// --------------------------------------------------------------------------------
+//           Cache operations
+// --------------------------------------------------------------------------------
+
+bool XSECVerificationCache::lookup(const std::string & key) {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.find(key) != NULL;
+
+}
+
+void XSECVerificationCache::store(const std::string & key) {
+
+	XMLMutexLock lock(&m_mutex);
+	*(m_cache.store(key)) = true;
+
+}
+
+void XSECVerificationCache::clear(void) {
+
+	XMLMutexLock lock(&m_mutex);
+	m_cache.clear();
+
+}
+
+// --------------------------------------------------------------------------------
+//           Statistics
+// --------------------------------------------------------------------------------
+
+unsigned long XSECVerificationCache::getHits(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getHits();
+
+}
+
+unsigned long XSECVerificationCache::getMisses(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getMisses();
+
+}
+
+unsigned long XSECVerificationCache::getEvictions(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getEvictions();
+
+}
+
+unsigned int XSECVerificationCache::getSize(void) const {
+
+	XMLMutexLock lock(&m_mutex);
+	return m_cache.getSize();
+
+}
@@ -0,0 +1,151 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECVerificationCache := Bounded cache of successful SignedInfo verifications
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECVERIFICATIONCACHE_INCLUDE
+#define XSECVERIFICATIONCACHE_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+#include <xsec/utils/XSECLRUCache.hpp>
+
+#include <xercesc/util/Mutexes.hpp>
+
+#include <string>
+
+/**
+ * @ingroup pubsig
+ */
+/*\@{*/
+
+/**
+ * @brief Cache of successful signature value verifications
+ *
+ * Services frequently receive the same signed token many times over.
+ * When a cache is installed in a signature
+ * (DSIGSignature::setVerificationCache()), a successful check of the
+ * SignatureValue is remembered under a SHA-256 hash of:
+ *
+ *  - the canonicalised SignedInfo (which carries the signature
+ *    algorithm and every Reference's digest value);
+ *  - the SignatureValue; and
+ *  - the identity of the verifying public key (see
+ *    XSECCryptoKey::getPublicKeyIdentity()).
+ *
+ * A later verification with the same key hash skips the public key
+ * operation.  The References are always re-digested and compared with
+ * the (cached) SignedInfo, so the signed content is still checked.
+ *
+ * Failures are never cached, and nor are verifications with keys that
+ * cannot be identified (such as HMAC keys).
+ *
+ * The cache holds at most the number of entries given at construction,
+ * discarding the least recently used, and entries expire after the
+ * given number of seconds.  A single cache may be shared by any number
+ * of signatures and threads.
+ *
+ * @note Call clear() if the trust placed in any key changes.
+ */
+
+class DSIG_EXPORT XSECVerificationCache {
+
+public:
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	/**
+	 * \brief Create an empty cache
+	 *
+	 * @param maxEntries Maximum number of verifications held
+	 * @param maxAge Number of seconds an entry is valid for (0 for no limit)
+	 */
+
+	XSECVerificationCache(unsigned int maxEntries = 1024, unsigned int maxAge = 300);
+	~XSECVerificationCache();
+
+	//@}
+
+	/** @name Cache operations */
+	//@{
+
+	/**
+	 * \brief Has this verification succeeded before?
+	 *
+	 * @param key Key built by DSIGSignature as described above
+	 * @returns true if the key is held and has not expired
+	 */
+
+	bool lookup(const std::string & key);
+
+	/**
+	 * \brief Remember a successful verification
+	 *
+	 * @param key Key built by DSIGSignature as described above
+	 */
+
+	void store(const std::string & key);
+
+	/**
+	 * \brief Remove all entries (the statistics are kept)
+	 */
+
+	void clear(void);
+
+	//@}
+
+	/** @name Statistics */
+	//@{
+
+	/** \brief Number of lookups that found a verification */
+	unsigned long getHits(void) const;
+
+	/** \brief Number of lookups that did not */
+	unsigned long getMisses(void) const;
+
+	/** \brief Number of verifications discarded to make room for others */
+	unsigned long getEvictions(void) const;
+
+	/** \brief Number of verifications currently held */
+	unsigned int getSize(void) const;
+
+	//@}
+
+private:
+
+	// Unimplemented
+	XSECVerificationCache(const XSECVerificationCache &);
+	XSECVerificationCache & operator = (const XSECVerificationCache &);
+
+	XSECLRUCache<bool>							m_cache;	// Value unused
+	mutable XERCES_CPP_NAMESPACE_QUALIFIER XMLMutex
+												m_mutex;
+
+};
+
+/*\@}*/
+
+#endif /* XSECVERIFICATIONCACHE_INCLUDE */
@@ -194,6 +194,9 @@
 #       define XSEC_OPENSSL_HAVE_SHA2
 #       define XSEC_OPENSSL_HAVE_MGF1
 #	endif
+#	if (OPENSSL_VERSION_NUMBER >= 0x10000000)
+#		define XSEC_OPENSSL_HAVE_CIPHER_CTX_COPY
+#	endif
 #	if (OPENSSL_VERSION_NUMBER >= 0x10001000)
 #		define XSEC_OPENSSL_HAVE_GCM
 #	endif
@@ -0,0 +1,492 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * provbench := Micro-benchmarks for the crypto provider
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/utils/XSECPlatformUtils.hpp>
+#include <xsec/framework/XSECException.hpp>
+#include <xsec/enc/XSECCryptoException.hpp>
+#include <xsec/enc/XSECCryptoProvider.hpp>
+#include <xsec/enc/XSECCryptoKeyHMAC.hpp>
+#include <xsec/enc/XSECCryptoHash.hpp>
+#include <xsec/enc/XSECCryptoSymmetricKey.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
+
+// General
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#else
+#	include <sys/time.h>
+#endif
+
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLException.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/util/XMLUni.hpp>
+#include <xercesc/util/Janitor.hpp>
+
+XERCES_CPP_NAMESPACE_USE
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::vector;
+
+// --------------------------------------------------------------------------------
+//           Utilities
+// --------------------------------------------------------------------------------
+
+struct BenchOptions {
+
+	unsigned int	m_count;		// Operations per measurement
+	unsigned int	m_size;			// Bytes of input per operation
+
+};
+
+double timeNow(void) {
+
+#if defined(_WIN32)
+	return GetTickCount() / 1000.0;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+
+}
+
+void report(const char * name, unsigned int count, double secs) {
+
+	if (secs <= 0)
+		secs = 0.001;
+
+	cout << name << ": " << count << " in " << secs << "s = "
+		<< (count / secs) << "/s" << endl;
+
+}
+
+void fillInput(vector<unsigned char> & buf, unsigned int size) {
+
+	buf.resize(size > 0 ? size : 1);
+	for (unsigned int i = 0; i < buf.size(); ++i)
+		buf[i] = (unsigned char) (i * 31 + 7);
+
+}
+
+// --------------------------------------------------------------------------------
+//           HMAC
+// --------------------------------------------------------------------------------
+
+// An HMAC key the provider knows nothing about, so every HMAC made with
+// it is keyed from the raw key bytes
+
+class PlainHMACKey : public XSECCryptoKeyHMAC {
+
+public:
+
+	PlainHMACKey() : m_keyLen(0) {m_keyBuf.isSensitive();}
+
+	virtual const XMLCh * getProviderName() const {return XMLUni::fgZeroLenString;}
+
+	virtual XSECCryptoKey * clone() const {
+		PlainHMACKey * ret = new PlainHMACKey();
+		ret->m_keyBuf = m_keyBuf;
+		ret->m_keyLen = m_keyLen;
+		return ret;
+	}
+
+	virtual void setKey(unsigned char * inBuf, unsigned int inLength) {
+		m_keyBuf.sbMemcpyIn(inBuf, inLength);
+		m_keyLen = inLength;
+	}
+
+	virtual unsigned int getKey(safeBuffer & outBuf) const {
+		outBuf = m_keyBuf;
+		return m_keyLen;
+	}
+
+private:
+
+	safeBuffer		m_keyBuf;
+	unsigned int	m_keyLen;
+
+};
+
+double timeHMAC(const XSECCryptoKey * key, const BenchOptions & opts) {
+
+	// As TXFMSHA1 does for each signature - a new HMAC, keyed from a
+	// clone of the signing key
+
+	vector<unsigned char> in;
+	fillInput(in, opts.m_size);
+
+	unsigned char out[XSEC_MAX_HASH_SIZE];
+
+	double start = timeNow();
+
+	for (unsigned int i = 0; i < opts.m_count; ++i) {
+
+		XSECCryptoKey * k = key->clone();
+		Janitor<XSECCryptoKey> j_k(k);
+
+		XSECCryptoHash * h = XSECPlatformUtils::g_cryptoProvider->hashHMACSHA(256);
+		Janitor<XSECCryptoHash> j_h(h);
+
+		h->setKey(k);
+		h->hash(&in[0], (unsigned int) in.size());
+		h->finish(out, XSEC_MAX_HASH_SIZE);
+
+	}
+
+	return timeNow() - start;
+
+}
+
+void benchHMAC(const BenchOptions & opts) {
+
+	unsigned char keyBytes[32];
+	for (int i = 0; i < 32; ++i)
+		keyBytes[i] = (unsigned char) (i + 1);
+
+	PlainHMACKey plain;
+	plain.setKey(keyBytes, 32);
+
+	XSECCryptoKeyHMAC * prov = XSECPlatformUtils::g_cryptoProvider->keyHMAC();
+	Janitor<XSECCryptoKeyHMAC> j_prov(prov);
+	prov->setKey(keyBytes, 32);
+
+	report("hmac-sha256, keyed per message   ", opts.m_count, timeHMAC(&plain, opts));
+	report("hmac-sha256, provider key        ", opts.m_count, timeHMAC(prov, opts));
+
+}
+
+// --------------------------------------------------------------------------------
+//           Batched digests
+// --------------------------------------------------------------------------------
+
+#define BENCH_BATCH_SIZE	32
+
+void benchDigestBatch(const BenchOptions & opts) {
+
+	// Many small inputs (as for References to short elements), each with
+	// its own hash object and then a batch at a time
+
+	vector<unsigned char> in;
+	fillInput(in, opts.m_size);
+
+	unsigned char out[BENCH_BATCH_SIZE * XSEC_MAX_HASH_SIZE];
+
+	const unsigned char * inputs[BENCH_BATCH_SIZE];
+	unsigned int inputLens[BENCH_BATCH_SIZE];
+
+	for (int i = 0; i < BENCH_BATCH_SIZE; ++i) {
+		inputs[i] = &in[0];
+		inputLens[i] = (unsigned int) in.size();
+	}
+
+	double start = timeNow();
+
+	for (unsigned int i = 0; i < opts.m_count; ++i) {
+
+		XSECCryptoHash * h = XSECPlatformUtils::g_cryptoProvider->hashSHA(256);
+		Janitor<XSECCryptoHash> j_h(h);
+
+		h->hash(&in[0], (unsigned int) in.size());
+		h->finish(out, XSEC_MAX_HASH_SIZE);
+
+	}
+
+	report("sha256, hash object per input    ", opts.m_count, timeNow() - start);
+
+	unsigned int done = 0;
+
+	start = timeNow();
+
+	while (done < opts.m_count) {
+
+		unsigned int n = opts.m_count - done;
+		if (n > BENCH_BATCH_SIZE)
+			n = BENCH_BATCH_SIZE;
+
+		XSECPlatformUtils::g_cryptoProvider->hashBatch(XSECCryptoHash::HASH_SHA256,
+			n, inputs, inputLens, out, XSEC_MAX_HASH_SIZE);
+
+		done += n;
+
+	}
+
+	report("sha256, hashBatch                ", opts.m_count, timeNow() - start);
+
+}
+
+// --------------------------------------------------------------------------------
+//           Symmetric encryption
+// --------------------------------------------------------------------------------
+
+double timeAES(const XSECCryptoSymmetricKey * key, const unsigned char * keyBytes,
+			   const BenchOptions & opts) {
+
+	// Encrypt each message with a clone of the key (as the algorithm
+	// handlers do) or, if keyBytes is set, with a key newly set up from
+	// the raw bytes
+
+	vector<unsigned char> in;
+	fillInput(in, opts.m_size);
+
+	vector<unsigned char> out(in.size() + 64);
+
+	double start = timeNow();
+
+	for (unsigned int i = 0; i < opts.m_count; ++i) {
+
+		XSECCryptoSymmetricKey * k;
+
+		if (keyBytes != NULL) {
+			k = XSECPlatformUtils::g_cryptoProvider->keySymmetric(XSECCryptoSymmetricKey::KEY_AES_128);
+			k->setKey(keyBytes, 16);
+		}
+		else
+			k = (XSECCryptoSymmetricKey *) key->clone();
+
+		Janitor<XSECCryptoSymmetricKey> j_k(k);
+
+		k->encryptInit();
+		unsigned int len = k->encrypt(&in[0], &out[0], (unsigned int) in.size(), (unsigned int) out.size());
+		k->encryptFinish(&out[len], (unsigned int) out.size() - len);
+
+	}
+
+	return timeNow() - start;
+
+}
+
+void benchAES(const BenchOptions & opts) {
+
+	unsigned char keyBytes[16];
+	for (int i = 0; i < 16; ++i)
+		keyBytes[i] = (unsigned char) (i + 1);
+
+	XSECCryptoSymmetricKey * key =
+		XSECPlatformUtils::g_cryptoProvider->keySymmetric(XSECCryptoSymmetricKey::KEY_AES_128);
+	Janitor<XSECCryptoSymmetricKey> j_key(key);
+	key->setKey(keyBytes, 16);
+
+	report("aes128-cbc, key set per message  ", opts.m_count, timeAES(NULL, keyBytes, opts));
+	report("aes128-cbc, cloned key           ", opts.m_count, timeAES(key, NULL, opts));
+
+}
+
+// --------------------------------------------------------------------------------
+//           AES key wrap
+// --------------------------------------------------------------------------------
+
+void benchKeyWrap(const BenchOptions & opts) {
+
+	// Unwrap a 256 bit content key, as for each recipient of a message,
+	// through the provider and through the generic implementation
+
+	unsigned char keyBytes[16];
+	unsigned char cek[32];
+	for (int i = 0; i < 16; ++i)
+		keyBytes[i] = (unsigned char) (i + 1);
+	for (int i = 0; i < 32; ++i)
+		cek[i] = (unsigned char) (i * 7);
+
+	const XSECCryptoProvider * prov = XSECPlatformUtils::g_cryptoProvider;
+
+	XSECCryptoSymmetricKey * kek = prov->keySymmetric(XSECCryptoSymmetricKey::KEY_AES_128);
+	Janitor<XSECCryptoSymmetricKey> j_kek(kek);
+	kek->setKey(keyBytes, 16);
+
+	unsigned char wrapped[40];
+	unsigned char out[40];
+	prov->wrapKeyAES(kek, cek, 32, wrapped, 40);
+
+	double start = timeNow();
+
+	for (unsigned int i = 0; i < opts.m_count; ++i)
+		prov->XSECCryptoProvider::unwrapKeyAES(kek, wrapped, 40, out, 40);
+
+	report("aes128 unwrap, block at a time   ", opts.m_count, timeNow() - start);
+
+	start = timeNow();
+
+	for (unsigned int i = 0; i < opts.m_count; ++i)
+		prov->unwrapKeyAES(kek, wrapped, 40, out, 40);
+
+	report("aes128 unwrap, provider          ", opts.m_count, timeNow() - start);
+
+}
+
+// --------------------------------------------------------------------------------
+//           Main
+// --------------------------------------------------------------------------------
+
+struct BenchTest {
+
+	const char		* mp_name;
+	void			(* mp_run)(const BenchOptions & opts);
+
+};
+
+const BenchTest s_tests[] = {
+
+	{"hmac", benchHMAC},
+	{"digest-batch", benchDigestBatch},
+	{"aes", benchAES},
+	{"keywrap", benchKeyWrap},
+	{NULL, NULL}
+
+};
+
+void printUsage(void) {
+
+	cerr << "\nUsage: provbench [options] [<test> ...]\n\n";
+	cerr << "     Where options are :\n\n";
+	cerr << "     --count/-n <count>\n";
+	cerr << "         Operations timed in each measurement (default 100000)\n";
+	cerr << "     --size/-s <bytes>\n";
+	cerr << "         Bytes of input to each operation (default 512)\n\n";
+	cerr << "     And tests are (default is all of them) :\n\n";
+	for (const BenchTest * t = s_tests; t->mp_name != NULL; ++t)
+		cerr << "     " << t->mp_name << "\n";
+	cerr << "\n";
+
+}
+
+int evaluate(int argc, char ** argv) {
+
+	BenchOptions opts;
+	opts.m_count = 100000;
+	opts.m_size = 512;
+
+	int paramCount = 1;
+
+	while (paramCount < argc && argv[paramCount][0] == '-') {
+
+		if ((_stricmp(argv[paramCount], "--count") == 0 || _stricmp(argv[paramCount], "-n") == 0)
+			&& paramCount + 1 < argc) {
+			opts.m_count = (unsigned int) atoi(argv[paramCount + 1]);
+			paramCount += 2;
+		}
+		else if ((_stricmp(argv[paramCount], "--size") == 0 || _stricmp(argv[paramCount], "-s") == 0)
+			&& paramCount + 1 < argc) {
+			opts.m_size = (unsigned int) atoi(argv[paramCount + 1]);
+			paramCount += 2;
+		}
+		else {
+			printUsage();
+			return 2;
+		}
+
+	}
+
+	if (opts.m_count == 0) {
+		printUsage();
+		return 2;
+	}
+
+	// Check the names before running anything
+	int first = paramCount;
+	for (; paramCount < argc; ++paramCount) {
+
+		const BenchTest * t = s_tests;
+		while (t->mp_name != NULL && _stricmp(t->mp_name, argv[paramCount]) != 0)
+			++t;
+
+		if (t->mp_name == NULL) {
+			cerr << "Unknown test " << argv[paramCount] << endl;
+			printUsage();
+			return 2;
+		}
+
+	}
+
+	try {
+
+		for (const BenchTest * t = s_tests; t->mp_name != NULL; ++t) {
+
+			bool run = (first == argc);
+			for (int i = first; !run && i < argc; ++i)
+				run = (_stricmp(t->mp_name, argv[i]) == 0);
+
+			if (run)
+				t->mp_run(opts);
+
+		}
+
+	}
+	catch (XSECException &e) {
+		char * m = XMLString::transcode(e.getMsg());
+		cerr << "An error occurred during benchmarking\n   Message: " << m << endl;
+		XSEC_RELEASE_XMLCH(m);
+		return 2;
+	}
+	catch (XSECCryptoException &e) {
+		cerr << "A crypto error occurred during benchmarking\n   Message: " << e.getMsg() << endl;
+		return 2;
+	}
+
+	return 0;
+
+}
+
+int main(int argc, char **argv) {
+
+	int retResult;
+
+	// Initialise the XML system
+
+	try {
+
+		XMLPlatformUtils::Initialize();
+		XSECPlatformUtils::Initialise();
+
+	}
+	catch (const XMLException &e) {
+
+		cerr << "Error during initialisation of Xerces" << endl;
+		cerr << "Error Message = : "
+		     << e.getMessage() << endl;
+
+	}
+
+	retResult = evaluate(argc, argv);
+
+	XSECPlatformUtils::Terminate();
+	XMLPlatformUtils::Terminate();
+
+	return retResult;
+
+}
@@ -0,0 +1,371 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * sigbench := Measure signature verification throughput, serially and
+ *             using DSIGBatchVerifier
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/utils/XSECPlatformUtils.hpp>
+#include <xsec/framework/XSECProvider.hpp>
+#include <xsec/framework/XSECException.hpp>
+#include <xsec/framework/XSECVerificationCache.hpp>
+#include <xsec/dsig/DSIGSignature.hpp>
+#include <xsec/dsig/DSIGBatchVerifier.hpp>
+#include <xsec/enc/XSECCryptoException.hpp>
+#include <xsec/enc/XSECKeyInfoResolverDefault.hpp>
+#include <xsec/enc/XSECKeyCache.hpp>
+#include <xsec/utils/XSECDOMUtils.hpp>
+#include <xsec/utils/XSECThreadPool.hpp>
+
+// General
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#else
+#	include <sys/time.h>
+#endif
+
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLException.hpp>
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/parsers/XercesDOMParser.hpp>
+
+XERCES_CPP_NAMESPACE_USE
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::string;
+using std::vector;
+
+// --------------------------------------------------------------------------------
+//           Utilities
+// --------------------------------------------------------------------------------
+
+double timeNow(void) {
+
+#if defined(_WIN32)
+	return GetTickCount() / 1000.0;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+
+}
+
+bool readFile(const char * name, string & out) {
+
+	ifstream in(name, std::ios::in | std::ios::binary);
+	if (!in)
+		return false;
+
+	char buf[4096];
+	while (in.read(buf, sizeof(buf)) || in.gcount() > 0)
+		out.append(buf, (size_t) in.gcount());
+
+	return true;
+
+}
+
+void report(const char * name, unsigned int count, unsigned int failures, double secs) {
+
+	if (secs <= 0)
+		secs = 0.001;
+
+	cout << name << ": " << count << " documents in " << secs << "s = "
+		<< (count / secs) << " documents/s";
+	if (failures > 0)
+		cout << " (" << failures << " did not verify)";
+	cout << endl;
+
+}
+
+void printUsage(void) {
+
+	cerr << "\nUsage: sigbench [options] <signed file> [<signed file> ...]\n\n";
+	cerr << "     Where options are :\n\n";
+	cerr << "     --threads/-t <count>\n";
+	cerr << "         Number of worker threads (default is one per CPU)\n";
+	cerr << "     --count/-n <count>\n";
+	cerr << "         Number of documents verified in each run (default 1000)\n";
+	cerr << "     --cache/-c\n";
+	cerr << "         Share a verification cache between batch jobs\n";
+	cerr << "     --key-cache/-k\n";
+	cerr << "         Re-use keys resolved from KeyInfo.  Shareable keys are then\n";
+	cerr << "         used by every thread at once rather than rebuilt per document\n";
+	cerr << "     --batch-only/-b\n";
+	cerr << "         Skip the serial run\n\n";
+	cerr << "     Keys are found from each signature's KeyInfo.  The files are\n";
+	cerr << "     verified in turn until <count> documents have been checked.\n\n";
+
+}
+
+// --------------------------------------------------------------------------------
+//           Runs
+// --------------------------------------------------------------------------------
+
+// Today's approach - parse, load and verify each document in turn
+
+unsigned int runSerial(const vector<string> & docs, unsigned int count,
+					   XSECKeyCache * keyCache) {
+
+	unsigned int failures = 0;
+	XSECKeyInfoResolverDefault resolver;
+	resolver.setKeyCache(keyCache);
+
+	for (unsigned int i = 0; i < count; ++i) {
+
+		const string & d = docs[i % docs.size()];
+
+		XercesDOMParser parser;
+		parser.setDoNamespaces(true);
+		parser.setCreateEntityReferenceNodes(true);
+
+		MemBufInputSource src((const XMLByte *) d.data(), (unsigned int) d.size(), "sigbench");
+		parser.parse(src);
+
+		DOMDocument * doc = parser.getDocument();
+		DOMNode * sigNode = (parser.getErrorCount() == 0 ? findDSIGNode(doc, "Signature") : NULL);
+
+		if (sigNode == NULL) {
+			++failures;
+			continue;
+		}
+
+		try {
+
+			XSECProvider prov;
+			DSIGSignature * sig = prov.newSignatureFromDOM(doc, sigNode);
+			sig->setKeyInfoResolver(&resolver);
+			sig->load();
+			if (!sig->verify())
+				++failures;
+
+		}
+		catch (XSECException &) {
+			++failures;
+		}
+		catch (XSECCryptoException &) {
+			++failures;
+		}
+
+	}
+
+	return failures;
+
+}
+
+// The same documents through a DSIGBatchVerifier, keeping a bounded
+// number of jobs in flight
+
+unsigned int runBatch(const vector<string> & docs, unsigned int count,
+					  unsigned int threads, XSECVerificationCache * cache,
+					  XSECKeyCache * keyCache) {
+
+	unsigned int failures = 0;
+	XSECKeyInfoResolverDefault resolver;
+	resolver.setKeyCache(keyCache);
+
+	DSIGBatchVerifier verifier(threads);
+	verifier.setVerificationCache(cache);
+
+	unsigned int window = verifier.getThreadCount() * 4;
+	if (window == 0)
+		window = 1;
+
+	vector<DSIGBatchVerifier::Job *> inFlight;
+	unsigned int next = 0;
+
+	for (unsigned int i = 0; i < count; ++i) {
+
+		const string & d = docs[i % docs.size()];
+
+		inFlight.push_back(verifier.submit((const XMLByte *) d.data(),
+			(unsigned int) d.size(), &resolver));
+
+		if (inFlight.size() - next >= window) {
+			if (verifier.wait(inFlight[next]) != DSIGBatchVerifier::BATCH_VALID)
+				++failures;
+			verifier.releaseJob(inFlight[next++]);
+		}
+
+	}
+
+	for (; next < inFlight.size(); ++next) {
+		if (verifier.wait(inFlight[next]) != DSIGBatchVerifier::BATCH_VALID)
+			++failures;
+		verifier.releaseJob(inFlight[next]);
+	}
+
+	return failures;
+
+}
+
+int evaluate(int argc, char ** argv) {
+
+	unsigned int threads = 0;
+	unsigned int count = 1000;
+	bool useCache = false;
+	bool useKeyCache = false;
+	bool batchOnly = false;
+
+	int paramCount = 1;
+
+	while (paramCount < argc && argv[paramCount][0] == '-') {
+
+		if ((_stricmp(argv[paramCount], "--threads") == 0 || _stricmp(argv[paramCount], "-t") == 0)
+			&& paramCount + 1 < argc) {
+			threads = (unsigned int) atoi(argv[paramCount + 1]);
+			paramCount += 2;
+		}
+		else if ((_stricmp(argv[paramCount], "--count") == 0 || _stricmp(argv[paramCount], "-n") == 0)
+			&& paramCount + 1 < argc) {
+			count = (unsigned int) atoi(argv[paramCount + 1]);
+			paramCount += 2;
+		}
+		else if (_stricmp(argv[paramCount], "--cache") == 0 || _stricmp(argv[paramCount], "-c") == 0) {
+			useCache = true;
+			paramCount++;
+		}
+		else if (_stricmp(argv[paramCount], "--key-cache") == 0 || _stricmp(argv[paramCount], "-k") == 0) {
+			useKeyCache = true;
+			paramCount++;
+		}
+		else if (_stricmp(argv[paramCount], "--batch-only") == 0 || _stricmp(argv[paramCount], "-b") == 0) {
+			batchOnly = true;
+			paramCount++;
+		}
+		else {
+			printUsage();
+			return 2;
+		}
+
+	}
+
+	if (paramCount >= argc || count == 0) {
+		printUsage();
+		return 2;
+	}
+
+	vector<string> docs;
+	for (; paramCount < argc; ++paramCount) {
+
+		string d;
+		if (!readFile(argv[paramCount], d)) {
+			cerr << "Unable to read " << argv[paramCount] << endl;
+			return 2;
+		}
+		docs.push_back(d);
+
+	}
+
+	if (threads == 0)
+		threads = XSECThreadPool::getDefaultThreadCount();
+
+	cout << "Verifying " << count << " documents from " << docs.size()
+		<< " file(s) using " << threads << " thread(s)" << endl;
+
+	unsigned int failures;
+	double start;
+
+	try {
+
+		XSECKeyCache keyCache;
+
+		if (!batchOnly) {
+			start = timeNow();
+			failures = runSerial(docs, count, useKeyCache ? &keyCache : NULL);
+			report("serial", count, failures, timeNow() - start);
+		}
+
+		XSECVerificationCache cache;
+
+		// Each run starts with no keys
+		keyCache.clear();
+
+		start = timeNow();
+		failures = runBatch(docs, count, threads, useCache ? &cache : NULL,
+			useKeyCache ? &keyCache : NULL);
+		report("batch ", count, failures, timeNow() - start);
+
+		if (useKeyCache)
+			cout << "key cache: " << keyCache.getHits() << " hits, "
+				<< keyCache.getMisses() << " misses" << endl;
+
+		if (useCache)
+			cout << "verification cache: " << cache.getHits() << " hits, "
+				<< cache.getMisses() << " misses" << endl;
+
+	}
+	catch (XSECException &e) {
+		char * m = XMLString::transcode(e.getMsg());
+		cerr << "An error occurred during benchmarking\n   Message: " << m << endl;
+		XSEC_RELEASE_XMLCH(m);
+		return 2;
+	}
+
+	return 0;
+
+}
+
+int main(int argc, char **argv) {
+
+	int retResult;
+
+	// Initialise the XML system
+
+	try {
+
+		XMLPlatformUtils::Initialize();
+		XSECPlatformUtils::Initialise();
+
+	}
+	catch (const XMLException &e) {
+
+		cerr << "Error during initialisation of Xerces" << endl;
+		cerr << "Error Message = : "
+		     << e.getMessage() << endl;
+
+	}
+
+	retResult = evaluate(argc, argv);
+
+	XSECPlatformUtils::Terminate();
+	XMLPlatformUtils::Terminate();
+
+	return retResult;
+
+}
@@ -76,9 +76,17 @@ XALAN_USING_XALAN(XalanTransformer)
 #include <xsec/dsig/DSIGReference.hpp>
 #include <xsec/framework/XSECError.hpp>
 #include <xsec/dsig/DSIGSignature.hpp>
+#include <xsec/dsig/DSIGBatchVerifier.hpp>
+#include <xsec/dsig/DSIGSigningTemplate.hpp>
 #include <xsec/utils/XSECNameSpaceExpander.hpp>
 #include <xsec/utils/XSECDOMUtils.hpp>
 #include <xsec/utils/XSECBinTXFMInputStream.hpp>
+#include <xsec/utils/XSECIdIndex.hpp>
+#include <xsec/framework/XSECEnv.hpp>
+#include <xsec/framework/XSECDocumentContext.hpp>
+#include <xsec/framework/XSECDigestCache.hpp>
+#include <xsec/framework/XSECVerificationCache.hpp>
+#include <xsec/enc/XSECKeyCache.hpp>
 #include <xsec/enc/XSECCryptoException.hpp>
 #include <xsec/dsig/DSIGKeyInfoX509.hpp>
 #include <xsec/dsig/DSIGKeyInfoName.hpp>
@@ -104,6 +112,16 @@ XALAN_USING_XALAN(XalanTransformer)
 #	include <xsec/enc/WinCAPI/WinCAPICryptoKeyRSA.hpp>
 #	include <xsec/enc/WinCAPI/WinCAPICryptoProvider.hpp>
 #endif
+#if !defined(_WIN32)
+#	include <xsec/utils/unixutils/XSECBinHTTPURIInputStream.hpp>
+#	include <xsec/utils/unixutils/XSECHTTPConnectionPool.hpp>
+#	include <xercesc/util/XMLUri.hpp>
+#	include <sys/socket.h>
+#	include <netinet/in.h>
+#	include <arpa/inet.h>
+#	include <pthread.h>
+#	include <unistd.h>
+#endif
 #if defined (XSEC_HAVE_NSS)
 #	include <xsec/enc/NSS/NSSCryptoKeyHMAC.hpp>
 #	include <xsec/enc/NSS/NSSCryptoKeyRSA.hpp>
@@ -474,52 +492,63 @@ void outputDoc(DOMImplementation * impl, DOMDocument * doc) {
 //           Unit test helper functions
 // --------------------------------------------------------------------------------
 
-bool reValidateSig(DOMImplementation *impl, DOMDocument * inDoc, XSECCryptoKey *k) {
-
-	// Take a signature in DOM, serialise and re-validate
+char * serialiseDocument(DOMImplementation *impl, DOMDocument * inDoc, xsecsize_t & len) {
 
-	try {
+	// Serialise to a new[] buffer of UTF-8
 
-		MemBufFormatTarget *formatTarget = new MemBufFormatTarget();
+	MemBufFormatTarget *formatTarget = new MemBufFormatTarget();
 #if defined (XSEC_XERCES_DOMLSSERIALIZER)
 
-        // DOM L3 version as per Xerces 3.0 API
-        DOMLSSerializer   *theSerializer = ((DOMImplementationLS*)impl)->createLSSerializer();
+	// DOM L3 version as per Xerces 3.0 API
+	DOMLSSerializer   *theSerializer = ((DOMImplementationLS*)impl)->createLSSerializer();
 
-        // Get the config so we can set up pretty printing
-        DOMConfiguration *dc = theSerializer->getDomConfig();
-        dc->setParameter(XMLUni::fgDOMWRTFormatPrettyPrint, false);
-        
-        // Now create an output object to format to UTF-8
-        DOMLSOutput *theOutput = ((DOMImplementationLS*)impl)->createLSOutput();
-        Janitor<DOMLSOutput> j_theOutput(theOutput);
-        
-        theOutput->setEncoding(MAKE_UNICODE_STRING("UTF-8"));
-        theOutput->setByteStream(formatTarget);
+	// Get the config so we can set up pretty printing
+	DOMConfiguration *dc = theSerializer->getDomConfig();
+	dc->setParameter(XMLUni::fgDOMWRTFormatPrettyPrint, false);
+
+	// Now create an output object to format to UTF-8
+	DOMLSOutput *theOutput = ((DOMImplementationLS*)impl)->createLSOutput();
+	Janitor<DOMLSOutput> j_theOutput(theOutput);
+
+	theOutput->setEncoding(MAKE_UNICODE_STRING("UTF-8"));
+	theOutput->setByteStream(formatTarget);
 
-        theSerializer->write(inDoc,theOutput);
+	theSerializer->write(inDoc,theOutput);
 #else
 
-		DOMWriter *theSerializer = ((DOMImplementationLS*)impl)->createDOMWriter();
+	DOMWriter *theSerializer = ((DOMImplementationLS*)impl)->createDOMWriter();
 
-		theSerializer->setEncoding(MAKE_UNICODE_STRING("UTF-8"));
+	theSerializer->setEncoding(MAKE_UNICODE_STRING("UTF-8"));
 
-		if (theSerializer->canSetFeature(XMLUni::fgDOMWRTFormatPrettyPrint, false))
-			theSerializer->setFeature(XMLUni::fgDOMWRTFormatPrettyPrint, false);
+	if (theSerializer->canSetFeature(XMLUni::fgDOMWRTFormatPrettyPrint, false))
+		theSerializer->setFeature(XMLUni::fgDOMWRTFormatPrettyPrint, false);
 
 
-		theSerializer->writeNode(formatTarget, *inDoc);
+	theSerializer->writeNode(formatTarget, *inDoc);
 
 #endif
 
-		// Copy to a new buffer
-		xsecsize_t len = formatTarget->getLen();
-		char * mbuf = new char [len + 1];
-		memcpy(mbuf, formatTarget->getRawBuffer(), len);
-		mbuf[len] = '\0';
+	// Copy to a new buffer
+	len = formatTarget->getLen();
+	char * mbuf = new char [len + 1];
+	memcpy(mbuf, formatTarget->getRawBuffer(), len);
+	mbuf[len] = '\0';
 
-		delete theSerializer;
-		delete formatTarget;
+	delete theSerializer;
+	delete formatTarget;
+
+	return mbuf;
+
+}
+
+bool reValidateSig(DOMImplementation *impl, DOMDocument * inDoc, XSECCryptoKey *k) {
+
+	// Take a signature in DOM, serialise and re-validate
+
+	try {
+
+		xsecsize_t len;
+		char * mbuf = serialiseDocument(impl, inDoc, len);
 
 		/*
 		 * Re-parse
@@ -1171,11 +1200,1221 @@ void unitTestRSA(DOMImplementation * impl) {
 	else
 		cerr << "Skipping non SHA 224/256/384/512 RSA signatures" << endl;
 
-	cerr << "Unit testing RSA-MD5 signature ... ";
-	unitTestRSASig(impl, rsaKey, DSIGConstants::s_unicodeStrURIRSA_MD5);
-	
-		
+	cerr << "Unit testing RSA-MD5 signature ... ";
+	unitTestRSASig(impl, rsaKey, DSIGConstants::s_unicodeStrURIRSA_MD5);
+	
+		
+}
+// --------------------------------------------------------------------------------
+//           Id index
+// --------------------------------------------------------------------------------
+
+DOMElement * idIndexLookup(DOMDocument * doc, const char * id, const XSECEnv * env) {
+
+	XMLCh * idX = XMLString::transcode(id);
+	DOMElement * ret;
+
+	try {
+		ret = XSECIdIndex::findElementById(doc, idX, env);
+	}
+	catch (...) {
+		XSEC_RELEASE_XMLCH(idX);
+		throw;
+	}
+
+	XSEC_RELEASE_XMLCH(idX);
+	return ret;
+
+}
+
+void unitTestIdIndex(DOMImplementation * impl, bool useContext) {
+
+	if (useContext)
+		cerr << "Finding elements by Id via a document context ... ";
+	else
+		cerr << "Finding elements by Id ... ";
+
+	DOMDocument * doc = impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL);
+	DOMElement * root = doc->getDocumentElement();
+
+	DOMElement * a = doc->createElementNS(NULL, MAKE_UNICODE_STRING("A"));
+	DOMElement * b = doc->createElementNS(NULL, MAKE_UNICODE_STRING("B"));
+	DOMElement * c = doc->createElementNS(NULL, MAKE_UNICODE_STRING("C"));
+	a->setAttributeNS(NULL, MAKE_UNICODE_STRING("Id"), MAKE_UNICODE_STRING("one"));
+	b->setAttributeNS(NULL, MAKE_UNICODE_STRING("Id"), MAKE_UNICODE_STRING("two"));
+	c->setAttributeNS(NULL, MAKE_UNICODE_STRING("Ref"), MAKE_UNICODE_STRING("three"));
+	root->appendChild(a);
+	root->appendChild(b);
+	root->appendChild(c);
+
+	XSECEnv env(doc);
+	XSECDocumentContext ctx(doc);
+	if (useContext)
+		env.setDocumentContext(&ctx);
+
+	try {
+
+		if (idIndexLookup(doc, "one", &env) != a || idIndexLookup(doc, "two", &env) != b ||
+			idIndexLookup(doc, "three", &env) != NULL) {
+			cerr << "bad lookup" << endl;
+			exit(1);
+		}
+
+		// Moved elements are still found, removed ones are not
+		c->appendChild(root->removeChild(a));
+		if (idIndexLookup(doc, "one", &env) != a) {
+			cerr << "moved element not found" << endl;
+			exit(1);
+		}
+
+		DOMNode * removed = c->removeChild(a);
+		if (idIndexLookup(doc, "one", &env) != NULL) {
+			cerr << "removed element found" << endl;
+			exit(1);
+		}
+		root->appendChild(removed);
+
+		// Changed Id values
+		b->setAttributeNS(NULL, MAKE_UNICODE_STRING("Id"), MAKE_UNICODE_STRING("four"));
+		if (idIndexLookup(doc, "two", &env) != NULL || idIndexLookup(doc, "four", &env) != b) {
+			cerr << "changed Id not seen" << endl;
+			exit(1);
+		}
+
+		// Changed Id attribute names
+		env.registerIdAttributeName(MAKE_UNICODE_STRING("Ref"));
+		if (idIndexLookup(doc, "three", &env) != c) {
+			cerr << "added Id attribute name not used" << endl;
+			exit(1);
+		}
+
+		env.deregisterIdAttributeName(MAKE_UNICODE_STRING("Ref"));
+		if (idIndexLookup(doc, "three", &env) != NULL) {
+			cerr << "removed Id attribute name still used" << endl;
+			exit(1);
+		}
+
+	}
+	catch (XSECException &e)
+	{
+		cerr << "An error occured during Id lookup\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	// A duplicate Id is never resolved to either element
+	c->setAttributeNS(NULL, MAKE_UNICODE_STRING("Id"), MAKE_UNICODE_STRING("one"));
+	if (useContext)
+		ctx.reset();
+	else
+		env.invalidateIdIndex();
+
+	bool thrown = false;
+	try {
+		idIndexLookup(doc, "one", &env);
+	}
+	catch (XSECException &e) {
+		thrown = (e.getType() == XSECException::IDNotFoundInDOMDoc);
+	}
+
+	if (!thrown) {
+		cerr << "duplicate Id not detected" << endl;
+		exit(1);
+	}
+
+	env.setDocumentContext(NULL);
+	doc->release();
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestIncrementalSigning(DOMImplementation * impl) {
+
+	// Changes that are not reported must not be picked up, unless they
+	// alter the Reference itself
+
+	cerr << "Incremental re-signing ... ";
+
+	try {
+
+		DOMDocument * doc = impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL);
+		DOMElement * root = doc->getDocumentElement();
+
+		// Only output by exclusive c14n when listed as inclusive
+		root->setAttributeNS(DSIGConstants::s_unicodeStrURIXMLNS,
+			MAKE_UNICODE_STRING("xmlns:foo"), MAKE_UNICODE_STRING("urn:foo"));
+
+		DOMElement * data = doc->createElementNS(NULL, MAKE_UNICODE_STRING("Data"));
+		data->setAttributeNS(NULL, MAKE_UNICODE_STRING("Id"), MAKE_UNICODE_STRING("data"));
+		DOMText * txt = doc->createTextNode(MAKE_UNICODE_STRING("A test string"));
+		data->appendChild(txt);
+		root->appendChild(data);
+
+		XSECProvider prov;
+		DSIGSignature * sig = prov.newSignature();
+		DOMElement * sigNode = sig->createBlankSignature(doc,
+			DSIGConstants::s_unicodeStrURIC14N_COM,
+			DSIGConstants::s_unicodeStrURIHMAC_SHA1);
+		root->appendChild(sigNode);
+
+		DSIGReference * ref = sig->createReference(MAKE_UNICODE_STRING("#data"),
+			DSIGConstants::s_unicodeStrURISHA1);
+		DSIGTransformC14n * c14n = ref->appendCanonicalizationTransform(CANON_C14NE_NOC);
+
+		sig->setIncrementalSigning(true);
+		sig->setSigningKey(createHMACKey((unsigned char *) "secret"));
+		sig->sign();
+
+		if (!sig->verify()) {
+			cerr << "bad verify!" << endl;
+			exit(1);
+		}
+
+		// Unreported change - the Reference is not re-hashed, so the
+		// stale DigestValue fails
+		txt->setNodeValue(MAKE_UNICODE_STRING("A bad string"));
+		sig->sign();
+
+		if (sig->verify()) {
+			cerr << "unchanged Reference was re-hashed" << endl;
+			exit(1);
+		}
+
+		// Reported, it is
+		sig->noteChanged(txt);
+		sig->sign();
+
+		if (!sig->verify()) {
+			cerr << "reported change was not re-hashed" << endl;
+			exit(1);
+		}
+
+		// Changing a transform's parameters changes the input
+		c14n->addInclusiveNamespace("foo");
+		sig->sign();
+
+		if (!sig->verify()) {
+			cerr << "changed InclusiveNamespaces was not re-hashed" << endl;
+			exit(1);
+		}
+
+		// As does adding a transform
+		ref->appendCanonicalizationTransform(CANON_C14N_NOC);
+		txt->setNodeValue(MAKE_UNICODE_STRING("A test string"));
+		sig->sign();
+
+		if (!sig->verify()) {
+			cerr << "added transform was not re-hashed" << endl;
+			exit(1);
+		}
+
+		prov.releaseSignature(sig);
+		doc->release();
+
+	}
+
+	catch (XSECException &e)
+	{
+		cerr << "An error occured during signature processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	cerr << "OK" << endl;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Same document digests
+// --------------------------------------------------------------------------------
+
+// Ids that only differ outside ASCII (e acute and e grave)
+
+static const XMLCh s_tstIdEAcute[] = {chLatin_d, 0x00E9, chDigit_1, chNull};
+static const XMLCh s_tstIdEGrave[] = {chLatin_d, 0x00E8, chDigit_1, chNull};
+static const XMLCh s_tstURIEAcute[] = {chPound, chLatin_d, 0x00E9, chDigit_1, chNull};
+static const XMLCh s_tstURIEGrave[] = {chPound, chLatin_d, 0x00E8, chDigit_1, chNull};
+
+DOMText * appendIdElement(DOMDocument * doc, const XMLCh * id, const char * text) {
+
+	DOMElement * data = doc->createElementNS(NULL, MAKE_UNICODE_STRING("Data"));
+	data->setAttributeNS(NULL, MAKE_UNICODE_STRING("Id"), id);
+	DOMText * txt = doc->createTextNode(MAKE_UNICODE_STRING(text));
+	data->appendChild(txt);
+	doc->getDocumentElement()->appendChild(data);
+
+	return txt;
+
+}
+
+DSIGSignature * createHMACSignature(XSECProvider & prov, DOMDocument * doc) {
+
+	// A signature at the end of the document, without References
+
+	DSIGSignature * sig = prov.newSignature();
+	DOMElement * sigNode = sig->createBlankSignature(doc,
+		DSIGConstants::s_unicodeStrURIC14N_COM,
+		DSIGConstants::s_unicodeStrURIHMAC_SHA1);
+	doc->getDocumentElement()->appendChild(sigNode);
+	sig->setSigningKey(createHMACKey((unsigned char *) "secret"));
+
+	return sig;
+
+}
+
+void unitTestDocumentContextIds(DOMImplementation * impl) {
+
+	// A digest one signature leaves in the document context must only be
+	// used for the same input - not for an Id that merely looks the same
+	// in the local code page
+
+	cerr << "Shared digests for Ids that differ outside ASCII ... ";
+
+	try {
+
+		DOMDocument * doc = impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL);
+		appendIdElement(doc, s_tstIdEAcute, "Chosen by another signer");
+		DOMText * txt = appendIdElement(doc, s_tstIdEGrave, "A test string");
+
+		XSECProvider prov;
+
+		DSIGSignature * other = createHMACSignature(prov, doc);
+		other->createReference(s_tstURIEAcute, DSIGConstants::s_unicodeStrURISHA1);
+		other->sign();
+
+		DSIGSignature * sig = createHMACSignature(prov, doc);
+		sig->createReference(s_tstURIEGrave, DSIGConstants::s_unicodeStrURISHA1);
+		sig->sign();
+
+		XSECDocumentContext ctx(doc);
+		other->setDocumentContext(&ctx);
+		sig->setDocumentContext(&ctx);
+
+		if (!other->verify() || !sig->verify()) {
+			cerr << "digest of the other Id was used" << endl;
+			exit(1);
+		}
+
+		txt->setNodeValue(MAKE_UNICODE_STRING("A bad string"));
+		ctx.reset();
+
+		if (!other->verify() || sig->verify()) {
+			cerr << "changed content verified" << endl;
+			exit(1);
+		}
+
+		other->setDocumentContext(NULL);
+		sig->setDocumentContext(NULL);
+		prov.releaseSignature(other);
+		prov.releaseSignature(sig);
+		doc->release();
+
+	}
+
+	catch (XSECException &e)
+	{
+		cerr << "An error occured during signature processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	cerr << "OK" << endl;
+
+}
+
+void createReferenceTestDoc(DOMImplementation * impl, XSECProvider & prov,
+							DOMDocument * & doc, DSIGSignature * & sig,
+							DOMText * & tamper) {
+
+	// Same input under several digests, Ids that only differ outside
+	// ASCII, small inputs and one too big to be held for a batch
+
+	doc = impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL);
+
+	appendIdElement(doc, MAKE_UNICODE_STRING("a"), "Digested more than once");
+	appendIdElement(doc, s_tstIdEAcute, "One string");
+	tamper = appendIdElement(doc, s_tstIdEGrave, "Another string");
+	appendIdElement(doc, MAKE_UNICODE_STRING("b"), "A small string");
+
+	char large[8193];
+	memset(large, 'x', 8192);
+	large[8192] = '\0';
+	appendIdElement(doc, MAKE_UNICODE_STRING("c"), large);
+
+	sig = createHMACSignature(prov, doc);
+	sig->createReference(MAKE_UNICODE_STRING("#a"), DSIGConstants::s_unicodeStrURISHA1);
+	if (XSECPlatformUtils::g_cryptoProvider->algorithmSupported(XSECCryptoHash::HASH_SHA256))
+		sig->createReference(MAKE_UNICODE_STRING("#a"), DSIGConstants::s_unicodeStrURISHA256);
+	sig->createReference(MAKE_UNICODE_STRING("#a"), DSIGConstants::s_unicodeStrURISHA1);
+	sig->createReference(s_tstURIEAcute, DSIGConstants::s_unicodeStrURISHA1);
+	sig->createReference(s_tstURIEGrave, DSIGConstants::s_unicodeStrURISHA1);
+	sig->createReference(MAKE_UNICODE_STRING("#b"), DSIGConstants::s_unicodeStrURISHA1);
+	sig->createReference(MAKE_UNICODE_STRING("#c"), DSIGConstants::s_unicodeStrURISHA1);
+
+	sig->sign();
+
+}
+
+void compareWithSerial(DSIGSignature * sig, const char * what) {
+
+	// verify() digests the References together.  Checked one at a time,
+	// each is digested on its own - the results must be the same.
+
+	DSIGReferenceList * refs = sig->getReferenceList();
+	int size = (int) refs->getSize();
+
+	safeBuffer expected;
+	expected.sbXMLChIn(DSIGConstants::s_unicodeStrEmpty);
+	bool expectedResult = true;
+
+	for (int i = 0; i < size; ++i) {
+
+		DSIGReference * r = refs->item(i);
+		if (!r->checkHash()) {
+
+			expected.sbXMLChCat("Reference URI=\"");
+			expected.sbXMLChCat(r->getURI());
+			expected.sbXMLChCat("\" failed to verify\n");
+
+			expectedResult = false;
+
+		}
+
+	}
+
+	if (sig->verify() != expectedResult ||
+		!strEquals(sig->getErrMsgs(), expected.rawXMLChBuffer())) {
+
+		cerr << what << " - batch and serial results differ" << endl;
+		exit(1);
+
+	}
+
+}
+
+void unitTestReferenceBatch(DOMImplementation * impl) {
+
+	cerr << "Digesting References together ... ";
+
+	try {
+
+		XSECProvider prov;
+		DOMDocument * doc;
+		DSIGSignature * sig;
+		DOMText * tamper;
+
+		createReferenceTestDoc(impl, prov, doc, sig, tamper);
+
+		compareWithSerial(sig, "signed");
+		if (!sig->verify()) {
+			cerr << "bad verify!" << endl;
+			exit(1);
+		}
+
+		tamper->setNodeValue(MAKE_UNICODE_STRING("A bad string"));
+
+		compareWithSerial(sig, "tampered");
+		if (sig->verify()) {
+			cerr << "tampered Reference verified" << endl;
+			exit(1);
+		}
+
+		prov.releaseSignature(sig);
+		doc->release();
+
+	}
+
+	catch (XSECException &e)
+	{
+		cerr << "An error occured during signature processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	cerr << "OK" << endl;
+
+}
+
+void compareWithParallel(DSIGSignature * sig, const char * what) {
+
+	sig->setParallelReferenceVerification(false);
+	bool serial = sig->verify();
+	safeBuffer serialErrs;
+	serialErrs.sbXMLChIn(sig->getErrMsgs());
+
+	sig->setParallelReferenceVerification(true);
+	bool parallel = sig->verify();
+
+	sig->setParallelReferenceVerification(false);
+
+	if (serial != parallel || !strEquals(sig->getErrMsgs(), serialErrs.rawXMLChBuffer())) {
+
+		cerr << what << " - parallel and serial results differ" << endl;
+		exit(1);
+
+	}
+
+}
+
+void unitTestParallelReferences(DOMImplementation * impl) {
+
+	cerr << "Verifying References in parallel ... ";
+
+	try {
+
+		XSECProvider prov;
+		DOMDocument * doc;
+		DSIGSignature * sig;
+		DOMText * tamper;
+
+		createReferenceTestDoc(impl, prov, doc, sig, tamper);
+
+		compareWithParallel(sig, "signed");
+
+		tamper->setNodeValue(MAKE_UNICODE_STRING("A bad string"));
+
+		compareWithParallel(sig, "tampered");
+		if (sig->verify()) {
+			cerr << "tampered Reference verified" << endl;
+			exit(1);
+		}
+
+		prov.releaseSignature(sig);
+		doc->release();
+
+	}
+
+	catch (XSECException &e)
+	{
+		cerr << "An error occured during signature processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestSigningTemplate(DOMImplementation * impl) {
+
+	cerr << "Signing documents from a template ... ";
+
+	try {
+
+		XSECProvider prov;
+
+		// The template is made in a scratch document
+
+		DOMDocument * scratch = impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL);
+		DSIGSignature * tsig = prov.newSignature();
+		DOMElement * tsigNode = tsig->createBlankSignature(scratch,
+			DSIGConstants::s_unicodeStrURIC14N_COM,
+			DSIGConstants::s_unicodeStrURIHMAC_SHA1);
+		scratch->getDocumentElement()->appendChild(tsigNode);
+		tsig->createReference(MAKE_UNICODE_STRING("#data"), DSIGConstants::s_unicodeStrURISHA1);
+		tsig->createReference(MAKE_UNICODE_STRING("#other"), DSIGConstants::s_unicodeStrURISHA1);
+
+		DSIGSigningTemplate tmpl(tsigNode);
+
+		prov.releaseSignature(tsig);
+		scratch->release();
+
+		if (tmpl.getReferenceCount() != 2) {
+			cerr << "wrong Reference count" << endl;
+			exit(1);
+		}
+
+		XSECCryptoKeyHMAC * key = createHMACKey((unsigned char *) "secret");
+		Janitor<XSECCryptoKeyHMAC> j_key(key);
+
+		// Only the first Reference is re-pointed
+		XMLCh * swapped = XMLString::transcode("#other");
+		const XMLCh * uris[] = {swapped, NULL};
+
+		for (int i = 0; i < 4; ++i) {
+
+			bool useURIs = (i % 2 == 1);
+
+			DOMDocument * doc = impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL);
+			DOMText * txt = appendIdElement(doc, MAKE_UNICODE_STRING("data"),
+				(i < 2 ? "A test string" : "Another test string"));
+			appendIdElement(doc, MAKE_UNICODE_STRING("other"), "A different string");
+
+			DOMElement * sigNode = tmpl.stamp(doc, doc->getDocumentElement(), key,
+				useURIs ? uris : NULL);
+
+			DSIGSignature * sig = prov.newSignatureFromDOM(doc, sigNode);
+			sig->load();
+			sig->setSigningKey(key->clone());
+
+			if (!strEquals(sig->getReferenceList()->item(0)->getURI(),
+					useURIs ? "#other" : "#data") ||
+				!strEquals(sig->getReferenceList()->item(1)->getURI(), "#other")) {
+				cerr << "wrong Reference URI" << endl;
+				exit(1);
+			}
+
+			if (!sig->verify()) {
+				cerr << "stamp " << i << " failed to verify" << endl;
+				exit(1);
+			}
+
+			// Only a covered change breaks the signature
+			txt->setNodeValue(MAKE_UNICODE_STRING("A bad string"));
+			if (sig->verify() == !useURIs) {
+				cerr << "stamp " << i << " covered the wrong content" << endl;
+				exit(1);
+			}
+
+			prov.releaseSignature(sig);
+			doc->release();
+
+		}
+
+		XSEC_RELEASE_XMLCH(swapped);
+
+	}
+
+	catch (XSECException &e)
+	{
+		cerr << "An error occured during signature processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	cerr << "OK" << endl;
+
+}
+
+DOMDocument * createSignedTestDoc(DOMImplementation * impl, XSECProvider & prov, bool tamper) {
+
+	DOMDocument * doc = impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL);
+	DOMText * txt = appendIdElement(doc, MAKE_UNICODE_STRING("data"), "A test string");
+
+	DSIGSignature * sig = createHMACSignature(prov, doc);
+	sig->createReference(MAKE_UNICODE_STRING("#data"), DSIGConstants::s_unicodeStrURISHA1);
+	sig->sign();
+	prov.releaseSignature(sig);
+
+	if (tamper)
+		txt->setNodeValue(MAKE_UNICODE_STRING("A bad string"));
+
+	return doc;
+
+}
+
+void unitTestBatchVerifier(DOMImplementation * impl) {
+
+	cerr << "Verifying a batch of documents ... ";
+
+	// Valid, tampered and unusable documents - as bytes, then as DOMs
+
+	const DSIGBatchVerifier::BatchResult expected[] = {
+		DSIGBatchVerifier::BATCH_VALID,
+		DSIGBatchVerifier::BATCH_INVALID,
+		DSIGBatchVerifier::BATCH_ERROR,
+		DSIGBatchVerifier::BATCH_VALID,
+		DSIGBatchVerifier::BATCH_INVALID,
+		DSIGBatchVerifier::BATCH_ERROR
+	};
+	const int kinds = 6, rounds = 4, count = kinds * rounds;
+
+	try {
+
+		XSECProvider prov;
+
+		// Jobs may change the DOM (while canonicalising), so each DOM job
+		// gets a document of its own
+
+		std::vector<DOMDocument *> docs;
+		DOMDocument * doc;
+
+		doc = createSignedTestDoc(impl, prov, false);
+		xsecsize_t validLen, tamperedLen;
+		char * validBytes = serialiseDocument(impl, doc, validLen);
+		ArrayJanitor<char> j_validBytes(validBytes);
+		doc->release();
+
+		doc = createSignedTestDoc(impl, prov, true);
+		char * tamperedBytes = serialiseDocument(impl, doc, tamperedLen);
+		ArrayJanitor<char> j_tamperedBytes(tamperedBytes);
+		doc->release();
+		const char * brokenBytes = "<Root><Data>Not closed</Root>";
+
+		XSECCryptoKeyHMAC * key = createHMACKey((unsigned char *) "secret");
+		Janitor<XSECCryptoKeyHMAC> j_key(key);
+
+		std::vector<DSIGBatchVerifier::Job *> jobs;
+		int index[count];
+
+		{
+
+			DSIGBatchVerifier verifier(2);
+
+			for (int i = 0; i < count; ++i) {
+
+				index[i] = i;
+				DSIGBatchVerifier::Job * job;
+
+				switch (i % kinds) {
+
+				case 0 :
+					job = verifier.submit((const XMLByte *) validBytes, (unsigned int) validLen,
+						NULL, key, &index[i]);
+					break;
+				case 1 :
+					job = verifier.submit((const XMLByte *) tamperedBytes, (unsigned int) tamperedLen,
+						NULL, key, &index[i]);
+					break;
+				case 2 :
+					job = verifier.submit((const XMLByte *) brokenBytes,
+						(unsigned int) strlen(brokenBytes), NULL, key, &index[i]);
+					break;
+				case 3 :
+					docs.push_back(createSignedTestDoc(impl, prov, false));
+					job = verifier.submit(docs.back(), NULL, key, &index[i]);
+					break;
+				case 4 :
+					docs.push_back(createSignedTestDoc(impl, prov, true));
+					job = verifier.submit(docs.back(), NULL, key, &index[i]);
+					break;
+				default :
+					docs.push_back(impl->createDocument(0, MAKE_UNICODE_STRING("Root"), NULL));
+					job = verifier.submit(docs.back(), NULL, key, &index[i]);
+					break;
+
+				}
+
+				jobs.push_back(job);
+
+			}
+
+			verifier.waitAll();
+
+			if (verifier.getJobCount() != (unsigned int) count) {
+				cerr << "wrong job count" << endl;
+				exit(1);
+			}
+
+			for (int i = 0; i < count; ++i) {
+
+				DSIGBatchVerifier::Job * job = jobs[i];
+
+				if (job->getUserData() != &index[i] || job->getResult() != expected[i % kinds]) {
+					cerr << "job " << i << " has the wrong result" << endl;
+					exit(1);
+				}
+
+				bool haveMsg = (job->getErrorMessage() != NULL && job->getErrorMessage()[0] != 0);
+				if (haveMsg != (job->getResult() != DSIGBatchVerifier::BATCH_VALID)) {
+					cerr << "job " << i << " has the wrong error message" << endl;
+					exit(1);
+				}
+
+				// Bytes are parsed into a document the job owns
+				if ((i % kinds == 2) != (job->getDocument() == NULL)) {
+					cerr << "job " << i << " has the wrong document" << endl;
+					exit(1);
+				}
+
+			}
+
+			// Released jobs go, the rest stay readable
+			for (int i = 1; i < count; i += 2)
+				verifier.releaseJob(jobs[i]);
+
+			if (verifier.getJobCount() != (unsigned int) (count / 2) ||
+				jobs[0]->getResult() != expected[0]) {
+				cerr << "releaseJob did not release" << endl;
+				exit(1);
+			}
+
+			// A job may be released before it has been waited for
+			docs.push_back(createSignedTestDoc(impl, prov, false));
+			DSIGBatchVerifier::Job * job = verifier.submit(docs.back(), NULL, key);
+			verifier.releaseJob(job);
+
+			job = verifier.submit((const XMLByte *) validBytes, (unsigned int) validLen, NULL, key);
+			if (verifier.wait(job) != DSIGBatchVerifier::BATCH_VALID ||
+				verifier.getJobCount() != (unsigned int) (count / 2 + 1)) {
+				cerr << "wait gave the wrong result" << endl;
+				exit(1);
+			}
+
+			// The rest are released with the verifier
+
+		}
+
+		for (std::vector<DOMDocument *>::size_type i = 0; i < docs.size(); ++i)
+			docs[i]->release();
+
+	}
+
+	catch (XSECException &e)
+	{
+		cerr << "An error occured during signature processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	cerr << "OK" << endl;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Bounded caches
+// --------------------------------------------------------------------------------
+
+void cacheCheck(bool ok, const char * what) {
+
+	if (!ok) {
+		cerr << what << endl;
+		exit(1);
+	}
+
+}
+
+void unitTestDigestCache(void) {
+
+	cerr << "Digest cache eviction and statistics ... ";
+
+	XSECDigestCache cache(2);
+	XMLByte d1[] = {1, 2, 3, 4};
+	XMLByte d2[] = {5, 6, 7};
+	XMLByte d3[] = {8, 9};
+	XMLByte out[CRYPTO_MAX_HASH_SIZE];
+
+	cache.store("one", d1, 4);
+	cache.store("two", d2, 3);
+
+	// Touch "one" so that "two" is the least recently used
+	cacheCheck(cache.lookup("one", out, CRYPTO_MAX_HASH_SIZE) == 4 &&
+		memcmp(out, d1, 4) == 0, "wrong digest returned");
+
+	cache.store("three", d3, 2);
+
+	cacheCheck(cache.lookup("two", out, CRYPTO_MAX_HASH_SIZE) == 0,
+		"least recently used digest was not evicted");
+	cacheCheck(cache.lookup("one", out, CRYPTO_MAX_HASH_SIZE) == 4,
+		"recently used digest was evicted");
+	cacheCheck(cache.lookup("three", out, CRYPTO_MAX_HASH_SIZE) == 2 &&
+		memcmp(out, d3, 2) == 0, "wrong digest returned");
+
+	// Replacing a digest does not evict anything
+	cache.store("one", d2, 3);
+	cacheCheck(cache.lookup("one", out, CRYPTO_MAX_HASH_SIZE) == 3 &&
+		memcmp(out, d2, 3) == 0, "replaced digest not returned");
+
+	cacheCheck(cache.getHits() == 4 && cache.getMisses() == 1 &&
+		cache.getEvictions() == 1 && cache.getSize() == 2, "wrong statistics");
+
+	cache.clear();
+	cacheCheck(cache.getSize() == 0 && cache.getHits() == 4,
+		"clear should empty the cache and keep the statistics");
+	cacheCheck(cache.lookup("three", out, CRYPTO_MAX_HASH_SIZE) == 0,
+		"digest found after clear");
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestVerificationCache(void) {
+
+	cerr << "Verification cache eviction and statistics ... ";
+
+	XSECVerificationCache cache(3, 0);
+
+	cacheCheck(!cache.lookup("a"), "found verification never stored");
+
+	cache.store("a");
+	cache.store("b");
+	cache.store("c");
+	cacheCheck(cache.lookup("a"), "stored verification not found");
+
+	// "b" is now the least recently used
+	cache.store("d");
+	cache.store("e");
+
+	cacheCheck(!cache.lookup("b") && !cache.lookup("c"),
+		"least recently used verifications were not evicted");
+	cacheCheck(cache.lookup("a") && cache.lookup("d") && cache.lookup("e"),
+		"recently used verification was evicted");
+
+	cacheCheck(cache.getHits() == 4 && cache.getMisses() == 3 &&
+		cache.getEvictions() == 2 && cache.getSize() == 3, "wrong statistics");
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestKeyCache(void) {
+
+	cerr << "Key cache eviction and statistics ... ";
+
+	XSECKeyCache cache(1, 0);
+	XSECCryptoKeyHMAC * k1 = createHMACKey((unsigned char *) "first key");
+	Janitor<XSECCryptoKeyHMAC> j_k1(k1);
+	XSECCryptoKeyHMAC * k2 = createHMACKey((unsigned char *) "second key");
+	Janitor<XSECCryptoKeyHMAC> j_k2(k2);
+
+	cache.store("material one", 12, k1);
+
+	XSECCryptoKey * found = cache.lookup("material one", 12);
+	cacheCheck(found != NULL && found != k1, "key not found (or not cloned)");
+
+	safeBuffer buf;
+	unsigned int len = ((XSECCryptoKeyHMAC *) found)->getKey(buf);
+	delete found;
+	cacheCheck(len == 9 && memcmp(buf.rawBuffer(), "first key", 9) == 0, "wrong key returned");
+
+	cache.store("material two", 12, k2);
+	cacheCheck(cache.lookup("material one", 12) == NULL, "key was not evicted");
+
+	found = cache.lookup("material two", 12);
+	cacheCheck(found != NULL, "key not found");
+	delete found;
+
+	cacheCheck(cache.getHits() == 2 && cache.getMisses() == 1 &&
+		cache.getEvictions() == 1 && cache.getSize() == 1, "wrong statistics");
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestCaches(void) {
+
+	unitTestDigestCache();
+	unitTestVerificationCache();
+	unitTestKeyCache();
+
+}
+
+#if !defined(_WIN32)
+
+// --------------------------------------------------------------------------------
+//           Pooled HTTP connections
+// --------------------------------------------------------------------------------
+
+// A (very) minimal keep-alive HTTP server on the loopback interface.  Each
+// request is answered with the next entry of a script (wrapping round at
+// the end).  A NULL entry closes the connection without answering and an
+// empty one never answers at all.
+
+static const char * s_httpContentLength = "HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\nHello, World!";
+static const char * s_httpChunked =
+	"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nHello\r\n8\r\n, World!\r\n0\r\n\r\n";
+
+struct LoopbackHTTPServer {
+	int				m_listener;
+	const char		** mp_script;
+	int				m_scriptLen;
+	pthread_t		m_thread;
+	char			m_url[64];
+};
+
+extern "C" void * loopbackHTTPServer(void * arg) {
+
+	LoopbackHTTPServer * server = (LoopbackHTTPServer *) arg;
+	int accepted;
+	int count = 0;
+
+	while ((accepted = accept(server->m_listener, NULL, NULL)) >= 0) {
+
+		char buf[1024];
+		int len = 0, n;
+		bool open = true;
+
+		// Each request has no body, so just look for the blank line
+		while (open && (n = (int) recv(accepted, buf + len, sizeof(buf) - 1 - len, 0)) > 0) {
+			len += n;
+			buf[len] = '\0';
+			char * end;
+			while ((end = strstr(buf, "\r\n\r\n")) != NULL) {
+				const char * r = server->mp_script[count++ % server->m_scriptLen];
+				if (r == NULL) {
+					open = false;
+					break;
+				}
+				send(accepted, r, strlen(r), 0);
+				len -= (int) (end + 4 - buf);
+				memmove(buf, end + 4, len + 1);
+			}
+		}
+
+		close(accepted);
+
+	}
+
+	return NULL;
+
+}
+
+bool startLoopbackHTTPServer(LoopbackHTTPServer & server, const char ** script, int scriptLen) {
+
+	server.m_listener = socket(AF_INET, SOCK_STREAM, 0);
+	server.mp_script = script;
+	server.m_scriptLen = scriptLen;
+
+	struct sockaddr_in sa;
+	socklen_t saLen = sizeof(sa);
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sa.sin_port = 0;
+
+	if (server.m_listener < 0 ||
+		bind(server.m_listener, (struct sockaddr *) &sa, sizeof(sa)) != 0 ||
+		getsockname(server.m_listener, (struct sockaddr *) &sa, &saLen) != 0 ||
+		listen(server.m_listener, 4) != 0) {
+
+		cerr << "unable to listen on loopback - skipping" << endl;
+		if (server.m_listener >= 0)
+			close(server.m_listener);
+		return false;
+
+	}
+
+	sprintf(server.m_url, "http://127.0.0.1:%d/test.txt", (int) ntohs(sa.sin_port));
+	pthread_create(&server.m_thread, NULL, loopbackHTTPServer, &server);
+
+	return true;
+
+}
+
+void stopLoopbackHTTPServer(LoopbackHTTPServer & server) {
+
+	shutdown(server.m_listener, SHUT_RDWR);
+	close(server.m_listener);
+	pthread_join(server.m_thread, NULL);
+
+}
+
+void reportHTTPError(XSECException &e) {
+
+	cerr << "An error occured fetching via HTTP\n   Message: ";
+	char * ce = XMLString::transcode(e.getMsg());
+	cerr << ce << endl;
+	XSEC_RELEASE_XMLCH(ce);
+	exit(1);
+
+}
+
+void unitTestHTTPReuse(void) {
+
+	cerr << "Fetching over pooled HTTP connections ... ";
+
+	const char * script[] = {s_httpContentLength, s_httpChunked};
+	LoopbackHTTPServer server;
+	if (!startLoopbackHTTPServer(server, script, 2))
+		return;
+
+	XMLCh * urlX = XMLString::transcode(server.m_url);
+	XMLUri uri(urlX);
+	XSEC_RELEASE_XMLCH(urlX);
+
+	XSECHTTPConnectionPool * pool = XSECHTTPConnectionPool::getDefault();
+	unsigned long connects = pool->getConnectCount();
+
+	try {
+
+		for (int i = 0; i < 6; ++i) {
+
+			XSECBinHTTPURIInputStream is(uri);
+			XMLByte buf[64];
+			xsecsize_t len = 0, n;
+
+			// Small reads, so chunk boundaries fall mid-read
+			while ((n = is.readBytes(&buf[len], 3)) > 0 && len < 60)
+				len += n;
+
+			if (len != 13 || memcmp(buf, "Hello, World!", 13) != 0) {
+				cerr << "bad response body" << endl;
+				exit(1);
+			}
+
+		}
+
+	}
+	catch (XSECException &e)
+	{
+		reportHTTPError(e);
+	}
+
+	if (pool->getConnectCount() - connects != 1) {
+		cerr << "connection was not re-used" << endl;
+		exit(1);
+	}
+
+	pool->closeIdle();
+	stopLoopbackHTTPServer(server);
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestHTTPResend(void) {
+
+	cerr << "Re-sending only safe requests on dropped connections ... ";
+
+	// The second and fourth requests find the connection has gone
+	const char * script[] = {s_httpContentLength, NULL, s_httpContentLength, NULL};
+	LoopbackHTTPServer server;
+	if (!startLoopbackHTTPServer(server, script, 4))
+		return;
+
+	XMLCh * urlX = XMLString::transcode(server.m_url);
+	XMLUri uri(urlX);
+	XSEC_RELEASE_XMLCH(urlX);
+
+	XSECHTTPConnectionPool pool;
+	safeBuffer sb;
+
+	try {
+
+		// Answered, and the connection kept
+		{
+			XSECHTTPExchange ex(&pool, uri);
+			if (ex.doRequest("GET", NULL, NULL, 0) != 200 || ex.readBody(sb) != 13) {
+				cerr << "bad response" << endl;
+				exit(1);
+			}
+		}
+
+		// Dropped, so sent again on a new connection
+		{
+			XSECHTTPExchange ex(&pool, uri);
+			if (ex.doRequest("GET", NULL, NULL, 0) != 200 || ex.readBody(sb) != 13) {
+				cerr << "GET was not re-sent" << endl;
+				exit(1);
+			}
+		}
+
+	}
+	catch (XSECException &e)
+	{
+		reportHTTPError(e);
+	}
+
+	if (pool.getConnectCount() != 2 || pool.getReuseCount() != 1) {
+		cerr << "unexpected connection use" << endl;
+		exit(1);
+	}
+
+	// Dropped after being sent - the server may have acted on it
+	bool thrown = false;
+	try {
+		XSECHTTPExchange ex(&pool, uri);
+		ex.doRequest("POST", NULL, NULL, 0);
+	}
+	catch (XSECException &) {
+		thrown = true;
+	}
+
+	if (!thrown || pool.getConnectCount() != 2) {
+		cerr << "POST was re-sent" << endl;
+		exit(1);
+	}
+
+	pool.closeIdle();
+	stopLoopbackHTTPServer(server);
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestHTTPTimeout(void) {
+
+	cerr << "Timing out HTTP connections (takes a few seconds) ... ";
+
+	// The second request is never answered
+	const char * script[] = {s_httpContentLength, ""};
+	LoopbackHTTPServer server;
+	if (!startLoopbackHTTPServer(server, script, 2))
+		return;
+
+	XMLCh * urlX = XMLString::transcode(server.m_url);
+	XMLUri uri(urlX);
+	XSEC_RELEASE_XMLCH(urlX);
+
+	// One connection per server, one second timeout
+	XSECHTTPConnectionPool pool(1, XSEC_HTTP_POOL_IDLE_TIMEOUT, 1);
+	bool thrown = false;
+
+	try {
+
+		XSECHTTPExchange held(&pool, uri);
+		if (held.doRequest("GET", NULL, NULL, 0) != 200) {
+			cerr << "bad response" << endl;
+			exit(1);
+		}
+
+		// No connection free until held goes away
+		try {
+			XSECHTTPExchange ex(&pool, uri);
+			ex.doRequest("GET", NULL, NULL, 0);
+		}
+		catch (XSECException &) {
+			thrown = true;
+		}
+
+	}
+	catch (XSECException &e)
+	{
+		reportHTTPError(e);
+	}
+
+	if (!thrown) {
+		cerr << "waiting for a connection did not time out" << endl;
+		exit(1);
+	}
+
+	// The held body was never read, so the next request has a new
+	// connection - and is never answered
+	thrown = false;
+	try {
+		XSECHTTPExchange ex(&pool, uri);
+		ex.doRequest("GET", NULL, NULL, 0);
+	}
+	catch (XSECException &) {
+		thrown = true;
+	}
+
+	if (!thrown) {
+		cerr << "reading the response did not time out" << endl;
+		exit(1);
+	}
+
+	stopLoopbackHTTPServer(server);
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestHTTPConnectionPool(void) {
+
+	unitTestHTTPReuse();
+	unitTestHTTPResend();
+	unitTestHTTPTimeout();
+
 }
+
+#endif
+
 void unitTestSignature(DOMImplementation * impl) {
 
 	// Test an enveloping signature
@@ -1194,6 +2433,32 @@ void unitTestSignature(DOMImplementation * impl) {
 
 	// Test RSA Signatures
 	unitTestRSA(impl);
+
+	// Test lookups of Id attributes
+	unitTestIdIndex(impl, false);
+	unitTestIdIndex(impl, true);
+
+	// Test incremental signing
+	unitTestIncrementalSigning(impl);
+
+	// Digests shared through a document context
+	unitTestDocumentContextIds(impl);
+
+	// References digested together
+	unitTestReferenceBatch(impl);
+
+	// References verified in parallel
+	unitTestParallelReferences(impl);
+
+	// Signatures stamped from a template
+	unitTestSigningTemplate(impl);
+
+	// Documents verified as a batch
+	unitTestBatchVerifier(impl);
+
+	// Test the bounded caches
+	unitTestCaches();
+
 }
 
 // --------------------------------------------------------------------------------
@@ -1810,6 +3075,126 @@ void unitTestElementContentEncrypt(DOMImplementation *impl, XSECCryptoKey * key,
 
 }
 
+void unitTestGCMRoundTrip(DOMImplementation *impl, unsigned int size,
+						  XSECPlatformUtils::PlaintextRelease release, bool stream) {
+
+	// Encrypt the content of an element of size bytes with AES-GCM, then
+	// decrypt (as an element or a stream) and compare
+
+	cerr << "AES-GCM " << size << " bytes, "
+		<< (release == XSECPlatformUtils::PLAINTEXT_STREAM ? "streamed" :
+			(release == XSECPlatformUtils::PLAINTEXT_BUFFER_FILE ? "file buffered" : "memory buffered"))
+		<< (stream ? ", to stream" : ", to element") << " ... ";
+
+	safeBuffer text;
+	for (unsigned int i = 0; i < size; ++i)
+		text[i] = (char) ('a' + (i % 26));
+	text[size] = '\0';
+
+	DOMDocument *doc = impl->createDocument(
+				0,
+				MAKE_UNICODE_STRING("ADoc"),
+				NULL);
+	DOMElement * payload = doc->createElement(MAKE_UNICODE_STRING("Payload"));
+	doc->getDocumentElement()->appendChild(payload);
+	payload->appendChild(doc->createTextNode(MAKE_UNICODE_STRING(text.rawCharBuffer())));
+
+	XSECProvider prov;
+	XSECPlatformUtils::PlaintextRelease oldRelease = XSECPlatformUtils::GetPlaintextRelease();
+
+	try {
+
+		XSECCryptoSymmetricKey * ks =
+			XSECPlatformUtils::g_cryptoProvider->keySymmetric(XSECCryptoSymmetricKey::KEY_AES_128);
+		ks->setKey((unsigned char *) s_keyStr, 16);
+
+		XENCCipher * cipher = prov.newCipher(doc);
+		cipher->setKey(ks->clone());
+		cipher->encryptElementContent(payload, ENCRYPT_AES128_GCM);
+
+		XSECPlatformUtils::SetPlaintextRelease(release);
+
+		XENCCipher * cipher2 = prov.newCipher(doc);
+		cipher2->setKey(ks);
+
+		DOMNode * n = findXENCNode(doc, "EncryptedData");
+		bool ok;
+
+		if (stream) {
+
+			XSECBinTXFMInputStream * is = cipher2->decryptToBinInputStream((DOMElement *) n);
+			Janitor<XSECBinTXFMInputStream> j_is(is);
+
+			safeBuffer out;
+			XMLByte buf[1024];
+			unsigned int outLen = 0;
+			xsecsize_t bytesRead;
+
+			while ((bytesRead = is->readBytes(buf, 1024)) > 0) {
+				out.sbMemcpyIn(outLen, buf, (unsigned int) bytesRead);
+				outLen += (unsigned int) bytesRead;
+			}
+
+			ok = (outLen == size && memcmp(out.rawBuffer(), text.rawBuffer(), size) == 0);
+
+		}
+		else {
+
+			cipher2->decryptElement((DOMElement *) n);
+
+			char * content = XMLString::transcode(payload->getTextContent());
+			ok = (strcmp(content, text.rawCharBuffer()) == 0);
+			XSEC_RELEASE_XMLCH(content);
+
+		}
+
+		XSECPlatformUtils::SetPlaintextRelease(oldRelease);
+
+		if (!ok) {
+			cerr << "failed - bad compare of decrypted data" << endl;
+			exit(1);
+		}
+
+		cerr << "OK" << endl;
+
+	}
+	catch (XSECException &e)
+	{
+		cerr << "failed\n";
+		cerr << "An error occured during AES-GCM processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		delete ce;
+		exit(1);
+	}
+	catch (XSECCryptoException &e)
+	{
+		cerr << "failed\n";
+		cerr << "A cryptographic error occured during AES-GCM processing\n   Message: "
+		<< e.getMsg() << endl;
+		exit(1);
+	}
+
+	doc->release();
+
+}
+
+void unitTestGCM(DOMImplementation *impl) {
+
+	// Sizes either side of the step TXFMCipher holds back before the first
+	// decrypt, and of its 2K read
+
+	static const unsigned int sizes[] = {1, 40, 100, 3000, 10000};
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		unitTestGCMRoundTrip(impl, sizes[i], XSECPlatformUtils::PLAINTEXT_BUFFER_MEMORY, false);
+		unitTestGCMRoundTrip(impl, sizes[i], XSECPlatformUtils::PLAINTEXT_STREAM, false);
+		unitTestGCMRoundTrip(impl, sizes[i], XSECPlatformUtils::PLAINTEXT_STREAM, true);
+		unitTestGCMRoundTrip(impl, sizes[i], XSECPlatformUtils::PLAINTEXT_BUFFER_FILE, true);
+	}
+
+}
+
 void unitTestSmallElement(DOMImplementation *impl) {
 	
 	cerr << "Encrypt small input... ";
@@ -1920,6 +3305,142 @@ void unitTestSmallElement(DOMImplementation *impl) {
 }
 
 
+// --------------------------------------------------------------------------------
+//           RFC 3394 section 4 known answers
+// --------------------------------------------------------------------------------
+
+static const unsigned char s_kwKEK[] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F
+};
+
+static const unsigned char s_kwKeyData[] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+struct KeyWrapVector {
+	const char						* mp_name;
+	XSECCryptoSymmetricKey::SymmetricKeyType
+									m_kekType;
+	unsigned int					m_kekLen;
+	unsigned int					m_keyDataLen;
+	unsigned char					m_wrapped[40];
+};
+
+static const KeyWrapVector s_kwVectors[] = {
+
+	{"4.1 (128 bit KEK, 128 bit key)", XSECCryptoSymmetricKey::KEY_AES_128, 16, 16,
+		{0x1F, 0xA6, 0x8B, 0x0A, 0x81, 0x12, 0xB4, 0x47, 0xAE, 0xF3, 0x4B, 0xD8,
+		 0xFB, 0x5A, 0x7B, 0x82, 0x9D, 0x3E, 0x86, 0x23, 0x71, 0xD2, 0xCF, 0xE5}},
+
+	{"4.2 (192 bit KEK, 128 bit key)", XSECCryptoSymmetricKey::KEY_AES_192, 24, 16,
+		{0x96, 0x77, 0x8B, 0x25, 0xAE, 0x6C, 0xA4, 0x35, 0xF9, 0x2B, 0x5B, 0x97,
+		 0xC0, 0x50, 0xAE, 0xD2, 0x46, 0x8A, 0xB8, 0xA1, 0x7A, 0xD8, 0x4E, 0x5D}},
+
+	{"4.3 (256 bit KEK, 128 bit key)", XSECCryptoSymmetricKey::KEY_AES_256, 32, 16,
+		{0x64, 0xE8, 0xC3, 0xF9, 0xCE, 0x0F, 0x5B, 0xA2, 0x63, 0xE9, 0x77, 0x79,
+		 0x05, 0x81, 0x8A, 0x2A, 0x93, 0xC8, 0x19, 0x1E, 0x7D, 0x6E, 0x8A, 0xE7}},
+
+	{"4.4 (192 bit KEK, 192 bit key)", XSECCryptoSymmetricKey::KEY_AES_192, 24, 24,
+		{0x03, 0x1D, 0x33, 0x26, 0x4E, 0x15, 0xD3, 0x32, 0x68, 0xF2, 0x4E, 0xC2,
+		 0x60, 0x74, 0x3E, 0xDC, 0xE1, 0xC6, 0xC7, 0xDD, 0xEE, 0x72, 0x5A, 0x93,
+		 0x6B, 0xA8, 0x14, 0x91, 0x5C, 0x67, 0x62, 0xD2}},
+
+	{"4.5 (256 bit KEK, 192 bit key)", XSECCryptoSymmetricKey::KEY_AES_256, 32, 24,
+		{0xA8, 0xF9, 0xBC, 0x16, 0x12, 0xC6, 0x8B, 0x3F, 0xF6, 0xE6, 0xF4, 0xFB,
+		 0xE3, 0x0E, 0x71, 0xE4, 0x76, 0x9C, 0x8B, 0x80, 0xA3, 0x2C, 0xB8, 0x95,
+		 0x8C, 0xD5, 0xD1, 0x7D, 0x6B, 0x25, 0x4D, 0xA1}},
+
+	{"4.6 (256 bit KEK, 256 bit key)", XSECCryptoSymmetricKey::KEY_AES_256, 32, 32,
+		{0x28, 0xC9, 0xF4, 0x04, 0xC4, 0xB8, 0x10, 0xF4, 0xCB, 0xCC, 0xB3, 0x5C,
+		 0xFB, 0x87, 0xF8, 0x26, 0x3F, 0x57, 0x86, 0xE2, 0xD8, 0x0E, 0xD3, 0x26,
+		 0xCB, 0xC7, 0xF0, 0xE7, 0x1A, 0x99, 0xF4, 0x3B, 0xFB, 0x98, 0x8B, 0x9B,
+		 0x7A, 0x02, 0xDD, 0x21}}
+
+};
+
+void unitTestKeyWrapVector(const KeyWrapVector & v, bool useDefault) {
+
+	XSECCryptoProvider * prov = XSECPlatformUtils::g_cryptoProvider;
+
+	XSECCryptoSymmetricKey * kek = prov->keySymmetric(v.m_kekType);
+	Janitor<XSECCryptoSymmetricKey> j_kek(kek);
+	kek->setKey(s_kwKEK, v.m_kekLen);
+
+	unsigned char out[48];
+	unsigned int wrappedLen = v.m_keyDataLen + 8;
+	unsigned int len;
+
+	// The base class version is the block at a time loop providers may
+	// override
+	if (useDefault)
+		len = prov->XSECCryptoProvider::wrapKeyAES(kek, s_kwKeyData, v.m_keyDataLen, out, 48);
+	else
+		len = prov->wrapKeyAES(kek, s_kwKeyData, v.m_keyDataLen, out, 48);
+
+	if (len != wrappedLen || memcmp(out, v.m_wrapped, wrappedLen) != 0) {
+		cerr << "wrap of " << v.mp_name << " does not match RFC 3394" << endl;
+		exit(1);
+	}
+
+	if (useDefault)
+		len = prov->XSECCryptoProvider::unwrapKeyAES(kek, v.m_wrapped, wrappedLen, out, 48);
+	else
+		len = prov->unwrapKeyAES(kek, v.m_wrapped, wrappedLen, out, 48);
+
+	if (len != v.m_keyDataLen || memcmp(out, s_kwKeyData, len) != 0) {
+		cerr << "unwrap of " << v.mp_name << " does not match RFC 3394" << endl;
+		exit(1);
+	}
+
+	// Any change must fail the integrity check
+	unsigned char bad[40];
+	memcpy(bad, v.m_wrapped, wrappedLen);
+	bad[wrappedLen - 1] ^= 0x01;
+
+	if (useDefault)
+		len = prov->XSECCryptoProvider::unwrapKeyAES(kek, bad, wrappedLen, out, 48);
+	else
+		len = prov->unwrapKeyAES(kek, bad, wrappedLen, out, 48);
+
+	if (len != 0) {
+		cerr << "altered " << v.mp_name << " passed the integrity check" << endl;
+		exit(1);
+	}
+
+}
+
+void unitTestKeyWrapVectors(void) {
+
+	cerr << "AES key wrap known answers (RFC 3394) ... ";
+
+	try {
+
+		for (unsigned int i = 0; i < sizeof(s_kwVectors) / sizeof(KeyWrapVector); ++i) {
+			unitTestKeyWrapVector(s_kwVectors[i], false);
+			unitTestKeyWrapVector(s_kwVectors[i], true);
+		}
+
+	}
+	catch (XSECCryptoException &e)
+	{
+		cerr << "failed\n   Message: " << e.getMsg() << endl;
+		exit(1);
+	}
+	catch (XSECException &e)
+	{
+		cerr << "failed\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		XSEC_RELEASE_XMLCH(ce);
+		exit(1);
+	}
+
+	cerr << "OK" << endl;
+
+}
+
 void unitTestKeyEncrypt(DOMImplementation *impl, XSECCryptoKey * k, encryptionMethod em) {
 
 	// Create a document that we will embed the encrypted key in
@@ -2017,6 +3538,168 @@ void unitTestKeyEncrypt(DOMImplementation *impl, XSECCryptoKey * k, encryptionMe
 }
 
 
+// --------------------------------------------------------------------------------
+//           KEK identity matching
+// --------------------------------------------------------------------------------
+
+// Content keys wrapped for the recipients of a test document - only the
+// good one decrypts the data
+
+static unsigned char s_kekGoodKey[] = "0123456789ABCDEF";
+static unsigned char s_kekBadKey[] = "FEDCBA9876543210";
+
+struct KEKRecipient {
+	const unsigned char * key;
+	const char * keyName;
+	const char * issuer;
+	const char * serial;
+};
+
+void unitTestKEKIdentity(DOMImplementation * impl,
+						 const KEKRecipient * recipients,
+						 int count,
+						 const char * kekName,
+						 const char * kekIssuer,
+						 const char * kekSerial) {
+
+	DOMDocument * doc = createTestDoc(impl);
+	DOMNode * categoryNode = findNode(doc, MAKE_UNICODE_STRING("category"));
+	if (categoryNode == NULL) {
+
+		cerr << "Error finding category node for KEK identity test" << endl;
+		exit(1);
+
+	}
+
+	XSECProvider prov;
+
+	XMLCh * name = (kekName != NULL ? XMLString::transcode(kekName) : NULL);
+	XMLCh * issuer = (kekIssuer != NULL ? XMLString::transcode(kekIssuer) : NULL);
+	XMLCh * serial = (kekSerial != NULL ? XMLString::transcode(kekSerial) : NULL);
+
+	try {
+
+		// Encrypt the data with the good key and wrap each recipient's key
+
+		XENCCipher * cipher = prov.newCipher(doc);
+		cipher->setXENCNSPrefix(MAKE_UNICODE_STRING("xenc"));
+
+		XSECCryptoSymmetricKey * ks =
+			XSECPlatformUtils::g_cryptoProvider->keySymmetric(XSECCryptoSymmetricKey::KEY_AES_128);
+		ks->setKey(s_kekGoodKey, 16);
+		cipher->setKey(ks);
+
+		ks = XSECPlatformUtils::g_cryptoProvider->keySymmetric(XSECCryptoSymmetricKey::KEY_AES_128);
+		ks->setKey((unsigned char *) s_keyStr, 16);
+		cipher->setKEK(ks);
+
+		cipher->encryptElement((DOMElement *) categoryNode, ENCRYPT_AES128_CBC);
+		XENCEncryptedData * encryptedData = cipher->getEncryptedData();
+
+		for (int i = 0; i < count; ++i) {
+
+			XENCEncryptedKey * encryptedKey =
+				cipher->encryptKey(recipients[i].key, 16, ENCRYPT_KW_AES128);
+
+			if (recipients[i].keyName != NULL)
+				encryptedKey->appendKeyName(MAKE_UNICODE_STRING(recipients[i].keyName));
+			if (recipients[i].issuer != NULL)
+				encryptedKey->appendX509Data()->setX509IssuerSerial(
+					MAKE_UNICODE_STRING(recipients[i].issuer),
+					MAKE_UNICODE_STRING(recipients[i].serial));
+
+			encryptedData->appendEncryptedKey(encryptedKey);
+
+		}
+
+		// Now decrypt with nothing but the KEK and its identity
+
+		DOMNode * n = findXENCNode(doc, "EncryptedData");
+
+		XENCCipher * cipher2 = prov.newCipher(doc);
+
+		ks = XSECPlatformUtils::g_cryptoProvider->keySymmetric(XSECCryptoSymmetricKey::KEY_AES_128);
+		ks->setKey((unsigned char *) s_keyStr, 16);
+		cipher2->setKEK(ks);
+		cipher2->setKEKIdentity(name, issuer, serial);
+
+		cipher2->decryptElement(static_cast<DOMElement *>(n));
+
+		if (findNode(doc, MAKE_UNICODE_STRING("category")) == NULL) {
+
+			cerr << "failed - category did not decrypt properly" << endl;
+			exit(1);
+
+		}
+
+	}
+	catch (XSECException &e)
+	{
+		cerr << "failed\n";
+		cerr << "An error occured during encryption processing\n   Message: ";
+		char * ce = XMLString::transcode(e.getMsg());
+		cerr << ce << endl;
+		delete ce;
+		exit(1);
+
+	}
+	catch (XSECCryptoException &e)
+	{
+		cerr << "failed\n";
+		cerr << "A cryptographic error occured during encryption processing\n   Message: "
+		<< e.getMsg() << endl;
+		exit(1);
+	}
+
+	XSEC_RELEASE_XMLCH(name);
+	XSEC_RELEASE_XMLCH(issuer);
+	XSEC_RELEASE_XMLCH(serial);
+
+	doc->release();
+
+	cerr << "OK" << endl;
+
+}
+
+void unitTestKEKMatching(DOMImplementation * impl) {
+
+	// The key for the KEK is listed after one that unwraps to the wrong
+	// content key, so each test only passes if the match is tried first
+
+	cerr << "KEK matched by KeyName ... ";
+
+	KEKRecipient byName[] = {
+		{ s_kekBadKey, NULL, NULL, NULL },
+		{ s_kekGoodKey, "recipient", NULL, NULL }
+	};
+	unitTestKEKIdentity(impl, byName, 2, "recipient", NULL, NULL);
+
+	cerr << "KEK matched by canonical issuer and serial ... ";
+
+	KEKRecipient byIssuer[] = {
+		{ s_kekBadKey, "someone else", NULL, NULL },
+		{ s_kekGoodKey, NULL, "cn=Recipient,  o=Example", "0123" }
+	};
+	unitTestKEKIdentity(impl, byIssuer, 2, NULL, "CN=Recipient,O=Example", "123");
+
+	cerr << "KEK matched by reversed issuer ... ";
+
+	KEKRecipient byReversed[] = {
+		{ s_kekBadKey, NULL, "CN=Other,O=Example", "123" },
+		{ s_kekGoodKey, NULL, "O=Example, CN=Recipient", "123" }
+	};
+	unitTestKEKIdentity(impl, byReversed, 2, NULL, "CN=Recipient,O=Example", "123");
+
+	// A KeyInfo that names another recipient must not stop the key being tried
+
+	cerr << "KEK tried when named for another recipient ... ";
+
+	KEKRecipient other[] = {
+		{ s_kekGoodKey, "old name", NULL, NULL }
+	};
+	unitTestKEKIdentity(impl, other, 1, "recipient", NULL, NULL);
+
+}
 
 void unitTestEncrypt(DOMImplementation *impl) {
 
@@ -2133,6 +3816,10 @@ void unitTestEncrypt(DOMImplementation *impl) {
 			ks->setKey((unsigned char *) s_keyStr, 32);
 		
 			unitTestKeyEncrypt(impl, ks, ENCRYPT_KW_AES256);
+
+			unitTestKeyWrapVectors();
+
+			unitTestKEKMatching(impl);
 		}
 
 		else 
@@ -2194,6 +3881,17 @@ void unitTestEncrypt(DOMImplementation *impl) {
 #else
 		cerr << "Skipped Cipher Reference Test (requires XPath)" << endl;
 #endif
+		bool haveGCM = false;
+#if defined (XSEC_HAVE_OPENSSL) && defined (XSEC_OPENSSL_HAVE_GCM)
+		haveGCM = (g_haveAES && !g_useWinCAPI && !g_useNSS);
+#endif
+		if (haveGCM) {
+			cerr << "Unit testing AES 128 bit GCM encryption" << endl;
+			unitTestGCM(impl);
+		}
+		else
+			cerr << "Skipped AES-GCM tests" << endl;
+
 		cerr << "Misc. encryption tests" << endl;
 		unitTestSmallElement(impl);
 	}
@@ -2522,6 +4220,8 @@ void printUsage(void) {
 	cerr << "         Only run basic encryption test\n\n";
 	cerr << "     --encryption-unit-only/-u\n";
 	cerr << "         Only run encryption unit tests\n\n";
+	cerr << "     --http-unit-only/-c\n";
+	cerr << "         Only run HTTP connection pool unit tests\n\n";
 //	cerr << "     --xkms-only/-x\n";
 //	cerr << "         Only run basic XKMS test\n\n";
 
@@ -2545,6 +4245,7 @@ int main(int argc, char **argv) {
 	bool		doEncryptionUnitTests = true;
 	bool		doSignatureTest = true;
 	bool		doSignatureUnitTests = true;
+	bool		doHTTPUnitTests = true;
 	bool		doXKMSTest = true;
 
 	int paramCount = 1;
@@ -2576,6 +4277,7 @@ int main(int argc, char **argv) {
 			doEncryptionTest = false;
 			doEncryptionUnitTests = false;
 			doSignatureUnitTests = false;
+			doHTTPUnitTests = false;
 			doXKMSTest = false;
 			paramCount++;
 		}
@@ -2583,6 +4285,7 @@ int main(int argc, char **argv) {
 			doSignatureTest = false;
 			doEncryptionUnitTests = false;
 			doSignatureUnitTests = false;
+			doHTTPUnitTests = false;
 			doXKMSTest = false;
 			paramCount++;
 		}
@@ -2590,6 +4293,7 @@ int main(int argc, char **argv) {
 			doEncryptionTest = false;
 			doSignatureTest = false;
 			doSignatureUnitTests = false;
+			doHTTPUnitTests = false;
 			doXKMSTest = false;
 			paramCount++;
 		}
@@ -2597,6 +4301,15 @@ int main(int argc, char **argv) {
 			doEncryptionTest = false;
 			doSignatureTest = false;
 			doEncryptionUnitTests = false;
+			doHTTPUnitTests = false;
+			doXKMSTest = false;
+			paramCount++;
+		}
+		else if (_stricmp(argv[paramCount], "--http-unit-only") == 0 || _stricmp(argv[paramCount], "-c") == 0) {
+			doEncryptionTest = false;
+			doSignatureTest = false;
+			doEncryptionUnitTests = false;
+			doSignatureUnitTests = false;
 			doXKMSTest = false;
 			paramCount++;
 		}
@@ -2723,6 +4436,18 @@ int main(int argc, char **argv) {
 
 			unitTestEncrypt(impl);
 		}
+
+#if !defined(_WIN32)
+		// Fetching of external references over pooled connections
+		if (doHTTPUnitTests) {
+			cerr << endl << "====================================";
+			cerr << endl << "Performing HTTP Connection Pool Unit Tests";
+			cerr << endl << "====================================";
+			cerr << endl << endl;
+
+			unitTestHTTPConnectionPool();
+		}
+#endif
 /*
 		// Running XKMS Base test
 		if (doXKMSTest) {
@@ -44,6 +44,9 @@
 
 class TXFMChain;
 
+// Largest block handed to a hash in one call when digesting in-memory input
+#define TXFM_HASH_MAX_BLOCK		0x40000000
+
 /** @defgroup internal Internal Classes
  * Classes marked as <b>internal</b> are used internally by the xml-security-c
  * library.  Generally there should be no requirement for these classes
@@ -130,6 +133,20 @@ public:
 	// BinInputStream methods:
 
 	virtual unsigned int readBytes(XMLByte * const toFill, const unsigned int maxToFill) = 0;
+
+	/**
+	 * \brief Obtain the remaining output as one contiguous block
+	 *
+	 * Transforms that already hold their output in memory (e.g. a TXFMURL
+	 * reading a mapped file) can hand it on without copying it through
+	 * readBytes().  The block is consumed by the call, and remains valid
+	 * until this transform is deleted.
+	 *
+	 * @returns false if not supported - use readBytes() instead.
+	 */
+
+	virtual bool getContiguousBytes(const XMLByte *& data, XMLSize_t & len) {return false;}
+
 	virtual XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument *getDocument() = 0;
 	virtual XERCES_CPP_NAMESPACE_QUALIFIER DOMNode *getFragmentNode() = 0;
 	virtual const XMLCh * getFragmentId() = 0;
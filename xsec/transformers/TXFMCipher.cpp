@@ -44,7 +44,16 @@ TXFMBase(doc),
 m_doEncrypt(encrypt),
 m_taglen(taglen),
 mp_cipher(NULL),
-m_remaining(0) {
+m_remaining(0),
+m_aead(!encrypt && mode == XSECCryptoSymmetricKey::MODE_GCM),
+m_held(0),
+m_consumed(0),
+m_release(XSECPlatformUtils::GetPlaintextRelease()),
+m_spooled(false),
+m_spoolBuf(""),
+m_spoolLen(0),
+m_spoolPos(0),
+mp_spoolFile(NULL) {
 
     if (key && key->getKeyType() == XSECCryptoKey::KEY_SYMMETRIC)
 	    mp_cipher = key->clone();
@@ -55,8 +64,15 @@ m_remaining(0) {
 	}
 
 	m_complete = false;
+	m_spoolBuf.isSensitive();
 
 	try {
+		if (m_aead && (m_taglen == 0 || m_taglen > TXFMCIPHER_MAX_TAG ||
+				!((XSECCryptoSymmetricKey *) (mp_cipher))->canDeferTag())) {
+			throw XSECException(XSECException::CipherError,
+				"TXFMCipher - key cannot decrypt a stream with a trailing authentication tag");
+		}
+
 		if (m_doEncrypt)
 			((XSECCryptoSymmetricKey *) (mp_cipher))->encryptInit((mode != XSECCryptoSymmetricKey::MODE_GCM), mode);
 		else
@@ -74,6 +90,10 @@ TXFMCipher::~TXFMCipher() {
 
 		delete mp_cipher;
 
+		// A temporary file is removed once closed
+		if (mp_spoolFile != NULL)
+			fclose(mp_spoolFile);
+
 };
 
 	// Methods to set the inputs
@@ -113,6 +133,18 @@ unsigned int TXFMCipher::readBytes(XMLByte * const toFill, unsigned int maxToFil
 	
 	unsigned int ret, fill, leftToFill;
 
+	// AEAD plain text that is not to be released until the tag is checked
+	// is decrypted in full first, then read back
+
+	if (m_aead && m_release != XSECPlatformUtils::PLAINTEXT_STREAM) {
+
+		if (!m_spooled)
+			spoolAEAD();
+
+		return readSpool(toFill, maxToFill);
+
+	}
+
 	ret = 0;					// How much have we copied?
 	leftToFill = maxToFill;		// Still have to copy in entire thing
 
@@ -137,6 +169,11 @@ unsigned int TXFMCipher::readBytes(XMLByte * const toFill, unsigned int maxToFil
 
 		if (m_complete == false && m_remaining == 0) {
 
+			if (m_aead) {
+				decryptAEADStep();
+				continue;
+			}
+
 			unsigned int sz = input->readBytes(m_inputBuffer, 2048);
 		
 			XSECCryptoSymmetricKey * symCipher = 
@@ -167,6 +204,137 @@ unsigned int TXFMCipher::readBytes(XMLByte * const toFill, unsigned int maxToFil
 
 }
 
+void TXFMCipher::decryptAEADStep(void) {
+
+	// The tag is the last m_taglen bytes of the input, so that much is
+	// always held back until the input runs out.  Sets m_remaining (and
+	// m_complete once the tag has been checked).
+
+	XSECCryptoSymmetricKey * symCipher = (XSECCryptoSymmetricKey*) mp_cipher;
+
+	unsigned int sz = input->readBytes(&m_inputBuffer[m_held], 2048);
+	unsigned int len;
+
+	if (sz == 0) {
+
+		// Earlier steps always leave exactly the tag held, so the body
+		// here may be empty - the length check is on the whole input
+		if (m_consumed <= m_taglen || m_held < m_taglen) {
+			throw XSECException(XSECException::CipherError,
+				"TXFMCipher - cipher text not large enough to include authentication tag");
+		}
+
+		len = m_held - m_taglen;
+		m_remaining = (len > 0 ? symCipher->decrypt(m_inputBuffer, m_outputBuffer, len, 3072) : 0);
+
+		symCipher->setTag(&m_inputBuffer[len], m_taglen);
+		m_remaining += symCipher->decryptFinish(&m_outputBuffer[m_remaining], 3072 - m_remaining);
+
+		m_held = 0;
+		m_complete = true;
+		return;
+
+	}
+
+	m_held += sz;
+	m_consumed += sz;
+
+	if (m_held < m_taglen + TXFMCIPHER_AEAD_MIN_STEP) {
+		m_remaining = 0;
+		return;
+	}
+
+	len = m_held - m_taglen;
+	m_remaining = symCipher->decrypt(m_inputBuffer, m_outputBuffer, len, 3072);
+
+	memmove(m_inputBuffer, &m_inputBuffer[len], m_taglen);
+	m_held = m_taglen;
+
+}
+
+void TXFMCipher::spoolAEAD(void) {
+
+	// Decrypt everything into memory or a temporary file.  Should the tag
+	// not verify, decryptFinish() throws and nothing is ever read back.
+
+	if (m_release == XSECPlatformUtils::PLAINTEXT_BUFFER_FILE) {
+
+		mp_spoolFile = tmpfile();
+
+		if (mp_spoolFile == NULL) {
+			throw XSECException(XSECException::CipherError,
+				"TXFMCipher - unable to create temporary file for plain text");
+		}
+
+	}
+
+	do {
+
+		decryptAEADStep();
+
+		if (m_remaining == 0)
+			continue;
+
+		if (mp_spoolFile != NULL) {
+
+			if (fwrite(m_outputBuffer, 1, m_remaining, mp_spoolFile) != m_remaining) {
+				throw XSECException(XSECException::CipherError,
+					"TXFMCipher - error writing plain text to temporary file");
+			}
+
+		}
+		else {
+
+			// safeBuffer sizes are xsecsize_t, and it doubles what it
+			// is asked for when it grows
+			if (m_spoolLen + m_remaining >= (XMLFilePos) (((xsecsize_t) -1) / 2)) {
+				throw XSECException(XSECException::CipherError,
+					"TXFMCipher - plain text too large to buffer in memory");
+			}
+
+			m_spoolBuf.sbMemcpyIn((xsecsize_t) m_spoolLen, m_outputBuffer, m_remaining);
+
+		}
+
+		m_spoolLen += m_remaining;
+		m_remaining = 0;
+
+	} while (m_complete == false);
+
+	memset(m_outputBuffer, 0, sizeof(m_outputBuffer));
+
+	if (mp_spoolFile != NULL)
+		rewind(mp_spoolFile);
+
+	m_spooled = true;
+
+}
+
+unsigned int TXFMCipher::readSpool(XMLByte * const toFill, const unsigned int maxToFill) {
+
+	XMLFilePos left = m_spoolLen - m_spoolPos;
+	unsigned int fill = (left > maxToFill ? maxToFill : (unsigned int) left);
+
+	if (fill == 0)
+		return 0;
+
+	if (mp_spoolFile != NULL) {
+
+		if (fread(toFill, 1, fill, mp_spoolFile) != fill) {
+			throw XSECException(XSECException::CipherError,
+				"TXFMCipher - error reading plain text from temporary file");
+		}
+
+	}
+	else
+		memcpy(toFill, m_spoolBuf.rawBuffer() + (xsecsize_t) m_spoolPos, fill);
+
+	m_spoolPos += fill;
+
+	return fill;
+
+}
+
 DOMDocument *TXFMCipher::getDocument() {
 
 	return NULL;
@@ -33,12 +33,26 @@
 
 #include <xsec/transformers/TXFMBase.hpp>
 #include <xsec/enc/XSECCryptoSymmetricKey.hpp>
+#include <xsec/utils/XSECPlatformUtils.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
+
+#include <stdio.h>
+
+// Largest authentication tag that can be held back from the cipher text
+#define TXFMCIPHER_MAX_TAG			32
+// Cipher text (beyond the tag) gathered before the first AEAD decrypt, so
+// that it includes the IV
+#define TXFMCIPHER_AEAD_MIN_STEP	64
  
 /**
  * \brief Transformer to handle symmetric encryption.
  *
  * Note that there is no particular XML DSIG/XENC transform associated
  * with encryption, but this is a convenient way to handle this process.
+ *
+ * When decrypting an AEAD mode (GCM), the trailing tag is held back from
+ * the cipher text as it is read and handed to the key at the end.  What
+ * happens to plain text before then is set by setPlaintextRelease().
  * @ingroup internal
  */
 
@@ -65,6 +79,9 @@ public:
 
 	void setKey(unsigned char * key, unsigned int keyLen);
 
+	// When AEAD plain text is released (defaults to the library setting)
+	void setPlaintextRelease(XSECPlatformUtils::PlaintextRelease release) {m_release = release;}
+
 	// Methods to set input data
 
 	virtual void setInput(TXFMBase * newInput);
@@ -79,14 +96,30 @@ public:
 private:
 	TXFMCipher();
 
+	void decryptAEADStep(void);
+	void spoolAEAD(void);
+	unsigned int readSpool(XMLByte * const toFill, const unsigned int maxToFill);
+
 	bool					m_doEncrypt;		// Are we in encrypt (or decrypt) mode
     unsigned int            m_taglen;           // Length of Authentication Tag for AEAD ciphers
 	XSECCryptoKey			* mp_cipher;		// Crypto implementation
 	bool					m_complete;
-	unsigned char			m_inputBuffer[2050];
+	unsigned char			m_inputBuffer[2048 + TXFMCIPHER_MAX_TAG + TXFMCIPHER_AEAD_MIN_STEP];
 	unsigned char			m_outputBuffer[3072];	// Always keep 2K of data
 	unsigned int			m_remaining;		// Amount remaining in output
 
+	// AEAD decryption
+	bool					m_aead;				// Decrypting cipher text with a trailing tag
+	unsigned int			m_held;				// Cipher text held back in m_inputBuffer
+	XMLFilePos				m_consumed;			// Cipher text read from the input in total
+	XSECPlatformUtils::PlaintextRelease
+							m_release;
+	bool					m_spooled;			// Plain text verified and waiting in the spool
+	safeBuffer				m_spoolBuf;
+	XMLFilePos				m_spoolLen;			// 64 bit, as a file spool may pass 4GB
+	XMLFilePos				m_spoolPos;
+	FILE					* mp_spoolFile;
+
 };
 
 #endif /* TXFMCIPHER_INCLUDE */
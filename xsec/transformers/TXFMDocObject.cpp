@@ -29,6 +29,7 @@
 #include <xsec/transformers/TXFMDocObject.hpp>
 #include <xsec/framework/XSECException.hpp>
 #include <xsec/utils/XSECDOMUtils.hpp>
+#include <xsec/utils/XSECIdIndex.hpp>
 
 XERCES_CPP_NAMESPACE_USE
 
@@ -60,59 +61,6 @@ void TXFMDocObject::setInput(TXFMBase *newInput) {
 
 }
 
-DOMNode * findDSIGId(DOMNode *current, const XMLCh * newFragmentId, const XSECEnv * env) {
-
-	DOMNode *tmp, *ret;
-	DOMNamedNodeMap *atts;
-
-	if (current->getNodeType() == DOMNode::ELEMENT_NODE) {
-
-		atts = current->getAttributes();
-		if (atts != NULL) {
-			int sz = env->getIdAttributeNameListSize();
-			for (int i = 0; i < sz ; ++i) {
-				if (env->getIdAttributeNameListItemIsNS(i) == false) {
-					tmp = atts->getNamedItem(env->getIdAttributeNameListItem(i));
-					if (tmp != 0 && strEquals(tmp->getNodeValue(), newFragmentId)) {
-
-						// Found it!
-
-						return current;
-					}
-				}
-
-				else {
-					// This is a namespace aware Id
-					tmp = atts->getNamedItemNS(env->getIdAttributeNameListItemNS(i),
-											   env->getIdAttributeNameListItem(i));
-					if (tmp != 0 && strEquals(tmp->getNodeValue(), newFragmentId)) {
-						return current;
-					}
-
-				}
-
-			}
-
-		}
-
-	}
-
-	// Check children
-
-	tmp = current->getFirstChild();
-	while (tmp != NULL) {
-
-		if ((ret = findDSIGId(tmp, newFragmentId, env)) != 0)
-			return ret;
-
-		tmp = tmp->getNextSibling();
-
-	}
-
-	return NULL;
-
-}
-
 void TXFMDocObject::setInput(DOMDocument *doc, const XMLCh * newFragmentId) {
 
 	// We have a document fragment marked by an objectID string.
@@ -125,9 +73,10 @@ void TXFMDocObject::setInput(DOMDocument *doc, const XMLCh * newFragmentId) {
 
 		// It might be that no DSIG DTD was attached and that the ID is in a
 		// DSIG element and the application is permitting attribute name based
-		// Id searches
+		// Id searches.  These go via the document's Id index rather than
+		// walking the whole document each time.
 
-		fragmentObject = findDSIGId(doc, newFragmentId, mp_env);
+		fragmentObject = XSECIdIndex::findElementById(doc, newFragmentId, mp_env);
 
 	}
 
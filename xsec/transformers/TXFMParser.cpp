@@ -33,6 +33,7 @@
 #include <xsec/utils/XSECPlatformUtils.hpp>
 #include <xsec/framework/XSECError.hpp>
 #include <xsec/utils/XSECTXFMInputSource.hpp>
+#include <xsec/utils/XSECParserPool.hpp>
 
 #include <xercesc/parsers/XercesDOMParser.hpp>
 #include <xercesc/framework/MemBufInputSource.hpp>
@@ -110,22 +111,17 @@ void TXFMParser::setInput(TXFMBase *newInput) {
 
 	XSECTXFMInputSource is(chain, false);
 
-	// Create a XercesParser and parse!
-	XercesDOMParser parser;
+	// Borrow a pooled parser and parse!
+	XSECParserPoolJanitor j_parser;
+	XercesDOMParser * parser = j_parser.get();
 
-	parser.setDoNamespaces(true);
-	parser.setLoadExternalDTD(false);
-
-	SecurityManager securityManager;
-	securityManager.setEntityExpansionLimit(XSEC_ENTITY_EXPANSION_LIMIT);
-	parser.setSecurityManager(&securityManager);
-
-	parser.parse(is);
-    xsecsize_t errorCount = parser.getErrorCount();
+	parser->parse(is);
+    xsecsize_t errorCount = parser->getErrorCount();
     if (errorCount > 0)
 		throw XSECException(XSECException::XSLError, "Errors occured parsing BYTE STREAM");
 
-    mp_parsedDoc = parser.adoptDocument();
+    mp_parsedDoc = parser->adoptDocument();
+	j_parser.done();
 
 	// Clean up
 
@@ -124,7 +124,19 @@ void TXFMSHA1::setInput(TXFMBase * inputT) {
 
 	keepComments = input->getCommentsStatus();
 
-	// Now run through the data
+	// Now run through the data - directly if the input is already in memory
+	const XMLByte * data;
+	XMLSize_t dataLen;
+
+	if (input->getContiguousBytes(data, dataLen)) {
+		while (dataLen > 0) {
+			unsigned int size = (dataLen > TXFM_HASH_MAX_BLOCK ? TXFM_HASH_MAX_BLOCK : (unsigned int) dataLen);
+			mp_h->hash((unsigned char *) data, size);
+			data += size;
+			dataLen -= size;
+		}
+	}
+
 	unsigned char buffer[1024];
 	unsigned int size;
 
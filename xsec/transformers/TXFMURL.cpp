@@ -29,6 +29,10 @@
 #include <xsec/transformers/TXFMURL.hpp>
 #include <xsec/framework/XSECError.hpp>
 
+#if !defined(_WIN32)
+#	include <xsec/utils/unixutils/XSECBinMMapFileInputStream.hpp>
+#endif
+
 // To catch exceptions
 
 #include <xercesc/util/XMLNetAccessor.hpp>
@@ -142,6 +146,23 @@ unsigned int TXFMURL::readBytes(XMLByte * const toFill, unsigned int maxToFill)
 
 }
 
+bool TXFMURL::getContiguousBytes(const XMLByte *& data, XMLSize_t & len) {
+
+#if !defined(_WIN32)
+	// Local files on UNIX are mapped by the default resolver
+	XSECBinMMapFileInputStream * mis = dynamic_cast<XSECBinMMapFileInputStream *>(is);
+
+	if (done || mis == NULL || !mis->getRemainingBytes(data, len))
+		return false;
+
+	done = true;
+	return true;
+#else
+	return false;
+#endif
+
+}
+
 DOMDocument *TXFMURL::getDocument() {
 
 	return NULL;
@@ -71,6 +71,7 @@ public:
 	// Methods to get output data
 
 	virtual unsigned int readBytes(XMLByte * const toFill, const unsigned int maxToFill);
+	virtual bool getContiguousBytes(const XMLByte *& data, XMLSize_t & len);
 	virtual XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument *getDocument();
 	virtual XERCES_CPP_NAMESPACE_QUALIFIER DOMNode *getFragmentNode();
 	virtual const XMLCh * getFragmentId();
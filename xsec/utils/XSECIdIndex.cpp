@@ -0,0 +1,324 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECIdIndex := Per-document index of elements by Id attribute
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/utils/XSECIdIndex.hpp>
+#include <xsec/utils/XSECDOMUtils.hpp>
+#include <xsec/framework/XSECEnv.hpp>
+#include <xsec/framework/XSECDocumentContext.hpp>
+#include <xsec/framework/XSECError.hpp>
+
+// Xerces
+
+#include <xercesc/util/Mutexes.hpp>
+#include <xercesc/util/XMLString.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Index state
+// --------------------------------------------------------------------------------
+
+namespace {
+
+	// Id strings are keyed on their raw UTF-16 bytes
+
+	std::string makeKey(const XMLCh * str) {
+
+		return std::string((const char *) str, XMLString::stringLen(str) * sizeof(XMLCh));
+
+	}
+
+	void appendUTF8(std::string & str, const XMLCh * in) {
+
+		char * utf8 = transcodeToUTF8(in);
+		if (utf8 != NULL) {
+			str += utf8;
+			XSEC_RELEASE_XMLCH(utf8);
+		}
+
+	}
+
+	// Does the element (still) carry the Id?
+
+	bool hasId(const DOMElement * elt, const XMLCh * id, const XSECEnv * env) {
+
+		int sz = env->getIdAttributeNameListSize();
+		const XMLCh * value;
+
+		for (int i = 0; i < sz; ++i) {
+
+			if (env->getIdAttributeNameListItemIsNS(i))
+				value = elt->getAttributeNS(env->getIdAttributeNameListItemNS(i),
+											env->getIdAttributeNameListItem(i));
+			else
+				value = elt->getAttribute(env->getIdAttributeNameListItem(i));
+
+			if (value != NULL && strEquals(value, id))
+				return true;
+
+		}
+
+		return false;
+
+	}
+
+	bool isInDocument(const DOMNode * n, const DOMDocument * doc) {
+
+		while (n != NULL && n != doc)
+			n = n->getParentNode();
+
+		return n != NULL;
+
+	}
+
+}
+
+struct XSECIdIndex::IndexState {
+
+	typedef std::map<std::string, DOMElement *>	ElementMapType;
+
+	IndexState() : mp_doc(NULL), m_stale(true) {}
+
+	XMLMutex				m_mutex;
+	ElementMapType			m_elements;
+	std::set<std::string>	m_duplicates;
+	std::string				m_config;
+	DOMDocument				* mp_doc;
+	bool					m_stale;
+
+	void addElement(DOMElement * elt, const XMLCh * id) {
+
+		std::string key = makeKey(id);
+
+		ElementMapType::iterator i = m_elements.find(key);
+
+		if (i == m_elements.end())
+			m_elements[key] = elt;
+		else if (i->second != elt)
+			m_duplicates.insert(key);
+
+	}
+
+};
+
+// --------------------------------------------------------------------------------
+//           Constructors and Destructors
+// --------------------------------------------------------------------------------
+
+XSECIdIndex::XSECIdIndex() {
+
+	XSECnew(mp_state, IndexState);
+
+}
+
+XSECIdIndex::~XSECIdIndex() {
+
+	delete mp_state;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Build
+// --------------------------------------------------------------------------------
+
+std::string XSECIdIndex::makeConfigKey(const XSECEnv * env) {
+
+	// Identifies the Id attributes searched for.  Only ever compared.
+
+	std::string ret(env->getIdByAttributeName() ? "+" : "-");
+	int sz = env->getIdAttributeNameListSize();
+
+	for (int i = 0; i < sz; ++i) {
+
+		if (env->getIdAttributeNameListItemIsNS(i)) {
+			ret += '\1';
+			appendUTF8(ret, env->getIdAttributeNameListItemNS(i));
+		}
+		ret += '\2';
+		appendUTF8(ret, env->getIdAttributeNameListItem(i));
+
+	}
+
+	return ret;
+
+}
+
+bool XSECIdIndex::needsBuild(DOMDocument * doc, const XSECEnv * env) {
+
+	// Lock must be held
+	return mp_state->m_stale || mp_state->mp_doc != doc || mp_state->m_config != makeConfigKey(env);
+
+}
+
+void XSECIdIndex::build(DOMDocument * doc, const XSECEnv * env) {
+
+	// Lock must be held.  Only reads the document.
+
+	mp_state->m_elements.clear();
+	mp_state->m_duplicates.clear();
+	mp_state->m_config = makeConfigKey(env);
+	mp_state->mp_doc = doc;
+	mp_state->m_stale = false;
+
+	int sz = env->getIdAttributeNameListSize();
+
+	// Walk the tree in document order without recursing
+
+	DOMNode * n = doc->getDocumentElement();
+
+	while (n != NULL) {
+
+		if (n->getNodeType() == DOMNode::ELEMENT_NODE && n->hasAttributes()) {
+
+			DOMElement * elt = (DOMElement *) n;
+			DOMNamedNodeMap * atts = elt->getAttributes();
+			DOMNode * att;
+
+			for (int i = 0; i < sz; ++i) {
+
+				if (env->getIdAttributeNameListItemIsNS(i))
+					att = atts->getNamedItemNS(env->getIdAttributeNameListItemNS(i),
+											   env->getIdAttributeNameListItem(i));
+				else
+					att = atts->getNamedItem(env->getIdAttributeNameListItem(i));
+
+				if (att != NULL)
+					mp_state->addElement(elt, att->getNodeValue());
+
+			}
+
+		}
+
+		// Next node
+
+		if (n->getFirstChild() != NULL) {
+			n = n->getFirstChild();
+			continue;
+		}
+
+		while (n != NULL && n->getNextSibling() == NULL) {
+			n = n->getParentNode();
+			if (n == doc)
+				n = NULL;
+		}
+
+		if (n != NULL)
+			n = n->getNextSibling();
+
+	}
+
+}
+
+void XSECIdIndex::prepare(DOMDocument * doc, const XSECEnv * env) {
+
+	XMLMutexLock lock(&mp_state->m_mutex);
+
+	if (needsBuild(doc, env))
+		build(doc, env);
+
+}
+
+void XSECIdIndex::invalidate(void) {
+
+	XMLMutexLock lock(&mp_state->m_mutex);
+
+	mp_state->m_stale = true;
+	mp_state->mp_doc = NULL;
+	mp_state->m_elements.clear();
+	mp_state->m_duplicates.clear();
+
+}
+
+// --------------------------------------------------------------------------------
+//           Lookups
+// --------------------------------------------------------------------------------
+
+DOMElement * XSECIdIndex::find(DOMDocument * doc, const XMLCh * id, const XSECEnv * env) {
+
+	XMLMutexLock lock(&mp_state->m_mutex);
+
+	std::string key = makeKey(id);
+	bool built = false;
+
+	if (needsBuild(doc, env)) {
+		build(doc, env);
+		built = true;
+	}
+
+	for (;;) {
+
+		if (mp_state->m_duplicates.count(key) > 0) {
+
+			throw XSECException(XSECException::IDNotFoundInDOMDoc,
+				"Referenced Id appears on more than one element in the document");
+
+		}
+
+		IndexState::ElementMapType::iterator i = mp_state->m_elements.find(key);
+
+		if (i != mp_state->m_elements.end() &&
+			hasId(i->second, id, env) && isInDocument(i->second, doc))
+			return i->second;
+
+		// Either not there or out of date.  Only worth trying again if the
+		// index wasn't just built.
+
+		if (built)
+			return NULL;
+
+		build(doc, env);
+		built = true;
+
+	}
+
+}
+
+XSECIdIndex * XSECIdIndex::getIndex(DOMDocument * doc, const XSECEnv * env) {
+
+	XSECDocumentContext * ctx = env->getDocumentContext();
+
+	if (ctx != NULL && ctx->getDocument() == doc)
+		return ctx->getIdIndex();
+
+	return env->getIdIndex();
+
+}
+
+DOMElement * XSECIdIndex::findElementById(DOMDocument * doc,
+										  const XMLCh * id,
+										  const XSECEnv * env) {
+
+	return getIndex(doc, env)->find(doc, id, env);
+
+}
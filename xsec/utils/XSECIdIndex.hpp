@@ -0,0 +1,175 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECIdIndex := Per-document index of elements by Id attribute
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECIDINDEX_INCLUDE
+#define XSECIDINDEX_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+
+#include <xercesc/dom/DOM.hpp>
+
+#include <string>
+
+class XSECEnv;
+
+/**
+ * \brief Index of the elements in a document by Id attribute value
+ * @ingroup internal
+ *
+ * When an Id cannot be found via DOMDocument::getElementById() and the
+ * environment allows Ids to be found by attribute name, the library used
+ * to walk the whole document for each lookup.  An index instead records
+ * every element carrying one of the environment's Id attributes
+ * (namespaced or not) the first time the document is searched, and is
+ * used for all later lookups until it is invalidated.
+ *
+ * Each XSECEnv owns an index for its document, which is invalidated at
+ * the start of every sign and verify.  An XSECDocumentContext holds one
+ * that is shared by all the signatures attached to it.  Nothing is
+ * written to the document, so an index can be built and searched while
+ * other threads read the document.  Lookups are serialised by a lock
+ * held by the index.
+ *
+ * An Id found on more than one element is recorded as a duplicate, and
+ * looking it up throws rather than picking one of the elements.  The
+ * index is rebuilt if the environment's Id attribute names change.  Each
+ * hit is checked against the element itself (it must still carry the Id
+ * and be in the document), and a miss rebuilds the index once, so Ids
+ * that have been added, changed or moved are found.
+ *
+ * @note Changes that could create a duplicate of an already indexed Id
+ * are not seen until the index is invalidated.
+ */
+
+class XSECIdIndex {
+
+public:
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	XSECIdIndex();
+	~XSECIdIndex();
+
+	//@}
+
+	/** @name Lookups */
+	//@{
+
+	/**
+	 * \brief Find the element with the given Id
+	 *
+	 * The index is (re)built if it is stale, was built for another
+	 * document or for other Id attribute names.
+	 *
+	 * @param doc The document to search
+	 * @param id The Id value
+	 * @param env The environment whose Id attribute names are used
+	 * @returns The element, or NULL if there is none.
+	 * @throws XSECException if more than one element has the Id
+	 */
+
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMElement * find(
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc,
+		const XMLCh * id,
+		const XSECEnv * env
+	);
+
+	/**
+	 * \brief Build the index now if a lookup would
+	 *
+	 * Lets the walk of the document happen before work is handed to
+	 * other threads.
+	 *
+	 * @param doc The document to be searched
+	 * @param env The environment whose Id attribute names are used
+	 */
+
+	void prepare(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc, const XSECEnv * env);
+
+	/**
+	 * \brief Discard the index, so the next lookup builds it again
+	 */
+
+	void invalidate(void);
+
+	/**
+	 * \brief Find the element with the given Id using the environment's index
+	 *
+	 * Uses the index of the environment's document context if the
+	 * document is the context's, otherwise that of the environment.
+	 *
+	 * @param doc The document to search
+	 * @param id The Id value
+	 * @param env The environment whose Id attribute names are used
+	 * @returns The element, or NULL if there is none.
+	 * @throws XSECException if more than one element has the Id
+	 */
+
+	static XERCES_CPP_NAMESPACE_QUALIFIER DOMElement * findElementById(
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc,
+		const XMLCh * id,
+		const XSECEnv * env
+	);
+
+	/**
+	 * \brief Return the index the environment uses for a document
+	 */
+
+	static XSECIdIndex * getIndex(
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc,
+		const XSECEnv * env
+	);
+
+	/**
+	 * \brief Identify how the environment finds Ids
+	 *
+	 * @returns A string that differs between environments that could
+	 * resolve the same Id to different elements
+	 */
+
+	static std::string makeConfigKey(const XSECEnv * env);
+
+	//@}
+
+private:
+
+	struct IndexState;
+
+	void build(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc, const XSECEnv * env);
+	bool needsBuild(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument * doc, const XSECEnv * env);
+
+	// Unimplemented
+	XSECIdIndex(const XSECIdIndex &);
+	XSECIdIndex & operator = (const XSECIdIndex &);
+
+	IndexState		* mp_state;
+
+};
+
+#endif /* XSECIDINDEX_INCLUDE */
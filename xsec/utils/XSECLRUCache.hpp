@@ -0,0 +1,202 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * XSEC
+ *
+ * XSECLRUCache := Bounded, least recently used map used by the library caches
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECLRUCACHE_INCLUDE
+#define XSECLRUCACHE_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+#include <time.h>
+
+/**
+ * \addtogroup internal
+ * @{
+ */
+
+/**
+ * @brief Default release policy - values need no cleanup
+ */
+
+template <class V> struct XSECLRUNoRelease {
+	static void release(V &) {}
+};
+
+/**
+ * @brief Release policy for values that are owned pointers
+ */
+
+template <class V> struct XSECLRUDeleteRelease {
+	static void release(V & v) {delete v; v = 0;}
+};
+
+/**
+ * @brief Map of string keys to values, bounded by size and age
+ *
+ * Holds at most maxEntries values, discarding the least recently used
+ * when full.  With a non-zero maxAge, entries expire that many seconds
+ * after they were last stored.  Values removed from the cache (evicted,
+ * expired, replaced by clear() or on destruction) are passed to
+ * R::release().
+ *
+ * Hits, misses and evictions are counted.  clear() keeps the counts.
+ *
+ * The class does no locking - the caches that use it hold their own
+ * mutex around every call.
+ */
+
+template <class V, class R = XSECLRUNoRelease<V> >
+class XSECLRUCache {
+
+public:
+
+	XSECLRUCache(unsigned int maxEntries, unsigned int maxAge = 0) :
+		m_maxEntries(maxEntries > 0 ? maxEntries : 1),
+		m_maxAge(maxAge),
+		m_hits(0),
+		m_misses(0),
+		m_evictions(0) {}
+
+	~XSECLRUCache() {clear();}
+
+	/**
+	 * \brief Find a value, making it the most recently used
+	 *
+	 * @returns The value held for key, or NULL if there is none (or it
+	 * has expired)
+	 */
+
+	V * find(const std::string & key) {
+
+		typename EntryMapType::iterator i = m_entries.find(key);
+		if (i == m_entries.end()) {
+			++m_misses;
+			return NULL;
+		}
+
+		if (m_maxAge > 0 && time(NULL) >= i->second.m_expires) {
+			removeEntry(i);
+			++m_misses;
+			return NULL;
+		}
+
+		++m_hits;
+		m_lru.splice(m_lru.begin(), m_lru, i->second.m_lru);
+
+		return &(i->second.m_value);
+
+	}
+
+	/**
+	 * \brief Find or create the slot for a key
+	 *
+	 * The entry becomes the most recently used and its age is reset,
+	 * making room first if the key is new.  A new slot holds V().
+	 *
+	 * @returns The slot for the caller to fill in
+	 */
+
+	V * store(const std::string & key) {
+
+		typename EntryMapType::iterator i = m_entries.find(key);
+
+		if (i == m_entries.end()) {
+
+			while (m_entries.size() >= m_maxEntries) {
+				removeEntry(m_entries.find(m_lru.back()));
+				++m_evictions;
+			}
+
+			m_lru.push_front(key);
+			i = m_entries.insert(typename EntryMapType::value_type(key, Entry())).first;
+			i->second.m_lru = m_lru.begin();
+
+		}
+		else {
+			m_lru.splice(m_lru.begin(), m_lru, i->second.m_lru);
+		}
+
+		i->second.m_expires = time(NULL) + m_maxAge;
+
+		return &(i->second.m_value);
+
+	}
+
+	void clear(void) {
+
+		typename EntryMapType::iterator i;
+		for (i = m_entries.begin(); i != m_entries.end(); ++i)
+			R::release(i->second.m_value);
+
+		m_entries.clear();
+		m_lru.clear();
+
+	}
+
+	unsigned long getHits(void) const {return m_hits;}
+	unsigned long getMisses(void) const {return m_misses;}
+	unsigned long getEvictions(void) const {return m_evictions;}
+	unsigned int getSize(void) const {return (unsigned int) m_entries.size();}
+
+private:
+
+	struct Entry {
+		Entry() : m_value(), m_expires(0) {}
+		V										m_value;
+		time_t									m_expires;
+		std::list<std::string>::iterator		m_lru;
+	};
+
+	typedef std::map<std::string, Entry>		EntryMapType;
+
+	// Unimplemented
+	XSECLRUCache(const XSECLRUCache &);
+	XSECLRUCache & operator = (const XSECLRUCache &);
+
+	void removeEntry(typename EntryMapType::iterator i) {
+		R::release(i->second.m_value);
+		m_lru.erase(i->second.m_lru);
+		m_entries.erase(i);
+	}
+
+	unsigned int								m_maxEntries;
+	unsigned int								m_maxAge;
+	EntryMapType								m_entries;
+	std::list<std::string>						m_lru;		// Most recent first
+	unsigned long								m_hits;
+	unsigned long								m_misses;
+	unsigned long								m_evictions;
+
+};
+
+/** @} */
+
+#endif /* XSECLRUCACHE_INCLUDE */
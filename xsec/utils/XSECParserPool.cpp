@@ -0,0 +1,277 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECParserPool := Per-thread pool of re-usable Xerces DOM parsers
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/utils/XSECParserPool.hpp>
+#include <xsec/utils/XSECPlatformUtils.hpp>
+#include <xsec/framework/XSECError.hpp>
+
+// Xerces
+
+#include <xercesc/parsers/XercesDOMParser.hpp>
+#include <xercesc/util/SecurityManager.hpp>
+#include <xercesc/util/Mutexes.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+
+XERCES_CPP_NAMESPACE_USE
+
+// --------------------------------------------------------------------------------
+//           Pooled parser
+// --------------------------------------------------------------------------------
+
+namespace {
+
+	// A parser that carries its own SecurityManager, so the manager
+	// lives exactly as long as the parser that refers to it
+
+	class XSECPooledDOMParser : public XercesDOMParser {
+
+	public:
+
+		XSECPooledDOMParser(XMLGrammarPool * grammarPool) :
+			XercesDOMParser(0, XMLPlatformUtils::fgMemoryManager, grammarPool) {
+
+			m_securityManager.setEntityExpansionLimit(XSEC_ENTITY_EXPANSION_LIMIT);
+
+		}
+
+		void configure(void) {
+
+			setDoNamespaces(true);
+			setLoadExternalDTD(false);
+			setSecurityManager(&m_securityManager);
+
+			// The shared pool is locked (see acquireParser()), so only
+			// read from it
+			if (getGrammarPool() != NULL) {
+				useCachedGrammarInParse(true);
+				cacheGrammarFromParse(false);
+			}
+
+		}
+
+	private:
+
+		SecurityManager		m_securityManager;
+
+	};
+
+#if defined(XSEC_NO_NAMESPACES)
+	typedef vector<XSECPooledDOMParser *>		ParserVectorType;
+	typedef vector<ParserVectorType *>			ParserListVectorType;
+#else
+	typedef std::vector<XSECPooledDOMParser *>	ParserVectorType;
+	typedef std::vector<ParserVectorType *>		ParserListVectorType;
+#endif
+
+	// Every per-thread list is also held here, so Terminate() can
+	// clean up after threads that are still running (or, on Windows,
+	// that have exited without a TLS destructor being run).
+
+	XMLMutex				* s_registryMutex = NULL;
+	ParserListVectorType	* s_registry = NULL;
+
+#if defined(_WIN32)
+	DWORD					s_tlsIndex = TLS_OUT_OF_INDEXES;
+#else
+	pthread_key_t			s_tlsKey;
+#endif
+
+	void deleteParserList(ParserVectorType * lst) {
+
+		ParserVectorType::iterator i;
+		for (i = lst->begin(); i != lst->end(); ++i)
+			delete *i;
+
+		delete lst;
+
+	}
+
+	ParserVectorType * getThreadList(bool create) {
+
+		ParserVectorType * lst;
+
+#if defined(_WIN32)
+		lst = (ParserVectorType *) TlsGetValue(s_tlsIndex);
+#else
+		lst = (ParserVectorType *) pthread_getspecific(s_tlsKey);
+#endif
+
+		if (lst != NULL || !create)
+			return lst;
+
+		XSECnew(lst, ParserVectorType);
+		lst->reserve(XSEC_PARSER_POOL_MAX_PER_THREAD);
+
+		{
+			XMLMutexLock lock(s_registryMutex);
+			s_registry->push_back(lst);
+		}
+
+#if defined(_WIN32)
+		TlsSetValue(s_tlsIndex, lst);
+#else
+		pthread_setspecific(s_tlsKey, lst);
+#endif
+
+		return lst;
+
+	}
+
+}
+
+#if !defined(_WIN32)
+
+// Called by pthreads as each thread that used the pool exits
+
+extern "C" void XSECParserPoolThreadCleanup(void * arg) {
+
+	ParserVectorType * lst = (ParserVectorType *) arg;
+
+	if (s_registryMutex == NULL)
+		return;
+
+	{
+		XMLMutexLock lock(s_registryMutex);
+		ParserListVectorType::iterator i =
+			std::find(s_registry->begin(), s_registry->end(), lst);
+		if (i == s_registry->end())
+			return;		// Already cleaned up by Terminate
+		s_registry->erase(i);
+	}
+
+	deleteParserList(lst);
+
+}
+
+#endif
+
+// --------------------------------------------------------------------------------
+//           Initialise and Terminate
+// --------------------------------------------------------------------------------
+
+void XSECParserPool::Initialise(void) {
+
+	XSECnew(s_registry, ParserListVectorType);
+	XSECnew(s_registryMutex, XMLMutex);
+
+#if defined(_WIN32)
+	s_tlsIndex = TlsAlloc();
+	if (s_tlsIndex == TLS_OUT_OF_INDEXES)
+#else
+	if (pthread_key_create(&s_tlsKey, XSECParserPoolThreadCleanup) != 0)
+#endif
+		throw XSECException(XSECException::InternalError,
+			"XSECParserPool::Initialise - Unable to allocate thread local storage");
+
+}
+
+void XSECParserPool::Terminate(void) {
+
+	if (s_registryMutex == NULL)
+		return;
+
+	{
+		XMLMutexLock lock(s_registryMutex);
+
+		ParserListVectorType::iterator i;
+		for (i = s_registry->begin(); i != s_registry->end(); ++i)
+			deleteParserList(*i);
+
+		s_registry->clear();
+	}
+
+#if defined(_WIN32)
+	TlsFree(s_tlsIndex);
+	s_tlsIndex = TLS_OUT_OF_INDEXES;
+#else
+	pthread_key_delete(s_tlsKey);
+#endif
+
+	delete s_registry;
+	s_registry = NULL;
+	delete s_registryMutex;
+	s_registryMutex = NULL;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Acquire and release
+// --------------------------------------------------------------------------------
+
+XercesDOMParser * XSECParserPool::acquireParser(void) {
+
+	XSECPooledDOMParser * ret;
+
+	// No more grammars once anything may be reading the pool
+	XSECPlatformUtils::LockGrammarPool();
+
+	ParserVectorType * lst = (s_registryMutex != NULL ? getThreadList(true) : NULL);
+
+	if (lst != NULL && !lst->empty()) {
+		ret = lst->back();
+		lst->pop_back();
+	}
+	else {
+		XSECnew(ret, XSECPooledDOMParser(XSECPlatformUtils::GetGrammarPool()));
+	}
+
+	ret->configure();
+	return ret;
+
+}
+
+void XSECParserPool::releaseParser(XercesDOMParser * parser) {
+
+	if (parser == NULL)
+		return;
+
+	XSECPooledDOMParser * p = (XSECPooledDOMParser *) parser;
+
+	// Drop any document the caller didn't adopt
+	p->resetDocumentPool();
+
+	ParserVectorType * lst = (s_registryMutex != NULL ? getThreadList(false) : NULL);
+
+	if (lst == NULL || lst->size() >= XSEC_PARSER_POOL_MAX_PER_THREAD) {
+		delete p;
+		return;
+	}
+
+	lst->push_back(p);
+
+}
@@ -0,0 +1,147 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECParserPool := Per-thread pool of re-usable Xerces DOM parsers
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECPARSERPOOL_INCLUDE
+#define XSECPARSERPOOL_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+
+#include <xercesc/parsers/XercesDOMParser.hpp>
+
+/**
+ * \brief Pool of DOM parsers used internally by the library
+ * @ingroup internal
+ *
+ * Creating a XercesDOMParser is comparatively expensive (scanner,
+ * validators, string pools and buffers are all built up front), and
+ * the library parses small byte streams frequently (re-parsing
+ * transform output, de-serialising decrypted content).  This class
+ * hands out parsers from a free list held per thread, so no locking
+ * is needed on the hot path.  Each thread keeps at most
+ * XSEC_PARSER_POOL_MAX_PER_THREAD idle parsers - any beyond that are
+ * deleted when returned.
+ *
+ * All parsers share the grammar pool owned by XSECPlatformUtils.  They
+ * use the grammars loaded into it by XSECPlatformUtils::LoadGrammar(),
+ * and the pool is locked when the first parser is acquired.
+ *
+ * Parsers are (re)configured on acquisition with namespace processing
+ * on, external DTD loading off and an entity expansion limit of
+ * XSEC_ENTITY_EXPANSION_LIMIT.
+ *
+ * @note Any document still owned by a parser (i.e. not adopted) is
+ * released when the parser is returned to the pool.
+ */
+
+#define XSEC_PARSER_POOL_MAX_PER_THREAD		4
+
+class XSECParserPool {
+
+public:
+
+	/**
+	 * \brief Obtain a parser for use by the calling thread
+	 *
+	 * @returns A configured parser.  Must be handed back via
+	 * releaseParser() on the same thread.
+	 */
+
+	static XERCES_CPP_NAMESPACE_QUALIFIER XercesDOMParser * acquireParser(void);
+
+	/**
+	 * \brief Return a parser to the calling thread's pool
+	 *
+	 * @param parser The parser previously obtained from acquireParser()
+	 */
+
+	static void releaseParser(XERCES_CPP_NAMESPACE_QUALIFIER XercesDOMParser * parser);
+
+	/**
+	 * \brief Set up the pool.  Called from XSECPlatformUtils::Initialise()
+	 */
+
+	static void Initialise(void);
+
+	/**
+	 * \brief Delete all pooled parsers for all threads.
+	 *
+	 * Called from XSECPlatformUtils::Terminate()
+	 */
+
+	static void Terminate(void);
+
+private:
+
+	XSECParserPool();
+
+};
+
+/**
+ * \brief Janitor to hand a pooled parser back on scope exit
+ * @ingroup internal
+ *
+ * The parser only goes back into the pool once the caller has marked
+ * the parse as complete with done().  A parser abandoned part way
+ * through a parse (e.g. by an exception) is deleted instead.
+ */
+
+class XSECParserPoolJanitor {
+
+public:
+
+	XSECParserPoolJanitor() :
+		mp_parser(XSECParserPool::acquireParser()),
+		m_done(false) {}
+
+	~XSECParserPoolJanitor() {
+		if (m_done)
+			XSECParserPool::releaseParser(mp_parser);
+		else
+			delete mp_parser;
+	}
+
+	XERCES_CPP_NAMESPACE_QUALIFIER XercesDOMParser * get(void) {return mp_parser;}
+
+	/**
+	 * \brief Mark the parse as complete so the parser can be re-used
+	 */
+
+	void done(void) {m_done = true;}
+
+private:
+
+	// Unimplemented
+	XSECParserPoolJanitor(const XSECParserPoolJanitor &);
+	XSECParserPoolJanitor & operator = (const XSECParserPoolJanitor &);
+
+	XERCES_CPP_NAMESPACE_QUALIFIER XercesDOMParser		* mp_parser;
+	bool												m_done;
+
+};
+
+#endif /* XSECPARSERPOOL_INCLUDE */
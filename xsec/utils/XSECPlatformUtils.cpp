@@ -37,6 +37,12 @@
 #include <xsec/xkms/XKMSConstants.hpp>
 #include <xsec/framework/XSECAlgorithmMapper.hpp>
 #include <xsec/transformers/TXFMOutputFile.hpp>
+#include <xsec/utils/XSECParserPool.hpp>
+#include <xsec/utils/XSECThreadPool.hpp>
+
+#include <xercesc/internal/XMLGrammarPoolImpl.hpp>
+#include <xercesc/parsers/XercesDOMParser.hpp>
+#include <xercesc/util/Mutexes.hpp>
 
 #include "../xenc/impl/XENCCipherImpl.hpp"
 
@@ -44,6 +50,8 @@ XERCES_CPP_NAMESPACE_USE
 
 #if defined(_WIN32)
 #include <xsec/utils/winutils/XSECBinHTTPURIInputStream.hpp>
+#else
+#include <xsec/utils/unixutils/XSECHTTPConnectionPool.hpp>
 #endif
 
 #if defined (XSEC_HAVE_OPENSSL)
@@ -68,6 +76,16 @@ const XSECAlgorithmMapper * XSECPlatformUtils::g_algorithmMapper = NULL;
 XSECAlgorithmMapper * internalMapper = NULL;
 
 XSECPlatformUtils::TransformFactory* XSECPlatformUtils::g_loggingSink = NULL;
+XSECPlatformUtils::PlaintextRelease XSECPlatformUtils::g_plaintextRelease =
+	XSECPlatformUtils::PLAINTEXT_BUFFER_MEMORY;
+
+XMLGrammarPool* XSECPlatformUtils::g_grammarPool = NULL;
+XMLMutex* XSECPlatformUtils::g_grammarPoolMutex = NULL;
+volatile bool XSECPlatformUtils::g_grammarPoolLocked = false;
+
+XSECThreadPool* XSECPlatformUtils::g_threadPool = NULL;
+XMLMutex* XSECPlatformUtils::g_threadPoolMutex = NULL;
+unsigned int XSECPlatformUtils::g_threadPoolSize = 0;
 
 // Determine default crypto provider
 
@@ -118,6 +136,23 @@ void XSECPlatformUtils::Initialise(XSECCryptoProvider * p) {
 	XSECnew(internalMapper, XSECAlgorithmMapper);
 	g_algorithmMapper = internalMapper;
 
+	// Shared grammar pool and per-thread parsers.  The pool takes
+	// grammars from LoadGrammar() until the first parser is handed out,
+	// then is locked so that concurrent parsers only ever read from it.
+	XSECnew(g_grammarPool, XMLGrammarPoolImpl(XMLPlatformUtils::fgMemoryManager));
+	XSECnew(g_grammarPoolMutex, XMLMutex);
+	g_grammarPoolLocked = false;
+
+	XSECParserPool::Initialise();
+
+	// Worker threads are only started when first needed
+	XSECnew(g_threadPoolMutex, XMLMutex);
+
+#if !defined(_WIN32)
+	// Keep-alive HTTP connections for URI resolution and SOAP
+	XSECHTTPConnectionPool::Initialise();
+#endif
+
 	// Initialise the XENCCipherImpl class
 	XENCCipherImpl::Initialise();
 
@@ -149,14 +184,92 @@ TXFMBase* XSECPlatformUtils::GetReferenceLoggingSink(DOMDocument* doc) {
     return (g_loggingSink ? g_loggingSink(doc) : NULL);
 }
 
+XMLGrammarPool* XSECPlatformUtils::GetGrammarPool(void) {
+
+    return g_grammarPool;
+
+}
+
+bool XSECPlatformUtils::LoadGrammar(const InputSource & source, Grammar::GrammarType grammarType) {
+
+    if (g_grammarPool == NULL)
+        return false;
+
+    XMLMutexLock lock(g_grammarPoolMutex);
+
+    if (g_grammarPoolLocked)
+        return false;
+
+    XercesDOMParser parser(0, XMLPlatformUtils::fgMemoryManager, g_grammarPool);
+    parser.setDoNamespaces(true);
+    parser.setDoSchema(grammarType == Grammar::SchemaGrammarType);
+    parser.setLoadExternalDTD(false);
+
+    return (parser.loadGrammar(source, grammarType, true) != NULL);
+
+}
+
+void XSECPlatformUtils::LockGrammarPool(void) {
+
+    if (g_grammarPool == NULL || g_grammarPoolLocked)
+        return;
+
+    XMLMutexLock lock(g_grammarPoolMutex);
+
+    if (!g_grammarPoolLocked) {
+        g_grammarPool->lockPool();
+        g_grammarPoolLocked = true;
+    }
+
+}
+
+XSECThreadPool* XSECPlatformUtils::GetThreadPool(void) {
+
+    XMLMutexLock lock(g_threadPoolMutex);
+
+    if (g_threadPool == NULL)
+        XSECnew(g_threadPool, XSECThreadPool(g_threadPoolSize > 0 ?
+            g_threadPoolSize : XSECThreadPool::getDefaultThreadCount()));
+
+    return g_threadPool;
+
+}
+
+bool XSECPlatformUtils::SetThreadPoolSize(unsigned int numThreads) {
+
+    XMLMutexLock lock(g_threadPoolMutex);
+
+    if (g_threadPool != NULL)
+        return false;
+
+    g_threadPoolSize = numThreads;
+    return true;
+
+}
+
 void XSECPlatformUtils::Terminate(void) {
 
 	if (--initCount > 0)
 		return;
 
+	// Stop any worker threads before what they use goes away
+	delete g_threadPool;
+	g_threadPool = NULL;
+	delete g_threadPoolMutex;
+	g_threadPoolMutex = NULL;
+
 	// Clean out the algorithm mapper
 	delete internalMapper;
 
+	// Pooled parsers reference the grammar pool, so go first
+	XSECParserPool::Terminate();
+
+	delete g_grammarPool;
+	g_grammarPool = NULL;
+	delete g_grammarPoolMutex;
+	g_grammarPoolMutex = NULL;
+	g_grammarPoolLocked = false;
+
 	if (g_cryptoProvider != NULL)
 		delete g_cryptoProvider;
 
@@ -166,6 +279,8 @@ void XSECPlatformUtils::Terminate(void) {
 	// Destroy anything platform specific
 #if defined(_WIN32)
 	XSECBinHTTPURIInputStream::Cleanup();
+#else
+	XSECHTTPConnectionPool::Terminate();
 #endif
 
 }
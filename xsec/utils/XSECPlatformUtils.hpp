@@ -32,6 +32,7 @@
 #define XSECPLATFORMUTILS_INCLUDE
 
 #include <xercesc/dom/DOM.hpp>
+#include <xercesc/validators/common/Grammar.hpp>
 
 // XSEC
 
@@ -41,6 +42,11 @@
 class TXFMBase;
 class XSECAlgorithmMapper;
 class XSECAlgorithmHandler;
+class XSECThreadPool;
+
+XSEC_DECLARE_XERCES_CLASS(XMLGrammarPool);
+XSEC_DECLARE_XERCES_CLASS(InputSource);
+XSEC_DECLARE_XERCES_CLASS(XMLMutex);
 
 #include <stdio.h>
 
@@ -203,6 +209,112 @@ public :
      */
     static TXFMBase* GetReferenceLoggingSink(XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc);
 
+    /**
+     * \brief Indicates whether Reference logging is installed
+     *
+     * @return  true if GetReferenceLoggingSink() would return a transform
+     */
+    static bool HasReferenceLoggingSink(void) {return g_loggingSink != NULL;}
+
+    /**
+     * \brief When the plain text of an authenticated cipher is released
+     *
+     * The authentication tag of AES-GCM follows the cipher text, so
+     * whether the plain text is genuine is only known once all of it has
+     * been decrypted.
+     */
+    enum PlaintextRelease {
+        /** Held in memory until the tag is checked (the default) */
+        PLAINTEXT_BUFFER_MEMORY,
+        /** Held in a temporary file until the tag is checked */
+        PLAINTEXT_BUFFER_FILE,
+        /** Released as it is decrypted.  A bad tag is reported (by an
+            exception) when the end of the plain text is reached, so the
+            caller must discard whatever it has read */
+        PLAINTEXT_STREAM
+    };
+
+    /**
+     * \brief Sets when AES-GCM plain text is handed to the caller
+     *
+     * Applies to decryption via XENCCipher::decryptElement() and
+     * XENCCipher::decryptToBinInputStream().
+     *
+     * @note This is <b>not</b> thread safe.  It should be set prior to
+     * any processing of encrypted data.
+     * @param release The policy to use
+     */
+    static void SetPlaintextRelease(PlaintextRelease release) {g_plaintextRelease = release;}
+
+    /**
+     * \brief Returns when AES-GCM plain text is handed to the caller
+     *
+     * @return  the current policy
+     */
+    static PlaintextRelease GetPlaintextRelease(void) {return g_plaintextRelease;}
+
+    /**
+     * \brief Returns the grammar pool shared by the library's parsers
+     *
+     * The pool is created (and locked, so it may be read from many threads
+     * at once) by Initialise() and deleted by Terminate().  All of the
+     * internal parsers handed out by XSECParserPool are attached to it.
+     *
+     * @return  the shared grammar pool, or NULL if the library is not initialised
+     */
+    static XERCES_CPP_NAMESPACE_QUALIFIER XMLGrammarPool* GetGrammarPool(void);
+
+    /**
+     * \brief Adds a grammar to the shared grammar pool
+     *
+     * Grammars (such as the schemas of the documents an application
+     * works with) must be loaded before the library first parses
+     * anything, as the pool is then locked.  Grammars met while parsing
+     * are never added - the internal DTD subset of one document would
+     * otherwise apply its entities to the next.
+     *
+     * @note This is <b>not</b> thread safe.  Grammars should be loaded
+     * prior to any processing of signatures etc.
+     * @param source  the grammar to load
+     * @param grammarType  the type of grammar (schema or DTD)
+     * @return  true if the grammar was loaded, false if it could not be
+     * or the pool is already locked
+     */
+    static bool LoadGrammar(const XERCES_CPP_NAMESPACE_QUALIFIER InputSource & source,
+        XERCES_CPP_NAMESPACE_QUALIFIER Grammar::GrammarType grammarType);
+
+    /**
+     * \brief Locks the shared grammar pool
+     *
+     * Once locked, the pool is only read from, so may be shared by
+     * parsers on many threads.  Called when the library first asks for
+     * a parser, so need only be called to lock the pool sooner.
+     */
+    static void LockGrammarPool(void);
+
+    /**
+     * \brief Returns the library's pool of worker threads
+     *
+     * The pool is started (with the number of threads set by
+     * SetThreadPoolSize(), by default one per online CPU) the first
+     * time it is requested, and stopped by Terminate().
+     *
+     * @return  the library thread pool
+     */
+    static XSECThreadPool* GetThreadPool(void);
+
+    /**
+     * \brief Sets the number of threads in the library's worker pool
+     *
+     * These threads digest prefetched and parallel References.  The
+     * size can only be set before the pool is first used.
+     *
+     * @param numThreads Number of worker threads, or 0 for one per
+     * online CPU
+     * @return  false if the pool has already been started
+     */
+    static bool SetThreadPoolSize(unsigned int numThreads);
+
 	/**
 	 * \brief Terminate
 	 *
@@ -218,6 +330,13 @@ public :
 
 private:
 	static TransformFactory* g_loggingSink;
+	static PlaintextRelease g_plaintextRelease;
+	static XERCES_CPP_NAMESPACE_QUALIFIER XMLGrammarPool* g_grammarPool;
+	static XERCES_CPP_NAMESPACE_QUALIFIER XMLMutex* g_grammarPoolMutex;
+	static volatile bool g_grammarPoolLocked;
+	static XSECThreadPool* g_threadPool;
+	static XERCES_CPP_NAMESPACE_QUALIFIER XMLMutex* g_threadPoolMutex;
+	static unsigned int g_threadPoolSize;
 };
 
 
@@ -0,0 +1,287 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECThreadPool := Simple pool of worker threads
+ *
+ * $Id$
+ *
+ */
+
+// XSEC
+
+#include <xsec/utils/XSECThreadPool.hpp>
+#include <xsec/framework/XSECError.hpp>
+
+#include <list>
+#include <vector>
+#include <algorithm>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#	include <process.h>
+#else
+#	include <pthread.h>
+#	include <unistd.h>
+#endif
+
+// --------------------------------------------------------------------------------
+//           Platform specifics
+// --------------------------------------------------------------------------------
+
+#if defined(_WIN32)
+
+typedef HANDLE					ThreadHandle;
+
+#	define POOL_LOCK(s)			EnterCriticalSection(&(s)->m_lock)
+#	define POOL_UNLOCK(s)		LeaveCriticalSection(&(s)->m_lock)
+#	define POOL_WAIT(s,c)		SleepConditionVariableCS(&(s)->c, &(s)->m_lock, INFINITE)
+#	define POOL_SIGNAL(s,c)		WakeConditionVariable(&(s)->c)
+#	define POOL_BROADCAST(s,c)	WakeAllConditionVariable(&(s)->c)
+
+#else
+
+typedef pthread_t				ThreadHandle;
+
+#	define POOL_LOCK(s)			pthread_mutex_lock(&(s)->m_lock)
+#	define POOL_UNLOCK(s)		pthread_mutex_unlock(&(s)->m_lock)
+#	define POOL_WAIT(s,c)		pthread_cond_wait(&(s)->c, &(s)->m_lock)
+#	define POOL_SIGNAL(s,c)		pthread_cond_signal(&(s)->c)
+#	define POOL_BROADCAST(s,c)	pthread_cond_broadcast(&(s)->c)
+
+#endif
+
+struct XSECThreadPool::PoolState {
+
+#if defined(_WIN32)
+	CRITICAL_SECTION				m_lock;
+	CONDITION_VARIABLE				m_workCond;		// Work queued or shutting down
+	CONDITION_VARIABLE				m_doneCond;		// A task has completed
+#else
+	pthread_mutex_t					m_lock;
+	pthread_cond_t					m_workCond;
+	pthread_cond_t					m_doneCond;
+#endif
+
+	std::list<XSECThreadPool::Task *>	m_queue;
+	std::vector<ThreadHandle>			m_threads;
+	bool								m_shutdown;
+
+};
+
+#if defined(_WIN32)
+static unsigned __stdcall poolThreadMain(void * arg) {
+	((XSECThreadPool *) arg)->workerLoop();
+	return 0;
+}
+#else
+extern "C" void * XSECThreadPoolThreadMain(void * arg) {
+	((XSECThreadPool *) arg)->workerLoop();
+	return NULL;
+}
+#endif
+
+// --------------------------------------------------------------------------------
+//           Construct/Destroy
+// --------------------------------------------------------------------------------
+
+XSECThreadPool::XSECThreadPool(unsigned int numThreads) {
+
+	XSECnew(mp_state, PoolState);
+	mp_state->m_shutdown = false;
+
+#if defined(_WIN32)
+	InitializeCriticalSection(&mp_state->m_lock);
+	InitializeConditionVariable(&mp_state->m_workCond);
+	InitializeConditionVariable(&mp_state->m_doneCond);
+#else
+	pthread_mutex_init(&mp_state->m_lock, NULL);
+	pthread_cond_init(&mp_state->m_workCond, NULL);
+	pthread_cond_init(&mp_state->m_doneCond, NULL);
+#endif
+
+	// A failure to start a thread just leaves a smaller pool - callers
+	// always make progress by running unstarted tasks themselves.
+
+	for (unsigned int i = 0; i < numThreads; ++i) {
+
+		ThreadHandle h;
+
+#if defined(_WIN32)
+		h = (HANDLE) _beginthreadex(NULL, 0, poolThreadMain, this, 0, NULL);
+		if (h == 0)
+			break;
+#else
+		if (pthread_create(&h, NULL, XSECThreadPoolThreadMain, this) != 0)
+			break;
+#endif
+
+		mp_state->m_threads.push_back(h);
+
+	}
+
+}
+
+XSECThreadPool::~XSECThreadPool() {
+
+	POOL_LOCK(mp_state);
+	mp_state->m_shutdown = true;
+	POOL_BROADCAST(mp_state, m_workCond);
+	POOL_UNLOCK(mp_state);
+
+	std::vector<ThreadHandle>::iterator i;
+	for (i = mp_state->m_threads.begin(); i != mp_state->m_threads.end(); ++i) {
+#if defined(_WIN32)
+		WaitForSingleObject(*i, INFINITE);
+		CloseHandle(*i);
+#else
+		pthread_join(*i, NULL);
+#endif
+	}
+
+#if defined(_WIN32)
+	DeleteCriticalSection(&mp_state->m_lock);
+#else
+	pthread_cond_destroy(&mp_state->m_doneCond);
+	pthread_cond_destroy(&mp_state->m_workCond);
+	pthread_mutex_destroy(&mp_state->m_lock);
+#endif
+
+	delete mp_state;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Workers
+// --------------------------------------------------------------------------------
+
+void XSECThreadPool::workerLoop(void) {
+
+	POOL_LOCK(mp_state);
+
+	for (;;) {
+
+		while (mp_state->m_queue.empty() && !mp_state->m_shutdown)
+			POOL_WAIT(mp_state, m_workCond);
+
+		if (mp_state->m_queue.empty())
+			break;		// Shutting down and nothing left to do
+
+		Task * t = mp_state->m_queue.front();
+		mp_state->m_queue.pop_front();
+		t->m_state = Task::TASK_RUNNING;
+
+		POOL_UNLOCK(mp_state);
+
+		try {
+			t->run();
+		}
+		catch (...) {
+			// Tasks are required to capture their own errors
+		}
+
+		POOL_LOCK(mp_state);
+
+		// Once marked done the task may be deleted by its owner, so
+		// it must not be touched again
+		t->m_state = Task::TASK_DONE;
+		POOL_BROADCAST(mp_state, m_doneCond);
+
+	}
+
+	POOL_UNLOCK(mp_state);
+
+}
+
+// --------------------------------------------------------------------------------
+//           Work management
+// --------------------------------------------------------------------------------
+
+void XSECThreadPool::submit(Task * task) {
+
+	POOL_LOCK(mp_state);
+
+	task->m_state = Task::TASK_QUEUED;
+	mp_state->m_queue.push_back(task);
+	POOL_SIGNAL(mp_state, m_workCond);
+
+	POOL_UNLOCK(mp_state);
+
+}
+
+void XSECThreadPool::wait(Task * task) {
+
+	POOL_LOCK(mp_state);
+
+	if (task->m_state == Task::TASK_QUEUED) {
+
+		// Nobody has started it - do it ourselves
+		mp_state->m_queue.remove(task);
+		task->m_state = Task::TASK_RUNNING;
+
+		POOL_UNLOCK(mp_state);
+
+		try {
+			task->run();
+		}
+		catch (...) {
+		}
+
+		POOL_LOCK(mp_state);
+		task->m_state = Task::TASK_DONE;
+
+	}
+
+	while (task->m_state == Task::TASK_RUNNING)
+		POOL_WAIT(mp_state, m_doneCond);
+
+	POOL_UNLOCK(mp_state);
+
+}
+
+unsigned int XSECThreadPool::getThreadCount(void) const {
+
+	return (unsigned int) mp_state->m_threads.size();
+
+}
+
+unsigned int XSECThreadPool::getDefaultThreadCount(void) {
+
+	long n;
+
+#if defined(_WIN32)
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	n = (long) si.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	n = 1;
+#endif
+
+	if (n < 1)
+		n = 1;
+	if (n > 64)
+		n = 64;
+
+	return (unsigned int) n;
+
+}
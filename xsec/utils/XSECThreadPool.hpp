@@ -0,0 +1,154 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECThreadPool := Simple pool of worker threads
+ *
+ * $Id$
+ *
+ */
+
+#ifndef XSECTHREADPOOL_INCLUDE
+#define XSECTHREADPOOL_INCLUDE
+
+#include <xsec/framework/XSECDefs.hpp>
+
+/**
+ * \brief Fixed size pool of worker threads
+ * @ingroup internal
+ *
+ * Used by the library to run independent pieces of work (such as
+ * digesting References) concurrently.  Work is handed over as Task
+ * objects, which remain owned by the caller.
+ *
+ * A caller that waits on a task which no worker has yet picked up runs
+ * it on its own thread.  This means a pool with no worker threads still
+ * makes progress, and tasks may safely wait on other tasks.
+ */
+
+class DSIG_EXPORT XSECThreadPool {
+
+public:
+
+	/**
+	 * \brief A unit of work
+	 *
+	 * run() must not throw - any errors need to be captured in the
+	 * derived class for the submitter to examine once wait() returns.
+	 */
+
+	class DSIG_EXPORT Task {
+
+	public:
+
+		Task() : m_state(TASK_IDLE) {}
+		virtual ~Task() {}
+
+		/** \brief Do the work */
+		virtual void run(void) = 0;
+
+	private:
+
+		friend class XSECThreadPool;
+
+		enum TaskState {
+			TASK_IDLE,
+			TASK_QUEUED,
+			TASK_RUNNING,
+			TASK_DONE
+		};
+
+		volatile TaskState		m_state;
+
+	};
+
+	/** @name Constructors and Destructors */
+	//@{
+
+	/**
+	 * \brief Start the pool
+	 *
+	 * @param numThreads Number of worker threads to start
+	 */
+
+	XSECThreadPool(unsigned int numThreads);
+
+	/**
+	 * \brief Stop the pool
+	 *
+	 * Tasks already queued are run to completion first.
+	 */
+
+	~XSECThreadPool();
+
+	//@}
+
+	/** @name Work management */
+	//@{
+
+	/**
+	 * \brief Queue a task
+	 *
+	 * @param task The task to run.  Must remain valid until wait() has
+	 * returned for it.
+	 */
+
+	void submit(Task * task);
+
+	/**
+	 * \brief Wait for a submitted task to complete
+	 *
+	 * If the task has not yet been started it is removed from the queue
+	 * and run on the calling thread.
+	 */
+
+	void wait(Task * task);
+
+	/**
+	 * \brief Number of worker threads in the pool
+	 */
+
+	unsigned int getThreadCount(void) const;
+
+	/**
+	 * \brief Number of workers to use by default (one per online CPU)
+	 */
+
+	static unsigned int getDefaultThreadCount(void);
+
+	//@}
+
+	// Used internally by the worker threads
+	void workerLoop(void);
+
+private:
+
+	struct PoolState;
+
+	// Unimplemented
+	XSECThreadPool(const XSECThreadPool &);
+	XSECThreadPool & operator = (const XSECThreadPool &);
+
+	PoolState					* mp_state;
+
+};
+
+#endif /* XSECTHREADPOOL_INCLUDE */
@@ -62,17 +62,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <errno.h>
-#include <limits.h>
-
 #include <xsec/framework/XSECError.hpp>
 #include <xsec/utils/unixutils/XSECBinHTTPURIInputStream.hpp>
+#include <xsec/utils/unixutils/XSECHTTPConnectionPool.hpp>
 
 #include "../../utils/XSECAutoPtr.hpp"
 
@@ -84,195 +76,36 @@
 
 XERCES_CPP_NAMESPACE_USE
 
-int XSECBinHTTPURIInputStream::getSocketHandle(const XMLUri&  urlSource) {
-
-    //
-    // Pull all of the parts of the URL out of th urlSource object, and transcode them
-    //   and transcode them back to ASCII.
-    //
-    const XMLCh*        hostName = urlSource.getHost();
-    XSECAutoPtrChar     hostNameAsCharStar(hostName);
-
-    const XMLCh*        path = urlSource.getPath();
-    XSECAutoPtrChar     pathAsCharStar(path);
-
-    const XMLCh*        fragment = urlSource.getFragment();
-    XSECAutoPtrChar     fragmentAsCharStar(fragment);
-
-    const XMLCh*        query = urlSource.getQueryString();
-    XSECAutoPtrChar     queryAsCharStar(query);
-
-    unsigned short      portNumber = (unsigned short) urlSource.getPort();
-	if (portNumber == USHRT_MAX)
-		portNumber = 80;
-
-    //
-    // Set up a socket.
-    //
-    struct hostent*     hostEntPtr = 0;
-    struct sockaddr_in  sa;
-
-
-    if ((hostEntPtr = gethostbyname(hostNameAsCharStar.get())) == NULL)
-    {
-        unsigned long  numAddress = inet_addr(hostNameAsCharStar.get());
-        if (numAddress == 0)
-        {
-            ThrowXML(NetAccessorException,
-                     XMLExcepts::NetAcc_TargetResolution);
-        }
-        if ((hostEntPtr =
-                gethostbyaddr((char *) &numAddress,
-                              sizeof(unsigned long), AF_INET)) == NULL)
-        {
-            ThrowXML(NetAccessorException,
-                     XMLExcepts::NetAcc_TargetResolution);
-        }
-    }
-
-    memcpy((void *) &sa.sin_addr,
-           (const void *) hostEntPtr->h_addr, hostEntPtr->h_length);
-    sa.sin_family = hostEntPtr->h_addrtype;
-    sa.sin_port = htons(portNumber);
-
-    int s = socket(hostEntPtr->h_addrtype, SOCK_STREAM, 0);
-    if (s < 0)
-    {
-        throw XSECException(XSECException::HTTPURIInputStreamError,
-							"Error creating socket");
-
-    }
-
-    if (connect(s, (struct sockaddr *) &sa, sizeof(sa)) < 0)
-    {
-        throw XSECException(XSECException::HTTPURIInputStreamError,
-							"Error connecting to end server");
-    }
-
-    // The port is open and ready to go.
-    // Build up the http GET command to send to the server.
-    // To do:  We should really support http 1.1.  This implementation
-    //         is weak.
-    strcpy(fBuffer, "GET ");
-    strcat(fBuffer, pathAsCharStar.get());
-
-    if (queryAsCharStar.get() != 0)
-    {
-        size_t n = strlen(fBuffer);
-        fBuffer[n] = XERCES_CPP_NAMESPACE_QUALIFIER chQuestion;
-        fBuffer[n+1] = XERCES_CPP_NAMESPACE_QUALIFIER chNull;
-        strcat(fBuffer, queryAsCharStar.get());
-    }
-
-    if (fragmentAsCharStar.get() != 0)
-    {
-        strcat(fBuffer, fragmentAsCharStar.get());
-    }
-    strcat(fBuffer, " HTTP/1.0\r\n");
-
-
-    strcat(fBuffer, "Host: ");
-    strcat(fBuffer, hostNameAsCharStar.get());
-    if (portNumber != 80)
-    {
-        int i = strlen(fBuffer);
-		sprintf(fBuffer+i, ":%d", portNumber);
-        // _itoa(portNumber, fBuffer+i, 10);
-    }
-    strcat(fBuffer, "\r\n\r\n");
-
-    // Send the http request
-    int lent = strlen(fBuffer);
-    int  aLent = 0;
-    if ((aLent = write(s, (void *) fBuffer, lent)) != lent)
-    {
-        throw XSECException(XSECException::HTTPURIInputStreamError,
-							"Error writing to socket");
-    }
-
-    //
-    // get the response, check the http header for errors from the server.
-    //
-    aLent = read(s, (void *)fBuffer, sizeof(fBuffer)-1);
-    if (aLent <= 0)
-    {
-        throw XSECException(XSECException::HTTPURIInputStreamError,
-							"Error reported reading socket");
-    }
-
-    fBufferEnd = fBuffer+aLent;
-    *fBufferEnd = 0;
-
-    // Find the break between the returned http header and any data.
-    //  (Delimited by a blank line)
-    // Hang on to any data for use by the first read from this BinHTTPURLInputStream.
-    //
-    fBufferPos = strstr(fBuffer, "\r\n\r\n");
-    if (fBufferPos != 0)
-    {
-        fBufferPos += 4;
-        *(fBufferPos-2) = 0;
-    }
-    else
-    {
-        fBufferPos = strstr(fBuffer, "\n\n");
-        if (fBufferPos != 0)
-        {
-            fBufferPos += 2;
-            *(fBufferPos-1) = 0;
-        }
-        else
-            fBufferPos = fBufferEnd;
-    }
-
-    // Make sure the header includes an HTTP 200 OK response.
-    //
-    char *p = strstr(fBuffer, "HTTP");
-    if (p == 0)
-    {
-        throw XSECException(XSECException::HTTPURIInputStreamError,
-							"Error reported reading socket");
-    }
+XSECHTTPExchange * XSECBinHTTPURIInputStream::openExchange(const XMLUri&  urlSource,
+														   int redirectsLeft) {
 
-    p = strchr(p, ' ');
-    if (p == 0)
-    {
-        throw XSECException(XSECException::HTTPURIInputStreamError,
-							"Error reported reading socket");
-    }
+    XSECHTTPExchange * ex;
+    XSECnew(ex, XSECHTTPExchange(XSECHTTPConnectionPool::getDefault(), urlSource));
+    Janitor<XSECHTTPExchange> j_ex(ex);
 
-    int httpResponse = atoi(p);
+    int httpResponse = ex->doRequest("GET", NULL, NULL, 0);
 
 	if (httpResponse == 302 || httpResponse == 301) {
 		//Once grows, should use a switch
-		char redirectBuf[256];
-		int q;
 
 		// Find the "Location:" string
-		p = strstr(p, "Location:");
-		if (p == 0)
+		const char * location = ex->getHeader("Location");
+		if (location == NULL || redirectsLeft <= 0)
         {
 			throw XSECException(XSECException::HTTPURIInputStreamError,
 							"Error reported reading socket");
 		}
-		p = strchr(p, ' ');
-		if (p == 0)
-		{
-			throw XSECException(XSECException::HTTPURIInputStreamError,
-							"Error reported reading socket");
-		}
 
-		// Now read
-		p++;
-		for (q=0; q < 255 && p[q] != '\r' && p[q] !='\n'; ++q)
-			redirectBuf[q] = p[q];
+		// Try to find this location (which may be relative)
+        XSECAutoPtrXMLCh redirectBufTrans(location);
+		XMLUri redirect(&urlSource, redirectBufTrans.get());
 
-		redirectBuf[q] = '\0';
+		// Hand the connection back before going elsewhere
+		ex->skipBody();
+		j_ex.release();
+		delete ex;
 
-		// Try to find this location
-        XSECAutoPtrXMLCh redirectBufTrans(redirectBuf);
-
-		return getSocketHandle(XMLUri(redirectBufTrans.get()));
+		return openExchange(redirect, redirectsLeft - 1);
 	}
 
     else if (httpResponse != 200)
@@ -284,16 +117,17 @@ int XSECBinHTTPURIInputStream::getSocketHandle(const XMLUri&  urlSource) {
 						"Unknown HTTP Response");
     }
 
-	return s;
+	j_ex.release();
+	return ex;
 }
 
 
 XSECBinHTTPURIInputStream::XSECBinHTTPURIInputStream(const XMLUri& urlSource)
-      : fSocket(0)
+      : fExchange(NULL)
       , fBytesProcessed(0)
 {
 
-    fSocket = getSocketHandle(urlSource);
+    fExchange = openExchange(urlSource, XSEC_HTTP_MAX_REDIRECTS);
 
 }
 
@@ -301,36 +135,15 @@ XSECBinHTTPURIInputStream::XSECBinHTTPURIInputStream(const XMLUri& urlSource)
 
 XSECBinHTTPURIInputStream::~XSECBinHTTPURIInputStream()
 {
-    shutdown(fSocket, 2);
-    close(fSocket);
+    // Returns the connection to the pool if the body was read to the end
+    delete fExchange;
 }
 
 
 xsecsize_t XSECBinHTTPURIInputStream::readBytes(XMLByte* const    toFill
                                       , const xsecsize_t    maxToRead)
 {
-    xsecsize_t len = fBufferEnd - fBufferPos;
-    if (len > 0)
-    {
-        // If there's any data left over in the buffer into which we first
-        //   read from the server (to get the http header), return that.
-        if (len > maxToRead)
-            len = maxToRead;
-        memcpy(toFill, fBufferPos, len);
-        fBufferPos += len;
-    }
-    else
-    {
-        // There was no data in the local buffer.
-        // Read some from the socket, straight into our caller's buffer.
-        //
-        len = read(fSocket, (void *) toFill, maxToRead);
-        if (len == UINT_MAX)
-        {
-			throw XSECException(XSECException::HTTPURIInputStreamError,
-						"Error reading from Socket");
-        }
-    }
+    xsecsize_t len = fExchange->readBody(toFill, maxToRead);
 
     fBytesProcessed += len;
     return len;
@@ -58,9 +58,12 @@
 #include <xercesc/util/XMLExceptMsgs.hpp>
 #include <xercesc/util/BinInputStream.hpp>
 
+class XSECHTTPExchange;
+
 //
 // This class implements the BinInputStream interface specified by the XML
-// parser.
+// parser.  Requests are made over HTTP/1.1 using connections from the
+// shared XSECHTTPConnectionPool.
 //
 
 class DSIG_EXPORT XSECBinHTTPURIInputStream : public XERCES_CPP_NAMESPACE_QUALIFIER BinInputStream
@@ -88,27 +91,19 @@ private :
     // -----------------------------------------------------------------------
     //  Private data members
     //
-    //  fSocket
-    //      The socket representing the connection to the remote file.
+    //  fExchange
+    //      The request to the remote file, holding the pooled connection
+    //      the body is read from.
     //  fBytesProcessed
     //      Its a rolling count of the number of bytes processed off this
     //      input stream.
-    //  fBuffer
-    //      Holds the http header, plus the first part of the actual
-    //      data.  Filled at the time the stream is opened, data goes
-    //      out to user in response to readBytes().
-    //  fBufferPos, fBufferEnd
-    //      Pointers into fBuffer, showing start and end+1 of content
-    //      that readBytes must return.
     // -----------------------------------------------------------------------
 
-	int getSocketHandle(const XERCES_CPP_NAMESPACE_QUALIFIER XMLUri&  urlSource);
+	XSECHTTPExchange * openExchange(const XERCES_CPP_NAMESPACE_QUALIFIER XMLUri&  urlSource,
+									int redirectsLeft);
 
-    int                 fSocket;
+    XSECHTTPExchange *  fExchange;
     xsecsize_t          fBytesProcessed;
-    char                fBuffer[4000];
-    char *              fBufferEnd;
-    char *              fBufferPos;
 
 };
 
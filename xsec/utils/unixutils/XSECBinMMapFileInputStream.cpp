@@ -0,0 +1,155 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECBinMMapFileInputStream := BinInputStream over a memory mapped local file
+ *
+ * $Id$
+ *
+ */
+
+#include <xsec/utils/unixutils/XSECBinMMapFileInputStream.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined (XSEC_HAVE_MMAP)
+#	include <sys/mman.h>
+#endif
+
+XERCES_CPP_NAMESPACE_USE
+
+// -----------------------------------------------------------------------
+//  Construct/Destroy
+// -----------------------------------------------------------------------
+
+XSECBinMMapFileInputStream::XSECBinMMapFileInputStream(const char * fileName) :
+fFile(-1),
+fMap(NULL),
+fMapLen(0),
+fBytesProcessed(0) {
+
+	do {
+		fFile = open(fileName, O_RDONLY);
+	} while (fFile == -1 && errno == EINTR);
+
+	if (fFile == -1)
+		return;
+
+#if defined (XSEC_HAVE_MMAP)
+
+	// Only map regular, non-empty files that fit in the address space.
+	// Anything else is read() in the usual way.
+
+	struct stat st;
+	if (fstat(fFile, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+		(unsigned long long) st.st_size > (unsigned long long) ((size_t) -1))
+		return;
+
+	void * map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fFile, 0);
+	if (map == MAP_FAILED)
+		return;
+
+#	if defined (MADV_SEQUENTIAL)
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+#	endif
+
+	fMap = (XMLByte *) map;
+	fMapLen = (XMLSize_t) st.st_size;
+
+	// The mapping holds its own reference to the file
+	close(fFile);
+	fFile = -1;
+
+#endif
+
+}
+
+XSECBinMMapFileInputStream::~XSECBinMMapFileInputStream() {
+
+#if defined (XSEC_HAVE_MMAP)
+	if (fMap != NULL)
+		munmap(fMap, fMapLen);
+#endif
+
+	if (fFile != -1)
+		close(fFile);
+
+}
+
+// -----------------------------------------------------------------------
+//  Implementation of the input stream interface
+// -----------------------------------------------------------------------
+
+xsecsize_t XSECBinMMapFileInputStream::readBytes(XMLByte* const toFill,
+                                                 const xsecsize_t maxToRead) {
+
+	if (fMap != NULL) {
+
+		XMLSize_t len = fMapLen - fBytesProcessed;
+		if (len > maxToRead)
+			len = maxToRead;
+
+		memcpy(toFill, &fMap[fBytesProcessed], len);
+		fBytesProcessed += len;
+
+		return (xsecsize_t) len;
+
+	}
+
+	if (fFile == -1)
+		return 0;
+
+	ssize_t len;
+	do {
+		len = read(fFile, toFill, maxToRead);
+	} while (len == -1 && errno == EINTR);
+
+	if (len <= 0)
+		return 0;
+
+	fBytesProcessed += len;
+	return (xsecsize_t) len;
+
+}
+
+bool XSECBinMMapFileInputStream::getRemainingBytes(const XMLByte *& data, XMLSize_t & len) {
+
+	if (fMap == NULL)
+		return false;
+
+	data = &fMap[fBytesProcessed];
+	len = fMapLen - fBytesProcessed;
+	fBytesProcessed = fMapLen;
+
+	return true;
+
+}
+
+#ifdef XSEC_XERCES_INPUTSTREAM_HAS_CONTENTTYPE
+const XMLCh* XSECBinMMapFileInputStream::getContentType() const {
+	return NULL;
+}
+#endif
@@ -0,0 +1,115 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECBinMMapFileInputStream := BinInputStream over a memory mapped local file
+ *
+ * $Id$
+ *
+ */
+
+#ifndef UNIXXSECBINMMAPFILEINPUTSTREAM_HEADER
+#define UNIXXSECBINMMAPFILEINPUTSTREAM_HEADER
+
+#include <xsec/framework/XSECDefs.hpp>
+
+#include <xercesc/util/BinInputStream.hpp>
+
+//
+// This class implements the BinInputStream interface for local files.
+// Where possible the whole file is mapped into memory (and the kernel
+// told it will be read sequentially), so readers that understand
+// getRemainingBytes() can consume it without any copies or read()
+// calls.  If the file cannot be mapped (not a regular file, empty, no
+// mmap support) the stream falls back to plain read() calls.
+//
+// A mapped file that is truncated while it is being read raises SIGBUS
+// on the next access past its new end, where read() would fail with an
+// error.  XSECURIResolverGenericUnix only uses this stream when asked to
+// (setMapLocalFiles()).
+//
+
+class DSIG_EXPORT XSECBinMMapFileInputStream : public XERCES_CPP_NAMESPACE_QUALIFIER BinInputStream
+{
+public :
+    XSECBinMMapFileInputStream(const char * fileName);
+    ~XSECBinMMapFileInputStream();
+
+    bool getIsOpen() const;
+
+#ifdef XSEC_XERCES_64BITSAFE
+    XMLFilePos curPos() const;
+#else
+    unsigned int curPos() const;
+#endif
+    xsecsize_t readBytes
+    (
+                XMLByte* const  toFill
+        , const xsecsize_t    maxToRead
+    );
+
+#ifdef XSEC_XERCES_INPUTSTREAM_HAS_CONTENTTYPE
+    const XMLCh* getContentType() const;
+#endif
+
+    // Hand back everything not yet read as a single block and mark it as
+    // read.  The block remains valid until the stream is deleted.
+    // Returns false if the file is not mapped.
+    bool getRemainingBytes(const XMLByte *& data, XMLSize_t & len);
+
+private :
+    // -----------------------------------------------------------------------
+    //  Private data members
+    //
+    //  fFile
+    //      Descriptor of the open file, or -1 (closed once mapped)
+    //  fMap, fMapLen
+    //      The mapped view of the file, or NULL if reading via fFile
+    //  fBytesProcessed
+    //      Rolling count of bytes returned (and offset into fMap)
+    // -----------------------------------------------------------------------
+
+    int                 fFile;
+    XMLByte *           fMap;
+    XMLSize_t           fMapLen;
+    XMLSize_t           fBytesProcessed;
+
+};
+
+
+inline
+#ifdef XSEC_XERCES_64BITSAFE
+XMLFilePos
+#else
+unsigned int
+#endif
+XSECBinMMapFileInputStream::curPos() const
+{
+    return fBytesProcessed;
+}
+
+inline bool XSECBinMMapFileInputStream::getIsOpen() const
+{
+    return fFile != -1 || fMap != NULL;
+}
+
+
+#endif // UNIXXSECBINMMAPFILEINPUTSTREAM_HEADER
@@ -0,0 +1,1012 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECHTTPConnectionPool := Shared pool of persistent (keep-alive) HTTP/1.1
+ *                           connections, plus a single request/response
+ *                           exchange run over one of them
+ *
+ * $Id$
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <xsec/framework/XSECError.hpp>
+#include <xsec/utils/unixutils/XSECHTTPConnectionPool.hpp>
+
+#include "../../utils/XSECAutoPtr.hpp"
+
+#include <xercesc/util/XMLNetAccessor.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/util/XMLExceptMsgs.hpp>
+
+#include <map>
+#include <list>
+#include <string>
+
+XERCES_CPP_NAMESPACE_USE
+
+#ifndef MSG_NOSIGNAL
+#	define MSG_NOSIGNAL 0
+#endif
+
+// Guard against servers sending unbounded header blocks
+#define XSEC_HTTP_MAX_HEADER_SIZE	0x10000
+
+// --------------------------------------------------------------------------------
+//           Pool state
+// --------------------------------------------------------------------------------
+
+namespace {
+
+    struct IdleConnection {
+        int         m_socket;
+        time_t      m_since;
+    };
+
+    struct HostEntry {
+        std::list<IdleConnection>   m_idle;
+        unsigned int                m_active;
+
+        HostEntry() : m_active(0) {}
+    };
+
+    typedef std::map<std::string, HostEntry> HostMapType;
+
+    std::string makeHostKey(const char * host, unsigned short port) {
+
+        char portStr[8];
+        sprintf(portStr, ":%u", (unsigned int) port);
+
+        std::string key(host);
+        key += portStr;
+        return key;
+
+    }
+
+    // A socket that has anything to read while idle has either been
+    // closed by the server or is out of step - either way it can't be used
+
+    bool isStillUsable(int sock) {
+
+        struct pollfd pfd;
+        pfd.fd = sock;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        return poll(&pfd, 1, 0) == 0;
+
+    }
+
+    void closeSocket(int sock) {
+
+        shutdown(sock, SHUT_RDWR);
+        close(sock);
+
+    }
+
+}
+
+struct XSECHTTPConnectionPool::PoolState {
+
+    pthread_mutex_t     m_lock;
+    pthread_cond_t      m_released;     // A connection for some host was handed back
+
+    HostMapType         m_hosts;
+    unsigned int        m_maxPerHost;
+    unsigned int        m_idleTimeout;
+    unsigned int        m_timeout;
+
+    unsigned long       m_connects;
+    unsigned long       m_reuses;
+
+    // Close anything that has been idle too long.  Lock must be held.
+    void expireIdle(void) {
+
+        time_t now = time(NULL);
+
+        for (HostMapType::iterator h = m_hosts.begin(); h != m_hosts.end(); ++h) {
+
+            std::list<IdleConnection> & idle = h->second.m_idle;
+
+            while (!idle.empty() &&
+                   (unsigned long) (now - idle.front().m_since) >= m_idleTimeout) {
+                closeSocket(idle.front().m_socket);
+                idle.pop_front();
+            }
+
+        }
+
+    }
+
+};
+
+class XSECHTTPPoolLock {
+
+public:
+
+    XSECHTTPPoolLock(pthread_mutex_t * m) : mp_mutex(m) {pthread_mutex_lock(mp_mutex);}
+    ~XSECHTTPPoolLock() {pthread_mutex_unlock(mp_mutex);}
+
+private:
+
+    pthread_mutex_t * mp_mutex;
+
+};
+
+XSECHTTPConnectionPool * XSECHTTPConnectionPool::s_defaultPool = NULL;
+
+// --------------------------------------------------------------------------------
+//           Construct/Destroy
+// --------------------------------------------------------------------------------
+
+XSECHTTPConnectionPool::XSECHTTPConnectionPool(unsigned int maxPerHost,
+                                               unsigned int idleTimeout,
+                                               unsigned int timeout) {
+
+    XSECnew(mp_state, PoolState);
+
+    pthread_mutex_init(&mp_state->m_lock, NULL);
+    pthread_cond_init(&mp_state->m_released, NULL);
+
+    mp_state->m_maxPerHost = (maxPerHost > 0 ? maxPerHost : 1);
+    mp_state->m_idleTimeout = idleTimeout;
+    mp_state->m_timeout = timeout;
+    mp_state->m_connects = 0;
+    mp_state->m_reuses = 0;
+
+}
+
+XSECHTTPConnectionPool::~XSECHTTPConnectionPool() {
+
+    closeIdle();
+
+    pthread_cond_destroy(&mp_state->m_released);
+    pthread_mutex_destroy(&mp_state->m_lock);
+
+    delete mp_state;
+
+}
+
+void XSECHTTPConnectionPool::Initialise() {
+
+    if (s_defaultPool == NULL)
+        XSECnew(s_defaultPool, XSECHTTPConnectionPool());
+
+}
+
+void XSECHTTPConnectionPool::Terminate() {
+
+    delete s_defaultPool;
+    s_defaultPool = NULL;
+
+}
+
+XSECHTTPConnectionPool * XSECHTTPConnectionPool::getDefault() {
+
+    return s_defaultPool;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Configuration and statistics
+// --------------------------------------------------------------------------------
+
+void XSECHTTPConnectionPool::setMaxPerHost(unsigned int maxPerHost) {
+
+    XSECHTTPPoolLock lock(&mp_state->m_lock);
+    mp_state->m_maxPerHost = (maxPerHost > 0 ? maxPerHost : 1);
+
+    // Anyone waiting may now be allowed through
+    pthread_cond_broadcast(&mp_state->m_released);
+
+}
+
+unsigned int XSECHTTPConnectionPool::getMaxPerHost() const {
+
+    return mp_state->m_maxPerHost;
+
+}
+
+void XSECHTTPConnectionPool::setIdleTimeout(unsigned int seconds) {
+
+    XSECHTTPPoolLock lock(&mp_state->m_lock);
+    mp_state->m_idleTimeout = seconds;
+
+}
+
+unsigned int XSECHTTPConnectionPool::getIdleTimeout() const {
+
+    return mp_state->m_idleTimeout;
+
+}
+
+void XSECHTTPConnectionPool::setTimeout(unsigned int seconds) {
+
+    XSECHTTPPoolLock lock(&mp_state->m_lock);
+    mp_state->m_timeout = seconds;
+
+}
+
+unsigned int XSECHTTPConnectionPool::getTimeout() const {
+
+    return mp_state->m_timeout;
+
+}
+
+unsigned long XSECHTTPConnectionPool::getConnectCount() const {
+
+    XSECHTTPPoolLock lock(&mp_state->m_lock);
+    return mp_state->m_connects;
+
+}
+
+unsigned long XSECHTTPConnectionPool::getReuseCount() const {
+
+    XSECHTTPPoolLock lock(&mp_state->m_lock);
+    return mp_state->m_reuses;
+
+}
+
+void XSECHTTPConnectionPool::closeIdle() {
+
+    XSECHTTPPoolLock lock(&mp_state->m_lock);
+
+    for (HostMapType::iterator h = mp_state->m_hosts.begin(); h != mp_state->m_hosts.end(); ++h) {
+
+        std::list<IdleConnection>::iterator i;
+        for (i = h->second.m_idle.begin(); i != h->second.m_idle.end(); ++i)
+            closeSocket(i->m_socket);
+
+        h->second.m_idle.clear();
+
+    }
+
+}
+
+// --------------------------------------------------------------------------------
+//           Acquire and release
+// --------------------------------------------------------------------------------
+
+int XSECHTTPConnectionPool::connectTo(const char * host, unsigned short port) {
+
+    struct addrinfo hints;
+    struct addrinfo * res = NULL;
+    char portStr[8];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    sprintf(portStr, "%u", (unsigned int) port);
+
+    if (getaddrinfo(host, portStr, &hints, &res) != 0 || res == NULL)
+    {
+        ThrowXML(NetAccessorException,
+                 XMLExcepts::NetAcc_TargetResolution);
+    }
+
+    int s = -1;
+    bool created = false;
+
+    // Applies to the connect as well as every later send and receive
+    struct timeval tv;
+    tv.tv_sec = getTimeout();
+    tv.tv_usec = 0;
+
+    for (struct addrinfo * ai = res; ai != NULL; ai = ai->ai_next) {
+
+        s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s < 0)
+            continue;
+
+        created = true;
+
+        if (tv.tv_sec > 0) {
+            setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof(tv));
+            setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (char *) &tv, sizeof(tv));
+        }
+
+        if (connect(s, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+
+        close(s);
+        s = -1;
+
+    }
+
+    freeaddrinfo(res);
+
+    if (s < 0)
+    {
+        if (!created)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Error creating socket");
+
+        throw XSECException(XSECException::HTTPURIInputStreamError,
+                            "Error connecting to end server");
+    }
+
+    // Requests are written in one go - don't hold them back
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *) &one, sizeof(one));
+#if defined(SO_NOSIGPIPE)
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, (char *) &one, sizeof(one));
+#endif
+
+    return s;
+
+}
+
+int XSECHTTPConnectionPool::acquire(const char * host, unsigned short port, bool & reused) {
+
+    std::string key = makeHostKey(host, port);
+
+    // Set the first time we have to wait for a slot
+    struct timespec deadline;
+    deadline.tv_sec = 0;
+    deadline.tv_nsec = 0;
+
+    {
+        XSECHTTPPoolLock lock(&mp_state->m_lock);
+
+        mp_state->expireIdle();
+
+        for (;;) {
+
+            HostEntry & entry = mp_state->m_hosts[key];
+
+            // Most recently used first - the least likely to have been dropped
+            while (!entry.m_idle.empty()) {
+
+                int s = entry.m_idle.back().m_socket;
+                entry.m_idle.pop_back();
+
+                if (isStillUsable(s)) {
+                    entry.m_active++;
+                    mp_state->m_reuses++;
+                    reused = true;
+                    return s;
+                }
+
+                closeSocket(s);
+
+            }
+
+            if (entry.m_active < mp_state->m_maxPerHost) {
+                // Reserve a slot and connect outside the lock
+                entry.m_active++;
+                mp_state->m_connects++;
+                break;
+            }
+
+            if (mp_state->m_timeout == 0) {
+                pthread_cond_wait(&mp_state->m_released, &mp_state->m_lock);
+                continue;
+            }
+
+            if (deadline.tv_sec == 0)
+                deadline.tv_sec = time(NULL) + mp_state->m_timeout;
+
+            if (pthread_cond_timedwait(&mp_state->m_released, &mp_state->m_lock, &deadline) == ETIMEDOUT)
+                throw XSECException(XSECException::HTTPURIInputStreamError,
+                                    "Timed out waiting for a free connection to the server");
+
+        }
+    }
+
+    reused = false;
+
+    try {
+        return connectTo(host, port);
+    }
+    catch (...) {
+        XSECHTTPPoolLock lock(&mp_state->m_lock);
+        mp_state->m_hosts[key].m_active--;
+        pthread_cond_broadcast(&mp_state->m_released);
+        throw;
+    }
+
+}
+
+void XSECHTTPConnectionPool::release(const char * host, unsigned short port,
+                                     int sock, bool keepAlive) {
+
+    std::string key = makeHostKey(host, port);
+
+    XSECHTTPPoolLock lock(&mp_state->m_lock);
+
+    HostEntry & entry = mp_state->m_hosts[key];
+
+    if (entry.m_active > 0)
+        entry.m_active--;
+
+    if (keepAlive && mp_state->m_idleTimeout > 0 &&
+        entry.m_idle.size() < mp_state->m_maxPerHost) {
+
+        IdleConnection c;
+        c.m_socket = sock;
+        c.m_since = time(NULL);
+        entry.m_idle.push_back(c);
+
+    }
+    else
+        closeSocket(sock);
+
+    pthread_cond_broadcast(&mp_state->m_released);
+
+}
+
+// --------------------------------------------------------------------------------
+//           Exchange - construct/destroy
+// --------------------------------------------------------------------------------
+
+XSECHTTPExchange::XSECHTTPExchange(XSECHTTPConnectionPool * pool, const XMLUri & uri) :
+    mp_pool(pool),
+    mp_host(NULL),
+    m_socket(-1),
+    m_reused(false),
+    m_keepAlive(false),
+    mp_bufferPos(m_buffer),
+    mp_bufferEnd(m_buffer),
+    m_bytesRead(0),
+    m_headersLen(0),
+    m_status(0),
+    m_bodyMode(BODY_NONE),
+    m_remaining(0),
+    m_bodyDone(true) {
+
+    if (mp_pool == NULL)
+        throw XSECException(XSECException::HTTPURIInputStreamError,
+                            "HTTP connection pool is not available");
+
+    //
+    // Pull all of the parts of the URL out of the uri object, and transcode them
+    //   and transcode them back to ASCII.
+    //
+    XSECAutoPtrChar     hostNameAsCharStar(uri.getHost());
+    XSECAutoPtrChar     pathAsCharStar(uri.getPath());
+    XSECAutoPtrChar     queryAsCharStar(uri.getQueryString());
+
+    if (hostNameAsCharStar.get() == NULL)
+        throw XSECException(XSECException::HTTPURIInputStreamError,
+                            "No host in HTTP URI");
+
+    m_port = (unsigned short) uri.getPort();
+    if (m_port == USHRT_MAX)
+        m_port = 80;
+
+    mp_host = hostNameAsCharStar.release();
+
+    // The fragment is never sent to the server
+    const char * path = pathAsCharStar.get();
+    m_target.sbStrcpyIn((path != NULL && *path != '\0') ? path : "/");
+    if (queryAsCharStar.get() != NULL) {
+        m_target.sbStrcatIn("?");
+        m_target.sbStrcatIn(queryAsCharStar.get());
+    }
+
+}
+
+XSECHTTPExchange::~XSECHTTPExchange() {
+
+    if (m_socket >= 0)
+        mp_pool->release(mp_host, m_port, m_socket, m_keepAlive && m_bodyDone);
+
+    XSEC_RELEASE_XMLCH(mp_host);
+
+}
+
+void XSECHTTPExchange::closeConnection() {
+
+    if (m_socket >= 0) {
+        mp_pool->release(mp_host, m_port, m_socket, false);
+        m_socket = -1;
+    }
+
+}
+
+// --------------------------------------------------------------------------------
+//           Exchange - request
+// --------------------------------------------------------------------------------
+
+int XSECHTTPExchange::doRequest(const char * method,
+                                const char * extraHeaders,
+                                const char * body,
+                                xsecsize_t bodyLen) {
+
+    if (m_socket >= 0)
+        throw XSECException(XSECException::HTTPURIInputStreamError,
+                            "HTTP exchange already used");
+
+    // Build the whole request, so it goes out in as few packets as possible
+
+    safeBuffer request;
+    char portStr[8];
+
+    request.sbStrcpyIn(method);
+    request.sbStrcatIn(" ");
+    request.sbStrcatIn(m_target);
+    request.sbStrcatIn(" HTTP/1.1\r\nHost: ");
+    request.sbStrcatIn(mp_host);
+    if (m_port != 80) {
+        sprintf(portStr, ":%u", (unsigned int) m_port);
+        request.sbStrcatIn(portStr);
+    }
+    request.sbStrcatIn("\r\n");
+
+    if (extraHeaders != NULL)
+        request.sbStrcatIn(extraHeaders);
+
+    if (body != NULL) {
+        char lenStr[32];
+        sprintf(lenStr, "Content-Length: %lu\r\n", (unsigned long) bodyLen);
+        request.sbStrcatIn(lenStr);
+    }
+
+    request.sbStrcatIn("\r\n");
+
+    xsecsize_t len = request.sbStrlen();
+    if (body != NULL && bodyLen > 0) {
+        request.sbMemcpyIn(len, body, bodyLen);
+        len += bodyLen;
+    }
+
+    // A re-used connection may have been dropped by the server since we
+    // last looked.  A request that could not be sent can always go again
+    // on another connection.  Once sent, the server may have acted on it
+    // even though nothing came back, so only requests that are safe to
+    // repeat are re-sent.
+
+    bool mayResend = (strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0);
+
+    for (;;) {
+
+        m_socket = mp_pool->acquire(mp_host, m_port, m_reused);
+
+        if (sendAndReadHeaders(request, len, mayResend))
+            break;
+
+        bool wasReused = m_reused;
+        closeConnection();
+
+        if (!wasReused)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Error reported reading socket");
+
+    }
+
+    return m_status;
+
+}
+
+bool XSECHTTPExchange::sendAndReadHeaders(const safeBuffer & request, xsecsize_t len, bool mayResend) {
+
+    const char * p = request.rawCharBuffer();
+    xsecsize_t sent = 0;
+
+    mp_bufferPos = mp_bufferEnd = m_buffer;
+    m_bytesRead = 0;
+
+    while (sent < len) {
+
+        ssize_t n = send(m_socket, p + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            if (m_reused)
+                return false;
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Error writing to socket");
+        }
+        sent += (xsecsize_t) n;
+
+    }
+
+    // Skip any informational (1xx) responses
+    do {
+        if (!readHeaders()) {
+            if (mayResend)
+                return false;
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Connection closed by server before any response");
+        }
+    } while (m_status >= 100 && m_status < 200);
+
+    return true;
+
+}
+
+// --------------------------------------------------------------------------------
+//           Exchange - response headers
+// --------------------------------------------------------------------------------
+
+bool XSECHTTPExchange::fill() {
+
+    mp_bufferPos = mp_bufferEnd = m_buffer;
+
+    for (;;) {
+
+        ssize_t n = recv(m_socket, m_buffer, XSEC_HTTP_BUFFER_SIZE, 0);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Timed out reading from Socket");
+
+        if (n < 0)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Error reading from Socket");
+
+        mp_bufferEnd = m_buffer + n;
+        m_bytesRead += (xsecsize_t) n;
+        return n > 0;
+
+    }
+
+}
+
+bool XSECHTTPExchange::readLine(safeBuffer & line, xsecsize_t & len) {
+
+    len = 0;
+
+    for (;;) {
+
+        if (mp_bufferPos == mp_bufferEnd) {
+
+            bool got;
+
+            try {
+                got = fill();
+            }
+            catch (XSECException &) {
+                // A reset before anything arrived is just a dead connection
+                if (m_reused && m_bytesRead == 0)
+                    return false;
+                throw;
+            }
+
+            if (!got) {
+                if (m_bytesRead == 0)
+                    return false;
+                throw XSECException(XSECException::HTTPURIInputStreamError,
+                                    "Connection closed in HTTP header");
+            }
+
+        }
+
+        char * nl = (char *) memchr(mp_bufferPos, '\n', mp_bufferEnd - mp_bufferPos);
+        char * end = (nl != NULL ? nl : mp_bufferEnd);
+
+        xsecsize_t n = (xsecsize_t) (end - mp_bufferPos);
+        if (len + n > XSEC_HTTP_MAX_HEADER_SIZE)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "HTTP header line too long");
+
+        line.sbMemcpyIn(len, mp_bufferPos, n);
+        len += n;
+        mp_bufferPos = end;
+
+        if (nl != NULL) {
+            mp_bufferPos++;
+            if (len > 0 && line[len - 1] == '\r')
+                len--;
+            line[len] = '\0';
+            return true;
+        }
+
+    }
+
+}
+
+bool XSECHTTPExchange::readHeaders() {
+
+    safeBuffer line;
+    xsecsize_t len;
+
+    if (!readLine(line, len))
+        return false;
+
+    // Status line : HTTP/1.x SP code SP reason
+
+    const char * s = line.rawCharBuffer();
+    if (strncmp(s, "HTTP/", 5) != 0)
+        throw XSECException(XSECException::HTTPURIInputStreamError,
+                            "Error reported reading socket");
+
+    bool http11 = (strncmp(s, "HTTP/1.0", 8) != 0);
+
+    const char * p = strchr(s, ' ');
+    if (p == NULL)
+        throw XSECException(XSECException::HTTPURIInputStreamError,
+                            "Error reported reading socket");
+
+    m_status = atoi(p);
+
+    p = strchr(p + 1, ' ');
+    m_reason.sbStrcpyIn(p != NULL ? p + 1 : "");
+
+    // Header fields - kept as received for getHeader()
+
+    m_headersLen = 0;
+    m_headers.sbStrcpyIn("");
+
+    for (;;) {
+
+        if (!readLine(line, len))
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Connection closed in HTTP header");
+
+        if (len == 0)
+            break;
+
+        if (m_headersLen + len + 1 > XSEC_HTTP_MAX_HEADER_SIZE)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "HTTP header too long");
+
+        m_headers.sbMemcpyIn(m_headersLen, line.rawBuffer(), len);
+        m_headersLen += len;
+        m_headers[m_headersLen++] = '\n';
+        m_headers[m_headersLen] = '\0';
+
+    }
+
+    // Persistence
+
+    const char * conn = getHeader("Connection");
+    if (http11)
+        m_keepAlive = (conn == NULL || strcasecmp(conn, "close") != 0);
+    else
+        m_keepAlive = (conn != NULL && strcasecmp(conn, "keep-alive") == 0);
+
+    // How is the body delimited?
+
+    const char * te = getHeader("Transfer-Encoding");
+    const char * cl;
+
+    m_remaining = 0;
+    m_bodyDone = false;
+
+    if ((m_status >= 100 && m_status < 200) || m_status == 204 || m_status == 304) {
+        m_bodyMode = BODY_NONE;
+        m_bodyDone = true;
+    }
+    else if (te != NULL && strcasecmp(te, "identity") != 0) {
+        m_bodyMode = BODY_CHUNKED;
+    }
+    else if ((cl = getHeader("Content-Length")) != NULL) {
+        m_bodyMode = BODY_LENGTH;
+        m_remaining = (xsecsize_t) strtoul(cl, NULL, 10);
+        m_bodyDone = (m_remaining == 0);
+    }
+    else {
+        m_bodyMode = BODY_TO_CLOSE;
+        m_keepAlive = false;
+    }
+
+    return true;
+
+}
+
+const char * XSECHTTPExchange::getHeader(const char * name) const {
+
+    size_t nameLen = strlen(name);
+    const char * p = m_headers.rawCharBuffer();
+    const char * end = p + m_headersLen;
+
+    while (p < end) {
+
+        const char * nl = (const char *) memchr(p, '\n', end - p);
+        if (nl == NULL)
+            nl = end;
+
+        if ((size_t) (nl - p) > nameLen && strncasecmp(p, name, nameLen) == 0 && p[nameLen] == ':') {
+
+            const char * v = p + nameLen + 1;
+            while (v < nl && (*v == ' ' || *v == '\t'))
+                ++v;
+            const char * e = nl;
+            while (e > v && (e[-1] == ' ' || e[-1] == '\t'))
+                --e;
+
+            m_headerValue.sbStrncpyIn(v, (xsecsize_t) (e - v));
+            return m_headerValue.rawCharBuffer();
+
+        }
+
+        p = nl + 1;
+
+    }
+
+    return NULL;
+
+}
+
+const char * XSECHTTPExchange::getReason() const {
+
+    return m_reason.rawCharBuffer();
+
+}
+
+// --------------------------------------------------------------------------------
+//           Exchange - response body
+// --------------------------------------------------------------------------------
+
+xsecsize_t XSECHTTPExchange::readRaw(XMLByte * toFill, xsecsize_t maxToRead) {
+
+    xsecsize_t len = (xsecsize_t) (mp_bufferEnd - mp_bufferPos);
+
+    if (len > 0) {
+
+        // Anything left over from reading the headers goes first
+        if (len > maxToRead)
+            len = maxToRead;
+        memcpy(toFill, mp_bufferPos, len);
+        mp_bufferPos += len;
+        return len;
+
+    }
+
+    // Straight into the caller's buffer
+
+    for (;;) {
+
+        ssize_t n = recv(m_socket, toFill, maxToRead, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Error reading from Socket");
+        return (xsecsize_t) n;
+
+    }
+
+}
+
+xsecsize_t XSECHTTPExchange::readBody(XMLByte * toFill, xsecsize_t maxToRead) {
+
+    if (m_bodyDone || maxToRead == 0 || m_socket < 0)
+        return 0;
+
+    xsecsize_t n;
+
+    switch (m_bodyMode) {
+
+    case BODY_TO_CLOSE :
+
+        n = readRaw(toFill, maxToRead);
+        if (n == 0)
+            m_bodyDone = true;
+        return n;
+
+    case BODY_LENGTH :
+
+        n = readRaw(toFill, (maxToRead < m_remaining ? maxToRead : m_remaining));
+        if (n == 0)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Connection closed before end of HTTP body");
+        m_remaining -= n;
+        if (m_remaining == 0)
+            m_bodyDone = true;
+        return n;
+
+    case BODY_CHUNKED :
+        break;
+
+    default :
+        m_bodyDone = true;
+        return 0;
+
+    }
+
+    // Chunked : size line, data, CRLF ... 0 size line, trailers, blank line
+
+    safeBuffer line;
+    xsecsize_t len;
+
+    if (m_remaining == 0) {
+
+        if (!readLine(line, len))
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Connection closed before end of HTTP body");
+
+        m_remaining = (xsecsize_t) strtoul(line.rawCharBuffer(), NULL, 16);
+
+        if (m_remaining == 0) {
+
+            // Last chunk - skip any trailer fields
+            do {
+                if (!readLine(line, len))
+                    throw XSECException(XSECException::HTTPURIInputStreamError,
+                                        "Connection closed before end of HTTP body");
+            } while (len > 0);
+
+            m_bodyDone = true;
+            return 0;
+
+        }
+
+    }
+
+    n = readRaw(toFill, (maxToRead < m_remaining ? maxToRead : m_remaining));
+    if (n == 0)
+        throw XSECException(XSECException::HTTPURIInputStreamError,
+                            "Connection closed before end of HTTP body");
+
+    m_remaining -= n;
+
+    if (m_remaining == 0) {
+        // CRLF after the chunk data
+        if (!readLine(line, len) || len != 0)
+            throw XSECException(XSECException::HTTPURIInputStreamError,
+                                "Malformed HTTP chunk");
+    }
+
+    return n;
+
+}
+
+xsecsize_t XSECHTTPExchange::readBody(safeBuffer & sb) {
+
+    XMLByte buf[XSEC_HTTP_BUFFER_SIZE];
+    xsecsize_t total = 0, n;
+
+    while ((n = readBody(buf, XSEC_HTTP_BUFFER_SIZE)) > 0) {
+        sb.sbMemcpyIn(total, buf, n);
+        total += n;
+    }
+
+    return total;
+
+}
+
+void XSECHTTPExchange::skipBody() {
+
+    // Not worth reading a long way just to save a connection
+    if (m_bodyMode == BODY_TO_CLOSE ||
+        (m_bodyMode == BODY_LENGTH && m_remaining > 0x10000)) {
+        closeConnection();
+        return;
+    }
+
+    XMLByte buf[XSEC_HTTP_BUFFER_SIZE];
+    while (readBody(buf, XSEC_HTTP_BUFFER_SIZE) > 0)
+        ;
+
+}
@@ -0,0 +1,203 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * XSEC
+ *
+ * XSECHTTPConnectionPool := Shared pool of persistent (keep-alive) HTTP/1.1
+ *                           connections, plus a single request/response
+ *                           exchange run over one of them
+ *
+ * $Id$
+ *
+ */
+
+#ifndef UNIXXSECHTTPCONNECTIONPOOL_HEADER
+#define UNIXXSECHTTPCONNECTIONPOOL_HEADER
+
+#include <xsec/framework/XSECDefs.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
+
+#include <xercesc/util/XMLUri.hpp>
+
+// Defaults for the shared pool
+#define XSEC_HTTP_POOL_MAX_PER_HOST		4		// Connections per host:port
+#define XSEC_HTTP_POOL_IDLE_TIMEOUT		30		// Seconds an idle connection is kept
+#define XSEC_HTTP_POOL_TIMEOUT			60		// Seconds to wait on a socket or a free slot
+#define XSEC_HTTP_BUFFER_SIZE			4096
+#define XSEC_HTTP_MAX_REDIRECTS			10		// Followed by XSECBinHTTPURIInputStream
+
+//
+// Connections are keyed by host and port.  At most maxPerHost are in use
+// for any one server at a time - further callers block (for at most
+// timeout seconds) until one is handed back.  Connections returned in a
+// re-usable state are kept (up to maxPerHost per server) for idleTimeout
+// seconds.  Idle connections are checked for having been closed by the
+// server before they are re-used.
+//
+// Sends and receives on pooled sockets also give up after timeout
+// seconds.  A timeout of 0 waits indefinitely.
+//
+// The pool is thread safe.  A process wide instance (used by
+// XSECBinHTTPURIInputStream and XSECSOAPRequestorSimple) is created by
+// XSECPlatformUtils::Initialise() and can be obtained via getDefault().
+//
+
+class DSIG_EXPORT XSECHTTPConnectionPool
+{
+public :
+    XSECHTTPConnectionPool(unsigned int maxPerHost = XSEC_HTTP_POOL_MAX_PER_HOST,
+                           unsigned int idleTimeout = XSEC_HTTP_POOL_IDLE_TIMEOUT,
+                           unsigned int timeout = XSEC_HTTP_POOL_TIMEOUT);
+    ~XSECHTTPConnectionPool();
+
+    // Configuration
+    void setMaxPerHost(unsigned int maxPerHost);
+    unsigned int getMaxPerHost() const;
+    void setIdleTimeout(unsigned int seconds);
+    unsigned int getIdleTimeout() const;
+    void setTimeout(unsigned int seconds);
+    unsigned int getTimeout() const;
+
+    // Obtain a connected socket to host:port.  reused is set to true if
+    // the socket has carried a previous request.
+    int acquire(const char * host, unsigned short port, bool & reused);
+
+    // Hand a socket from acquire() back.  If keepAlive is false (or the
+    // pool for the server is full) the socket is closed.
+    void release(const char * host, unsigned short port, int sock, bool keepAlive);
+
+    // Close every idle connection
+    void closeIdle();
+
+    // Statistics - new connections made and idle connections re-used
+    unsigned long getConnectCount() const;
+    unsigned long getReuseCount() const;
+
+    // The process wide pool
+    static XSECHTTPConnectionPool * getDefault();
+    static void Initialise();
+    static void Terminate();
+
+private :
+
+    struct PoolState;
+
+    int connectTo(const char * host, unsigned short port);
+
+    // Unimplemented
+    XSECHTTPConnectionPool(const XSECHTTPConnectionPool &);
+    XSECHTTPConnectionPool & operator = (const XSECHTTPConnectionPool &);
+
+    PoolState *         mp_state;
+
+    static XSECHTTPConnectionPool * s_defaultPool;
+
+};
+
+//
+// One HTTP/1.1 request and its response, run over a pooled connection.
+// If a re-used connection turns out to have been dropped by the server,
+// the request is transparently sent again on a fresh connection - but
+// only if it could not be sent at all, or it is a GET or HEAD (which the
+// server may safely see twice) and none of the response had arrived.
+// Otherwise the error is passed to the caller.
+//
+// The response body is de-chunked as necessary.  Once the body has been
+// read to the end, the connection goes back to the pool when the exchange
+// is deleted (unless either side asked for it to be closed).
+//
+
+class DSIG_EXPORT XSECHTTPExchange
+{
+public :
+    XSECHTTPExchange(XSECHTTPConnectionPool * pool,
+                     const XERCES_CPP_NAMESPACE_QUALIFIER XMLUri & uri);
+    ~XSECHTTPExchange();
+
+    // Send the request and read the response headers.  extraHeaders (if
+    // not NULL) must be complete CRLF terminated header lines.
+    // Returns the HTTP status code.
+    int doRequest(const char * method,
+                  const char * extraHeaders,
+                  const char * body,
+                  xsecsize_t bodyLen);
+
+    // Value of a response header (case insensitive name), or NULL
+    const char * getHeader(const char * name) const;
+
+    // Reason phrase of the status line (may be empty)
+    const char * getReason() const;
+
+    // Read up to maxToRead bytes of body.  Returns 0 at the end.
+    xsecsize_t readBody(XMLByte * toFill, xsecsize_t maxToRead);
+
+    // Read the body to the end, appending it to sb.  Returns the length.
+    xsecsize_t readBody(safeBuffer & sb);
+
+    // Read and discard the rest of the body (so the connection can be re-used)
+    void skipBody();
+
+private :
+
+    enum BodyMode {
+        BODY_NONE,
+        BODY_LENGTH,
+        BODY_CHUNKED,
+        BODY_TO_CLOSE
+    };
+
+    bool sendAndReadHeaders(const safeBuffer & request, xsecsize_t len, bool mayResend);
+    bool readHeaders();
+    bool readLine(safeBuffer & line, xsecsize_t & len);
+    xsecsize_t readRaw(XMLByte * toFill, xsecsize_t maxToRead);
+    bool fill();
+    void closeConnection();
+
+    // Unimplemented
+    XSECHTTPExchange(const XSECHTTPExchange &);
+    XSECHTTPExchange & operator = (const XSECHTTPExchange &);
+
+    XSECHTTPConnectionPool *    mp_pool;
+    char *                      mp_host;
+    unsigned short              m_port;
+    safeBuffer                  m_target;       // Request target (path + query)
+
+    int                         m_socket;
+    bool                        m_reused;
+    bool                        m_keepAlive;
+
+    char                        m_buffer[XSEC_HTTP_BUFFER_SIZE];
+    char *                      mp_bufferPos;
+    char *                      mp_bufferEnd;
+    xsecsize_t                  m_bytesRead;    // Raw bytes received on this exchange
+
+    safeBuffer                  m_headers;      // Lines after the status line
+    xsecsize_t                  m_headersLen;
+    int                         m_status;
+    safeBuffer                  m_reason;
+    mutable safeBuffer          m_headerValue;
+
+    BodyMode                    m_bodyMode;
+    xsecsize_t                  m_remaining;    // In the body or current chunk
+    bool                        m_bodyDone;
+
+};
+
+#endif // UNIXXSECHTTPCONNECTIONPOOL_HEADER
@@ -80,10 +80,16 @@ XERCES_CPP_NAMESPACE_USE
 
 #include <xsec/framework/XSECError.hpp>
 #include <xsec/utils/XSECDOMUtils.hpp>
+#include <xsec/utils/XSECSafeBuffer.hpp>
 #include <xsec/utils/unixutils/XSECBinHTTPURIInputStream.hpp>
+#include <xsec/utils/unixutils/XSECBinMMapFileInputStream.hpp>
 
 #include "../../utils/XSECAutoPtr.hpp"
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+
 static const XMLCh gFileScheme[] = {
 
 	XERCES_CPP_NAMESPACE_QUALIFIER chLatin_f,
@@ -122,7 +128,8 @@ static const XMLCh DOTDOT_SLASH[] = {
 
 
 XSECURIResolverGenericUnix::XSECURIResolverGenericUnix() :
-mp_baseURI(NULL) {
+mp_baseURI(NULL),
+m_mapFiles(false) {
 
 };
 
@@ -134,16 +141,13 @@ XSECURIResolverGenericUnix::~XSECURIResolverGenericUnix() {
 }
 
 // -----------------------------------------------------------------------
-//  Resolve a URI that is passed in
+//  Resolve a URI against the base URI
 // -----------------------------------------------------------------------
 
-BinInputStream * XSECURIResolverGenericUnix::resolveURI(const XMLCh * uri) {
+XERCES_CPP_NAMESPACE_QUALIFIER XMLUri * XSECURIResolverGenericUnix::makeXMLUri(const XMLCh * uri) {
 
-	XSEC_USING_XERCES(BinInputStream);
 	XSEC_USING_XERCES(XMLUri);
-	XSEC_USING_XERCES(XMLUni);
 	XSEC_USING_XERCES(Janitor);
-	XSEC_USING_XERCES(BinFileInputStream);
 
 	XMLUri					* xmluri;
 
@@ -191,42 +195,87 @@ BinInputStream * XSECURIResolverGenericUnix::resolveURI(const XMLCh * uri) {
 	else {
 		XSECnew(xmluri, XMLUri(uri));
 	}
-	
+
+	return xmluri;
+
+}
+
+// -----------------------------------------------------------------------
+//  Map a file: URI to a local path
+// -----------------------------------------------------------------------
+
+char * XSECURIResolverGenericUnix::makeLocalPath(const XERCES_CPP_NAMESPACE_QUALIFIER XMLUri * xmluri) {
+
+	XSEC_USING_XERCES(XMLUni);
+
+	if (XMLString::compareIString(xmluri->getScheme(), gFileScheme))
+		return NULL;
+
+	// This is a file.  We only really understand if this is localhost
+	// XMLUri has already cleaned of escape characters (%xx)
+
+	if (xmluri->getHost() == NULL || xmluri->getHost()[0] == chNull ||
+		!XMLString::compareIString(xmluri->getHost(), XMLUni::fgLocalHostString)) {
+
+		// Clean hex escapes
+		XMLCh * realPath = cleanURIEscapes(xmluri->getPath());
+
+		char * localPath = XMLString::transcode(realPath);
+		XSEC_RELEASE_XMLCH(realPath);
+
+		return localPath;
+
+	}
+
+	throw XSECException(XSECException::ErrorOpeningURI,
+		"XSECURIResolverGenericUnix - unable to open non-localhost file");
+
+}
+
+// -----------------------------------------------------------------------
+//  Resolve a URI that is passed in
+// -----------------------------------------------------------------------
+
+BinInputStream * XSECURIResolverGenericUnix::resolveURI(const XMLCh * uri) {
+
+	XSEC_USING_XERCES(BinInputStream);
+	XSEC_USING_XERCES(XMLUri);
+	XSEC_USING_XERCES(Janitor);
+
+	XMLUri * xmluri = makeXMLUri(uri);
 	Janitor<XMLUri> j_xmluri(xmluri);
 
 	// Determine what kind of URI this is and how to handle it.
 	
-	if (!XMLString::compareIString(xmluri->getScheme(), gFileScheme)) {
-
-		// This is a file.  We only really understand if this is localhost
-		// XMLUri has already cleaned of escape characters (%xx)
-        
-		if (xmluri->getHost() == NULL || xmluri->getHost()[0] == chNull ||
-			!XMLString::compareIString(xmluri->getHost(), XMLUni::fgLocalHostString)) {
+	char * localPath = makeLocalPath(xmluri);
+	if (localPath != NULL) {
 
-			// Clean hex escapes
-			XMLCh * realPath = cleanURIEscapes(xmluri->getPath());
+		// Localhost
 
-			// Localhost
+		if (m_mapFiles) {
 
-            BinFileInputStream* retStrm = new BinFileInputStream(realPath);
-            XSEC_RELEASE_XMLCH(realPath);
+			XSECBinMMapFileInputStream* retStrm = new XSECBinMMapFileInputStream(localPath);
+			XSEC_RELEASE_XMLCH(localPath);
 
-            if (!retStrm->getIsOpen())
-            {
-                delete retStrm;
-                return 0;
-            }
-            return retStrm;
+			if (!retStrm->getIsOpen())
+			{
+				delete retStrm;
+				return 0;
+			}
+			return retStrm;
 
 		}
 
-		else {
+		XERCES_CPP_NAMESPACE_QUALIFIER BinFileInputStream* retStrm =
+			new XERCES_CPP_NAMESPACE_QUALIFIER BinFileInputStream(localPath);
+		XSEC_RELEASE_XMLCH(localPath);
 
-			throw XSECException(XSECException::ErrorOpeningURI,
-				"XSECURIResolverGenericUnix - unable to open non-localhost file");
-		
+		if (!retStrm->getIsOpen())
+		{
+			delete retStrm;
+			return 0;
 		}
+		return retStrm;
 
 	}
 
@@ -247,6 +296,61 @@ BinInputStream * XSECURIResolverGenericUnix::resolveURI(const XMLCh * uri) {
 	
 }
 
+// -----------------------------------------------------------------------
+//  Validators for cached digests
+// -----------------------------------------------------------------------
+
+bool XSECURIResolverGenericUnix::getValidator(const XMLCh * uri, safeBuffer & validator) {
+
+	XSEC_USING_XERCES(XMLUri);
+	XSEC_USING_XERCES(Janitor);
+
+	XMLUri * xmluri = makeXMLUri(uri);
+	Janitor<XMLUri> j_xmluri(xmluri);
+
+	char * localPath = makeLocalPath(xmluri);
+	if (localPath == NULL)
+		return false;
+
+	struct stat st;
+	int res = stat(localPath, &st);
+
+	if (res != 0 || !S_ISREG(st.st_mode)) {
+		XSEC_RELEASE_XMLCH(localPath);
+		return false;
+	}
+
+	// A file re-written within the same second only shows up in the
+	// sub-second part of the times, where the platform records it
+
+	char buf[160];
+#if defined (XSEC_HAVE_STAT_TIM)
+	sprintf(buf, "|%lu|%lu|%llu|%ld.%09ld|%ld.%09ld",
+		(unsigned long) st.st_dev,
+		(unsigned long) st.st_ino,
+		(unsigned long long) st.st_size,
+		(long) st.st_mtim.tv_sec,
+		(long) st.st_mtim.tv_nsec,
+		(long) st.st_ctim.tv_sec,
+		(long) st.st_ctim.tv_nsec);
+#else
+	sprintf(buf, "|%lu|%lu|%llu|%ld|%ld",
+		(unsigned long) st.st_dev,
+		(unsigned long) st.st_ino,
+		(unsigned long long) st.st_size,
+		(long) st.st_mtime,
+		(long) st.st_ctime);
+#endif
+
+	validator.sbStrcpyIn("file:");
+	validator.sbStrcatIn(localPath);
+	validator.sbStrcatIn(buf);
+	XSEC_RELEASE_XMLCH(localPath);
+
+	return true;
+
+}
+
 // -----------------------------------------------------------------------
 //  Clone me
 // -----------------------------------------------------------------------
@@ -263,6 +367,8 @@ XSECURIResolver * XSECURIResolverGenericUnix::clone(void) {
 	else
 		ret->mp_baseURI = NULL;
 
+	ret->m_mapFiles = m_mapFiles;
+
 	return ret;
 
 }
@@ -57,6 +57,8 @@
 
 #include <xercesc/util/XMLString.hpp>
 
+XSEC_DECLARE_XERCES_CLASS(XMLUri);
+
 /**
  * @ingroup pubsig
  */
@@ -119,6 +121,20 @@ public:
 
 	virtual XSECURIResolver * clone(void);
 
+	/**
+	 * \brief Provide a validator for the content a URI resolves to.
+	 *
+	 * Local files are identified by their resolved path, device, inode,
+	 * size and modification time.  No validator is provided for other
+	 * schemes.
+	 *
+	 * @param uri The URI as passed to resolveURI()
+	 * @param validator Buffer to receive the validator string
+	 * @returns true if a validator was set
+	 */
+
+	virtual bool getValidator(const XMLCh * uri, safeBuffer & validator);
+
 	//@}
 
 	/** @name Class specific functions */
@@ -131,11 +147,36 @@ public:
 
 	void setBaseURI(const XMLCh * uri);
 
+	/**
+	 * \brief Map local files into memory
+	 *
+	 * When set, local files are returned as an XSECBinMMapFileInputStream,
+	 * which lets them be digested without copying or read() calls.
+	 * Otherwise (the default) they are read through a BinFileInputStream.
+	 *
+	 * @note If a mapped file is truncated while it is being read, the
+	 * process receives SIGBUS rather than a read error.  Only set this
+	 * for files that are not changed while signatures are processed.
+	 * @param flag true to map local files
+	 */
+
+	void setMapLocalFiles(bool flag) {m_mapFiles = flag;}
+
+	/**
+	 * \brief Are local files mapped into memory?
+	 */
+
+	bool getMapLocalFiles(void) const {return m_mapFiles;}
+
 	//@}
 
 private:
 
+	XERCES_CPP_NAMESPACE_QUALIFIER XMLUri * makeXMLUri(const XMLCh * uri);
+	char * makeLocalPath(const XERCES_CPP_NAMESPACE_QUALIFIER XMLUri * xmluri);
+
 	XMLCh			* mp_baseURI;
+	bool			m_mapFiles;
 
 
 };
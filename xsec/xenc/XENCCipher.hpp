@@ -613,6 +613,52 @@ public:
 
 	//@}
 
+	/** @name Recipient Functions */
+	//@{
+
+	/**
+	 * \brief Identify the Key Encryption Key
+	 *
+	 * Describes the KEK as a sender would in the KeyInfo of an
+	 * EncryptedKey.  When the key for an EncryptedData is found from
+	 * the EncryptedKey elements in its KeyInfo, those that identify the
+	 * KEK are tried first, then those that carry nothing to compare.
+	 * Those that only identify other keys (by any of the values set
+	 * here) are tried last, so a message for many recipients rarely
+	 * costs a failed decrypt per recipient.
+	 *
+	 * Without an identity (the default), every EncryptedKey is tried
+	 * in turn.
+	 *
+	 * The issuer name is compared as a distinguished name - case,
+	 * spacing, escaping, attribute aliases and RDN order (either way
+	 * round) do not matter.  The serial number is compared as an
+	 * integer, and whitespace is ignored in the base64 SKI and digest.
+	 * KeyName is compared as a string.  Any of the parameters may be
+	 * NULL, and passing all NULL removes the identity.
+	 *
+	 * @note Declared last, with a default that does nothing, so the
+	 * vtable slots of the other functions are as they were.  The vtable
+	 * still grows, so implementations compiled against earlier headers
+	 * must be rebuilt.
+	 *
+	 * @param keyName Compared with KeyName
+	 * @param issuerName Compared with X509IssuerName in X509IssuerSerial
+	 * @param serialNumber Compared with X509SerialNumber in X509IssuerSerial
+	 * @param ski Compared with X509SKI
+	 * @param digestAlgorithm Algorithm URI of digest
+	 * @param digest Compared with an X509Digest of the same algorithm
+	 */
+
+	virtual void setKEKIdentity(const XMLCh * keyName,
+		const XMLCh * issuerName = NULL,
+		const XMLCh * serialNumber = NULL,
+		const XMLCh * ski = NULL,
+		const XMLCh * digestAlgorithm = NULL,
+		const XMLCh * digest = NULL) {}
+
+	//@}
+
 };
 
 /*\@}*/
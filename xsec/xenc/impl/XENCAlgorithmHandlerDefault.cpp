@@ -62,19 +62,6 @@ unsigned char s_3DES_CMS_IV [] = {
 	0x05
 };
 
-unsigned char s_AES_IV [] = {
-
-	0xA6,
-	0xA6,
-	0xA6,
-	0xA6,
-	0xA6,
-	0xA6,
-	0xA6,
-	0xA6
-
-};
-
 // --------------------------------------------------------------------------------
 //			Compare URI to key type
 // --------------------------------------------------------------------------------
@@ -210,8 +197,6 @@ unsigned int XENCAlgorithmHandlerDefault::unwrapKeyAES(
 
 	// Cat the encrypted key
 	XMLByte buf[_MY_MAX_KEY_SIZE];
-	XMLByte aesBuf[16];
-	XMLByte aesOutBuf[16];
 	TXFMBase * b = cipherText->getLastTxfm();
 	unsigned int sz = (unsigned int) b->readBytes(buf, _MY_MAX_KEY_SIZE);
 
@@ -235,48 +220,21 @@ unsigned int XENCAlgorithmHandlerDefault::unwrapKeyAES(
 	// not have been able to get through algorithm checks otherwise
 	XSECCryptoSymmetricKey * sk = (XSECCryptoSymmetricKey *) key;
 
-	int blocks = sz / 8;
-	int n = blocks - 1;
-	for (int j = 5; j >= 0; j--) {
-		for (int i = n ; i > 0 ; --i) {
-
-			// Gather blocks to decrypt
-			// A
-			memcpy(aesBuf, buf, 8);
-			// Ri
-			memcpy(&aesBuf[8], &buf[8 * i], 8);
-			// A mod t
-			aesBuf[7] ^= ((n * j) + i);
-
-			// do decrypt
-			sk->decryptInit(false, XSECCryptoSymmetricKey::MODE_ECB);		// No padding
-			int sz = sk->decrypt(aesBuf, aesOutBuf, 16, 16);
-			sz += sk->decryptFinish(&aesOutBuf[sz], 16 - sz);
-
-			if (sz != 16) {
-				throw XSECException(XSECException::CipherError, 
-					"XENCAlgorithmHandlerDefault - Error performing decrypt in AES Unwrap");
-			}
-
-			// Copy back to where we are
-			// A
-			memcpy(buf, aesOutBuf, 8);
-			// Ri
-			memcpy(&buf[8 * i], &aesOutBuf[8], 8);
-
-		}
-	}
+	// Unwrapped in place
+	unsigned int len =
+		XSECPlatformUtils::g_cryptoProvider->unwrapKeyAES(sk, buf, sz, buf, _MY_MAX_KEY_SIZE);
 
 	// Check is valid
-	if (memcmp(buf, s_AES_IV, 8) != 0) {
+	if (len == 0) {
 		throw XSECException(XSECException::CipherError, 
 			"XENCAlgorithmHandlerDefault - decrypt failed - AES IV is not correct");
 	}
 
 	// Copy to safebuffer
-	result.sbMemcpyIn(&buf[8], n * 8);
+	result.sbMemcpyIn(buf, len);
+	memset(buf, 0, len);
 
-	return n * 8;
+	return len;
 }
 
 bool XENCAlgorithmHandlerDefault::wrapKeyAES(
@@ -286,9 +244,6 @@ bool XENCAlgorithmHandlerDefault::wrapKeyAES(
 
 	// get the raw key
 	XMLByte buf[_MY_MAX_KEY_SIZE + 8];
-	memcpy(buf, s_AES_IV, 8);
-	XMLByte aesBuf[16];
-	XMLByte aesOutBuf[32];  // Give this an extra block for WinCAPI
 	TXFMBase * b = cipherText->getLastTxfm();
 	unsigned int sz = (unsigned int) b->readBytes(&buf[8], _MY_MAX_KEY_SIZE);
 
@@ -308,41 +263,13 @@ bool XENCAlgorithmHandlerDefault::wrapKeyAES(
 			"XENCAlgorithmHandlerDefault - AES wrapped key not a multiple of 64");
 	}
 
-	// Do the decrypt - this cast will throw if wrong, but we should
+	// Do the encrypt - this cast will throw if wrong, but we should
 	// not have been able to get through algorithm checks otherwise
 	XSECCryptoSymmetricKey * sk = (XSECCryptoSymmetricKey *) key;
 
-	int n = sz / 8;
-
-	for (int j = 0; j <= 5; ++j) {
-		for (int i = 1 ; i <= n ; ++i) {
-
-			// Gather blocks to decrypt
-			// A
-			memcpy(aesBuf, buf, 8);
-			// Ri
-			memcpy(&aesBuf[8], &buf[8 * i], 8);
-
-			// do encrypt
-			sk->encryptInit(false, XSECCryptoSymmetricKey::MODE_ECB);
-			int sz = sk->encrypt(aesBuf, aesOutBuf, 16, 32);
-			sz += sk->encryptFinish(&aesOutBuf[sz], 32 - sz);
-
-			if (sz != 16) {
-				throw XSECException(XSECException::CipherError, 
-					"XENCAlgorithmHandlerDefault - Error performing encrypt in AES wrap");
-			}
-
-			// Copy back to where we are
-			// A
-			memcpy(buf, aesOutBuf, 8);
-			// A mod t
-			buf[7] ^= ((n * j) + i);
-			// Ri
-			memcpy(&buf[8 * i], &aesOutBuf[8], 8);
-
-		}
-	}
+	// Wrapped in place
+	unsigned int wrappedLen =
+		XSECPlatformUtils::g_cryptoProvider->wrapKeyAES(sk, &buf[8], sz, buf, _MY_MAX_KEY_SIZE + 8);
 
 	// Now we have to base64 encode
 	XSECCryptoBase64 * b64 = XSECPlatformUtils::g_cryptoProvider->base64();
@@ -356,12 +283,12 @@ bool XENCAlgorithmHandlerDefault::wrapKeyAES(
 
 	Janitor<XSECCryptoBase64> j_b64(b64);
 	unsigned char * b64Buffer;
-	int bufLen = ((n + 1) * 8) * 3;
+	int bufLen = wrappedLen * 3;
 	XSECnew(b64Buffer, unsigned char[bufLen + 1]);// Overkill
 	ArrayJanitor<unsigned char> j_b64Buffer(b64Buffer);
 
 	b64->encodeInit();
-	int outputLen = b64->encode (buf, (n+1) * 8, b64Buffer, bufLen);
+	int outputLen = b64->encode (buf, wrappedLen, b64Buffer, bufLen);
 	outputLen += b64->encodeFinish(&b64Buffer[outputLen], bufLen - outputLen);
 	b64Buffer[outputLen] = '\0';
 
@@ -577,10 +504,20 @@ bool XENCAlgorithmHandlerDefault::appendDecryptCipherTXFM(
 			"XENCAlgorithmHandlerDefault::appendDecryptCipherTXFM - only supports bulk symmetric algorithms");
 	}
 
+    if (skm == XSECCryptoSymmetricKey::MODE_GCM && ((XSECCryptoSymmetricKey *) key)->canDeferTag()) {
+
+        // The tag is held back as the cipher text streams through, and the
+        // plain text released as XSECPlatformUtils::GetPlaintextRelease() says
+        TXFMCipher* tcipher;
+        XSECnew(tcipher, TXFMCipher(doc, key, false, skm, taglen));
+        cipherText->appendTxfm(tcipher);
+        return true;
+    }
+
     if (skm == XSECCryptoSymmetricKey::MODE_GCM) {
 
-        // GCM doesn't fit the pipelined model of the existing code, so we have a custom
-        // routine that decrypts to a safeBuffer directly.
+        // Keys that need the tag up front don't fit the pipelined model of the
+        // existing code, so we have a custom routine that decrypts to a safeBuffer directly.
         safeBuffer result;
         unsigned int sz = doGCMDecryptToSafeBuffer(cipherText, key, taglen, result);
 
@@ -862,16 +799,24 @@ unsigned int XENCAlgorithmHandlerDefault::decryptToSafeBuffer(
 
 	}
 
-    if (skm == XSECCryptoSymmetricKey::MODE_GCM) {
-        // GCM doesn't fit the pipelined model of the existing code, so we have a custom
-        // routine that decrypts to a safeBuffer directly.
+    if (skm == XSECCryptoSymmetricKey::MODE_GCM && !((XSECCryptoSymmetricKey *) key)->canDeferTag()) {
+        // Keys that need the tag up front don't fit the pipelined model of the
+        // existing code, so we have a custom routine that decrypts to a safeBuffer directly.
         return doGCMDecryptToSafeBuffer(cipherText, key, taglen, result);
     }
 
-	// It's symmetric and it's not a key wrap or GCM, so just treat as a block algorithm.
+	// It's symmetric and it's not a key wrap, so just treat as a block algorithm.
 
 	TXFMCipher * tcipher;
-	XSECnew(tcipher, TXFMCipher(doc, key, false));
+
+    if (skm == XSECCryptoSymmetricKey::MODE_GCM) {
+        XSECnew(tcipher, TXFMCipher(doc, key, false, skm, taglen));
+        // The caller only gets the result if the tag verifies, so there is
+        // nothing to be gained by holding the plain text back here as well
+        tcipher->setPlaintextRelease(XSECPlatformUtils::PLAINTEXT_STREAM);
+    }
+    else
+	    XSECnew(tcipher, TXFMCipher(doc, key, false));
 
 	cipherText->appendTxfm(tcipher);
 
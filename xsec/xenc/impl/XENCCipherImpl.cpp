@@ -31,6 +31,8 @@
 #include <xsec/framework/XSECDefs.hpp>
 #include <xsec/framework/XSECError.hpp>
 #include <xsec/enc/XSECCryptoKey.hpp>
+#include <xsec/dsig/DSIGKeyInfoList.hpp>
+#include <xsec/dsig/DSIGKeyInfoX509.hpp>
 #include <xsec/transformers/TXFMChain.hpp>
 #include <xsec/transformers/TXFMBase.hpp>
 #include <xsec/transformers/TXFMC14n.hpp>
@@ -46,6 +48,7 @@
 #include <xsec/framework/XSECAlgorithmHandler.hpp>
 #include <xsec/utils/XSECPlatformUtils.hpp>
 #include <xsec/utils/XSECBinTXFMInputStream.hpp>
+#include <xsec/utils/XSECParserPool.hpp>
 
 #include "XENCCipherImpl.hpp"
 #include "XENCEncryptedDataImpl.hpp"
@@ -58,7 +61,15 @@
 #include <xercesc/util/XMLUniDefs.hpp>
 #include <xercesc/parsers/XercesDOMParser.hpp>
 #include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/util/BinInputStream.hpp>
+#include <xercesc/sax/InputSource.hpp>
 #include <xercesc/util/Janitor.hpp>
+#include <xercesc/util/XMLChar.hpp>
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 // With all the characters - just uplift entire thing
 
@@ -72,9 +83,9 @@ using std::cout;
 // --------------------------------------------------------------------------------
 
 
-const XMLCh s_tagname[] = {
+const XMLCh s_memBufId[] = {
 
-chLatin_f, chLatin_r, chLatin_a, chLatin_g, chLatin_m, chLatin_e, chLatin_n, chLatin_t, chNull };
+chLatin_X, chLatin_S, chLatin_E, chLatin_C, chLatin_M, chLatin_e, chLatin_m, chNull };
 
 const XMLCh s_noData[] = { chLatin_n, chLatin_o, chLatin_D, chLatin_a, chLatin_t, chLatin_a, chNull };
 
@@ -85,7 +96,10 @@ const XMLCh s_ds[] = { chLatin_d, chLatin_s, chNull };
 // --------------------------------------------------------------------------------
 
 XENCCipherImpl::XENCCipherImpl(DOMDocument * doc) :
-    mp_doc(doc), mp_encryptedData(NULL), mp_key(NULL), mp_kek(NULL), mp_keyInfoResolver(NULL) {
+    mp_doc(doc), mp_encryptedData(NULL), mp_key(NULL), mp_kek(NULL),
+    mp_kekName(NULL), mp_kekIssuerName(NULL), mp_kekSerialNumber(NULL),
+    mp_kekSKI(NULL), mp_kekDigestAlgorithm(NULL), mp_kekDigest(NULL),
+    mp_keyInfoResolver(NULL) {
 
     XSECnew(mp_env, XSECEnv(doc));
     mp_env->setDSIGNSPrefix(s_ds);
@@ -112,6 +126,8 @@ XENCCipherImpl::~XENCCipherImpl() {
     if (mp_keyInfoResolver != NULL)
         delete mp_keyInfoResolver;
 
+    releaseKEKIdentity();
+
 }
 
 // --------------------------------------------------------------------------------
@@ -205,21 +221,259 @@ void XENCCipherImpl::setKEK(XSECCryptoKey * key) {
 
 }
 
+void XENCCipherImpl::releaseKEKIdentity(void) {
+
+    XSEC_RELEASE_XMLCH(mp_kekName);
+    XSEC_RELEASE_XMLCH(mp_kekIssuerName);
+    XSEC_RELEASE_XMLCH(mp_kekSerialNumber);
+    XSEC_RELEASE_XMLCH(mp_kekSKI);
+    XSEC_RELEASE_XMLCH(mp_kekDigestAlgorithm);
+    XSEC_RELEASE_XMLCH(mp_kekDigest);
+
+    mp_kekName = mp_kekIssuerName = mp_kekSerialNumber = NULL;
+    mp_kekSKI = mp_kekDigestAlgorithm = mp_kekDigest = NULL;
+
+}
+
+void XENCCipherImpl::setKEKIdentity(const XMLCh * keyName,
+                                    const XMLCh * issuerName,
+                                    const XMLCh * serialNumber,
+                                    const XMLCh * ski,
+                                    const XMLCh * digestAlgorithm,
+                                    const XMLCh * digest) {
+
+    releaseKEKIdentity();
+
+    mp_kekName = XMLString::replicate(keyName);
+    mp_kekIssuerName = XMLString::replicate(issuerName);
+    mp_kekSerialNumber = XMLString::replicate(serialNumber);
+    mp_kekSKI = XMLString::replicate(ski);
+    mp_kekDigestAlgorithm = XMLString::replicate(digestAlgorithm);
+    mp_kekDigest = XMLString::replicate(digest);
+
+}
+
 // --------------------------------------------------------------------------------
 //			Serialise/Deserialise an element
 // --------------------------------------------------------------------------------
 
-DOMDocumentFragment * XENCCipherImpl::deSerialise(safeBuffer &content, DOMNode * ctx) {
+// Stream presented to the parser when de-serialising.  It reads the
+// wrapper start tag (carrying the in-scope namespace declarations), then
+// the plain text - either directly from the decrypting transform or from
+// a buffer - then the wrapper end tag.  The plain text itself is never
+// copied into a wrapped string.
 
-    DOMDocumentFragment * result;
+class XENCFragmentInputStream : public BinInputStream {
+
+public:
+
+    XENCFragmentInputStream(const safeBuffer & prefix, TXFMBase * plainText,
+        const XMLByte * plainBuf, xsecsize_t plainLen, bool * bodyRead) :
+        mp_plainText(plainText),
+        mp_plainBuf(plainBuf),
+        m_plainLen(plainLen),
+        m_plainPos(0),
+        m_phase(PHASE_PREFIX),
+        m_pendingPos(0),
+        m_bytesRead(0),
+        mp_bodyRead(bodyRead) {
+
+        *mp_bodyRead = false;
+        m_pending.sbStrcpyIn(prefix.rawCharBuffer());
+        m_pendingLen = (xsecsize_t) strlen(prefix.rawCharBuffer());
+
+    }
+
+    virtual ~XENCFragmentInputStream() {}
+
+#ifdef XSEC_XERCES_64BITSAFE
+    virtual XMLFilePos curPos() const {
+#else
+    virtual unsigned int curPos() const {
+#endif
+        return m_bytesRead;
+    }
+
+#ifdef XSEC_XERCES_INPUTSTREAM_HAS_CONTENTTYPE
+    virtual const XMLCh* getContentType() const {
+        return NULL;
+    }
+#endif
+
+    virtual xsecsize_t readBytes(XMLByte* const toFill, const xsecsize_t maxToRead) {
+
+        xsecsize_t ret = 0;
+
+        while (ret == 0 && m_phase != PHASE_DONE) {
+
+            if (m_pendingPos < m_pendingLen) {
+
+                ret = m_pendingLen - m_pendingPos;
+                if (ret > maxToRead)
+                    ret = maxToRead;
+                memcpy(toFill, &(m_pending.rawBuffer()[m_pendingPos]), ret);
+                m_pendingPos += ret;
+
+            }
+
+            else if (m_phase == PHASE_PREFIX) {
+
+                skipLeadingPI();
+                m_phase = PHASE_BODY;
+
+            }
+
+            else if (m_phase == PHASE_BODY) {
+
+                ret = readPlain(toFill, maxToRead);
+                if (ret == 0) {
+
+                    // All the plain text is through, so any padding or
+                    // tag has been checked by the decrypting transform
+                    *mp_bodyRead = true;
+
+                    // Terminate with the closing wrapper
+                    m_pending.sbStrcpyIn("</");
+                    m_pending.sbStrcatIn(s_fragmentTag);
+                    m_pending.sbStrcatIn(">");
+                    m_pendingLen = (xsecsize_t) strlen(m_pending.rawCharBuffer());
+                    m_pendingPos = 0;
+                    m_phase = PHASE_TRAILER;
+
+                }
+
+            }
+
+            else
+                m_phase = PHASE_DONE;
+
+        }
+
+        m_bytesRead += ret;
+        return ret;
+
+    }
+
+    static const char s_fragmentTag[];
+
+private:
+
+    enum Phase {
+        PHASE_PREFIX,
+        PHASE_BODY,
+        PHASE_TRAILER,
+        PHASE_DONE
+    };
+
+    xsecsize_t readPlain(XMLByte * toFill, xsecsize_t maxToRead) {
+
+        if (mp_plainText != NULL)
+            return mp_plainText->readBytes(toFill, (unsigned int) maxToRead);
+
+        xsecsize_t ret = m_plainLen - m_plainPos;
+        if (ret > maxToRead)
+            ret = maxToRead;
+        memcpy(toFill, &mp_plainBuf[m_plainPos], ret);
+        m_plainPos += ret;
+
+        return ret;
+
+    }
+
+    // An XML declaration on the decrypted content would be illegal
+    // inside the wrapper, so drop any leading PI.  Only the first few
+    // bytes are held back to find out.
+
+    void skipLeadingPI(void) {
+
+        XMLByte buf[512];
+        xsecsize_t len = 0, sz;
+
+        m_pendingLen = m_pendingPos = 0;
+
+        do {
+            sz = readPlain(buf, 512);
+            m_pending.sbMemcpyIn(m_pendingLen, buf, sz);
+            m_pendingLen += sz;
+        } while (sz > 0 && m_pendingLen < 2);
+
+        const unsigned char * p = m_pending.rawBuffer();
+        if (m_pendingLen < 2 || p[0] != '<' || p[1] != '?')
+            return;
+
+        len = 2;
+        for (;;) {
+            while (len < m_pendingLen && p[len] != '>')
+                ++len;
+            if (len < m_pendingLen) {
+                // Found the end of the PI
+                m_pendingPos = len + 1;
+                return;
+            }
+            sz = readPlain(buf, 512);
+            if (sz == 0)
+                return;		// Unterminated - hand the lot to the parser
+            m_pending.sbMemcpyIn(m_pendingLen, buf, sz);
+            m_pendingLen += sz;
+            p = m_pending.rawBuffer();
+        }
+
+    }
+
+    TXFMBase                    * mp_plainText;
+    const XMLByte               * mp_plainBuf;
+    xsecsize_t                  m_plainLen;
+    xsecsize_t                  m_plainPos;
+    Phase                       m_phase;
+    safeBuffer                  m_pending;
+    xsecsize_t                  m_pendingLen;
+    xsecsize_t                  m_pendingPos;
+    xsecsize_t                  m_bytesRead;
+    bool                        * mp_bodyRead;
+
+};
+
+const char XENCFragmentInputStream::s_fragmentTag[] = "fragment";
+
+class XENCFragmentInputSource : public InputSource {
+
+public:
 
-    // Create the context to parse the document against
-    safeBuffer sb, sbt;
-    sb.sbXMLChIn(DSIGConstants::s_unicodeStrEmpty);
-    //sb.sbXMLChAppendCh(chUnicodeMarker);
-    //sb.sbXMLChCat8("<?xml version=\"1.0\" encoding=\"UTF-16\"?><");
-    sb.sbXMLChAppendCh(chOpenAngle);
-    sb.sbXMLChCat(s_tagname);
+    XENCFragmentInputSource(const safeBuffer & prefix, TXFMBase * plainText,
+        const XMLByte * plainBuf, xsecsize_t plainLen) :
+        InputSource(s_memBufId),
+        m_prefix(prefix),
+        mp_plainText(plainText),
+        mp_plainBuf(plainBuf),
+        m_plainLen(plainLen),
+        m_bodyRead(false) {}
+
+    virtual BinInputStream* makeStream() const {
+
+        // Direct new as for XSECTXFMInputSource
+        return new XENCFragmentInputStream(m_prefix, mp_plainText, mp_plainBuf, m_plainLen, &m_bodyRead);
+
+    }
+
+    // True once the parser has read the plain text through to the end
+    bool isBodyRead(void) const {return m_bodyRead;}
+
+private:
+
+    const safeBuffer            & m_prefix;
+    TXFMBase                    * mp_plainText;
+    const XMLByte               * mp_plainBuf;
+    xsecsize_t                  m_plainLen;
+    mutable bool                m_bodyRead;
+
+};
+
+void XENCCipherImpl::makeFragmentPrefix(DOMNode * ctx, safeBuffer & prefix) {
+
+    // Create the context to parse the document against.  This is
+    // written straight out as UTF-8.
+    prefix.sbStrcpyIn("<");
+    prefix.sbStrcatIn(XENCFragmentInputStream::s_fragmentTag);
 
     // Run through each node up to the document node and find any
     // xmlns: nodes that may be needed during the parse of the decrypted content
@@ -256,66 +510,39 @@ DOMDocumentFragment * XENCCipherImpl::deSerialise(safeBuffer &content, DOMNode *
                 if (found == false) {
 
                     // This is an attribute node that needs to be added
-                    sb.sbXMLChAppendCh(chSpace);
-                    sb.sbXMLChCat(att->getNodeName());
-                    sb.sbXMLChAppendCh(chEqual);
-                    sb.sbXMLChAppendCh(chDoubleQuote);
-                    sb.sbXMLChCat(att->getNodeValue());
-                    sb.sbXMLChAppendCh(chDoubleQuote);
+                    char * str = transcodeToUTF8(att->getNodeName());
+                    prefix.sbStrcatIn(" ");
+                    prefix.sbStrcatIn(str);
+                    XSEC_RELEASE_XMLCH(str);
+                    str = transcodeToUTF8(att->getNodeValue());
+                    prefix.sbStrcatIn("=\"");
+                    prefix.sbStrcatIn(str);
+                    prefix.sbStrcatIn("\"");
+                    XSEC_RELEASE_XMLCH(str);
                 }
             }
         }
         wk = wk->getParentNode();
     }
-    sb.sbXMLChAppendCh(chCloseAngle);
+    prefix.sbStrcatIn(">");
 
-    char* prefix = transcodeToUTF8(sb.rawXMLChBuffer());
-    sbt = prefix;
-    XSEC_RELEASE_XMLCH(prefix);
-
-    const char * crcb = content.rawCharBuffer();
-    int offset = 0;
-    if (crcb[0] == '<' && crcb[1] == '?') {
-        // Have a PI prefix - get rid of it
-        int i = 2;
-        while (crcb[i] != '\0' && crcb[i] != '>')
-            ++i;
-
-        if (crcb[i] == '>')
-            offset = i + 1;
-    }
-
-    sbt.sbStrcatIn(&crcb[offset]);
-
-    // Terminate the string
-    sb.sbXMLChIn(DSIGConstants::s_unicodeStrEmpty);
-    sb.sbXMLChAppendCh(chOpenAngle);
-    sb.sbXMLChAppendCh(chForwardSlash);
-    sb.sbXMLChCat(s_tagname);
-    sb.sbXMLChAppendCh(chCloseAngle);
-
-    char* trailer = transcodeToUTF8(sb.rawXMLChBuffer());
-    sbt.sbStrcatIn(trailer);
-    XSEC_RELEASE_XMLCH(trailer);
+}
 
-    // Create an input source
-    xsecsize_t bytes = XMLString::stringLen(sbt.rawCharBuffer());
-    MemBufInputSource memIS((const XMLByte*) sbt.rawBuffer(), bytes, "XSECMem");
+DOMDocumentFragment * XENCCipherImpl::parseFragment(InputSource & is, DOMNode * ctx) {
 
-    XercesDOMParser parser;
-    parser.setDoNamespaces(true);
-    parser.setLoadExternalDTD(false);
+    DOMDocumentFragment * result;
 
-    SecurityManager securityManager;
-    securityManager.setEntityExpansionLimit(XSEC_ENTITY_EXPANSION_LIMIT);
-    parser.setSecurityManager(&securityManager);
+    // The parsed document stays with the parser and is released when
+    // the parser goes back into the pool
+    XSECParserPoolJanitor j_parser;
+    XercesDOMParser * parser = j_parser.get();
 
-    parser.parse(memIS);
-    xsecsize_t errorCount = parser.getErrorCount();
+    parser->parse(is);
+    xsecsize_t errorCount = parser->getErrorCount();
     if (errorCount > 0)
         throw XSECException(XSECException::CipherError, "Errors occured during de-serialisation of decrypted element content");
 
-    DOMDocument * doc = parser.getDocument();
+    DOMDocument * doc = parser->getDocument();
 
     // Create a DocumentFragment to hold the children of the parsed doc element
     DOMDocument *ctxDocument = ctx->getOwnerDocument();
@@ -323,7 +550,7 @@ DOMDocumentFragment * XENCCipherImpl::deSerialise(safeBuffer &content, DOMNode *
     Janitor<DOMDocumentFragment> j_result(result);
 
     // Now get the children of the document into a DOC fragment
-    DOMNode * fragElt = doc->getDocumentElement();
+    DOMNode * fragElt = (doc != NULL ? doc->getDocumentElement() : NULL);
     DOMNode * child;
 
     if (fragElt != NULL) {
@@ -340,60 +567,486 @@ DOMDocumentFragment * XENCCipherImpl::deSerialise(safeBuffer &content, DOMNode *
 
     // Done!
 
+    j_parser.done();
     j_result.release();
     return result;
+
+}
+
+DOMDocumentFragment * XENCCipherImpl::deSerialise(safeBuffer &content, DOMNode * ctx) {
+
+    safeBuffer prefix;
+    makeFragmentPrefix(ctx, prefix);
+
+    const char * crcb = content.rawCharBuffer();
+    XENCFragmentInputSource is(prefix, NULL, (const XMLByte *) crcb, (xsecsize_t) strlen(crcb));
+
+    return parseFragment(is, ctx);
+
+}
+
+DOMDocumentFragment * XENCCipherImpl::deSerialise(TXFMBase * plainText, DOMNode * ctx) {
+
+    safeBuffer prefix;
+    makeFragmentPrefix(ctx, prefix);
+
+    XENCFragmentInputSource is(prefix, plainText, NULL, 0);
+
+    DOMDocumentFragment * result = parseFragment(is, ctx);
+
+    // The parser sees the plain text before the final block is checked.
+    // Unless it read through to the end (where a bad pad or GCM tag
+    // throws), the content cannot be trusted.
+    if (!is.isBodyRead()) {
+
+        result->release();
+        throw XSECException(XSECException::CipherError,
+            "XENCCipher::deSerialise - decrypted content was not read to completion");
+
+    }
+
+    return result;
+
 }
 
 // --------------------------------------------------------------------------------
 //			Decrypt an Element and replace in original document
 // --------------------------------------------------------------------------------
 
-XSECCryptoKey * XENCCipherImpl::decryptKeyFromKeyInfoList(DSIGKeyInfoList * kil) {
+namespace {
 
-    XSECCryptoKey * ret = NULL;
-    XSECAlgorithmHandler *handler;
+    bool isKeyWrapURI(const XMLCh * uri) {
 
-    int kLen = (int) kil->getSize();
+        return (strEquals(uri, DSIGConstants::s_unicodeStrURIKW_AES128) ||
+            strEquals(uri, DSIGConstants::s_unicodeStrURIKW_AES192) ||
+            strEquals(uri, DSIGConstants::s_unicodeStrURIKW_AES256) ||
+            strEquals(uri, DSIGConstants::s_unicodeStrURIKW_AES128_PAD) ||
+            strEquals(uri, DSIGConstants::s_unicodeStrURIKW_AES192_PAD) ||
+            strEquals(uri, DSIGConstants::s_unicodeStrURIKW_AES256_PAD) ||
+            strEquals(uri, DSIGConstants::s_unicodeStrURIKW_3DES));
+
+    }
+
+    // Base64 values may be broken over lines as the writer sees fit
+
+    bool base64Equals(const XMLCh * a, const XMLCh * b) {
+
+        if (a == NULL || b == NULL)
+            return false;
+
+        for (;;) {
+
+            while (*a != 0 && XMLChar1_0::isWhitespace(*a))
+                ++a;
+            while (*b != 0 && XMLChar1_0::isWhitespace(*b))
+                ++b;
+
+            if (*a != *b)
+                return false;
+            if (*a == 0)
+                return true;
+
+            ++a;
+            ++b;
+
+        }
+
+    }
+
+    // Distinguished names are written in many ways - "CN=A, O=B",
+    // "cn=A,o=B", "O=B, CN=A" (most significant first, as OpenSSL prints
+    // them) or with escapes, quotes and OIDs.  Each is reduced to a list
+    // of RDNs of the form TYPE=value: types upper cased with common
+    // aliases and OIDs mapped to one name, values unescaped, trimmed,
+    // with internal white space collapsed and lower cased.  Multi-valued
+    // RDNs have their parts sorted.
+
+    bool isDNSpace(char c) {
+
+        return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+
+    }
+
+    int hexValue(char c) {
+
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+
+    }
+
+    std::string normaliseDNType(const std::string & in) {
+
+        std::string t;
+        std::string::size_type i;
+
+        for (i = 0; i < in.size(); ++i)
+            if (!isDNSpace(in[i]))
+                t += (in[i] >= 'a' && in[i] <= 'z' ? (char) (in[i] - 'a' + 'A') : in[i]);
+
+        if (t.compare(0, 4, "OID.") == 0)
+            t.erase(0, 4);
+
+        static const char * const aliases[][2] = {
+            {"2.5.4.3", "CN"},
+            {"2.5.4.5", "SERIALNUMBER"},
+            {"2.5.4.6", "C"},
+            {"2.5.4.7", "L"},
+            {"2.5.4.8", "ST"},
+            {"S", "ST"},
+            {"2.5.4.9", "STREET"},
+            {"2.5.4.10", "O"},
+            {"2.5.4.11", "OU"},
+            {"2.5.4.12", "T"},
+            {"TITLE", "T"},
+            {"0.9.2342.19200300.100.1.1", "UID"},
+            {"USERID", "UID"},
+            {"0.9.2342.19200300.100.1.25", "DC"},
+            {"1.2.840.113549.1.9.1", "EMAILADDRESS"},
+            {"E", "EMAILADDRESS"},
+            {"EMAIL", "EMAILADDRESS"}
+        };
+
+        for (unsigned int j = 0; j < sizeof(aliases) / sizeof(aliases[0]); ++j)
+            if (t == aliases[j][0])
+                return aliases[j][1];
+
+        return t;
+
+    }
+
+    std::string normaliseDNValue(const std::string & in) {
+
+        std::string v;
+        bool space = false;
+        std::string::size_type i;
+
+        for (i = 0; i < in.size(); ++i) {
+
+            if (isDNSpace(in[i])) {
+                space = !v.empty();
+                continue;
+            }
 
-    for (int i = 0; ret == NULL && i < kLen; ++i) {
+            if (space)
+                v += ' ';
+            space = false;
 
-        if (kil->item(i)->getKeyInfoType() == DSIGKeyInfo::KEYINFO_ENCRYPTEDKEY) {
+            v += (in[i] >= 'A' && in[i] <= 'Z' ? (char) (in[i] - 'A' + 'a') : in[i]);
 
-            XENCEncryptedKey * ek = (XENCEncryptedKey*) (kil->item(i));
-            volatile XMLByte buffer[1024];
-            try {
-                // Have to cast off volatile
-                int keySize = decryptKey(ek, (XMLByte *) buffer, 1024);
+        }
+
+        return v;
+
+    }
+
+    bool parseDName(const XMLCh * dn, std::vector<std::string> & rdns) {
 
-                if (keySize > 0) {
-                    // Try to map the key
+        char * utf8 = transcodeToUTF8(dn);
+        if (utf8 == NULL)
+            return false;
 
-                    XENCEncryptionMethod * encryptionMethod = mp_encryptedData->getEncryptionMethod();
+        std::string in(utf8);
+        XSEC_RELEASE_XMLCH(utf8);
 
-                    if (encryptionMethod != NULL) {
+        std::vector<std::string> avas;
+        std::string type, value;
+        bool inType = true, inQuotes = false;
 
-                        handler = XSECPlatformUtils::g_algorithmMapper->mapURIToHandler(
-                            mp_encryptedData->getEncryptionMethod()->getAlgorithm());
+        for (std::string::size_type i = 0; i <= in.size(); ++i) {
+
+            char c = (i < in.size() ? in[i] : 0);
+
+            if (c == '\\' && i + 1 < in.size()) {
+
+                int h1 = hexValue(in[i + 1]);
+                int h2 = (i + 2 < in.size() ? hexValue(in[i + 2]) : -1);
+
+                if (h1 >= 0 && h2 >= 0) {
+                    c = (char) ((h1 << 4) | h2);
+                    i += 2;
+                }
+                else
+                    c = in[++i];
 
-                        if (handler != NULL)
-                            ret = handler->createKeyForURI(mp_encryptedData->getEncryptionMethod()->getAlgorithm(),
-                                (XMLByte *) buffer, keySize);
+                (inType ? type : value) += c;
+                continue;
+
+            }
+
+            if (c == '"' && !inType) {
+                inQuotes = !inQuotes;
+                continue;
+            }
+
+            if (c == '=' && inType && !inQuotes) {
+                inType = false;
+                continue;
+            }
+
+            if (c == 0 || (!inQuotes && (c == ',' || c == ';' || c == '+'))) {
+
+                if (inType) {
+                    // Nothing but white space (say a trailing separator)
+                    // is allowed without a type
+                    if (!normaliseDNType(type).empty())
+                        return false;
+                }
+                else
+                    avas.push_back(normaliseDNType(type) + "=" + normaliseDNValue(value));
+
+                type.erase();
+                value.erase();
+                inType = true;
+
+                if (c != '+' && !avas.empty()) {
+
+                    std::sort(avas.begin(), avas.end());
+
+                    std::string rdn;
+                    for (std::vector<std::string>::size_type j = 0; j < avas.size(); ++j) {
+                        if (j > 0)
+                            rdn += '+';
+                        rdn += avas[j];
                     }
+
+                    rdns.push_back(rdn);
+                    avas.clear();
+
                 }
+
+                continue;
+
+            }
+
+            (inType ? type : value) += c;
+
+        }
+
+        return !inQuotes && !rdns.empty();
+
+    }
+
+    bool dnEquals(const XMLCh * a, const XMLCh * b) {
+
+        if (a == NULL || b == NULL)
+            return false;
+
+        std::vector<std::string> ra, rb;
+
+        if (!parseDName(a, ra) || !parseDName(b, rb))
+            return strEquals(a, b);
+
+        return (ra == rb ||
+            (ra.size() == rb.size() && std::equal(ra.begin(), ra.end(), rb.rbegin())));
+
+    }
+
+    // Serial numbers are decimal integers, so leading zeros (or a sign)
+    // do not make them different
+
+    bool serialEquals(const XMLCh * a, const XMLCh * b) {
+
+        if (a == NULL || b == NULL)
+            return false;
+
+        const XMLCh * pa = a, * pb = b;
+
+        while (XMLChar1_0::isWhitespace(*pa))
+            ++pa;
+        while (XMLChar1_0::isWhitespace(*pb))
+            ++pb;
+
+        if (*pa == chPlus)
+            ++pa;
+        if (*pb == chPlus)
+            ++pb;
+
+        while (*pa == chDigit_0 && pa[1] >= chDigit_0 && pa[1] <= chDigit_9)
+            ++pa;
+        while (*pb == chDigit_0 && pb[1] >= chDigit_0 && pb[1] <= chDigit_9)
+            ++pb;
+
+        for (;; ++pa, ++pb) {
+
+            bool endA = (*pa == 0 || XMLChar1_0::isWhitespace(*pa));
+            bool endB = (*pb == 0 || XMLChar1_0::isWhitespace(*pb));
+
+            if (endA || endB)
+                return (endA && endB);
+
+            if (*pa < chDigit_0 || *pa > chDigit_9)
+                return strEquals(a, b);
+
+            if (*pa != *pb)
+                return false;
+
+        }
+
+    }
+
+}
+
+XENCCipherImpl::KEKMatch XENCCipherImpl::matchKEK(XENCEncryptedKey * encryptedKey) {
+
+    // Compare what the KeyInfo of the EncryptedKey says about the key it
+    // was made for with the identity of the KEK.  Only values we have
+    // count - a KeyName is no evidence against a KEK known only by its
+    // certificate.
+
+    KEKMatch ret = KEK_MATCH_UNKNOWN;
+
+    DSIGKeyInfoList * kil = encryptedKey->getKeyInfoList();
+    int size = (kil != NULL ? (int) kil->getSize() : 0);
+
+    for (int i = 0; i < size; ++i) {
+
+        DSIGKeyInfo * ki = kil->item(i);
+
+        if (ki->getKeyInfoType() == DSIGKeyInfo::KEYINFO_NAME) {
+
+            if (mp_kekName != NULL && ki->getKeyName() != NULL) {
+                if (strEquals(ki->getKeyName(), mp_kekName))
+                    return KEK_MATCH_YES;
+                ret = KEK_MATCH_NO;
+            }
+
+        }
+        else if (ki->getKeyInfoType() == DSIGKeyInfo::KEYINFO_X509) {
+
+            DSIGKeyInfoX509 * x509 = (DSIGKeyInfoX509 *) ki;
+
+            if (mp_kekIssuerName != NULL && mp_kekSerialNumber != NULL &&
+                x509->getX509IssuerName() != NULL && x509->getX509IssuerSerialNumber() != NULL) {
+
+                if (dnEquals(x509->getX509IssuerName(), mp_kekIssuerName) &&
+                    serialEquals(x509->getX509IssuerSerialNumber(), mp_kekSerialNumber))
+                    return KEK_MATCH_YES;
+                ret = KEK_MATCH_NO;
+
             }
 
-            catch (XSECCryptoException &) {
-                /* Do nothing - this is likely to be a bad decrypt on a public key */
-            } catch (...) {
-                memset((void *) buffer, 0, 1024);
-                throw;
+            if (mp_kekSKI != NULL && x509->getX509SKI() != NULL) {
+
+                if (base64Equals(x509->getX509SKI(), mp_kekSKI))
+                    return KEK_MATCH_YES;
+                ret = KEK_MATCH_NO;
+
+            }
+
+            // A digest by another algorithm cannot be compared
+            if (mp_kekDigest != NULL && x509->getX509DigestValue() != NULL &&
+                strEquals(x509->getX509DigestAlgorithm(), mp_kekDigestAlgorithm)) {
+
+                if (base64Equals(x509->getX509DigestValue(), mp_kekDigest))
+                    return KEK_MATCH_YES;
+                ret = KEK_MATCH_NO;
+
             }
 
-            // Clear out the key buffer
-            memset((void *) buffer, 0, 1024);
         }
+
+    }
+
+    return ret;
+
+}
+
+XSECCryptoKey * XENCCipherImpl::decryptKeyFromEncryptedKey(XENCEncryptedKey * ek) {
+
+    XSECCryptoKey * ret = NULL;
+    XSECAlgorithmHandler *handler;
+
+    volatile XMLByte buffer[1024];
+    try {
+        // Have to cast off volatile
+        int keySize = decryptKey(ek, (XMLByte *) buffer, 1024);
+
+        if (keySize > 0) {
+            // Try to map the key
+
+            XENCEncryptionMethod * encryptionMethod = mp_encryptedData->getEncryptionMethod();
+
+            if (encryptionMethod != NULL) {
+
+                handler = XSECPlatformUtils::g_algorithmMapper->mapURIToHandler(
+                    mp_encryptedData->getEncryptionMethod()->getAlgorithm());
+
+                if (handler != NULL)
+                    ret = handler->createKeyForURI(mp_encryptedData->getEncryptionMethod()->getAlgorithm(),
+                        (XMLByte *) buffer, keySize);
+            }
+        }
+    }
+
+    catch (XSECCryptoException &) {
+        /* Do nothing - this is likely to be a bad decrypt on a public key */
+    } catch (...) {
+        memset((void *) buffer, 0, 1024);
+        throw;
+    }
+
+    // Clear out the key buffer
+    memset((void *) buffer, 0, 1024);
+
+    return ret;
+}
+
+XSECCryptoKey * XENCCipherImpl::decryptKeyFromKeyInfoList(DSIGKeyInfoList * kil) {
+
+    // Without an identity for the KEK, each EncryptedKey is tried in turn.
+    // With one, those that identify the KEK go first, then those that
+    // say nothing comparable, and those that appear to be for other
+    // recipients last - the identity may simply be written differently.
+
+    bool haveIdentity = (mp_kekName != NULL || mp_kekIssuerName != NULL ||
+        mp_kekSKI != NULL || mp_kekDigest != NULL);
+
+    std::vector<XENCEncryptedKey *> candidates, unknown, others;
+
+    int kLen = (int) kil->getSize();
+
+    for (int i = 0; i < kLen; ++i) {
+
+        if (kil->item(i)->getKeyInfoType() != DSIGKeyInfo::KEYINFO_ENCRYPTEDKEY)
+            continue;
+
+        XENCEncryptedKey * ek = (XENCEncryptedKey*) (kil->item(i));
+
+        if (!haveIdentity) {
+            candidates.push_back(ek);
+            continue;
+        }
+
+        switch (matchKEK(ek)) {
+
+        case KEK_MATCH_YES :
+            candidates.push_back(ek);
+            break;
+        case KEK_MATCH_UNKNOWN :
+            unknown.push_back(ek);
+            break;
+        default :
+            others.push_back(ek);
+            break;
+
+        }
+
     }
 
+    candidates.insert(candidates.end(), unknown.begin(), unknown.end());
+    candidates.insert(candidates.end(), others.begin(), others.end());
+
+    XSECCryptoKey * ret = NULL;
+
+    std::vector<XENCEncryptedKey *>::iterator it;
+    for (it = candidates.begin(); ret == NULL && it != candidates.end(); ++it)
+        ret = decryptKeyFromEncryptedKey(*it);
+
     return ret;
 }
 
@@ -507,14 +1160,7 @@ DOMNode * XENCCipherImpl::decryptElementDetached(void) {
 
     }
 
-    safeBuffer sb("");
-    unsigned int decryptLen;
-
-    if (handler != NULL) {
-
-        decryptLen = handler->decryptToSafeBuffer(c, mp_encryptedData->getEncryptionMethod(), mp_key,
-            mp_env->getParentDocument(), sb);
-    } else {
+    if (handler == NULL) {
 
         // Very strange if we get here - any problems should throw an
         // exception in the AlgorithmMapper.
@@ -524,10 +1170,45 @@ DOMNode * XENCCipherImpl::decryptElementDetached(void) {
 
     }
 
+    DOMElement * element = mp_encryptedData->getElement();
+
+    // Bulk symmetric ciphers can be decrypted as a stream, which lets the
+    // parser read the plain text directly from the cipher transform.  Key
+    // wrap algorithms can only be decrypted to a buffer.
+    TXFMBase * last = c->getLastTxfm();
+    if (encryptionMethod != NULL &&
+        mp_key->getKeyType() == XSECCryptoKey::KEY_SYMMETRIC &&
+        !isKeyWrapURI(encryptionMethod->getAlgorithm()) &&
+        handler->appendDecryptCipherTXFM(c, mp_encryptedData->getEncryptionMethod(), mp_key,
+            mp_env->getParentDocument()) == true) {
+
+        // The parser sees plain text before the padding or tag has been
+        // checked, so how it fails must not tell anyone about the plain
+        // text - every failure is reported the same way.
+        try {
+            return deSerialise(c->getLastTxfm(), element);
+        }
+        catch (...) {
+            throw XSECException(XSECException::CipherError,
+                "XENCCipherImpl::decryptElement - unable to decrypt the element");
+        }
+
+    }
+
+    if (c->getLastTxfm() != last) {
+        throw XSECException(XSECException::CipherError,
+            "XENCCipherImpl::decryptElement - error appending final transform");
+    }
+
+    safeBuffer sb("");
+    unsigned int decryptLen;
+
+    decryptLen = handler->decryptToSafeBuffer(c, mp_encryptedData->getEncryptionMethod(), mp_key,
+        mp_env->getParentDocument(), sb);
+
     sb[decryptLen] = '\0';
 
     // Now de-serialise
-    DOMElement * element = mp_encryptedData->getElement();
     DOMDocumentFragment * frag = deSerialise(sb, element);
 
     return frag;
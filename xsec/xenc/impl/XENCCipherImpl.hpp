@@ -38,11 +38,14 @@ class safeBuffer;
 class XSECProvider;
 class XENCEncryptedDataImpl;
 class TXFMChain;
+class TXFMBase;
 class XSECEnv;
 class XSECKeyInfoResolver;
 class XSECPlatformUtils;
 class DSIGKeyInfoList;
 
+XSEC_DECLARE_XERCES_CLASS(InputSource);
+
 XSEC_DECLARE_XERCES_CLASS(DOMNode);
 XSEC_DECLARE_XERCES_CLASS(DOMDocumentFragment);
 
@@ -125,6 +128,12 @@ public:
 	// Setter methods
 	void setKey(XSECCryptoKey * key);
 	void setKEK(XSECCryptoKey * key);
+	void setKEKIdentity(const XMLCh * keyName,
+		const XMLCh * issuerName = NULL,
+		const XMLCh * serialNumber = NULL,
+		const XMLCh * ski = NULL,
+		const XMLCh * digestAlgorithm = NULL,
+		const XMLCh * digest = NULL);
 	void setKeyInfoResolver(const XSECKeyInfoResolver * resolver);
 
 	void setXENCNSPrefix(const XMLCh * prefix);
@@ -160,7 +169,30 @@ private:
 								safeBuffer &content, 
 								XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * ctx
 							);
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocumentFragment 
+							* deSerialise(
+								TXFMBase * plainText, 
+								XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * ctx
+							);
+	void makeFragmentPrefix(XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * ctx, 
+							safeBuffer & prefix);
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocumentFragment 
+							* parseFragment(
+								XERCES_CPP_NAMESPACE_QUALIFIER InputSource & is, 
+								XERCES_CPP_NAMESPACE_QUALIFIER DOMNode * ctx
+							);
 	XSECCryptoKey * decryptKeyFromKeyInfoList(DSIGKeyInfoList * kil);
+	XSECCryptoKey * decryptKeyFromEncryptedKey(XENCEncryptedKey * encryptedKey);
+
+	// Does an EncryptedKey identify the KEK?
+	enum KEKMatch {
+		KEK_MATCH_UNKNOWN,		// Nothing to compare
+		KEK_MATCH_YES,
+		KEK_MATCH_NO
+	};
+
+	KEKMatch matchKEK(XENCEncryptedKey * encryptedKey);
+	void releaseKEKIdentity(void);
 
 	// Unimplemented constructor
 	XENCCipherImpl();
@@ -179,6 +211,14 @@ private:
 	XSECCryptoKey			* mp_kek;
 	bool					m_kekDerived;		// Was this derived or loaded?
 
+	// Identity of the KEK
+	XMLCh					* mp_kekName;
+	XMLCh					* mp_kekIssuerName;
+	XMLCh					* mp_kekSerialNumber;
+	XMLCh					* mp_kekSKI;
+	XMLCh					* mp_kekDigestAlgorithm;
+	XMLCh					* mp_kekDigest;
+
 	// Environment
 	XSECEnv					* mp_env;
 